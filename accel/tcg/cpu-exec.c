@@ -460,6 +460,40 @@ static inline void tb_add_jump(CPUState *cpu, TranslationBlock *tb, int n,
     return;
 }
 
+#ifndef CONFIG_USER_ONLY
+/*
+ * Record the TLB addend of the destination page for jump @n of @tb,
+ * if the jump is guarded by translator_xpage_guard.  Return false if
+ * the jump must not be chained to @tb_next.
+ */
+static bool tb_set_jmp_page_addend(CPUState *cpu, TranslationBlock *tb, int n,
+                                   TranslationBlock *tb_next)
+{
+    tb_page_addr_t phys_page;
+    uintptr_t old, addend;
+    void *host;
+
+    if (qatomic_read(&tb->jmp_page_addend[n]) == TB_JMP_PAGE_ADDEND_NONE) {
+        return true;
+    }
+
+    /*
+     * tb_next may have been found in the jump cache, so make sure that the
+     * TLB entry the guard checks is present and maps the page of tb_next.
+     */
+    phys_page = get_page_addr_code_hostp(cpu->env_ptr, tb_next->pc, &host);
+    if (phys_page == -1 ||
+        (phys_page & TARGET_PAGE_MASK) != tb_next->page_addr[0]) {
+        return false;
+    }
+    addend = (uintptr_t)host - tb_next->pc;
+
+    old = qatomic_cmpxchg(&tb->jmp_page_addend[n], TB_JMP_PAGE_ADDEND_UNSET,
+                          addend);
+    return old == TB_JMP_PAGE_ADDEND_UNSET || old == addend;
+}
+#endif
+
 static inline TranslationBlock *tb_find(CPUState *cpu,
                                         TranslationBlock *last_tb,
                                         int tb_exit, uint32_t cf_mask)
@@ -484,6 +518,10 @@ static inline TranslationBlock *tb_find(CPUState *cpu,
     if (tb->page_addr[1] != -1) {
         last_tb = NULL;
     }
+    /* Jumps to another page are guarded by a check of the TLB. */
+    if (last_tb && !tb_set_jmp_page_addend(cpu, last_tb, tb_exit, tb)) {
+        last_tb = NULL;
+    }
 #endif
     /* See if we can patch the calling TB. */
     if (last_tb) {
@@ -41,6 +41,12 @@
  * optimization to avoid generating redundant operations. For instance, for the
  * second and all subsequent callbacks of an event, we do not need to reload the
  * CPU's index into a TCG temp, since the first callback did it already.
+ *
+ * TB and instruction callbacks, as well as all inline operations, are instead
+ * generated from scratch right before their empty callback, which is then
+ * removed. This is what allows them to contain branches (for conditional
+ * callbacks) and to address per-vCPU scoreboards; memory callbacks still need
+ * the copying scheme since they refer to the address temp of the access.
  */
 #include "qemu/osdep.h"
 #include "cpu.h"
@@ -126,8 +132,7 @@ static void gen_empty_udata_cb(void)
 }
 
 /*
- * For now we only support addi_i64.
- * When we support more ops, we can generate one empty inline cb for each.
+ * Only a placeholder: the actual inline ops are generated when injecting.
  */
 static void gen_empty_inline_cb(void)
 {
@@ -320,22 +325,6 @@ static TCGOp *copy_const_ptr(TCGOp **begin_op, TCGOp *op, void *ptr)
     return op;
 }
 
-static TCGOp *copy_const_i64(TCGOp **begin_op, TCGOp *op, uint64_t v)
-{
-    if (TCG_TARGET_REG_BITS == 32) {
-        /* 2x mov_i32 */
-        op = copy_op(begin_op, op, INDEX_op_mov_i32);
-        op->args[1] = tcgv_i32_arg(tcg_constant_i32(v));
-        op = copy_op(begin_op, op, INDEX_op_mov_i32);
-        op->args[1] = tcgv_i32_arg(tcg_constant_i32(v >> 32));
-    } else {
-        /* mov_i64 */
-        op = copy_op(begin_op, op, INDEX_op_mov_i64);
-        op->args[1] = tcgv_i64_arg(tcg_constant_i64(v));
-    }
-    return op;
-}
-
 static TCGOp *copy_extu_tl_i64(TCGOp **begin_op, TCGOp *op)
 {
     if (TARGET_LONG_BITS == 32) {
@@ -348,19 +337,6 @@ static TCGOp *copy_extu_tl_i64(TCGOp **begin_op, TCGOp *op)
     return op;
 }
 
-static TCGOp *copy_ld_i64(TCGOp **begin_op, TCGOp *op)
-{
-    if (TCG_TARGET_REG_BITS == 32) {
-        /* 2x ld_i32 */
-        op = copy_op(begin_op, op, INDEX_op_ld_i32);
-        op = copy_op(begin_op, op, INDEX_op_ld_i32);
-    } else {
-        /* ld_i64 */
-        op = copy_op(begin_op, op, INDEX_op_ld_i64);
-    }
-    return op;
-}
-
 static TCGOp *copy_st_i64(TCGOp **begin_op, TCGOp *op)
 {
     if (TCG_TARGET_REG_BITS == 32) {
@@ -374,18 +350,6 @@ static TCGOp *copy_st_i64(TCGOp **begin_op, TCGOp *op)
     return op;
 }
 
-static TCGOp *copy_add_i64(TCGOp **begin_op, TCGOp *op)
-{
-    if (TCG_TARGET_REG_BITS == 32) {
-        /* all 32-bit backends must implement add2_i32 */
-        g_assert(TCG_TARGET_HAS_add2_i32);
-        op = copy_op(begin_op, op, INDEX_op_add2_i32);
-    } else {
-        op = copy_op(begin_op, op, INDEX_op_add_i64);
-    }
-    return op;
-}
-
 static TCGOp *copy_st_ptr(TCGOp **begin_op, TCGOp *op)
 {
     if (UINTPTR_MAX == UINT32_MAX) {
@@ -431,49 +395,6 @@ static TCGOp *copy_call(TCGOp **begin_op, TCGOp *op, void *empty_func,
     return op;
 }
 
-static TCGOp *append_udata_cb(const struct qemu_plugin_dyn_cb *cb,
-                              TCGOp *begin_op, TCGOp *op, int *cb_idx)
-{
-    /* const_ptr */
-    op = copy_const_ptr(&begin_op, op, cb->userp);
-
-    /* copy the ld_i32, but note that we only have to copy it once */
-    begin_op = QTAILQ_NEXT(begin_op, link);
-    tcg_debug_assert(begin_op && begin_op->opc == INDEX_op_ld_i32);
-    if (*cb_idx == -1) {
-        op = tcg_op_insert_after(tcg_ctx, op, INDEX_op_ld_i32);
-        memcpy(op->args, begin_op->args, sizeof(op->args));
-    }
-
-    /* call */
-    op = copy_call(&begin_op, op, HELPER(plugin_vcpu_udata_cb),
-                   cb->f.vcpu_udata, cb->tcg_flags, cb_idx);
-
-    return op;
-}
-
-static TCGOp *append_inline_cb(const struct qemu_plugin_dyn_cb *cb,
-                               TCGOp *begin_op, TCGOp *op,
-                               int *unused)
-{
-    /* const_ptr */
-    op = copy_const_ptr(&begin_op, op, cb->userp);
-
-    /* ld_i64 */
-    op = copy_ld_i64(&begin_op, op);
-
-    /* const_i64 */
-    op = copy_const_i64(&begin_op, op, cb->inline_insn.imm);
-
-    /* add_i64 */
-    op = copy_add_i64(&begin_op, op);
-
-    /* st_i64 */
-    op = copy_st_i64(&begin_op, op);
-
-    return op;
-}
-
 static TCGOp *append_mem_cb(const struct qemu_plugin_dyn_cb *cb,
                             TCGOp *begin_op, TCGOp *op, int *cb_idx)
 {
@@ -554,16 +475,149 @@ void inject_cb_type(const GArray *cbs, TCGOp *begin_op, inject_fn inject,
     rm_ops_range(begin_op, end_op);
 }
 
+/* Return the address of the uint64_t operand of @cb for the current vCPU */
+static TCGv_ptr gen_plugin_u64_ptr(const struct qemu_plugin_dyn_cb *cb)
+{
+    TCGv_ptr ptr = tcg_temp_new_ptr();
+
+    if (cb->entry.score) {
+        GArray *data = cb->entry.score->data;
+        char *base = data->data + cb->entry.offset;
+        TCGv_i32 cpu_index = tcg_temp_new_i32();
+
+        tcg_gen_ld_i32(cpu_index, cpu_env,
+                       -offsetof(ArchCPU, env) + offsetof(CPUState, cpu_index));
+        tcg_gen_muli_i32(cpu_index, cpu_index,
+                         g_array_get_element_size(data));
+        tcg_gen_ext_i32_ptr(ptr, cpu_index);
+        tcg_gen_addi_ptr(ptr, ptr, (intptr_t)base);
+        tcg_temp_free_i32(cpu_index);
+    } else {
+        tcg_gen_movi_ptr(ptr, (intptr_t)cb->userp);
+    }
+    return ptr;
+}
+
+static TCGCond plugin_cond_to_tcgcond(enum qemu_plugin_cond cond)
+{
+    switch (cond) {
+    case QEMU_PLUGIN_COND_EQ:
+        return TCG_COND_EQ;
+    case QEMU_PLUGIN_COND_NE:
+        return TCG_COND_NE;
+    case QEMU_PLUGIN_COND_LT:
+        return TCG_COND_LTU;
+    case QEMU_PLUGIN_COND_LE:
+        return TCG_COND_LEU;
+    case QEMU_PLUGIN_COND_GT:
+        return TCG_COND_GTU;
+    case QEMU_PLUGIN_COND_GE:
+        return TCG_COND_GEU;
+    default:
+        /* ALWAYS and NEVER are handled when registering */
+        g_assert_not_reached();
+    }
+}
+
+static void gen_udata_cb(const struct qemu_plugin_dyn_cb *cb)
+{
+    TCGLabel *skip = NULL;
+    TCGv_i32 cpu_index;
+    TCGv_ptr udata;
+    TCGOp *op;
+    int func_idx;
+
+    if (cb->cond.cond != QEMU_PLUGIN_COND_ALWAYS) {
+        TCGCond cond = plugin_cond_to_tcgcond(cb->cond.cond);
+        TCGv_ptr ptr = gen_plugin_u64_ptr(cb);
+        TCGv_i64 val = tcg_temp_new_i64();
+
+        skip = gen_new_label();
+        tcg_gen_ld_i64(val, ptr, 0);
+        tcg_gen_brcondi_i64(tcg_invert_cond(cond), val, cb->cond.imm, skip);
+        tcg_temp_free_i64(val);
+        tcg_temp_free_ptr(ptr);
+    }
+
+    cpu_index = tcg_temp_new_i32();
+    udata = tcg_const_ptr(cb->userp);
+    tcg_gen_ld_i32(cpu_index, cpu_env,
+                   -offsetof(ArchCPU, env) + offsetof(CPUState, cpu_index));
+    gen_helper_plugin_vcpu_udata_cb(cpu_index, udata);
+    tcg_temp_free_ptr(udata);
+    tcg_temp_free_i32(cpu_index);
+
+    /* point the call we just emitted to the plugin's callback */
+    op = QTAILQ_PREV(tcg_ctx->emit_before_op, link);
+    tcg_debug_assert(op->opc == INDEX_op_call);
+    func_idx = TCGOP_CALLO(op) + TCGOP_CALLI(op);
+    tcg_debug_assert(op->args[func_idx] ==
+                     (uintptr_t)HELPER(plugin_vcpu_udata_cb));
+    op->args[func_idx] = (uintptr_t)cb->f.vcpu_udata;
+    op->args[func_idx + 1] = cb->tcg_flags;
+
+    if (skip) {
+        gen_set_label(skip);
+    }
+}
+
+static void gen_inline_cb(const struct qemu_plugin_dyn_cb *cb)
+{
+    TCGv_ptr ptr = gen_plugin_u64_ptr(cb);
+    TCGv_i64 val = tcg_temp_new_i64();
+
+    switch (cb->inline_insn.op) {
+    case QEMU_PLUGIN_INLINE_ADD_U64:
+        tcg_gen_ld_i64(val, ptr, 0);
+        tcg_gen_addi_i64(val, val, cb->inline_insn.imm);
+        break;
+    case QEMU_PLUGIN_INLINE_STORE_U64:
+        tcg_gen_movi_i64(val, cb->inline_insn.imm);
+        break;
+    default:
+        g_assert_not_reached();
+    }
+    tcg_gen_st_i64(val, ptr, 0);
+
+    tcg_temp_free_i64(val);
+    tcg_temp_free_ptr(ptr);
+}
+
+typedef void (*gen_cb_fn)(const struct qemu_plugin_dyn_cb *cb);
+
+/* generate @cbs right before @begin_op, then remove the empty callback */
+static void gen_cb_type(const GArray *cbs, TCGOp *begin_op, gen_cb_fn gen,
+                        op_ok_fn ok)
+{
+    TCGOp *end_op = find_op(begin_op, INDEX_op_plugin_cb_end);
+    int i;
+
+    tcg_debug_assert(end_op);
+    if (cbs && cbs->len) {
+        tcg_ctx->emit_before_op = begin_op;
+        for (i = 0; i < cbs->len; i++) {
+            struct qemu_plugin_dyn_cb *cb =
+                &g_array_index(cbs, struct qemu_plugin_dyn_cb, i);
+
+            if (ok(begin_op, cb)) {
+                gen(cb);
+            }
+        }
+        tcg_ctx->emit_before_op = NULL;
+    }
+    rm_ops_range(begin_op, end_op);
+}
+
 static void
 inject_udata_cb(const GArray *cbs, TCGOp *begin_op)
 {
-    inject_cb_type(cbs, begin_op, append_udata_cb, op_ok);
+    gen_cb_type(cbs, begin_op, gen_udata_cb, op_ok);
 }
 
 static void
 inject_inline_cb(const GArray *cbs, TCGOp *begin_op, op_ok_fn ok)
 {
-    inject_cb_type(cbs, begin_op, append_inline_cb, ok);
+    gen_cb_type(cbs, begin_op, gen_inline_cb, ok);
 }
 
 static void
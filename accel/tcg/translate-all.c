@@ -112,14 +112,48 @@ typedef struct PageDesc {
        of lookups we do to a given page to use a bitmap */
     unsigned long *code_bitmap;
     unsigned int code_write_count;
-#else
-    unsigned long flags;
 #endif
 #ifndef CONFIG_USER_ONLY
     QemuSpin lock;
 #endif
 } PageDesc;
 
+#ifdef CONFIG_USER_ONLY
+/*
+ * In user-mode emulation the flags of guest pages are kept in a tree of
+ * non-overlapping ranges, so that mapping, protecting and unmapping
+ * memory costs time in the number of mappings rather than in their size.
+ * A PageDesc is only allocated for the pages that hold translated code.
+ */
+typedef struct PageFlagsNode {
+    target_ulong start;
+    target_ulong last;          /* inclusive */
+    int flags;
+} PageFlagsNode;
+
+/*
+ * The tree is only modified with both mmap_lock and pageflags_lock held
+ * for writing, so lookups need either of the two.  Readers that do not
+ * hold mmap_lock thus never wait for the translator or for another
+ * thread's mmap, only for the tree update itself.
+ */
+static GTree *pageflags_root;
+static pthread_rwlock_t pageflags_lock = PTHREAD_RWLOCK_INITIALIZER;
+
+/* Overlapping ranges compare equal, as in util/iova-tree.c */
+static gint pageflags_cmp(gconstpointer a, gconstpointer b)
+{
+    const PageFlagsNode *pa = a, *pb = b;
+
+    if (pa->last < pb->start) {
+        return -1;
+    } else if (pa->start > pb->last) {
+        return 1;
+    }
+    return 0;
+}
+#endif
+
 /**
  * struct page_entry - page descriptor entry
  * @pd:     pointer to the &struct PageDesc of the page this entry represents
@@ -424,6 +458,9 @@ static void page_init(void)
 {
     page_size_init();
     page_table_config_init();
+#ifdef CONFIG_USER_ONLY
+    pageflags_root = g_tree_new(pageflags_cmp);
+#endif
 
 #if defined(CONFIG_BSD) && defined(CONFIG_USER_ONLY)
     {
@@ -562,6 +599,154 @@ static inline PageDesc *page_find(tb_page_addr_t index)
     return page_find_alloc(index, 0);
 }
 
+#ifdef CONFIG_USER_ONLY
+/*
+ * Like page_find(), but if @index has no PageDesc because one of the
+ * tables leading to it is not allocated, store in @skip how many pages,
+ * starting at @index, the missing table would have covered.
+ */
+static PageDesc *page_find_sparse(tb_page_addr_t index, tb_page_addr_t *skip)
+{
+    void **lp = l1_map + ((index >> v_l1_shift) & (v_l1_size - 1));
+    int i;
+
+    for (i = v_l2_levels; i >= 0; i--) {
+        void *p = qatomic_rcu_read(lp);
+
+        if (p == NULL) {
+            tb_page_addr_t span = (tb_page_addr_t)1 << ((i + 1) * V_L2_BITS);
+
+            *skip = span - (index & (span - 1));
+            return NULL;
+        }
+        if (i == 0) {
+            return (PageDesc *)p + (index & (V_L2_SIZE - 1));
+        }
+        lp = (void **)p + ((index >> (i * V_L2_BITS)) & (V_L2_SIZE - 1));
+    }
+    g_assert_not_reached();
+}
+
+static PageFlagsNode *pageflags_find(target_ulong start, target_ulong last)
+{
+    PageFlagsNode key = { .start = start, .last = last };
+
+    return g_tree_lookup(pageflags_root, &key);
+}
+
+/*
+ * Look up the range that contains @addr, returning false if there is
+ * none.  Safe without mmap_lock held.
+ */
+static bool pageflags_get(target_ulong addr, int *flags, target_ulong *last)
+{
+    bool locked = have_mmap_lock();
+    PageFlagsNode *p;
+
+    if (!locked) {
+        pthread_rwlock_rdlock(&pageflags_lock);
+    }
+    p = pageflags_find(addr, addr);
+    if (p) {
+        *flags = p->flags;
+        *last = p->last;
+    }
+    if (!locked) {
+        pthread_rwlock_unlock(&pageflags_lock);
+    }
+    return p != NULL;
+}
+
+/* Add [@start, @last] with @flags, merging it with equal neighbours */
+static void pageflags_insert(target_ulong start, target_ulong last, int flags)
+{
+    PageFlagsNode *p;
+
+    if (start > 0) {
+        p = pageflags_find(start - 1, start - 1);
+        if (p && p->flags == flags) {
+            g_tree_steal(pageflags_root, p);
+            start = p->start;
+            g_free(p);
+        }
+    }
+    if (last < (target_ulong)-1) {
+        p = pageflags_find(last + 1, last + 1);
+        if (p && p->flags == flags) {
+            g_tree_steal(pageflags_root, p);
+            last = p->last;
+            g_free(p);
+        }
+    }
+
+    p = g_new(PageFlagsNode, 1);
+    p->start = start;
+    p->last = last;
+    p->flags = flags;
+    g_tree_insert(pageflags_root, p, p);
+}
+
+/*
+ * Update the flags of the pages in [@start, @last].  With @fill the
+ * whole range gets @set as its flags, otherwise only the pages that
+ * are already mapped change their flags to (flags & ~@clear) | @set.
+ */
+static void pageflags_update(target_ulong start, target_ulong last,
+                             int set, int clear, bool fill)
+{
+    GPtrArray *old = g_ptr_array_new_with_free_func(g_free);
+    PageFlagsNode *p;
+    guint i;
+
+    assert_memory_lock();
+    pthread_rwlock_wrlock(&pageflags_lock);
+
+    while ((p = pageflags_find(start, last)) != NULL) {
+        g_tree_steal(pageflags_root, p);
+        g_ptr_array_add(old, p);
+    }
+
+    for (i = 0; i < old->len; i++) {
+        p = g_ptr_array_index(old, i);
+
+        if (p->start < start) {
+            pageflags_insert(p->start, start - 1, p->flags);
+        }
+        if (p->last > last) {
+            pageflags_insert(last + 1, p->last, p->flags);
+        }
+        if (!fill) {
+            int flags = (p->flags & ~clear) | set;
+
+            if (flags) {
+                pageflags_insert(MAX(p->start, start), MIN(p->last, last),
+                                 flags);
+            }
+        }
+    }
+    if (fill && set) {
+        pageflags_insert(start, last, set);
+    }
+
+    pthread_rwlock_unlock(&pageflags_lock);
+    g_ptr_array_free(old, true);
+}
+
+void page_fork_start(void)
+{
+    pthread_rwlock_wrlock(&pageflags_lock);
+}
+
+void page_fork_end(int child)
+{
+    if (child) {
+        pthread_rwlock_init(&pageflags_lock, NULL);
+    } else {
+        pthread_rwlock_unlock(&pageflags_lock);
+    }
+}
+#endif
+
 static void page_lock_pair(PageDesc **ret_p1, tb_page_addr_t phys1,
                            PageDesc **ret_p2, tb_page_addr_t phys2, int alloc);
 
@@ -1742,9 +1927,8 @@ static inline void tb_page_add(PageDesc *p, TranslationBlock *tb,
     invalidate_page_bitmap(p);
 
 #if defined(CONFIG_USER_ONLY)
-    if (p->flags & PAGE_WRITE) {
+    if (page_get_flags(page_addr) & PAGE_WRITE) {
         target_ulong addr;
-        PageDesc *p2;
         int prot;
 
         /* force the host page as non writable (writes will have a
@@ -1753,14 +1937,10 @@ static inline void tb_page_add(PageDesc *p, TranslationBlock *tb,
         prot = 0;
         for (addr = page_addr; addr < page_addr + qemu_host_page_size;
             addr += TARGET_PAGE_SIZE) {
-
-            p2 = page_find(addr >> TARGET_PAGE_BITS);
-            if (!p2) {
-                continue;
-            }
-            prot |= p2->flags;
-            p2->flags &= ~PAGE_WRITE;
-          }
+            prot |= page_get_flags(addr);
+        }
+        pageflags_update(page_addr, page_addr + qemu_host_page_size - 1,
+                         0, PAGE_WRITE, false);
         mprotect(g2h(page_addr), qemu_host_page_size,
                  (prot & PAGE_BITS) & ~PAGE_WRITE);
         if (DEBUG_TB_INVALIDATE_GATE) {
@@ -1933,6 +2113,10 @@ TranslationBlock *tb_gen_code(CPUState *cpu,
 
     tcg_func_start(tcg_ctx);
 
+    /* The translator marks the jumps that it guards. */
+    tb->jmp_page_addend[0] = TB_JMP_PAGE_ADDEND_NONE;
+    tb->jmp_page_addend[1] = TB_JMP_PAGE_ADDEND_NONE;
+
     tcg_ctx->cpu = env_cpu(env);
     gen_intermediate_code(cpu, tb, max_insns);
     tcg_ctx->cpu = NULL;
@@ -2619,84 +2803,49 @@ struct walk_memory_regions_data {
     walk_memory_regions_fn fn;
     void *priv;
     target_ulong start;
+    target_ulong end;
     int prot;
+    int rc;
 };
 
-static int walk_memory_regions_end(struct walk_memory_regions_data *data,
-                                   target_ulong end, int new_prot)
+static gboolean walk_memory_regions_1(gpointer key, gpointer value,
+                                      gpointer opaque)
 {
-    if (data->start != -1u) {
-        int rc = data->fn(data->priv, data->start, end, data->prot);
-        if (rc != 0) {
-            return rc;
-        }
-    }
-
-    data->start = (new_prot ? end : -1u);
-    data->prot = new_prot;
+    struct walk_memory_regions_data *data = opaque;
+    PageFlagsNode *p = key;
 
-    return 0;
-}
-
-static int walk_memory_regions_1(struct walk_memory_regions_data *data,
-                                 target_ulong base, int level, void **lp)
-{
-    target_ulong pa;
-    int i, rc;
-
-    if (*lp == NULL) {
-        return walk_memory_regions_end(data, base, 0);
+    /* adjacent ranges with the same flags make up a single region */
+    if (data->prot && data->end == p->start && data->prot == p->flags) {
+        data->end = p->last + 1;
+        return false;
     }
-
-    if (level == 0) {
-        PageDesc *pd = *lp;
-
-        for (i = 0; i < V_L2_SIZE; ++i) {
-            int prot = pd[i].flags;
-
-            pa = base | (i << TARGET_PAGE_BITS);
-            if (prot != data->prot) {
-                rc = walk_memory_regions_end(data, pa, prot);
-                if (rc != 0) {
-                    return rc;
-                }
-            }
-        }
-    } else {
-        void **pp = *lp;
-
-        for (i = 0; i < V_L2_SIZE; ++i) {
-            pa = base | ((target_ulong)i <<
-                (TARGET_PAGE_BITS + V_L2_BITS * level));
-            rc = walk_memory_regions_1(data, pa, level - 1, pp + i);
-            if (rc != 0) {
-                return rc;
-            }
+    if (data->prot) {
+        data->rc = data->fn(data->priv, data->start, data->end, data->prot);
+        if (data->rc != 0) {
+            return true;
         }
     }
-
-    return 0;
+    data->start = p->start;
+    data->end = p->last + 1;
+    data->prot = p->flags;
+    return false;
 }
 
 int walk_memory_regions(void *priv, walk_memory_regions_fn fn)
 {
-    struct walk_memory_regions_data data;
-    uintptr_t i, l1_sz = v_l1_size;
-
-    data.fn = fn;
-    data.priv = priv;
-    data.start = -1u;
-    data.prot = 0;
+    struct walk_memory_regions_data data = {
+        .fn = fn,
+        .priv = priv,
+    };
 
-    for (i = 0; i < l1_sz; i++) {
-        target_ulong base = i << (v_l1_shift + TARGET_PAGE_BITS);
-        int rc = walk_memory_regions_1(&data, base, v_l2_levels, l1_map + i);
-        if (rc != 0) {
-            return rc;
-        }
+    mmap_lock();
+    g_tree_foreach(pageflags_root, walk_memory_regions_1, &data);
+    if (data.rc == 0 && data.prot) {
+        data.rc = fn(priv, data.start, data.end, data.prot);
     }
+    mmap_unlock();
 
-    return walk_memory_regions_end(&data, 0, 0);
+    return data.rc;
 }
 
 static int dump_region(void *priv, target_ulong start,
@@ -2725,13 +2874,57 @@ void page_dump(FILE *f)
 
 int page_get_flags(target_ulong address)
 {
-    PageDesc *p;
+    target_ulong last;
+    int flags;
 
-    p = page_find(address >> TARGET_PAGE_BITS);
-    if (!p) {
+    if (!pageflags_get(address, &flags, &last)) {
         return 0;
     }
-    return p->flags;
+    return flags;
+}
+
+/*
+ * Return true if a page in [@start, @last] is mapped, storing in @used
+ * the first address of one of the mappings that overlap the range.
+ * The mmap_lock should already be held.
+ */
+bool page_range_used(target_ulong start, target_ulong last,
+                     target_ulong *used)
+{
+    PageFlagsNode *p;
+
+    assert_memory_lock();
+
+    p = pageflags_find(start, last);
+    if (!p) {
+        return false;
+    }
+    *used = p->start;
+    return true;
+}
+
+/*
+ * Invalidate the code in [@start, @last], skipping quickly over the
+ * parts of the range where code was never translated.
+ */
+static void tb_invalidate_phys_range_sparse(target_ulong start,
+                                            target_ulong last)
+{
+    tb_page_addr_t index = start >> TARGET_PAGE_BITS;
+    tb_page_addr_t last_index = last >> TARGET_PAGE_BITS;
+
+    while (true) {
+        tb_page_addr_t skip = 1;
+        PageDesc *p = page_find_sparse(index, &skip);
+
+        if (p && p->first_tb) {
+            tb_invalidate_phys_page(index << TARGET_PAGE_BITS, 0);
+        }
+        if (last_index - index < skip) {
+            break;
+        }
+        index += skip;
+    }
 }
 
 /* Modify the flags of a page and invalidate the code if necessary.
@@ -2739,8 +2932,6 @@ int page_get_flags(target_ulong address)
    on PAGE_WRITE.  The mmap_lock should already be held.  */
 void page_set_flags(target_ulong start, target_ulong end, int flags)
 {
-    target_ulong addr, len;
-
     /* This function should never be called with addresses outside the
        guest address space.  If this assert fires, it probably indicates
        a missing call to h2g_valid.  */
@@ -2753,29 +2944,17 @@ void page_set_flags(target_ulong start, target_ulong end, int flags)
 
     if (flags & PAGE_WRITE) {
         flags |= PAGE_WRITE_ORG;
-    }
 
-    for (addr = start, len = end - start;
-         len != 0;
-         len -= TARGET_PAGE_SIZE, addr += TARGET_PAGE_SIZE) {
-        PageDesc *p = page_find_alloc(addr >> TARGET_PAGE_BITS, 1);
-
-        /* If the write protection bit is set, then we invalidate
-           the code inside.  */
-        if (!(p->flags & PAGE_WRITE) &&
-            (flags & PAGE_WRITE) &&
-            p->first_tb) {
-            tb_invalidate_phys_page(addr, 0);
-        }
-        p->flags = flags;
+        /* Pages holding translated code are kept read-only, so any
+           code in the range must go before it becomes writable.  */
+        tb_invalidate_phys_range_sparse(start, end - 1);
     }
+    pageflags_update(start, end - 1, flags, 0, true);
 }
 
 int page_check_range(target_ulong start, target_ulong len, int flags)
 {
-    PageDesc *p;
-    target_ulong end;
-    target_ulong addr;
+    target_ulong last;
 
     /* This function should never be called with addresses outside the
        guest address space.  If this assert fires, it probably indicates
@@ -2793,37 +2972,41 @@ int page_check_range(target_ulong start, target_ulong len, int flags)
     }
 
     /* must do before we loose bits in the next step */
-    end = TARGET_PAGE_ALIGN(start + len);
+    last = TARGET_PAGE_ALIGN(start + len) - 1;
     start = start & TARGET_PAGE_MASK;
 
-    for (addr = start, len = end - start;
-         len != 0;
-         len -= TARGET_PAGE_SIZE, addr += TARGET_PAGE_SIZE) {
-        p = page_find(addr >> TARGET_PAGE_BITS);
-        if (!p) {
+    while (true) {
+        target_ulong p_last;
+        int p_flags;
+
+        if (!pageflags_get(start, &p_flags, &p_last)) {
             return -1;
         }
-        if (!(p->flags & PAGE_VALID)) {
+        if (!(p_flags & PAGE_VALID)) {
             return -1;
         }
-
-        if ((flags & PAGE_READ) && !(p->flags & PAGE_READ)) {
+        if ((flags & PAGE_READ) && !(p_flags & PAGE_READ)) {
             return -1;
         }
         if (flags & PAGE_WRITE) {
-            if (!(p->flags & PAGE_WRITE_ORG)) {
+            if (!(p_flags & PAGE_WRITE_ORG)) {
                 return -1;
             }
             /* unprotect the page if it was put read-only because it
-               contains translated code */
-            if (!(p->flags & PAGE_WRITE)) {
-                if (!page_unprotect(addr, 0)) {
+               contains translated code, then look it up again */
+            if (!(p_flags & PAGE_WRITE)) {
+                if (!page_unprotect(start, 0)) {
                     return -1;
                 }
+                continue;
             }
         }
+
+        if (p_last >= last) {
+            return 0;
+        }
+        start = p_last + 1;
     }
-    return 0;
 }
 
 /* called from signal handler: invalidate the code and unprotect the
@@ -2836,15 +3019,20 @@ int page_unprotect(target_ulong address, uintptr_t pc)
 {
     unsigned int prot;
     bool current_tb_invalidated;
-    PageDesc *p;
+    PageFlagsNode *p;
     target_ulong host_start, host_end, addr;
 
+    /* Faults on pages that were never writable do not need the lock */
+    if (!(page_get_flags(address) & PAGE_WRITE_ORG)) {
+        return 0;
+    }
+
     /* Technically this isn't safe inside a signal handler.  However we
        know this only ever happens in a synchronous SEGV handler, so in
        practice it seems to be ok.  */
     mmap_lock();
 
-    p = page_find(address >> TARGET_PAGE_BITS);
+    p = pageflags_find(address, address);
     if (!p) {
         mmap_unlock();
         return 0;
@@ -2869,11 +3057,11 @@ int page_unprotect(target_ulong address, uintptr_t pc)
             host_start = address & qemu_host_page_mask;
             host_end = host_start + qemu_host_page_size;
 
+            pageflags_update(host_start, host_end - 1, PAGE_WRITE, 0, false);
+
             prot = 0;
             for (addr = host_start; addr < host_end; addr += TARGET_PAGE_SIZE) {
-                p = page_find(addr >> TARGET_PAGE_BITS);
-                p->flags |= PAGE_WRITE;
-                prot |= p->flags;
+                prot |= page_get_flags(addr);
 
                 /* and since the content will be modified, we must invalidate
                    the corresponding translated code. */
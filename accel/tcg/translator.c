@@ -32,6 +32,44 @@ void translator_loop_temp_check(DisasContextBase *db)
     }
 }
 
+#ifndef CONFIG_USER_ONLY
+void translator_xpage_guard(DisasContextBase *db, int n, target_ulong dest,
+                            int mmu_idx, TCGLabel *fail)
+{
+    /* The TB is still being generated, so it is fine to modify it. */
+    TranslationBlock *tb = (TranslationBlock *)db->tb;
+    int fast_ofs = TLB_MASK_TABLE_OFS(mmu_idx);
+    TCGv_ptr entry = tcg_temp_local_new_ptr();
+    TCGv_ptr t0 = tcg_temp_new_ptr();
+    TCGv_ptr t1 = tcg_temp_new_ptr();
+    TCGv page = tcg_temp_new();
+
+    tcg_debug_assert(n < ARRAY_SIZE(tb->jmp_page_addend));
+    tb->jmp_page_addend[n] = TB_JMP_PAGE_ADDEND_UNSET;
+
+    /* entry = tlb_entry(env, mmu_idx, dest), with a constant @dest. */
+    tcg_gen_ld_ptr(entry, cpu_env, fast_ofs + offsetof(CPUTLBDescFast, mask));
+    tcg_gen_andi_ptr(entry, entry,
+                     dest >> (TARGET_PAGE_BITS - CPU_TLB_ENTRY_BITS));
+    tcg_gen_ld_ptr(t0, cpu_env, fast_ofs + offsetof(CPUTLBDescFast, table));
+    tcg_gen_add_ptr(entry, entry, t0);
+
+    /* Any flag in addr_code, e.g. TLB_MMIO, makes the comparison fail. */
+    tcg_gen_ld_tl(page, entry, offsetof(CPUTLBEntry, addr_code));
+    tcg_gen_brcondi_tl(TCG_COND_NE, page, dest & TARGET_PAGE_MASK, fail);
+
+    tcg_gen_ld_ptr(t0, entry, offsetof(CPUTLBEntry, addend));
+    tcg_gen_movi_ptr(t1, (uintptr_t)&tb->jmp_page_addend[n]);
+    tcg_gen_ld_ptr(t1, t1, 0);
+    tcg_gen_brcond_ptr(TCG_COND_NE, t0, t1, fail);
+
+    tcg_temp_free_ptr(entry);
+    tcg_temp_free_ptr(t0);
+    tcg_temp_free_ptr(t1);
+    tcg_temp_free(page);
+}
+#endif
+
 void translator_loop(const TranslatorOps *ops, DisasContextBase *db,
                      CPUState *cpu, TranslationBlock *tb, int max_insns)
 {
@@ -0,0 +1,399 @@
+/*
+ * Sampling profiler
+ *
+ * Every "period" instructions, record the block a vCPU is executing
+ * together with the call stack found by walking the frame pointer
+ * chain in guest memory. Counting instructions and checking for the
+ * end of the period is done inline, so only the samples themselves
+ * call into the plugin.
+ *
+ * Samples are written either as folded stacks, ready to be fed to
+ * flamegraph.pl, or in the text format of "perf script" so that the
+ * usual perf post-processing scripts can consume them. Addresses are
+ * symbolized with an optional symbol file in the format of "nm -n" or
+ * of a kernel System.map.
+ *
+ * License: GNU GPL, version 2 or later.
+ *   See the COPYING file in the top-level directory.
+ */
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+
+#include <qemu-plugin.h>
+
+QEMU_PLUGIN_EXPORT int qemu_plugin_version = QEMU_PLUGIN_VERSION;
+
+#define MAX_DEPTH 128
+
+/* Frame pointer chain of a target's usual ABI */
+typedef struct {
+    const char *target;
+    const char *fp_reg;
+    unsigned int word_size;
+    /* where the caller's frame pointer and the return address are saved */
+    int fp_offset;
+    int ra_offset;
+} FrameLayout;
+
+static const FrameLayout frame_layouts[] = {
+    { "x86_64",  "rbp", 8,   0,  8 },
+    { "i386",    "ebp", 4,   0,  4 },
+    { "aarch64", "x29", 8,   0,  8 },
+    { "riscv64", "fp",  8, -16, -8 },
+    { "riscv32", "fp",  4,  -8, -4 },
+};
+
+enum output_format {
+    OUTPUT_FOLDED,
+    OUTPUT_PERF,
+};
+
+typedef struct {
+    uint64_t addr;
+    char *name;
+} Symbol;
+
+static uint64_t period = 10007;
+static unsigned int max_depth = 32;
+static enum output_format format = OUTPUT_FOLDED;
+static const char *outfile;
+
+static const FrameLayout *layout;
+static struct qemu_plugin_register *fp_reg;
+
+/* instructions executed by each vCPU since its last sample */
+static struct qemu_plugin_scoreboard *since_sample;
+static qemu_plugin_u64 insns;
+
+/* sorted by address */
+static GArray *symbols;
+
+static GMutex lock;
+static uint64_t n_samples;
+static gint64 start_time;
+/* folded stack -> number of samples */
+static GHashTable *folded;
+static GString *perf_script;
+
+static gint cmp_symbol(gconstpointer a, gconstpointer b)
+{
+    const Symbol *sa = a;
+    const Symbol *sb = b;
+
+    return sa->addr < sb->addr ? -1 : sa->addr > sb->addr;
+}
+
+static bool load_symbols(const char *path)
+{
+    g_autofree gchar *contents = NULL;
+    g_auto(GStrv) lines = NULL;
+    int i;
+
+    if (!g_file_get_contents(path, &contents, NULL, NULL)) {
+        return false;
+    }
+    symbols = g_array_new(false, false, sizeof(Symbol));
+    lines = g_strsplit(contents, "\n", -1);
+    for (i = 0; lines[i]; i++) {
+        char type, name[256];
+        Symbol sym;
+
+        if (sscanf(lines[i], "%" SCNx64 " %c %255s",
+                   &sym.addr, &type, name) != 3) {
+            continue;
+        }
+        /* only code symbols */
+        if (!strchr("tTwW", type)) {
+            continue;
+        }
+        sym.name = g_strdup(name);
+        g_array_append_val(symbols, sym);
+    }
+    g_array_sort(symbols, cmp_symbol);
+    return true;
+}
+
+static const Symbol *find_symbol(uint64_t addr)
+{
+    unsigned int lo = 0, hi;
+
+    if (!symbols || !symbols->len) {
+        return NULL;
+    }
+    /* find the last symbol at or below @addr */
+    hi = symbols->len;
+    while (hi - lo > 1) {
+        unsigned int mid = lo + (hi - lo) / 2;
+
+        if (g_array_index(symbols, Symbol, mid).addr <= addr) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    if (g_array_index(symbols, Symbol, lo).addr > addr) {
+        return NULL;
+    }
+    return &g_array_index(symbols, Symbol, lo);
+}
+
+/*
+ * Return addresses point after the call, which might be the start of
+ * the next function already, so look up the call itself.
+ */
+static uint64_t lookup_addr(const uint64_t *stack, unsigned int i)
+{
+    return i ? stack[i] - 1 : stack[i];
+}
+
+static uint64_t read_word(const uint8_t *buf, unsigned int size)
+{
+    uint64_t val = 0;
+    unsigned int i;
+
+    /* all the targets in frame_layouts are little-endian */
+    for (i = 0; i < size; i++) {
+        val |= (uint64_t)buf[i] << (i * 8);
+    }
+    return val;
+}
+
+/* Fill @stack with at most @max return addresses, innermost first */
+static unsigned int unwind(uint64_t *stack, unsigned int max)
+{
+    unsigned int size = layout->word_size;
+    unsigned int n = 0;
+    uint8_t buf[8];
+    uint64_t fp;
+    int len;
+
+    len = qemu_plugin_read_register(fp_reg, buf, sizeof(buf));
+    if (len <= 0) {
+        return 0;
+    }
+    fp = read_word(buf, len);
+
+    while (n < max && fp && fp % size == 0) {
+        uint64_t next_fp, ra;
+
+        if (!qemu_plugin_read_memory_vaddr(fp + layout->ra_offset,
+                                           buf, size)) {
+            break;
+        }
+        ra = read_word(buf, size);
+        if (!qemu_plugin_read_memory_vaddr(fp + layout->fp_offset,
+                                           buf, size)) {
+            break;
+        }
+        next_fp = read_word(buf, size);
+        if (!ra) {
+            break;
+        }
+        stack[n++] = ra;
+        /* stacks grow down, so callers have their frames above ours */
+        if (next_fp <= fp) {
+            break;
+        }
+        fp = next_fp;
+    }
+    return n;
+}
+
+static void record_folded(const uint64_t *stack, unsigned int depth)
+{
+    g_autoptr(GString) key = g_string_new("");
+    uint64_t *count;
+    int i;
+
+    /* outermost caller first */
+    for (i = depth - 1; i >= 0; i--) {
+        uint64_t addr = lookup_addr(stack, i);
+        const Symbol *sym = find_symbol(addr);
+
+        if (sym) {
+            g_string_append(key, sym->name);
+        } else {
+            g_string_append_printf(key, "0x%" PRIx64, addr);
+        }
+        if (i) {
+            g_string_append_c(key, ';');
+        }
+    }
+
+    count = g_hash_table_lookup(folded, key->str);
+    if (!count) {
+        count = g_new0(uint64_t, 1);
+        g_hash_table_insert(folded, g_strdup(key->str), count);
+    }
+    (*count)++;
+}
+
+static void record_perf(unsigned int vcpu_index, const uint64_t *stack,
+                        unsigned int depth)
+{
+    gint64 now = g_get_monotonic_time() - start_time;
+    unsigned int i;
+
+    g_string_append_printf(perf_script,
+                           "qemu 0/%u [%03u] %" PRId64 ".%06" PRId64
+                           ": %" PRIu64 " instructions:\n",
+                           vcpu_index, vcpu_index,
+                           now / G_USEC_PER_SEC, now % G_USEC_PER_SEC,
+                           period);
+    for (i = 0; i < depth; i++) {
+        uint64_t addr = lookup_addr(stack, i);
+        const Symbol *sym = find_symbol(addr);
+
+        g_string_append_printf(perf_script, "\t%16" PRIx64 " ", stack[i]);
+        if (sym) {
+            g_string_append_printf(perf_script, "%s+0x%" PRIx64,
+                                   sym->name, stack[i] - sym->addr);
+        } else {
+            g_string_append(perf_script, "[unknown]");
+        }
+        g_string_append(perf_script, " (guest)\n");
+    }
+    g_string_append_c(perf_script, '\n');
+}
+
+static void vcpu_sample(unsigned int vcpu_index, void *udata)
+{
+    uint64_t stack[MAX_DEPTH];
+    unsigned int depth = 1;
+
+    qemu_plugin_u64_set(insns, vcpu_index, 0);
+
+    stack[0] = (uintptr_t)udata;
+    if (fp_reg) {
+        depth += unwind(stack + 1, max_depth - 1);
+    }
+
+    g_mutex_lock(&lock);
+    n_samples++;
+    if (format == OUTPUT_FOLDED) {
+        record_folded(stack, depth);
+    } else {
+        record_perf(vcpu_index, stack, depth);
+    }
+    g_mutex_unlock(&lock);
+}
+
+static void vcpu_tb_trans(qemu_plugin_id_t id, struct qemu_plugin_tb *tb)
+{
+    uint64_t pc = qemu_plugin_tb_vaddr(tb);
+
+    /* the counter is compared before this block's instructions are added */
+    qemu_plugin_register_vcpu_tb_exec_cond_cb(tb, vcpu_sample,
+                                              QEMU_PLUGIN_CB_R_REGS,
+                                              QEMU_PLUGIN_COND_GE, insns,
+                                              period, (void *)(uintptr_t)pc);
+    qemu_plugin_register_vcpu_tb_exec_inline_per_vcpu(
+        tb, QEMU_PLUGIN_INLINE_ADD_U64, insns, qemu_plugin_tb_n_insns(tb));
+}
+
+static void vcpu_init(qemu_plugin_id_t id, unsigned int vcpu_index)
+{
+    g_mutex_lock(&lock);
+    if (layout && !fp_reg) {
+        fp_reg = qemu_plugin_find_register(vcpu_index, layout->fp_reg);
+        if (!fp_reg) {
+            g_autofree gchar *msg =
+                g_strdup_printf("profile: no register %s, not unwinding\n",
+                                layout->fp_reg);
+            qemu_plugin_outs(msg);
+            layout = NULL;
+        }
+    }
+    g_mutex_unlock(&lock);
+}
+
+static void append_folded(gpointer key, gpointer value, gpointer user_data)
+{
+    GString *report = user_data;
+
+    g_string_append_printf(report, "%s %" PRIu64 "\n",
+                           (const char *)key, *(uint64_t *)value);
+}
+
+static void plugin_exit(qemu_plugin_id_t id, void *p)
+{
+    g_autoptr(GString) report = g_string_new("");
+    g_autofree gchar *summary = NULL;
+
+    g_mutex_lock(&lock);
+    if (format == OUTPUT_FOLDED) {
+        g_hash_table_foreach(folded, append_folded, report);
+    } else {
+        g_string_append_len(report, perf_script->str, perf_script->len);
+    }
+    summary = g_strdup_printf("profile: %" PRIu64 " samples every %" PRIu64
+                              " instructions\n", n_samples, period);
+    g_mutex_unlock(&lock);
+
+    if (outfile) {
+        g_autoptr(GError) err = NULL;
+
+        if (!g_file_set_contents(outfile, report->str, report->len, &err)) {
+            fprintf(stderr, "profile: %s\n", err->message);
+        }
+    } else {
+        qemu_plugin_outs(report->str);
+    }
+    qemu_plugin_outs(summary);
+}
+
+QEMU_PLUGIN_EXPORT int qemu_plugin_install(qemu_plugin_id_t id,
+                                           const qemu_info_t *info,
+                                           int argc, char **argv)
+{
+    int i;
+
+    for (i = 0; i < argc; i++) {
+        char *opt = argv[i];
+
+        if (g_str_has_prefix(opt, "period=")) {
+            period = g_ascii_strtoull(opt + 7, NULL, 0);
+        } else if (g_str_has_prefix(opt, "depth=")) {
+            max_depth = g_ascii_strtoull(opt + 6, NULL, 0);
+        } else if (g_strcmp0(opt, "format=folded") == 0) {
+            format = OUTPUT_FOLDED;
+        } else if (g_strcmp0(opt, "format=perf") == 0) {
+            format = OUTPUT_PERF;
+        } else if (g_str_has_prefix(opt, "symbols=")) {
+            if (!load_symbols(opt + 8)) {
+                fprintf(stderr, "profile: cannot read %s\n", opt + 8);
+                return -1;
+            }
+        } else if (g_str_has_prefix(opt, "outfile=")) {
+            outfile = opt + 8;
+        } else {
+            fprintf(stderr, "option parsing failed: %s\n", opt);
+            return -1;
+        }
+    }
+    if (!period || !max_depth || max_depth > MAX_DEPTH) {
+        fprintf(stderr, "profile: period must be non-zero and depth "
+                "between 1 and %d\n", MAX_DEPTH);
+        return -1;
+    }
+
+    for (i = 0; i < G_N_ELEMENTS(frame_layouts); i++) {
+        if (!strcmp(info->target_name, frame_layouts[i].target)) {
+            layout = &frame_layouts[i];
+        }
+    }
+
+    since_sample = qemu_plugin_scoreboard_new(sizeof(uint64_t));
+    insns = qemu_plugin_scoreboard_u64(since_sample);
+    folded = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+    perf_script = g_string_new("");
+    start_time = g_get_monotonic_time();
+
+    qemu_plugin_register_vcpu_init_cb(id, vcpu_init);
+    qemu_plugin_register_vcpu_tb_trans_cb(id, vcpu_tb_trans);
+    qemu_plugin_register_atexit_cb(id, plugin_exit, NULL);
+    return 0;
+}
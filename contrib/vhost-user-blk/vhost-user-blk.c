@@ -104,7 +104,6 @@ static void vub_req_complete(VubReq *req)
     /* IO size with 1 extra status byte */
     vu_queue_push(vu_dev, req->vq, req->elem,
                   req->size + 1);
-    vu_queue_notify(vu_dev, req->vq);
 
     if (req->elem) {
         free(req->elem);
@@ -350,6 +349,9 @@ static void vub_process_vq(VuDev *vu_dev, int idx)
             break;
         }
     }
+
+    /* Requests complete synchronously, so notify once for the batch */
+    vu_queue_notify(vu_dev, vq);
 }
 
 static void vub_queue_set_started(VuDev *vu_dev, int idx, bool started)
@@ -381,7 +383,9 @@ vub_get_features(VuDev *dev)
                1ull << VIRTIO_BLK_F_DISCARD |
                1ull << VIRTIO_BLK_F_WRITE_ZEROES |
                #endif
-               1ull << VIRTIO_BLK_F_CONFIG_WCE;
+               1ull << VIRTIO_BLK_F_CONFIG_WCE |
+               /* requests are completed in the order they are popped */
+               1ull << VIRTIO_F_IN_ORDER;
 
     if (vdev_blk->enable_ro) {
         features |= 1ull << VIRTIO_BLK_F_RO;
@@ -25,37 +25,28 @@
 /* Disassemble TCI bytecode. */
 int print_insn_tci(bfd_vma addr, disassemble_info *info)
 {
-    int length;
-    uint8_t byte;
+    const TCGOpDef *def;
+    TCIInsn insn;
     int status;
-    TCGOpcode op;
+    int op;
 
-    status = info->read_memory_func(addr, &byte, 1, info);
+    status = info->read_memory_func(addr, (bfd_byte *)&insn, sizeof(insn),
+                                    info);
     if (status != 0) {
         info->memory_error_func(status, addr, info);
         return -1;
     }
-    op = byte;
-
-    addr++;
-    status = info->read_memory_func(addr, &byte, 1, info);
-    if (status != 0) {
-        info->memory_error_func(status, addr, info);
-        return -1;
-    }
-    length = byte;
 
+    op = tci_dispatch_opc(insn.op);
     if (op >= tcg_op_defs_max) {
-        info->fprintf_func(info->stream, "illegal opcode %d", op);
-    } else {
-        const TCGOpDef *def = &tcg_op_defs[op];
-        int nb_oargs = def->nb_oargs;
-        int nb_iargs = def->nb_iargs;
-        int nb_cargs = def->nb_cargs;
-        /* TODO: Improve disassembler output. */
-        info->fprintf_func(info->stream, "%s\to=%d i=%d c=%d",
-                           def->name, nb_oargs, nb_iargs, nb_cargs);
+        info->fprintf_func(info->stream, "illegal opcode %" PRIxPTR, insn.op);
+        return sizeof(insn);
     }
 
-    return length;
+    def = &tcg_op_defs[op];
+    /* TODO: Improve disassembler output. */
+    info->fprintf_func(info->stream, "%s\tr=%d,%d,%d,%d i=%" PRId32,
+                       def->name, insn.r[0], insn.r[1], insn.r[2], insn.r[3],
+                       insn.i);
+    return tci_insn_size(op);
 }
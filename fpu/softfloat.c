@@ -401,6 +401,86 @@ float64_gen2(float64 xa, float64 xb, float_status *s,
     return soft(ua.s, ub.s, s);
 }
 
+/*
+ * Hardfloat for floatx80 is only possible where the host's long double is
+ * the x87 extended format, and the x87 precision control is left at 64-bit
+ * significands (which is not the case on Windows).  Since 80-bit loads of
+ * just-stored values defeat store forwarding, it only pays off for the
+ * operations that are expensive in software, i.e. division and sqrt.
+ */
+#if defined(__x86_64__) && !defined(_WIN32) && LDBL_MANT_DIG == 64
+# define QEMU_HARDFLOAT_FX80 1
+#else
+# define QEMU_HARDFLOAT_FX80 0
+#endif
+
+typedef union {
+    floatx80 s;
+    long double h;
+} union_floatx80;
+
+typedef bool (*fx80_check_fn)(floatx80 a, floatx80 b);
+typedef floatx80 (*soft_fx80_op2_fn)(floatx80 a, floatx80 b, float_status *s);
+typedef long double (*hard_fx80_op2_fn)(long double a, long double b);
+
+static inline bool can_use_fpu_fx80(const float_status *s)
+{
+    if (!QEMU_HARDFLOAT_FX80) {
+        return false;
+    }
+    return can_use_fpu(s) &&
+           s->floatx80_rounding_precision != 32 &&
+           s->floatx80_rounding_precision != 64;
+}
+
+/*
+ * Unlike the IEEE formats, floatx80 has an explicit integer bit; only
+ * accept canonical zeros and normals, leaving pseudo-denormals, unnormals
+ * and the like to the soft implementation.
+ */
+static inline bool fx80_is_zon(floatx80 a)
+{
+    int32_t exp = extractFloatx80Exp(a);
+    uint64_t frac = extractFloatx80Frac(a);
+
+    if (exp == 0) {
+        return frac == 0;
+    }
+    return exp != 0x7fff && (frac >> 63);
+}
+
+static inline floatx80
+floatx80_gen2(floatx80 xa, floatx80 xb, float_status *s,
+              hard_fx80_op2_fn hard, soft_fx80_op2_fn soft,
+              fx80_check_fn pre, fx80_check_fn post)
+{
+    union_floatx80 ua, ub, ur;
+
+    if (unlikely(!can_use_fpu_fx80(s))) {
+        goto soft;
+    }
+    if (unlikely(!pre(xa, xb))) {
+        goto soft;
+    }
+
+    ua.s = xa;
+    ub.s = xb;
+    ur.h = hard(ua.h, ub.h);
+    /*
+     * Let the soft implementation produce infinities, since the target
+     * may use a different encoding than the host (e.g. m68k).
+     */
+    if (unlikely(isinf(ur.h))) {
+        goto soft;
+    } else if (unlikely(fabsl(ur.h) <= LDBL_MIN) && post(xa, xb)) {
+        goto soft;
+    }
+    return ur.s;
+
+ soft:
+    return soft(xa, xb, s);
+}
+
 /*----------------------------------------------------------------------------
 | Returns the fraction bits of the single-precision floating-point value `a'.
 *----------------------------------------------------------------------------*/
@@ -2157,20 +2237,62 @@ float16 float16_round_to_int(float16 a, float_status *s)
     return float16_round_pack_canonical(pr, s);
 }
 
-float32 float32_round_to_int(float32 a, float_status *s)
+static float32 QEMU_SOFTFLOAT_ATTR
+soft_f32_round_to_int(float32 a, float_status *s)
 {
     FloatParts pa = float32_unpack_canonical(a, s);
     FloatParts pr = round_to_int(pa, s->float_rounding_mode, 0, s);
     return float32_round_pack_canonical(pr, s);
 }
 
-float64 float64_round_to_int(float64 a, float_status *s)
+float32 QEMU_FLATTEN float32_round_to_int(float32 xa, float_status *s)
+{
+    union_float32 ua, ur;
+
+    ua.s = xa;
+    if (unlikely(!can_use_fpu(s))) {
+        goto soft;
+    }
+
+    float32_input_flush1(&ua.s, s);
+    if (unlikely(float32_is_any_nan(ua.s))) {
+        goto soft;
+    }
+    ur.h = rintf(ua.h);
+    return ur.s;
+
+ soft:
+    return soft_f32_round_to_int(ua.s, s);
+}
+
+static float64 QEMU_SOFTFLOAT_ATTR
+soft_f64_round_to_int(float64 a, float_status *s)
 {
     FloatParts pa = float64_unpack_canonical(a, s);
     FloatParts pr = round_to_int(pa, s->float_rounding_mode, 0, s);
     return float64_round_pack_canonical(pr, s);
 }
 
+float64 QEMU_FLATTEN float64_round_to_int(float64 xa, float_status *s)
+{
+    union_float64 ua, ur;
+
+    ua.s = xa;
+    if (unlikely(!can_use_fpu(s))) {
+        goto soft;
+    }
+
+    float64_input_flush1(&ua.s, s);
+    if (unlikely(float64_is_any_nan(ua.s))) {
+        goto soft;
+    }
+    ur.h = rint(ua.h);
+    return ur.s;
+
+ soft:
+    return soft_f64_round_to_int(ua.s, s);
+}
+
 /*
  * Rounds the bfloat16 value `a' to an integer, and returns the
  * result as a bfloat16 value.
@@ -2310,6 +2432,46 @@ int64_t float64_to_int64_scalbn(float64 a, FloatRoundMode rmode, int scale,
                                  rmode, scale, INT64_MIN, INT64_MAX, s);
 }
 
+/*
+ * Hardfloat conversions to integer.  With can_use_fpu() the rounding mode
+ * is round-to-nearest-even as on the host, and inexact is already set.
+ * Once the rounded value is known to fit, the host conversion is exact
+ * and raises nothing else; NaNs fail the range check.
+ */
+#define GEN_HARD_TO_INT(name, fsz, isz, round_fn, rmode)                 \
+int##isz##_t name(float##fsz a, float_status *s)                         \
+{                                                                        \
+    union_float##fsz ua;                                                 \
+    const double lim = -(double)INT##isz##_MIN;                          \
+                                                                         \
+    ua.s = a;                                                            \
+    if (likely(can_use_fpu(s))) {                                        \
+        double r;                                                        \
+                                                                         \
+        float##fsz##_input_flush1(&ua.s, s);                             \
+        r = round_fn(ua.h);                                              \
+        if (likely(r >= -lim && r < lim)) {                              \
+            return r;                                                    \
+        }                                                                \
+    }                                                                    \
+    return float##fsz##_to_int##isz##_scalbn(ua.s, rmode, 0, s);         \
+}
+
+GEN_HARD_TO_INT(float32_to_int32, 32, 32, rintf, s->float_rounding_mode)
+GEN_HARD_TO_INT(float32_to_int64, 32, 64, rintf, s->float_rounding_mode)
+GEN_HARD_TO_INT(float64_to_int32, 64, 32, rint, s->float_rounding_mode)
+GEN_HARD_TO_INT(float64_to_int64, 64, 64, rint, s->float_rounding_mode)
+GEN_HARD_TO_INT(float32_to_int32_round_to_zero, 32, 32, truncf,
+                float_round_to_zero)
+GEN_HARD_TO_INT(float32_to_int64_round_to_zero, 32, 64, truncf,
+                float_round_to_zero)
+GEN_HARD_TO_INT(float64_to_int32_round_to_zero, 64, 32, trunc,
+                float_round_to_zero)
+GEN_HARD_TO_INT(float64_to_int64_round_to_zero, 64, 64, trunc,
+                float_round_to_zero)
+
+#undef GEN_HARD_TO_INT
+
 int8_t float16_to_int8(float16 a, float_status *s)
 {
     return float16_to_int8_scalbn(a, s->float_rounding_mode, 0, s);
@@ -2335,31 +2497,11 @@ int16_t float32_to_int16(float32 a, float_status *s)
     return float32_to_int16_scalbn(a, s->float_rounding_mode, 0, s);
 }
 
-int32_t float32_to_int32(float32 a, float_status *s)
-{
-    return float32_to_int32_scalbn(a, s->float_rounding_mode, 0, s);
-}
-
-int64_t float32_to_int64(float32 a, float_status *s)
-{
-    return float32_to_int64_scalbn(a, s->float_rounding_mode, 0, s);
-}
-
 int16_t float64_to_int16(float64 a, float_status *s)
 {
     return float64_to_int16_scalbn(a, s->float_rounding_mode, 0, s);
 }
 
-int32_t float64_to_int32(float64 a, float_status *s)
-{
-    return float64_to_int32_scalbn(a, s->float_rounding_mode, 0, s);
-}
-
-int64_t float64_to_int64(float64 a, float_status *s)
-{
-    return float64_to_int64_scalbn(a, s->float_rounding_mode, 0, s);
-}
-
 int16_t float16_to_int16_round_to_zero(float16 a, float_status *s)
 {
     return float16_to_int16_scalbn(a, float_round_to_zero, 0, s);
@@ -2380,31 +2522,11 @@ int16_t float32_to_int16_round_to_zero(float32 a, float_status *s)
     return float32_to_int16_scalbn(a, float_round_to_zero, 0, s);
 }
 
-int32_t float32_to_int32_round_to_zero(float32 a, float_status *s)
-{
-    return float32_to_int32_scalbn(a, float_round_to_zero, 0, s);
-}
-
-int64_t float32_to_int64_round_to_zero(float32 a, float_status *s)
-{
-    return float32_to_int64_scalbn(a, float_round_to_zero, 0, s);
-}
-
 int16_t float64_to_int16_round_to_zero(float64 a, float_status *s)
 {
     return float64_to_int16_scalbn(a, float_round_to_zero, 0, s);
 }
 
-int32_t float64_to_int32_round_to_zero(float64 a, float_status *s)
-{
-    return float64_to_int32_scalbn(a, float_round_to_zero, 0, s);
-}
-
-int64_t float64_to_int64_round_to_zero(float64 a, float_status *s)
-{
-    return float64_to_int64_scalbn(a, float_round_to_zero, 0, s);
-}
-
 /*
  * Returns the result of converting the floating-point value `a' to
  * the two's complement integer format.
@@ -2827,19 +2949,40 @@ float32 int16_to_float32_scalbn(int16_t a, int scale, float_status *status)
     return int64_to_float32_scalbn(a, scale, status);
 }
 
+/*
+ * The host performs the conversions from integers directly.  Those that
+ * may be inexact need can_use_fpu(), while those from integers no wider
+ * than the significand are always exact and never raise an exception.
+ */
+
 float32 int64_to_float32(int64_t a, float_status *status)
 {
+    union_float32 ur;
+
+    if (likely(can_use_fpu(status))) {
+        ur.h = a;
+        return ur.s;
+    }
     return int64_to_float32_scalbn(a, 0, status);
 }
 
 float32 int32_to_float32(int32_t a, float_status *status)
 {
+    union_float32 ur;
+
+    if (likely(can_use_fpu(status))) {
+        ur.h = a;
+        return ur.s;
+    }
     return int64_to_float32_scalbn(a, 0, status);
 }
 
 float32 int16_to_float32(int16_t a, float_status *status)
 {
-    return int64_to_float32_scalbn(a, 0, status);
+    union_float32 ur;
+
+    ur.h = a;
+    return ur.s;
 }
 
 float64 int64_to_float64_scalbn(int64_t a, int scale, float_status *status)
@@ -2860,17 +3003,29 @@ float64 int16_to_float64_scalbn(int16_t a, int scale, float_status *status)
 
 float64 int64_to_float64(int64_t a, float_status *status)
 {
+    union_float64 ur;
+
+    if (likely(can_use_fpu(status))) {
+        ur.h = a;
+        return ur.s;
+    }
     return int64_to_float64_scalbn(a, 0, status);
 }
 
 float64 int32_to_float64(int32_t a, float_status *status)
 {
-    return int64_to_float64_scalbn(a, 0, status);
+    union_float64 ur;
+
+    ur.h = a;
+    return ur.s;
 }
 
 float64 int16_to_float64(int16_t a, float_status *status)
 {
-    return int64_to_float64_scalbn(a, 0, status);
+    union_float64 ur;
+
+    ur.h = a;
+    return ur.s;
 }
 
 /*
@@ -2999,12 +3154,21 @@ float32 uint64_to_float32(uint64_t a, float_status *status)
 
 float32 uint32_to_float32(uint32_t a, float_status *status)
 {
+    union_float32 ur;
+
+    if (likely(can_use_fpu(status))) {
+        ur.h = a;
+        return ur.s;
+    }
     return uint64_to_float32_scalbn(a, 0, status);
 }
 
 float32 uint16_to_float32(uint16_t a, float_status *status)
 {
-    return uint64_to_float32_scalbn(a, 0, status);
+    union_float32 ur;
+
+    ur.h = a;
+    return ur.s;
 }
 
 float64 uint64_to_float64_scalbn(uint64_t a, int scale, float_status *status)
@@ -3030,12 +3194,18 @@ float64 uint64_to_float64(uint64_t a, float_status *status)
 
 float64 uint32_to_float64(uint32_t a, float_status *status)
 {
-    return uint64_to_float64_scalbn(a, 0, status);
+    union_float64 ur;
+
+    ur.h = a;
+    return ur.s;
 }
 
 float64 uint16_to_float64(uint16_t a, float_status *status)
 {
-    return uint64_to_float64_scalbn(a, 0, status);
+    union_float64 ur;
+
+    ur.h = a;
+    return ur.s;
 }
 
 /*
@@ -6038,7 +6208,8 @@ floatx80 floatx80_mul(floatx80 a, floatx80 b, float_status *status)
 | according to the IEC/IEEE Standard for Binary Floating-Point Arithmetic.
 *----------------------------------------------------------------------------*/
 
-floatx80 floatx80_div(floatx80 a, floatx80 b, float_status *status)
+static floatx80 QEMU_SOFTFLOAT_ATTR
+soft_fx80_div(floatx80 a, floatx80 b, float_status *status)
 {
     bool aSign, bSign, zSign;
     int32_t aExp, bExp, zExp;
@@ -6119,6 +6290,27 @@ floatx80 floatx80_div(floatx80 a, floatx80 b, float_status *status)
                                 zSign, zExp, zSig0, zSig1, status);
 }
 
+static long double hard_fx80_div(long double a, long double b)
+{
+    return a / b;
+}
+
+static bool fx80_div_pre(floatx80 a, floatx80 b)
+{
+    return fx80_is_zon(a) && fx80_is_zon(b) && !floatx80_is_zero(b);
+}
+
+static bool fx80_div_post(floatx80 a, floatx80 b)
+{
+    return !floatx80_is_zero(a);
+}
+
+floatx80 QEMU_FLATTEN floatx80_div(floatx80 a, floatx80 b, float_status *s)
+{
+    return floatx80_gen2(a, b, s, hard_fx80_div, soft_fx80_div,
+                         fx80_div_pre, fx80_div_post);
+}
+
 /*----------------------------------------------------------------------------
 | Returns the remainder of the extended double-precision floating-point value
 | `a' with respect to the corresponding value `b'.  The operation is performed
@@ -6279,7 +6471,8 @@ floatx80 floatx80_mod(floatx80 a, floatx80 b, float_status *status)
 | for Binary Floating-Point Arithmetic.
 *----------------------------------------------------------------------------*/
 
-floatx80 floatx80_sqrt(floatx80 a, float_status *status)
+static floatx80 QEMU_SOFTFLOAT_ATTR
+soft_fx80_sqrt(floatx80 a, float_status *status)
 {
     bool aSign;
     int32_t aExp, zExp;
@@ -6344,6 +6537,19 @@ floatx80 floatx80_sqrt(floatx80 a, float_status *status)
                                 0, zExp, zSig0, zSig1, status);
 }
 
+floatx80 QEMU_FLATTEN floatx80_sqrt(floatx80 a, float_status *s)
+{
+    if (likely(can_use_fpu_fx80(s) && fx80_is_zon(a) &&
+               !extractFloatx80Sign(a))) {
+        union_floatx80 ua, ur;
+
+        ua.s = a;
+        ur.h = sqrtl(ua.h);
+        return ur.s;
+    }
+    return soft_fx80_sqrt(a, s);
+}
+
 /*----------------------------------------------------------------------------
 | Returns the result of converting the quadruple-precision floating-point
 | value `a' to the 32-bit two's complement integer format.  The conversion
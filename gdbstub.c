@@ -857,12 +857,34 @@ static CPUState *gdb_get_cpu(uint32_t pid, uint32_t tid)
     }
 }
 
+/* Return the XML description called @p (@len characters long) for @cpu */
+static const char *lookup_xml(CPUState *cpu, const char *p, size_t len)
+{
+    CPUClass *cc = CPU_GET_CLASS(cpu);
+    const char *name;
+    int i;
+
+    if (cc->gdb_get_dynamic_xml) {
+        char *xmlname = g_strndup(p, len);
+        const char *xml = cc->gdb_get_dynamic_xml(cpu, xmlname);
+
+        g_free(xmlname);
+        if (xml) {
+            return xml;
+        }
+    }
+    for (i = 0; ; i++) {
+        name = xml_builtin[i][0];
+        if (!name || (strncmp(name, p, len) == 0 && strlen(name) == len))
+            break;
+    }
+    return name ? xml_builtin[i][1] : NULL;
+}
+
 static const char *get_feature_xml(const char *p, const char **newp,
                                    GDBProcess *process)
 {
     size_t len;
-    int i;
-    const char *name;
     CPUState *cpu = get_first_cpu_in_process(process);
     CPUClass *cc = CPU_GET_CLASS(cpu);
 
@@ -871,7 +893,6 @@ static const char *get_feature_xml(const char *p, const char **newp,
         len++;
     *newp = p + len;
 
-    name = NULL;
     if (strncmp(p, "target.xml", len) == 0) {
         char *buf = process->target_xml;
         const size_t buf_sz = sizeof(process->target_xml);
@@ -903,24 +924,10 @@ static const char *get_feature_xml(const char *p, const char **newp,
         }
         return buf;
     }
-    if (cc->gdb_get_dynamic_xml) {
-        char *xmlname = g_strndup(p, len);
-        const char *xml = cc->gdb_get_dynamic_xml(cpu, xmlname);
-
-        g_free(xmlname);
-        if (xml) {
-            return xml;
-        }
-    }
-    for (i = 0; ; i++) {
-        name = xml_builtin[i][0];
-        if (!name || (strncmp(name, p, len) == 0 && strlen(name) == len))
-            break;
-    }
-    return name ? xml_builtin[i][1] : NULL;
+    return lookup_xml(cpu, p, len);
 }
 
-static int gdb_read_register(CPUState *cpu, GByteArray *buf, int reg)
+int gdb_read_register(CPUState *cpu, GByteArray *buf, int reg)
 {
     CPUClass *cc = CPU_GET_CLASS(cpu);
     CPUArchState *env = cpu->env_ptr;
@@ -956,6 +963,60 @@ static int gdb_write_register(CPUState *cpu, uint8_t *mem_buf, int reg)
     return 0;
 }
 
+/*
+ * Look for register @name in the feature description @xml, whose
+ * registers are numbered from @regnum unless they say otherwise.
+ */
+static int find_xml_register(const char *xml, int regnum, const char *name)
+{
+    size_t name_len = strlen(name);
+    const char *p = xml;
+
+    while ((p = strstr(p, "<reg "))) {
+        const char *end = strchr(p, '>');
+        const char *attr;
+
+        if (!end) {
+            break;
+        }
+        attr = g_strstr_len(p, end - p, " regnum=\"");
+        if (attr) {
+            regnum = atoi(attr + strlen(" regnum=\""));
+        }
+        attr = g_strstr_len(p, end - p, " name=\"");
+        if (attr) {
+            attr += strlen(" name=\"");
+            if (!strncmp(attr, name, name_len) && attr[name_len] == '"') {
+                return regnum;
+            }
+        }
+        regnum++;
+        p = end;
+    }
+    return -1;
+}
+
+int gdb_find_register(CPUState *cpu, const char *name)
+{
+    CPUClass *cc = CPU_GET_CLASS(cpu);
+    GDBRegisterState *r;
+    const char *xml;
+    int reg;
+
+    if (!cc->gdb_core_xml_file) {
+        return -1;
+    }
+    xml = lookup_xml(cpu, cc->gdb_core_xml_file,
+                     strlen(cc->gdb_core_xml_file));
+    reg = xml ? find_xml_register(xml, 0, name) : -1;
+
+    for (r = cpu->gdb_regs; r && reg < 0; r = r->next) {
+        xml = lookup_xml(cpu, r->xml, strlen(r->xml));
+        reg = xml ? find_xml_register(xml, r->base_reg, name) : -1;
+    }
+    return reg;
+}
+
 /* Register a supplemental set of CPU registers.  If g_pos is nonzero it
    specifies the first register number and these registers are included in
    a standard "g" packet.  Direction is relative to gdb, i.e. get_reg is
@@ -77,6 +77,7 @@ struct E1000EState {
     uint16_t subsys_used;
 
     bool disable_vnet;
+    bool adaptive_itr;
 
     E1000ECore core;
 
@@ -221,6 +222,14 @@ e1000e_nc_receive(NetClientState *nc, const uint8_t *buf, size_t size)
     return e1000e_receive(&s->core, buf, size);
 }
 
+static int
+e1000e_nc_receive_batch(NetClientState *nc, const struct iovec *pkts,
+                        int count)
+{
+    E1000EState *s = qemu_get_nic_opaque(nc);
+    return e1000e_receive_batch(&s->core, pkts, count);
+}
+
 static void
 e1000e_set_link_status(NetClientState *nc)
 {
@@ -234,6 +243,7 @@ static NetClientInfo net_e1000e_info = {
     .can_receive = e1000e_nc_can_receive,
     .receive = e1000e_nc_receive,
     .receive_iov = e1000e_nc_receive_iov,
+    .receive_batch = e1000e_nc_receive_batch,
     .link_status_changed = e1000e_set_link_status,
 };
 
@@ -264,6 +274,7 @@ static void e1000e_core_realize(E1000EState *s)
 {
     s->core.owner = &s->parent_obj;
     s->core.owner_nic = s->nic;
+    s->core.adaptive_itr = s->adaptive_itr;
 }
 
 static void
@@ -666,6 +677,7 @@ static Property e1000e_properties[] = {
                         e1000e_prop_subsys_ven, uint16_t),
     DEFINE_PROP_SIGNED("subsys", E1000EState, subsys, 0,
                         e1000e_prop_subsys, uint16_t),
+    DEFINE_PROP_BOOL("adaptive-itr", E1000EState, adaptive_itr, false),
     DEFINE_PROP_END_OF_LIST(),
 };
 
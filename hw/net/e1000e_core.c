@@ -52,6 +52,7 @@
 #define E1000E_MIN_XITR     (500) /* No more then 7813 interrupts per
                                      second according to spec 10.2.4.2 */
 #define E1000E_MAX_TX_FRAGS (64)
+#define E1000E_TX_BURST     (32)  /* Descriptors fetched per DMA read */
 
 static inline void
 e1000e_set_interrupt_cause(E1000ECore *core, uint32_t val);
@@ -88,10 +89,9 @@ e1000e_lower_legacy_irq(E1000ECore *core)
 }
 
 static inline void
-e1000e_intrmgr_rearm_timer(E1000IntrDelayTimer *timer)
+e1000e_intrmgr_arm_timer(E1000IntrDelayTimer *timer, uint32_t delay)
 {
-    int64_t delay_ns = (int64_t) timer->core->mac[timer->delay_reg] *
-                                 timer->delay_resolution_ns;
+    int64_t delay_ns = (int64_t) delay * timer->delay_resolution_ns;
 
     trace_e1000e_irq_rearm_timer(timer->delay_reg << 2, delay_ns);
 
@@ -100,6 +100,12 @@ e1000e_intrmgr_rearm_timer(E1000IntrDelayTimer *timer)
     timer->running = true;
 }
 
+static inline void
+e1000e_intrmgr_rearm_timer(E1000IntrDelayTimer *timer)
+{
+    e1000e_intrmgr_arm_timer(timer, timer->core->mac[timer->delay_reg]);
+}
+
 static void
 e1000e_intmgr_timer_resume(E1000IntrDelayTimer *timer)
 {
@@ -767,9 +773,13 @@ e1000e_rx_wb_interrupt_cause(E1000ECore *core, int queue_idx,
     return (queue_idx == 0) ? E1000_ICR_RXQ0 : E1000_ICR_RXQ1;
 }
 
+/*
+ * Sets DD in @dp if the descriptor asks for a write-back.  The caller
+ * copies the descriptor back to guest memory when this returns non-zero.
+ */
 static uint32_t
-e1000e_txdesc_writeback(E1000ECore *core, dma_addr_t base,
-                        struct e1000_tx_desc *dp, bool *ide, int queue_idx)
+e1000e_txdesc_writeback(E1000ECore *core, struct e1000_tx_desc *dp,
+                        bool *ide, int queue_idx)
 {
     uint32_t txd_upper, txd_lower = le32_to_cpu(dp->lower.data);
 
@@ -783,8 +793,6 @@ e1000e_txdesc_writeback(E1000ECore *core, dma_addr_t base,
     txd_upper = le32_to_cpu(dp->upper.data) | E1000_TXD_STAT_DD;
 
     dp->upper.data = cpu_to_le32(txd_upper);
-    pci_dma_write(core->owner, base + ((char *)&dp->upper - (char *)dp),
-                  &dp->upper, sizeof(dp->upper));
     return e1000e_tx_wb_interrupt_cause(core, queue_idx);
 }
 
@@ -829,6 +837,23 @@ e1000e_ring_advance(E1000ECore *core, const E1000E_RingInfo *r, uint32_t count)
     }
 }
 
+/* Number of descriptors from the head up to the tail or the end of the ring */
+static inline uint32_t
+e1000e_ring_contig_descr_num(E1000ECore *core, const E1000E_RingInfo *r)
+{
+    uint32_t size = core->mac[r->dlen] / E1000_RING_DESC_LEN;
+
+    if (core->mac[r->dh] < core->mac[r->dt]) {
+        return core->mac[r->dt] - core->mac[r->dh];
+    }
+
+    if (core->mac[r->dh] < size) {
+        return size - core->mac[r->dh];
+    }
+
+    return 1;
+}
+
 static inline uint32_t
 e1000e_ring_free_descr_num(E1000ECore *core, const E1000E_RingInfo *r)
 {
@@ -906,28 +931,54 @@ static void
 e1000e_start_xmit(E1000ECore *core, const E1000E_TxRing *txr)
 {
     dma_addr_t base;
-    struct e1000_tx_desc desc;
+    struct e1000_tx_desc desc[E1000E_TX_BURST];
     bool ide = false;
     const E1000E_RingInfo *txi = txr->i;
     uint32_t cause = E1000_ICS_TXQE;
+    uint32_t i, n, wb_first, wb_last;
 
     if (!(core->mac[TCTL] & E1000_TCTL_EN)) {
         trace_e1000e_tx_disabled();
         return;
     }
 
+    /*
+     * Fetch descriptors in bursts, and write the ones that got DD set
+     * back with a single DMA per burst.  Only the device owns the
+     * descriptors between head and tail, so rewriting the untouched
+     * ones in between is harmless.
+     */
     while (!e1000e_ring_empty(core, txi)) {
         base = e1000e_ring_head_descr(core, txi);
+        n = MIN(e1000e_ring_contig_descr_num(core, txi), E1000E_TX_BURST);
 
-        pci_dma_read(core->owner, base, &desc, sizeof(desc));
+        pci_dma_read(core->owner, base, desc, n * sizeof(desc[0]));
 
-        trace_e1000e_tx_descr((void *)(intptr_t)desc.buffer_addr,
-                              desc.lower.data, desc.upper.data);
+        wb_first = n;
+        wb_last = 0;
+        for (i = 0; i < n; i++) {
+            uint32_t wb_cause;
 
-        e1000e_process_tx_desc(core, txr->tx, &desc, txi->idx);
-        cause |= e1000e_txdesc_writeback(core, base, &desc, &ide, txi->idx);
+            trace_e1000e_tx_descr((void *)(intptr_t)desc[i].buffer_addr,
+                                  desc[i].lower.data, desc[i].upper.data);
 
-        e1000e_ring_advance(core, txi, 1);
+            e1000e_process_tx_desc(core, txr->tx, &desc[i], txi->idx);
+            wb_cause = e1000e_txdesc_writeback(core, &desc[i], &ide,
+                                               txi->idx);
+            if (wb_cause) {
+                cause |= wb_cause;
+                wb_first = MIN(wb_first, i);
+                wb_last = i;
+            }
+        }
+
+        if (wb_first < n) {
+            pci_dma_write(core->owner, base + wb_first * sizeof(desc[0]),
+                          &desc[wb_first],
+                          (wb_last - wb_first + 1) * sizeof(desc[0]));
+        }
+
+        e1000e_ring_advance(core, txi, n);
     }
 
     if (!ide || !e1000e_intrmgr_delay_tx_causes(core, &cause)) {
@@ -1621,6 +1672,17 @@ e1000e_rx_fix_l4_csum(E1000ECore *core, struct NetRxPkt *pkt)
     }
 }
 
+static void
+e1000e_rx_raise_causes(E1000ECore *core, uint32_t causes)
+{
+    if (!e1000e_intrmgr_delay_rx_causes(core, &causes)) {
+        trace_e1000e_rx_interrupt_set(causes);
+        e1000e_set_interrupt_cause(core, causes);
+    } else {
+        trace_e1000e_rx_interrupt_delayed(causes);
+    }
+}
+
 ssize_t
 e1000e_receive_iov(E1000ECore *core, const struct iovec *iov, int iovcnt)
 {
@@ -1726,16 +1788,38 @@ e1000e_receive_iov(E1000ECore *core, const struct iovec *iov, int iovcnt)
         trace_e1000e_rx_not_written_to_guest(n);
     }
 
-    if (!e1000e_intrmgr_delay_rx_causes(core, &n)) {
-        trace_e1000e_rx_interrupt_set(n);
-        e1000e_set_interrupt_cause(core, n);
+    if (core->rx_batching) {
+        core->rx_batch_causes |= n;
     } else {
-        trace_e1000e_rx_interrupt_delayed(n);
+        e1000e_rx_raise_causes(core, n);
     }
 
     return retval;
 }
 
+int
+e1000e_receive_batch(E1000ECore *core, const struct iovec *pkts, int count)
+{
+    int i;
+
+    /* One interrupt for the whole burst, not one per packet */
+    core->rx_batching = true;
+    for (i = 0; i < count; i++) {
+        /* Out of rx buffers: the caller queues the rest */
+        if (e1000e_receive_iov(core, &pkts[i], 1) == 0) {
+            break;
+        }
+    }
+    core->rx_batching = false;
+
+    if (core->rx_batch_causes) {
+        e1000e_rx_raise_causes(core, core->rx_batch_causes);
+        core->rx_batch_causes = 0;
+    }
+
+    return i;
+}
+
 static inline bool
 e1000e_have_autoneg(E1000ECore *core)
 {
@@ -1957,10 +2041,38 @@ e1000e_clear_ims_bits(E1000ECore *core, uint32_t bits)
     core->mac[IMS] &= ~bits;
 }
 
+/*
+ * With adaptive-itr, a guest asking for more interrupts than the spec
+ * allows gets them while the traffic is sparse.  Once interrupts start
+ * coming back to back, they are throttled to the spec limit again.
+ */
+static uint32_t
+e1000e_xitr_interval(E1000IntrDelayTimer *timer)
+{
+    E1000ECore *core = timer->core;
+    uint32_t interval = core->mac[timer->delay_reg];
+    int64_t now;
+
+    if (!core->adaptive_itr || interval >= E1000E_MIN_XITR) {
+        return interval;
+    }
+
+    now = qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL);
+    if (now - timer->last_fire_ns <=
+        (int64_t) E1000E_MIN_XITR * timer->delay_resolution_ns) {
+        interval = E1000E_MIN_XITR;
+    }
+    timer->last_fire_ns = now;
+
+    return interval;
+}
+
 static inline bool
 e1000e_postpone_interrupt(bool *interrupt_pending,
                            E1000IntrDelayTimer *timer)
 {
+    uint32_t interval;
+
     if (timer->running) {
         trace_e1000e_irq_postponed_by_xitr(timer->delay_reg << 2);
 
@@ -1968,8 +2080,9 @@ e1000e_postpone_interrupt(bool *interrupt_pending,
         return true;
     }
 
-    if (timer->core->mac[timer->delay_reg] != 0) {
-        e1000e_intrmgr_rearm_timer(timer);
+    interval = e1000e_xitr_interval(timer);
+    if (interval != 0) {
+        e1000e_intrmgr_arm_timer(timer, interval);
     }
 
     return false;
@@ -2788,7 +2901,8 @@ e1000e_set_itr(E1000ECore *core, int index, uint32_t val)
     trace_e1000e_irq_itr_set(val);
 
     core->itr_guest_value = interval;
-    core->mac[index] = MAX(interval, E1000E_MIN_XITR);
+    core->mac[index] = core->adaptive_itr ?
+                       interval : MAX(interval, E1000E_MIN_XITR);
 }
 
 static void
@@ -2800,7 +2914,8 @@ e1000e_set_eitr(E1000ECore *core, int index, uint32_t val)
     trace_e1000e_irq_eitr_set(eitr_num, val);
 
     core->eitr_guest_value[eitr_num] = interval;
-    core->mac[index] = MAX(interval, E1000E_MIN_XITR);
+    core->mac[index] = core->adaptive_itr ?
+                       interval : MAX(interval, E1000E_MIN_XITR);
 }
 
 static void
@@ -2833,7 +2948,7 @@ e1000e_update_rx_offloads(E1000ECore *core)
 
     if (core->has_vnet) {
         qemu_set_offload(qemu_get_queue(core->owner_nic)->peer,
-                         cso_state, 0, 0, 0, 0);
+                         cso_state, 0, 0, 0, 0, 0, 0);
     }
 }
 
@@ -55,6 +55,7 @@ typedef struct E1000IntrDelayTimer_st {
     bool running;
     uint32_t delay_reg;
     uint32_t delay_resolution_ns;
+    int64_t last_fire_ns;       /* adaptive-itr only, not migrated */
     E1000ECore *core;
 } E1000IntrDelayTimer;
 
@@ -86,6 +87,10 @@ struct E1000Core {
 
     /* Interrupt moderation management */
     uint32_t delayed_causes;
+    bool adaptive_itr;
+
+    bool rx_batching;
+    uint32_t rx_batch_causes;
 
     E1000IntrDelayTimer radv;
     E1000IntrDelayTimer rdtr;
@@ -152,6 +157,9 @@ e1000e_receive(E1000ECore *core, const uint8_t *buf, size_t size);
 ssize_t
 e1000e_receive_iov(E1000ECore *core, const struct iovec *iov, int iovcnt);
 
+int
+e1000e_receive_batch(E1000ECore *core, const struct iovec *pkts, int count);
+
 void
 e1000e_start_recv(E1000ECore *core);
 
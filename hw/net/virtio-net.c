@@ -44,6 +44,8 @@
 #include "hw/pci/pci.h"
 #include "net_rx_pkt.h"
 #include "hw/virtio/vhost.h"
+#include "block/aio.h"
+#include "block/aio-wait.h"
 
 #define VIRTIO_NET_VM_VERSION    11
 
@@ -338,11 +340,40 @@ static void virtio_net_vnet_endian_status(VirtIONet *n, uint8_t status)
     }
 }
 
+/* Raise an interrupt for a data queue, possibly from an IOThread */
+static void virtio_net_notify(VirtIONet *n, VirtQueue *vq)
+{
+    if (n->dataplane_started) {
+        virtio_notify_irqfd(VIRTIO_DEVICE(n), vq);
+    } else {
+        virtio_notify(VIRTIO_DEVICE(n), vq);
+    }
+}
+
+/* Keep queue pairs running in IOThreads out while the main loop works */
+static void virtio_net_dataplane_lock(VirtIONet *n)
+{
+    int i;
+
+    for (i = 0; i < n->max_queues; i++) {
+        qemu_net_client_lock(qemu_get_subqueue(n->nic, i));
+    }
+}
+
+static void virtio_net_dataplane_unlock(VirtIONet *n)
+{
+    int i;
+
+    for (i = n->max_queues - 1; i >= 0; i--) {
+        qemu_net_client_unlock(qemu_get_subqueue(n->nic, i));
+    }
+}
+
 static void virtio_net_drop_tx_queue_data(VirtIODevice *vdev, VirtQueue *vq)
 {
     unsigned int dropped = virtqueue_drop_all(vq);
     if (dropped) {
-        virtio_notify(vdev, vq);
+        virtio_net_notify(VIRTIO_NET(vdev), vq);
     }
 }
 
@@ -356,6 +387,7 @@ static void virtio_net_set_status(struct VirtIODevice *vdev, uint8_t status)
     virtio_net_vnet_endian_status(n, status);
     virtio_net_vhost_status(n, status);
 
+    virtio_net_dataplane_lock(n);
     for (i = 0; i < n->max_queues; i++) {
         NetClientState *ncs = qemu_get_subqueue(n->nic, i);
         bool queue_started;
@@ -401,6 +433,7 @@ static void virtio_net_set_status(struct VirtIODevice *vdev, uint8_t status)
             }
         }
     }
+    virtio_net_dataplane_unlock(n);
 }
 
 static void virtio_net_set_link_status(NetClientState *nc)
@@ -579,6 +612,15 @@ static int peer_has_ufo(VirtIONet *n)
     return n->has_ufo;
 }
 
+static int peer_has_uso(VirtIONet *n)
+{
+    if (!peer_has_vnet_hdr(n)) {
+        return 0;
+    }
+
+    return qemu_has_uso(qemu_get_queue(n->nic)->peer);
+}
+
 static void virtio_net_set_mrg_rx_bufs(VirtIONet *n, int mergeable_rx_bufs,
                                        int version_1, int hash_report)
 {
@@ -721,6 +763,12 @@ static uint64_t virtio_net_get_features(VirtIODevice *vdev, uint64_t features,
         virtio_clear_feature(&features, VIRTIO_NET_F_HOST_UFO);
     }
 
+    if (!peer_has_uso(n)) {
+        virtio_clear_feature(&features, VIRTIO_NET_F_HOST_USO);
+        virtio_clear_feature(&features, VIRTIO_NET_F_GUEST_USO4);
+        virtio_clear_feature(&features, VIRTIO_NET_F_GUEST_USO6);
+    }
+
     if (!get_vhost_net(nc->peer)) {
         return features;
     }
@@ -760,17 +808,21 @@ static void virtio_net_apply_guest_offloads(VirtIONet *n)
             !!(n->curr_guest_offloads & (1ULL << VIRTIO_NET_F_GUEST_TSO4)),
             !!(n->curr_guest_offloads & (1ULL << VIRTIO_NET_F_GUEST_TSO6)),
             !!(n->curr_guest_offloads & (1ULL << VIRTIO_NET_F_GUEST_ECN)),
-            !!(n->curr_guest_offloads & (1ULL << VIRTIO_NET_F_GUEST_UFO)));
+            !!(n->curr_guest_offloads & (1ULL << VIRTIO_NET_F_GUEST_UFO)),
+            !!(n->curr_guest_offloads & (1ULL << VIRTIO_NET_F_GUEST_USO4)),
+            !!(n->curr_guest_offloads & (1ULL << VIRTIO_NET_F_GUEST_USO6)));
 }
 
-static uint64_t virtio_net_guest_offloads_by_features(uint32_t features)
+static uint64_t virtio_net_guest_offloads_by_features(uint64_t features)
 {
     static const uint64_t guest_offloads_mask =
         (1ULL << VIRTIO_NET_F_GUEST_CSUM) |
         (1ULL << VIRTIO_NET_F_GUEST_TSO4) |
         (1ULL << VIRTIO_NET_F_GUEST_TSO6) |
         (1ULL << VIRTIO_NET_F_GUEST_ECN)  |
-        (1ULL << VIRTIO_NET_F_GUEST_UFO);
+        (1ULL << VIRTIO_NET_F_GUEST_UFO)  |
+        (1ULL << VIRTIO_NET_F_GUEST_USO4) |
+        (1ULL << VIRTIO_NET_F_GUEST_USO6);
 
     return guest_offloads_mask & features;
 }
@@ -1336,6 +1388,7 @@ static void virtio_net_handle_ctrl(VirtIODevice *vdev, VirtQueue *vq)
     struct iovec *iov, *iov2;
     unsigned int iov_cnt;
 
+    virtio_net_dataplane_lock(n);
     for (;;) {
         elem = virtqueue_pop(vq, sizeof(VirtQueueElement));
         if (!elem) {
@@ -1345,7 +1398,7 @@ static void virtio_net_handle_ctrl(VirtIODevice *vdev, VirtQueue *vq)
             iov_size(elem->out_sg, elem->out_num) < sizeof(ctrl)) {
             virtio_error(vdev, "virtio-net ctrl missing headers");
             virtqueue_detach_element(vq, elem, 0);
-            g_free(elem);
+            virtqueue_element_free(elem);
             break;
         }
 
@@ -1375,8 +1428,9 @@ static void virtio_net_handle_ctrl(VirtIODevice *vdev, VirtQueue *vq)
         virtqueue_push(vq, elem, sizeof(status));
         virtio_notify(vdev, vq);
         g_free(iov2);
-        g_free(elem);
+        virtqueue_element_free(elem);
     }
+    virtio_net_dataplane_unlock(n);
 }
 
 /* RX */
@@ -1385,8 +1439,14 @@ static void virtio_net_handle_rx(VirtIODevice *vdev, VirtQueue *vq)
 {
     VirtIONet *n = VIRTIO_NET(vdev);
     int queue_index = vq2q(virtio_get_queue_index(vq));
+    VirtIONetQueue *q = &n->vqs[queue_index];
 
     qemu_flush_queued_packets(qemu_get_subqueue(n->nic, queue_index));
+
+    /* Steered packets that were waiting for buffers */
+    if (!QSIMPLEQ_EMPTY(&q->steer_pending)) {
+        qemu_bh_schedule(q->steer_bh);
+    }
 }
 
 static bool virtio_net_can_receive(NetClientState *nc)
@@ -1593,7 +1653,7 @@ static int virtio_net_process_rss(NetClientState *nc, const uint8_t *buf,
 {
     VirtIONet *n = qemu_get_nic_opaque(nc);
     unsigned int index = nc->queue_index, new_index = index;
-    struct NetRxPkt *pkt = n->rx_pkt;
+    struct NetRxPkt *pkt = virtio_net_get_subqueue(nc)->rx_pkt;
     uint8_t net_hash_type;
     uint32_t hash;
     bool isip4, isip6, isudp, istcp;
@@ -1641,6 +1701,43 @@ static int virtio_net_process_rss(NetClientState *nc, const uint8_t *buf,
     return (index == new_index) ? -1 : new_index;
 }
 
+/* Bound on packets waiting for a queue pair that runs in another IOThread */
+#define VIRTIO_NET_STEER_MAX 256
+
+typedef struct VirtIONetSteeredPacket {
+    QSLIST_ENTRY(VirtIONetSteeredPacket) next;
+    QSIMPLEQ_ENTRY(VirtIONetSteeredPacket) pending;
+    size_t size;
+    uint8_t data[];
+} VirtIONetSteeredPacket;
+
+/*
+ * Hand a packet that RSS picked for queue pair @q to the IOThread running
+ * it.  Returns false if steering is off and the caller keeps the packet.
+ */
+static bool virtio_net_steer(VirtIONet *n, VirtIONetQueue *q,
+                             const uint8_t *buf, size_t size)
+{
+    VirtIONetSteeredPacket *p;
+
+    if (!qatomic_load_acquire(&n->dataplane_steering) || !q->steer_bh) {
+        return false;
+    }
+
+    /* Drop like a full rx ring would if the target falls behind */
+    if (qatomic_fetch_inc(&q->steer_len) >= VIRTIO_NET_STEER_MAX) {
+        qatomic_dec(&q->steer_len);
+        return true;
+    }
+
+    p = g_malloc(sizeof(*p) + size);
+    p->size = size;
+    memcpy(p->data, buf, size);
+    QSLIST_INSERT_HEAD_ATOMIC(&q->steer_list, p, next);
+    qemu_bh_schedule(q->steer_bh);
+    return true;
+}
+
 static ssize_t virtio_net_receive_rcu(NetClientState *nc, const uint8_t *buf,
                                       size_t size, bool no_rss)
 {
@@ -1660,7 +1757,14 @@ static ssize_t virtio_net_receive_rcu(NetClientState *nc, const uint8_t *buf,
         int index = virtio_net_process_rss(nc, buf, size);
         if (index >= 0) {
             NetClientState *nc2 = qemu_get_subqueue(n->nic, index);
-            return virtio_net_receive_rcu(nc2, buf, size, true);
+
+            if (nc2->ctx == nc->ctx) {
+                return virtio_net_receive_rcu(nc2, buf, size, true);
+            }
+            /* Queues running in another IOThread cannot be filled here */
+            if (virtio_net_steer(n, &n->vqs[index], buf, size)) {
+                return size;
+            }
         }
     }
 
@@ -1699,7 +1803,7 @@ static ssize_t virtio_net_receive_rcu(NetClientState *nc, const uint8_t *buf,
             virtio_error(vdev,
                          "virtio-net receive queue contains no in buffers");
             virtqueue_detach_element(q->rx_vq, elem, 0);
-            g_free(elem);
+            virtqueue_element_free(elem);
             return -1;
         }
 
@@ -1736,13 +1840,13 @@ static ssize_t virtio_net_receive_rcu(NetClientState *nc, const uint8_t *buf,
          * Otherwise, drop it. */
         if (!n->mergeable_rx_bufs && offset < size) {
             virtqueue_unpop(q->rx_vq, elem, total);
-            g_free(elem);
+            virtqueue_element_free(elem);
             return size;
         }
 
         /* signal other side */
         virtqueue_fill(q->rx_vq, elem, total, i++);
-        g_free(elem);
+        virtqueue_element_free(elem);
     }
 
     if (mhdr_cnt) {
@@ -1753,7 +1857,11 @@ static ssize_t virtio_net_receive_rcu(NetClientState *nc, const uint8_t *buf,
     }
 
     virtqueue_flush(q->rx_vq, i);
-    virtio_notify(vdev, q->rx_vq);
+    if (q->rx_batching) {
+        q->rx_notify_pending = true;
+    } else {
+        virtio_net_notify(n, q->rx_vq);
+    }
 
     return size;
 }
@@ -2370,18 +2478,40 @@ static ssize_t virtio_net_receive(NetClientState *nc, const uint8_t *buf,
     }
 }
 
+static int virtio_net_receive_batch(NetClientState *nc,
+                                    const struct iovec *pkts, int count)
+{
+    VirtIONet *n = qemu_get_nic_opaque(nc);
+    VirtIONetQueue *q = virtio_net_get_subqueue(nc);
+    int i;
+
+    q->rx_batching = true;
+    for (i = 0; i < count; i++) {
+        /* Out of rx buffers: the caller queues the rest */
+        if (virtio_net_receive(nc, pkts[i].iov_base, pkts[i].iov_len) == 0) {
+            break;
+        }
+    }
+    q->rx_batching = false;
+
+    if (q->rx_notify_pending) {
+        q->rx_notify_pending = false;
+        virtio_net_notify(n, q->rx_vq);
+    }
+    return i;
+}
+
 static int32_t virtio_net_flush_tx(VirtIONetQueue *q);
 
 static void virtio_net_tx_complete(NetClientState *nc, ssize_t len)
 {
     VirtIONet *n = qemu_get_nic_opaque(nc);
     VirtIONetQueue *q = virtio_net_get_subqueue(nc);
-    VirtIODevice *vdev = VIRTIO_DEVICE(n);
 
     virtqueue_push(q->tx_vq, q->async_tx.elem, 0);
-    virtio_notify(vdev, q->tx_vq);
+    virtio_net_notify(n, q->tx_vq);
 
-    g_free(q->async_tx.elem);
+    virtqueue_element_free(q->async_tx.elem);
     q->async_tx.elem = NULL;
 
     virtio_queue_set_notification(q->tx_vq, 1);
@@ -2389,11 +2519,25 @@ static void virtio_net_tx_complete(NetClientState *nc, ssize_t len)
 }
 
 /* TX */
+#define VIRTIO_NET_TX_POP_BATCH 32
+
+/* Give back elements that were popped but not transmitted */
+static void virtio_net_tx_unpop(VirtIONetQueue *q, VirtQueueElement **elems,
+                                unsigned int num)
+{
+    while (num--) {
+        virtqueue_unpop(q->tx_vq, elems[num], 0);
+        virtqueue_element_free(elems[num]);
+    }
+}
+
 static int32_t virtio_net_flush_tx(VirtIONetQueue *q)
 {
     VirtIONet *n = q->n;
     VirtIODevice *vdev = VIRTIO_DEVICE(n);
     VirtQueueElement *elem;
+    VirtQueueElement *elems[VIRTIO_NET_TX_POP_BATCH];
+    unsigned int i = 0, num = 0;
     int32_t num_packets = 0;
     int queue_index = vq2q(virtio_get_queue_index(q->tx_vq));
     if (!(vdev->status & VIRTIO_CONFIG_S_DRIVER_OK)) {
@@ -2411,17 +2555,25 @@ static int32_t virtio_net_flush_tx(VirtIONetQueue *q)
         struct iovec sg[VIRTQUEUE_MAX_SIZE], sg2[VIRTQUEUE_MAX_SIZE + 1], *out_sg;
         struct virtio_net_hdr_mrg_rxbuf mhdr;
 
-        elem = virtqueue_pop(q->tx_vq, sizeof(VirtQueueElement));
-        if (!elem) {
-            break;
+        if (i == num) {
+            num = virtqueue_pop_batch(q->tx_vq, sizeof(VirtQueueElement),
+                                      (void **)elems,
+                                      MIN(ARRAY_SIZE(elems),
+                                          n->tx_burst - num_packets));
+            i = 0;
+            if (!num) {
+                break;
+            }
         }
+        elem = elems[i++];
 
         out_num = elem->out_num;
         out_sg = elem->out_sg;
         if (out_num < 1) {
             virtio_error(vdev, "virtio-net header not in first element");
+            virtio_net_tx_unpop(q, elems + i, num - i);
             virtqueue_detach_element(q->tx_vq, elem, 0);
-            g_free(elem);
+            virtqueue_element_free(elem);
             return -EINVAL;
         }
 
@@ -2429,8 +2581,9 @@ static int32_t virtio_net_flush_tx(VirtIONetQueue *q)
             if (iov_to_buf(out_sg, out_num, 0, &mhdr, n->guest_hdr_len) <
                 n->guest_hdr_len) {
                 virtio_error(vdev, "virtio-net header incorrect");
+                virtio_net_tx_unpop(q, elems + i, num - i);
                 virtqueue_detach_element(q->tx_vq, elem, 0);
-                g_free(elem);
+                virtqueue_element_free(elem);
                 return -EINVAL;
             }
             if (n->needs_vnet_hdr_swap) {
@@ -2467,6 +2620,7 @@ static int32_t virtio_net_flush_tx(VirtIONetQueue *q)
         ret = qemu_sendv_packet_async(qemu_get_subqueue(n->nic, queue_index),
                                       out_sg, out_num, virtio_net_tx_complete);
         if (ret == 0) {
+            virtio_net_tx_unpop(q, elems + i, num - i);
             virtio_queue_set_notification(q->tx_vq, 0);
             q->async_tx.elem = elem;
             return -EBUSY;
@@ -2474,8 +2628,8 @@ static int32_t virtio_net_flush_tx(VirtIONetQueue *q)
 
 drop:
         virtqueue_push(q->tx_vq, elem, 0);
-        virtio_notify(vdev, q->tx_vq);
-        g_free(elem);
+        virtio_net_notify(n, q->tx_vq);
+        virtqueue_element_free(elem);
 
         if (++num_packets >= n->tx_burst) {
             break;
@@ -2654,6 +2808,291 @@ static void virtio_net_del_queue(VirtIONet *n, int index)
     virtio_del_queue(vdev, index * 2 + 1);
 }
 
+/*
+ * Dataplane: each active queue pair and the peer it talks to move into an
+ * IOThread while the device runs without vhost.  The pair's NetClientState
+ * and its peer share the IOThread's AioContext, whose lock serializes them
+ * against the main loop.
+ */
+static bool virtio_net_dataplane_handle_rx(VirtIODevice *vdev, VirtQueue *vq)
+{
+    VirtIONet *n = VIRTIO_NET(vdev);
+    VirtIONetQueue *q = &n->vqs[vq2q(virtio_get_queue_index(vq))];
+
+    aio_context_acquire(q->ctx);
+    virtio_net_handle_rx(vdev, vq);
+    aio_context_release(q->ctx);
+
+    /* Buffers are consumed by the backend, not by polling the ring */
+    return false;
+}
+
+static bool virtio_net_dataplane_handle_tx(VirtIODevice *vdev, VirtQueue *vq)
+{
+    VirtIONet *n = VIRTIO_NET(vdev);
+    VirtIONetQueue *q = &n->vqs[vq2q(virtio_get_queue_index(vq))];
+
+    aio_context_acquire(q->ctx);
+    virtio_net_handle_tx_bh(vdev, vq);
+    aio_context_release(q->ctx);
+    return true;
+}
+
+static bool virtio_net_dataplane_handle_ctrl(VirtIODevice *vdev,
+                                             VirtQueue *vq)
+{
+    virtio_net_handle_ctrl(vdev, vq);
+    return true;
+}
+
+static void virtio_net_dataplane_tx_bh(void *opaque)
+{
+    VirtIONetQueue *q = opaque;
+    AioContext *ctx = q->ctx;
+
+    aio_context_acquire(ctx);
+    virtio_net_tx_bh(q);
+    aio_context_release(ctx);
+}
+
+/* Context: BH in the IOThread of the queue pair RSS steered packets to */
+static void virtio_net_dataplane_steer_bh(void *opaque)
+{
+    VirtIONetQueue *q = opaque;
+    VirtIONet *n = q->n;
+    NetClientState *nc = qemu_get_subqueue(n->nic, q - n->vqs);
+    QSLIST_HEAD(, VirtIONetSteeredPacket) reversed;
+    QSIMPLEQ_HEAD(, VirtIONetSteeredPacket) straight =
+        QSIMPLEQ_HEAD_INITIALIZER(straight);
+    VirtIONetSteeredPacket *p;
+
+    QSLIST_MOVE_ATOMIC(&reversed, &q->steer_list);
+    while (!QSLIST_EMPTY(&reversed)) {
+        p = QSLIST_FIRST(&reversed);
+        QSLIST_REMOVE_HEAD(&reversed, next);
+        QSIMPLEQ_INSERT_HEAD(&straight, p, pending);
+    }
+    QSIMPLEQ_CONCAT(&q->steer_pending, &straight);
+
+    aio_context_acquire(q->ctx);
+    q->rx_batching = true;
+    WITH_RCU_READ_LOCK_GUARD() {
+        while ((p = QSIMPLEQ_FIRST(&q->steer_pending))) {
+            if (virtio_net_receive_rcu(nc, p->data, p->size, true) == 0) {
+                /* Out of rx buffers, virtio_net_handle_rx() retries */
+                break;
+            }
+            QSIMPLEQ_REMOVE_HEAD(&q->steer_pending, pending);
+            qatomic_dec(&q->steer_len);
+            g_free(p);
+        }
+    }
+    q->rx_batching = false;
+
+    if (q->rx_notify_pending) {
+        q->rx_notify_pending = false;
+        virtio_net_notify(n, q->rx_vq);
+    }
+    aio_context_release(q->ctx);
+}
+
+/* Context: BH in IOThread */
+static void virtio_net_dataplane_stop_bh(void *opaque)
+{
+    VirtIONetQueue *q = opaque;
+
+    virtio_queue_aio_set_host_notifier_handler(q->rx_vq, q->ctx, NULL);
+    virtio_queue_aio_set_host_notifier_handler(q->tx_vq, q->ctx, NULL);
+    qemu_bh_delete(q->tx_bh);
+    q->tx_bh = NULL;
+}
+
+/*
+ * Context: BH in IOThread, once no queue pair can steer packets anymore.
+ * Packets still waiting are dropped, as on a reset.
+ */
+static void virtio_net_dataplane_steer_stop_bh(void *opaque)
+{
+    VirtIONetQueue *q = opaque;
+    VirtIONetSteeredPacket *p;
+
+    qemu_bh_delete(q->steer_bh);
+    q->steer_bh = NULL;
+
+    while ((p = QSIMPLEQ_FIRST(&q->steer_pending))) {
+        QSIMPLEQ_REMOVE_HEAD(&q->steer_pending, pending);
+        g_free(p);
+    }
+    while ((p = QSLIST_FIRST(&q->steer_list))) {
+        QSLIST_REMOVE_HEAD(&q->steer_list, next);
+        g_free(p);
+    }
+    q->steer_len = 0;
+}
+
+static int virtio_net_dataplane_queues(VirtIONet *n)
+{
+    return n->multiqueue ? n->max_queues : 1;
+}
+
+/* Context: QEMU global mutex held */
+static int virtio_net_dataplane_start(VirtIODevice *vdev)
+{
+    VirtIONet *n = VIRTIO_NET(vdev);
+    BusState *qbus = BUS(qdev_get_parent_bus(DEVICE(vdev)));
+    VirtioBusClass *k = VIRTIO_BUS_GET_CLASS(qbus);
+    int nvqs = virtio_get_num_queues(vdev);
+    int queues = virtio_net_dataplane_queues(n);
+    int i, r;
+
+    if (!n->num_iothreads) {
+        return virtio_device_start_ioeventfd_impl(vdev);
+    }
+
+    for (i = 0; i < queues; i++) {
+        NetClientState *peer = qemu_get_subqueue(n->nic, i)->peer;
+
+        if (peer && !peer->info->set_aio_context) {
+            warn_report_once("virtio-net: netdev '%s' cannot run in an "
+                             "IOThread, using the main loop", peer->name);
+            return virtio_device_start_ioeventfd_impl(vdev);
+        }
+    }
+
+    /* The mask callback is only implemented for vhost */
+    n->saved_use_guest_notifier_mask = vdev->use_guest_notifier_mask;
+    vdev->use_guest_notifier_mask = false;
+
+    r = k->set_guest_notifiers(qbus->parent, nvqs, true);
+    if (r != 0) {
+        warn_report_once("virtio-net: failed to set guest notifiers (%d), "
+                         "using the main loop", r);
+        goto fail_guest_notifiers;
+    }
+
+    for (i = 0; i < nvqs; i++) {
+        r = virtio_bus_set_host_notifier(VIRTIO_BUS(qbus), i, true);
+        if (r != 0) {
+            warn_report_once("virtio-net: failed to set host notifier (%d), "
+                             "using the main loop", r);
+            while (i--) {
+                virtio_bus_set_host_notifier(VIRTIO_BUS(qbus), i, false);
+                virtio_bus_cleanup_host_notifier(VIRTIO_BUS(qbus), i);
+            }
+            k->set_guest_notifiers(qbus->parent, nvqs, false);
+            goto fail_guest_notifiers;
+        }
+    }
+
+    n->dataplane_started = true;
+
+    for (i = 0; i < queues; i++) {
+        VirtIONetQueue *q = &n->vqs[i];
+        NetClientState *nc = qemu_get_subqueue(n->nic, i);
+        AioContext *ctx;
+
+        ctx = iothread_get_aio_context(n->iothreads[i % n->num_iothreads]);
+        q->ctx = ctx;
+        qemu_net_client_set_aio_context(nc, ctx);
+        qemu_bh_delete(q->tx_bh);
+        q->tx_bh = aio_bh_new(ctx, virtio_net_dataplane_tx_bh, q);
+        q->steer_bh = aio_bh_new(ctx, virtio_net_dataplane_steer_bh, q);
+        if (nc->peer) {
+            qemu_net_client_set_aio_context(nc->peer, ctx);
+        }
+
+        aio_context_acquire(ctx);
+        virtio_queue_aio_set_host_notifier_handler(q->rx_vq, ctx,
+                virtio_net_dataplane_handle_rx);
+        virtio_queue_aio_set_host_notifier_handler(q->tx_vq, ctx,
+                virtio_net_dataplane_handle_tx);
+        if (q->tx_waiting) {
+            qemu_bh_schedule(q->tx_bh);
+        }
+        aio_context_release(ctx);
+    }
+
+    /* Every queue pair can take steered packets now */
+    qatomic_store_release(&n->dataplane_steering, true);
+
+    /* Control commands touch the whole device and stay in the main loop */
+    virtio_queue_aio_set_host_notifier_handler(n->ctrl_vq,
+            qemu_get_aio_context(), virtio_net_dataplane_handle_ctrl);
+
+    /* Kick right away to pick up buffers already in the rings */
+    for (i = 0; i < nvqs; i++) {
+        VirtQueue *vq = virtio_get_queue(vdev, i);
+
+        event_notifier_set(virtio_queue_get_host_notifier(vq));
+    }
+    return 0;
+
+fail_guest_notifiers:
+    vdev->use_guest_notifier_mask = n->saved_use_guest_notifier_mask;
+    return virtio_device_start_ioeventfd_impl(vdev);
+}
+
+/* Context: QEMU global mutex held */
+static void virtio_net_dataplane_stop(VirtIODevice *vdev)
+{
+    VirtIONet *n = VIRTIO_NET(vdev);
+    BusState *qbus = BUS(qdev_get_parent_bus(DEVICE(vdev)));
+    VirtioBusClass *k = VIRTIO_BUS_GET_CLASS(qbus);
+    int nvqs = virtio_get_num_queues(vdev);
+    int queues = virtio_net_dataplane_queues(n);
+    int i;
+
+    if (!n->dataplane_started) {
+        virtio_device_stop_ioeventfd_impl(vdev);
+        return;
+    }
+
+    virtio_queue_aio_set_host_notifier_handler(n->ctrl_vq,
+            qemu_get_aio_context(), NULL);
+
+    /*
+     * Stop steering first.  Once every IOThread ran the stop BH, no queue
+     * pair is in the middle of handing a packet to another one.
+     */
+    qatomic_set(&n->dataplane_steering, false);
+    for (i = 0; i < queues; i++) {
+        VirtIONetQueue *q = &n->vqs[i];
+
+        aio_context_acquire(q->ctx);
+        aio_wait_bh_oneshot(q->ctx, virtio_net_dataplane_stop_bh, q);
+        aio_context_release(q->ctx);
+    }
+
+    for (i = 0; i < queues; i++) {
+        VirtIONetQueue *q = &n->vqs[i];
+        NetClientState *nc = qemu_get_subqueue(n->nic, i);
+
+        aio_context_acquire(q->ctx);
+        aio_wait_bh_oneshot(q->ctx, virtio_net_dataplane_steer_stop_bh, q);
+        aio_context_release(q->ctx);
+
+        if (nc->peer) {
+            qemu_net_client_set_aio_context(nc->peer, NULL);
+        }
+        qemu_net_client_set_aio_context(nc, NULL);
+        q->ctx = NULL;
+
+        q->tx_bh = qemu_bh_new(virtio_net_tx_bh, q);
+        if (q->tx_waiting) {
+            qemu_bh_schedule(q->tx_bh);
+        }
+    }
+
+    for (i = 0; i < nvqs; i++) {
+        virtio_bus_set_host_notifier(VIRTIO_BUS(qbus), i, false);
+        virtio_bus_cleanup_host_notifier(VIRTIO_BUS(qbus), i);
+    }
+
+    k->set_guest_notifiers(qbus->parent, nvqs, false);
+    vdev->use_guest_notifier_mask = n->saved_use_guest_notifier_mask;
+    n->dataplane_started = false;
+}
+
 static void virtio_net_change_num_queues(VirtIONet *n, int new_max_queues)
 {
     VirtIODevice *vdev = VIRTIO_DEVICE(n);
@@ -3030,6 +3469,7 @@ static NetClientInfo net_virtio_info = {
     .size = sizeof(NICState),
     .can_receive = virtio_net_can_receive,
     .receive = virtio_net_receive,
+    .receive_batch = virtio_net_receive_batch,
     .link_status_changed = virtio_net_set_link_status,
     .query_rx_filter = virtio_net_query_rxfilter,
     .announce = virtio_net_announce,
@@ -3263,7 +3703,40 @@ static void virtio_net_device_realize(DeviceState *dev, Error **errp)
         virtio_cleanup(vdev);
         return;
     }
+    if (n->num_iothreads) {
+        if (n->net_conf.tx && !strcmp(n->net_conf.tx, "timer")) {
+            error_setg(errp, "'iothreads' requires tx=bh");
+            virtio_cleanup(vdev);
+            return;
+        }
+        if (n->host_features & (1ULL << VIRTIO_NET_F_RSC_EXT)) {
+            error_setg(errp, "'iothreads' cannot be used with 'guest_rsc_ext'");
+            virtio_cleanup(vdev);
+            return;
+        }
+        n->iothreads = g_new0(IOThread *, n->num_iothreads);
+        for (i = 0; i < n->num_iothreads; i++) {
+            n->iothreads[i] = iothread_by_id(n->iothread_ids[i]);
+            if (!n->iothreads[i]) {
+                error_setg(errp, "IOThread '%s' not found",
+                           n->iothread_ids[i]);
+                while (i--) {
+                    object_unref(OBJECT(n->iothreads[i]));
+                }
+                g_free(n->iothreads);
+                n->iothreads = NULL;
+                virtio_cleanup(vdev);
+                return;
+            }
+            object_ref(OBJECT(n->iothreads[i]));
+        }
+    }
+
     n->vqs = g_malloc0(sizeof(VirtIONetQueue) * n->max_queues);
+    for (i = 0; i < n->max_queues; i++) {
+        QSIMPLEQ_INIT(&n->vqs[i].steer_pending);
+        net_rx_pkt_init(&n->vqs[i].rx_pkt, false);
+    }
     n->curr_queues = 1;
     n->tx_timeout = n->net_conf.txtimer;
 
@@ -3334,8 +3807,6 @@ static void virtio_net_device_realize(DeviceState *dev, Error **errp)
     }
     QTAILQ_INIT(&n->rsc_chains);
     n->qdev = dev;
-
-    net_rx_pkt_init(&n->rx_pkt, false);
 }
 
 static void virtio_net_device_unrealize(DeviceState *dev)
@@ -3366,11 +3837,18 @@ static void virtio_net_device_unrealize(DeviceState *dev)
     /* delete also control vq */
     virtio_del_queue(vdev, max_queues * 2);
     qemu_announce_timer_del(&n->announce_timer, false);
+    for (i = 0; i < n->max_queues; i++) {
+        net_rx_pkt_uninit(n->vqs[i].rx_pkt);
+    }
     g_free(n->vqs);
     qemu_del_nic(n->nic);
     virtio_net_rsc_cleanup(n);
     g_free(n->rss_data.indirections_table);
-    net_rx_pkt_uninit(n->rx_pkt);
+    for (i = 0; i < n->num_iothreads; i++) {
+        object_unref(OBJECT(n->iothreads[i]));
+    }
+    g_free(n->iothreads);
+    n->iothreads = NULL;
     virtio_cleanup(vdev);
 }
 
@@ -3478,6 +3956,12 @@ static Property virtio_net_properties[] = {
                     VIRTIO_NET_F_RSS, false),
     DEFINE_PROP_BIT64("hash", VirtIONet, host_features,
                     VIRTIO_NET_F_HASH_REPORT, false),
+    DEFINE_PROP_BIT64("guest_uso4", VirtIONet, host_features,
+                    VIRTIO_NET_F_GUEST_USO4, false),
+    DEFINE_PROP_BIT64("guest_uso6", VirtIONet, host_features,
+                    VIRTIO_NET_F_GUEST_USO6, false),
+    DEFINE_PROP_BIT64("host_uso", VirtIONet, host_features,
+                    VIRTIO_NET_F_HOST_USO, false),
     DEFINE_PROP_BIT64("guest_rsc_ext", VirtIONet, host_features,
                     VIRTIO_NET_F_RSC_EXT, false),
     DEFINE_PROP_UINT32("rsc_interval", VirtIONet, rsc_timeout,
@@ -3487,6 +3971,8 @@ static Property virtio_net_properties[] = {
                        TX_TIMER_INTERVAL),
     DEFINE_PROP_INT32("x-txburst", VirtIONet, net_conf.txburst, TX_BURST),
     DEFINE_PROP_STRING("tx", VirtIONet, net_conf.tx),
+    DEFINE_PROP_ARRAY("iothreads", VirtIONet, num_iothreads, iothread_ids,
+                      qdev_prop_string, char *),
     DEFINE_PROP_UINT16("rx_queue_size", VirtIONet, net_conf.rx_queue_size,
                        VIRTIO_NET_RX_QUEUE_DEFAULT_SIZE),
     DEFINE_PROP_UINT16("tx_queue_size", VirtIONet, net_conf.tx_queue_size,
@@ -3519,6 +4005,8 @@ static void virtio_net_class_init(ObjectClass *klass, void *data)
     vdc->set_status = virtio_net_set_status;
     vdc->guest_notifier_mask = virtio_net_guest_notifier_mask;
     vdc->guest_notifier_pending = virtio_net_guest_notifier_pending;
+    vdc->start_ioeventfd = virtio_net_dataplane_start;
+    vdc->stop_ioeventfd = virtio_net_dataplane_stop;
     vdc->legacy_features |= (0x1 << VIRTIO_NET_F_GSO);
     vdc->post_load = virtio_net_post_load_virtio;
     vdc->vmsd = &vmstate_virtio_net_device;
@@ -28,6 +28,7 @@
 #include "hw/virtio/virtio-access.h"
 #include "sysemu/dma.h"
 #include "sysemu/runstate.h"
+#include "sysemu/xen.h"
 #include "standard-headers/linux/virtio_ids.h"
 
 /*
@@ -1295,6 +1296,65 @@ int virtqueue_avail_bytes(VirtQueue *vq, unsigned int in_bytes,
     return in_bytes <= in_total && out_bytes <= out_total;
 }
 
+/*
+ * Writable guest RAM visible through dma_as, sorted by guest physical
+ * address.  Descriptors that point into plain RAM are translated with a
+ * binary search here instead of a full address_space_map().
+ */
+typedef struct VirtIORAMRegion {
+    hwaddr gpa;
+    hwaddr size;
+    uint8_t *host;
+    MemoryRegion *mr;
+} VirtIORAMRegion;
+
+typedef struct VirtIORAMMap {
+    struct rcu_head rcu;
+    unsigned int nr;
+    VirtIORAMRegion regions[];
+} VirtIORAMMap;
+
+static void virtio_ram_map_free(VirtIORAMMap *map)
+{
+    unsigned int i;
+
+    for (i = 0; i < map->nr; i++) {
+        memory_region_unref(map->regions[i].mr);
+    }
+    g_free(map);
+}
+
+/*
+ * Called within rcu_read_lock().  Like dma_memory_map(), takes a reference
+ * to the MemoryRegion, which dma_memory_unmap() drops again.
+ */
+static void *virtio_ram_map_lookup(VirtIODevice *vdev, hwaddr pa, hwaddr *plen)
+{
+    VirtIORAMMap *map = qatomic_rcu_read(&vdev->ram_map);
+    unsigned int lo = 0, hi;
+
+    if (!map) {
+        return NULL;
+    }
+
+    hi = map->nr;
+    while (lo < hi) {
+        unsigned int mid = lo + (hi - lo) / 2;
+        VirtIORAMRegion *r = &map->regions[mid];
+
+        if (pa < r->gpa) {
+            hi = mid;
+        } else if (pa - r->gpa >= r->size) {
+            lo = mid + 1;
+        } else {
+            *plen = MIN(*plen, r->size - (pa - r->gpa));
+            memory_region_ref(r->mr);
+            return r->host + (pa - r->gpa);
+        }
+    }
+    return NULL;
+}
+
 static bool virtqueue_map_desc(VirtIODevice *vdev, unsigned int *p_num_sg,
                                hwaddr *addr, struct iovec *iov,
                                unsigned int max_num_sg, bool is_write,
@@ -1318,10 +1378,13 @@ static bool virtqueue_map_desc(VirtIODevice *vdev, unsigned int *p_num_sg,
             goto out;
         }
 
-        iov[num_sg].iov_base = dma_memory_map(vdev->dma_as, pa, &len,
-                                              is_write ?
-                                              DMA_DIRECTION_FROM_DEVICE :
-                                              DMA_DIRECTION_TO_DEVICE);
+        iov[num_sg].iov_base = virtio_ram_map_lookup(vdev, pa, &len);
+        if (!iov[num_sg].iov_base) {
+            iov[num_sg].iov_base = dma_memory_map(vdev->dma_as, pa, &len,
+                                                  is_write ?
+                                                  DMA_DIRECTION_FROM_DEVICE :
+                                                  DMA_DIRECTION_TO_DEVICE);
+        }
         if (!iov[num_sg].iov_base) {
             virtio_error(vdev, "virtio: bogus descriptor or out of resources");
             goto out;
@@ -1389,6 +1452,55 @@ void virtqueue_map(VirtIODevice *vdev, VirtQueueElement *elem)
                                                                         false);
 }
 
+/*
+ * Elements that fit in VIRTQUEUE_ELEMENT_POOL_SIZE bytes are all allocated
+ * with that size and recycled through a per-thread free list by
+ * virtqueue_element_free().  They are still plain g_malloc() blocks, so
+ * devices that release elements with g_free() keep working.
+ */
+#define VIRTQUEUE_ELEMENT_POOL_SIZE     1024
+#define VIRTQUEUE_ELEMENT_POOL_MAX      256
+
+typedef struct VirtQueueElementFree {
+    struct VirtQueueElementFree *next;
+} VirtQueueElementFree;
+
+static __thread VirtQueueElementFree *element_pool;
+static __thread unsigned int element_pool_size;
+static __thread Notifier element_pool_cleanup_notifier;
+
+static void virtqueue_element_pool_cleanup(Notifier *n, void *value)
+{
+    VirtQueueElementFree *e;
+
+    while ((e = element_pool)) {
+        element_pool = e->next;
+        g_free(e);
+    }
+    element_pool_size = 0;
+}
+
+void virtqueue_element_free(void *opaque)
+{
+    VirtQueueElement *elem = opaque;
+    VirtQueueElementFree *e = opaque;
+
+    if (!elem) {
+        return;
+    }
+    if (!elem->pooled || element_pool_size >= VIRTQUEUE_ELEMENT_POOL_MAX) {
+        g_free(elem);
+        return;
+    }
+    if (!element_pool_cleanup_notifier.notify) {
+        element_pool_cleanup_notifier.notify = virtqueue_element_pool_cleanup;
+        qemu_thread_atexit_add(&element_pool_cleanup_notifier);
+    }
+    e->next = element_pool;
+    element_pool = e;
+    element_pool_size++;
+}
+
 static void *virtqueue_alloc_element(size_t sz, unsigned out_num, unsigned in_num)
 {
     VirtQueueElement *elem;
@@ -1398,10 +1510,18 @@ static void *virtqueue_alloc_element(size_t sz, unsigned out_num, unsigned in_nu
     size_t in_sg_ofs = QEMU_ALIGN_UP(out_addr_end, __alignof__(elem->in_sg[0]));
     size_t out_sg_ofs = in_sg_ofs + in_num * sizeof(elem->in_sg[0]);
     size_t out_sg_end = out_sg_ofs + out_num * sizeof(elem->out_sg[0]);
+    bool pooled = out_sg_end <= VIRTQUEUE_ELEMENT_POOL_SIZE;
 
     assert(sz >= sizeof(VirtQueueElement));
-    elem = g_malloc(out_sg_end);
+    if (pooled && element_pool) {
+        elem = (VirtQueueElement *)element_pool;
+        element_pool = element_pool->next;
+        element_pool_size--;
+    } else {
+        elem = g_malloc(pooled ? VIRTQUEUE_ELEMENT_POOL_SIZE : out_sg_end);
+    }
     trace_virtqueue_alloc_element(elem, sz, in_num, out_num);
+    elem->pooled = pooled;
     elem->out_num = out_num;
     elem->in_num = in_num;
     elem->in_addr = (void *)elem + in_addr_ofs;
@@ -1411,7 +1531,8 @@ static void *virtqueue_alloc_element(size_t sz, unsigned out_num, unsigned in_nu
     return elem;
 }
 
-static void *virtqueue_split_pop(VirtQueue *vq, size_t sz)
+/* Called within rcu_read_lock(), with at least one head available.  */
+static void *virtqueue_split_pop_rcu(VirtQueue *vq, size_t sz, bool set_event)
 {
     unsigned int i, head, max;
     VRingMemoryRegionCaches *caches;
@@ -1426,14 +1547,6 @@ static void *virtqueue_split_pop(VirtQueue *vq, size_t sz)
     VRingDesc desc;
     int rc;
 
-    RCU_READ_LOCK_GUARD();
-    if (virtio_queue_empty_rcu(vq)) {
-        goto done;
-    }
-    /* Needed after virtio_queue_empty(), see comment in
-     * virtqueue_num_heads(). */
-    smp_rmb();
-
     /* When we start there are none of either input nor output. */
     out_num = in_num = elem_entries = 0;
 
@@ -1448,7 +1561,7 @@ static void *virtqueue_split_pop(VirtQueue *vq, size_t sz)
         goto done;
     }
 
-    if (virtio_vdev_has_feature(vdev, VIRTIO_RING_F_EVENT_IDX)) {
+    if (set_event && virtio_vdev_has_feature(vdev, VIRTIO_RING_F_EVENT_IDX)) {
         vring_set_avail_event(vq, vq->last_avail_idx);
     }
 
@@ -1548,6 +1661,58 @@ err_undo_map:
     goto done;
 }
 
+static void *virtqueue_split_pop(VirtQueue *vq, size_t sz)
+{
+    RCU_READ_LOCK_GUARD();
+    if (virtio_queue_empty_rcu(vq)) {
+        return NULL;
+    }
+    /* Needed after virtio_queue_empty(), see comment in
+     * virtqueue_num_heads(). */
+    smp_rmb();
+
+    return virtqueue_split_pop_rcu(vq, sz, true);
+}
+
+/*
+ * Read the avail index once and pop every head it covers, up to @max,
+ * inside a single RCU critical section.  The avail event is published
+ * once for the whole batch.
+ */
+static unsigned int virtqueue_split_pop_batch(VirtQueue *vq, size_t sz,
+                                              void **elems, unsigned int max)
+{
+    uint16_t start = vq->last_avail_idx;
+    unsigned int n = 0;
+    int num_heads;
+
+    RCU_READ_LOCK_GUARD();
+    if (virtio_queue_empty_rcu(vq)) {
+        return 0;
+    }
+
+    num_heads = virtqueue_num_heads(vq, vq->last_avail_idx);
+    if (num_heads <= 0) {
+        return 0;
+    }
+    max = MIN(max, num_heads);
+
+    while (n < max) {
+        void *elem = virtqueue_split_pop_rcu(vq, sz, false);
+
+        if (!elem) {
+            break;
+        }
+        elems[n++] = elem;
+    }
+
+    if (vq->last_avail_idx != start &&
+        virtio_vdev_has_feature(vq->vdev, VIRTIO_RING_F_EVENT_IDX)) {
+        vring_set_avail_event(vq, vq->last_avail_idx);
+    }
+    return n;
+}
+
 static void *virtqueue_packed_pop(VirtQueue *vq, size_t sz)
 {
     unsigned int i, max;
@@ -1696,6 +1861,30 @@ void *virtqueue_pop(VirtQueue *vq, size_t sz)
     }
 }
 
+unsigned int virtqueue_pop_batch(VirtQueue *vq, size_t sz,
+                                 void **elems, unsigned int max)
+{
+    unsigned int n = 0;
+
+    if (virtio_device_disabled(vq->vdev)) {
+        return 0;
+    }
+
+    if (!virtio_vdev_has_feature(vq->vdev, VIRTIO_F_RING_PACKED)) {
+        return virtqueue_split_pop_batch(vq, sz, elems, max);
+    }
+
+    while (n < max) {
+        void *elem = virtqueue_packed_pop(vq, sz);
+
+        if (!elem) {
+            break;
+        }
+        elems[n++] = elem;
+    }
+    return n;
+}
+
 static unsigned int virtqueue_packed_drop_all(VirtQueue *vq)
 {
     VRingMemoryRegionCaches *caches;
@@ -3634,11 +3823,58 @@ void GCC_FMT_ATTR(2, 3) virtio_error(VirtIODevice *vdev, const char *fmt, ...)
     vdev->broken = true;
 }
 
+static void virtio_memory_listener_begin(MemoryListener *listener)
+{
+    VirtIODevice *vdev = container_of(listener, VirtIODevice, listener);
+
+    vdev->ram_map_next = g_array_new(false, false, sizeof(VirtIORAMRegion));
+}
+
+static void virtio_memory_listener_region_addnop(MemoryListener *listener,
+                                                 MemoryRegionSection *section)
+{
+    VirtIODevice *vdev = container_of(listener, VirtIODevice, listener);
+    VirtIORAMRegion r;
+
+    /* Anything address_space_map() would not map directly stays uncached */
+    if (!memory_access_is_direct(section->mr, true) || xen_enabled()) {
+        return;
+    }
+
+    r.gpa = section->offset_within_address_space;
+    r.size = int128_get64(section->size);
+    r.host = memory_region_get_ram_ptr(section->mr) +
+             section->offset_within_region;
+    r.mr = section->mr;
+    memory_region_ref(r.mr);
+    g_array_append_val(vdev->ram_map_next, r);
+}
+
+static void virtio_ram_map_commit(VirtIODevice *vdev)
+{
+    GArray *next = vdev->ram_map_next;
+    VirtIORAMMap *map, *old;
+
+    map = g_malloc(sizeof(*map) + next->len * sizeof(VirtIORAMRegion));
+    map->nr = next->len;
+    memcpy(map->regions, next->data, next->len * sizeof(VirtIORAMRegion));
+    g_array_free(next, true);
+    vdev->ram_map_next = NULL;
+
+    old = vdev->ram_map;
+    qatomic_rcu_set(&vdev->ram_map, map);
+    if (old) {
+        call_rcu(old, virtio_ram_map_free, rcu);
+    }
+}
+
 static void virtio_memory_listener_commit(MemoryListener *listener)
 {
     VirtIODevice *vdev = container_of(listener, VirtIODevice, listener);
     int i;
 
+    virtio_ram_map_commit(vdev);
+
     for (i = 0; i < VIRTIO_QUEUE_MAX; i++) {
         if (vdev->vq[i].vring.num == 0) {
             break;
@@ -3671,6 +3907,9 @@ static void virtio_device_realize(DeviceState *dev, Error **errp)
         return;
     }
 
+    vdev->listener.begin = virtio_memory_listener_begin;
+    vdev->listener.region_add = virtio_memory_listener_region_addnop;
+    vdev->listener.region_nop = virtio_memory_listener_region_addnop;
     vdev->listener.commit = virtio_memory_listener_commit;
     memory_listener_register(&vdev->listener, vdev->dma_as);
 }
@@ -3681,6 +3920,12 @@ static void virtio_device_unrealize(DeviceState *dev)
     VirtioDeviceClass *vdc = VIRTIO_DEVICE_GET_CLASS(dev);
 
     memory_listener_unregister(&vdev->listener);
+    if (vdev->ram_map) {
+        VirtIORAMMap *map = vdev->ram_map;
+
+        qatomic_rcu_set(&vdev->ram_map, NULL);
+        call_rcu(map, virtio_ram_map_free, rcu);
+    }
     virtio_bus_device_unplugged(vdev);
 
     if (vdc->unrealize != NULL) {
@@ -3726,7 +3971,7 @@ static Property virtio_properties[] = {
     DEFINE_PROP_END_OF_LIST(),
 };
 
-static int virtio_device_start_ioeventfd_impl(VirtIODevice *vdev)
+int virtio_device_start_ioeventfd_impl(VirtIODevice *vdev)
 {
     VirtioBusState *qbus = VIRTIO_BUS(qdev_get_parent_bus(DEVICE(vdev)));
     int i, n, r, err;
@@ -3788,7 +4033,7 @@ int virtio_device_start_ioeventfd(VirtIODevice *vdev)
     return virtio_bus_start_ioeventfd(vbus);
 }
 
-static void virtio_device_stop_ioeventfd_impl(VirtIODevice *vdev)
+void virtio_device_stop_ioeventfd_impl(VirtIODevice *vdev)
 {
     VirtioBusState *qbus = VIRTIO_BUS(qdev_get_parent_bus(DEVICE(vdev)));
     int n, r;
@@ -287,6 +287,10 @@ int walk_memory_regions(void *, walk_memory_regions_fn);
 int page_get_flags(target_ulong address);
 void page_set_flags(target_ulong start, target_ulong end, int flags);
 int page_check_range(target_ulong start, target_ulong len, int flags);
+bool page_range_used(target_ulong start, target_ulong last,
+                     target_ulong *used);
+void page_fork_start(void);
+void page_fork_end(int child);
 #endif
 
 CPUArchState *cpu_copy(CPUArchState *env);
@@ -511,6 +511,19 @@ struct TranslationBlock {
     uintptr_t jmp_list_head;
     uintptr_t jmp_list_next[2];
     uintptr_t jmp_dest[2];
+
+    /*
+     * In system emulation, a direct jump to another guest page is only
+     * taken while the vCPU maps the destination page as it did when the
+     * jump was chained (see translator_xpage_guard).  jmp_page_addend[n]
+     * is the TLB addend of the destination page at that time.  It is set
+     * once, by the first chaining of jump n, so that a guard that passed
+     * always refers to the current destination of the jump.
+     */
+    uintptr_t jmp_page_addend[2];
+/* Addends are page aligned, so these do not collide with valid values. */
+#define TB_JMP_PAGE_ADDEND_NONE  ((uintptr_t)-1) /* jump is not guarded */
+#define TB_JMP_PAGE_ADDEND_UNSET ((uintptr_t)-2) /* not chained yet */
 };
 
 extern bool parallel_cpus;
@@ -84,6 +84,25 @@ void gdb_register_coprocessor(CPUState *cpu,
                               gdb_get_reg_cb get_reg, gdb_set_reg_cb set_reg,
                               int num_regs, const char *xml, int g_pos);
 
+/**
+ * gdb_find_register() - look up a register by name
+ * @cpu: the CPU whose register descriptions to search
+ * @name: the register name in the gdb XML description
+ *
+ * Returns the gdb register number, or -1 if @name is not found.
+ */
+int gdb_find_register(CPUState *cpu, const char *name);
+
+/**
+ * gdb_read_register() - read a register in the gdb format
+ * @cpu: the CPU
+ * @buf: the value of the register is appended here, in target order
+ * @reg: gdb register number
+ *
+ * Returns the size of the register, or 0 if @reg does not exist.
+ */
+int gdb_read_register(CPUState *cpu, GByteArray *buf, int reg);
+
 /*
  * The GDB remote protocol transfers values in target byte order. As
  * the gdbstub may be batching up several register values we always
@@ -49,5 +49,6 @@ void address_space_dispatch_free(AddressSpaceDispatch *d);
 
 void mtree_print_dispatch(struct AddressSpaceDispatch *d,
                           MemoryRegion *root);
+void mtree_print_section_cache_stats(void);
 #endif
 #endif
@@ -145,6 +145,29 @@ void translator_loop(const TranslatorOps *ops, DisasContextBase *db,
 
 void translator_loop_temp_check(DisasContextBase *db);
 
+#ifndef CONFIG_USER_ONLY
+/**
+ * translator_xpage_guard:
+ * @db: Disassembly context.
+ * @n: Index of the direct jump (goto_tb) that follows.
+ * @dest: Guest virtual address of the destination.
+ * @mmu_idx: MMU index used for instruction fetches by the TB.
+ * @fail: Label to branch to when the direct jump can not be taken.
+ *
+ * Allow direct jump @n to a TB on another guest page.  In system
+ * emulation, such a jump is normally not chained because the mapping
+ * of the destination page may change at any time.  Instead, emit a check
+ * that the vCPU's TLB maps @dest to the same host page as when the jump
+ * was chained.  A TLB flush or a change of the mapping makes the check
+ * fail, so there is nothing to invalidate when this happens.
+ *
+ * The caller emits tcg_gen_goto_tb(@n) and the matching exit right after
+ * the guard, and an indirect jump to @dest at @fail.
+ */
+void translator_xpage_guard(DisasContextBase *db, int n, target_ulong dest,
+                            int mmu_idx, TCGLabel *fail);
+#endif
+
 /*
  * Translator Load Functions
  *
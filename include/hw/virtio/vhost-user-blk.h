@@ -35,6 +35,7 @@ struct VHostUserBlk {
     uint16_t num_queues;
     uint32_t queue_size;
     uint32_t config_wce;
+    uint32_t in_order;
     struct vhost_dev dev;
     struct vhost_inflight *inflight;
     VhostUserState vhost_user;
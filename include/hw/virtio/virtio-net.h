@@ -18,6 +18,7 @@
 #include "standard-headers/linux/virtio_net.h"
 #include "hw/virtio/virtio.h"
 #include "net/announce.h"
+#include "sysemu/iothread.h"
 #include "qemu/option_int.h"
 #include "qom/object.h"
 
@@ -149,6 +150,18 @@ typedef struct VirtIONetQueue {
         VirtQueueElement *elem;
     } async_tx;
     struct VirtIONet *n;
+    /* Set while a burst is received; the interrupt is sent at its end */
+    bool rx_batching;
+    bool rx_notify_pending;
+    /* IOThread running this queue pair, NULL for the main loop */
+    AioContext *ctx;
+    /* RSS classification, per queue as queue pairs may run in parallel */
+    struct NetRxPkt *rx_pkt;
+    /* Packets steered here by RSS from queues in other IOThreads */
+    QSLIST_HEAD(, VirtIONetSteeredPacket) steer_list;
+    QSIMPLEQ_HEAD(, VirtIONetSteeredPacket) steer_pending;
+    unsigned int steer_len;
+    QEMUBH *steer_bh;
 } VirtIONetQueue;
 
 struct VirtIONet {
@@ -208,7 +221,14 @@ struct VirtIONet {
     DeviceListener primary_listener;
     Notifier migration_state;
     VirtioNetRssData rss_data;
-    struct NetRxPkt *rx_pkt;
+    /* IOThreads for the queue pairs, assigned round-robin */
+    uint32_t num_iothreads;
+    char **iothread_ids;
+    IOThread **iothreads;
+    bool dataplane_started;
+    /* RSS may hand packets to queues in other IOThreads */
+    bool dataplane_steering;
+    bool saved_use_guest_notifier_mask;
 };
 
 void virtio_net_set_netclient_name(VirtIONet *n, const char *name,
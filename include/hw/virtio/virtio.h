@@ -57,6 +57,7 @@ typedef struct VirtQueueElement
     unsigned int ndescs;
     unsigned int out_num;
     unsigned int in_num;
+    bool pooled;
     hwaddr *in_addr;
     hwaddr *out_addr;
     struct iovec *in_sg;
@@ -93,6 +94,8 @@ struct VirtIODevice
     int nvectors;
     VirtQueue *vq;
     MemoryListener listener;
+    struct VirtIORAMMap *ram_map;   /* RCU-protected */
+    GArray *ram_map_next;           /* built during a memory transaction */
     uint16_t device_id;
     bool vm_running;
     bool broken; /* device in invalid state, needs reset */
@@ -197,6 +200,26 @@ void virtqueue_fill(VirtQueue *vq, const VirtQueueElement *elem,
 
 void virtqueue_map(VirtIODevice *vdev, VirtQueueElement *elem);
 void *virtqueue_pop(VirtQueue *vq, size_t sz);
+/**
+ * virtqueue_pop_batch:
+ * @vq: the #VirtQueue
+ * @sz: the size of each element, as for virtqueue_pop()
+ * @elems: array that receives the popped elements
+ * @max: capacity of @elems
+ *
+ * Pop up to @max available elements at once.  Returns the number of
+ * elements stored in @elems.
+ */
+unsigned int virtqueue_pop_batch(VirtQueue *vq, size_t sz,
+                                 void **elems, unsigned int max);
+/**
+ * virtqueue_element_free:
+ * @elem: an element returned by virtqueue_pop() or virtqueue_pop_batch()
+ *
+ * Release @elem, recycling its memory for the next pop from the calling
+ * thread when possible.  Calling g_free() on the element is also valid.
+ */
+void virtqueue_element_free(void *elem);
 unsigned int virtqueue_drop_all(VirtQueue *vq);
 void *qemu_get_virtqueue_element(VirtIODevice *vdev, QEMUFile *f, size_t sz);
 void qemu_put_virtqueue_element(VirtIODevice *vdev, QEMUFile *f,
@@ -311,6 +334,9 @@ EventNotifier *virtio_queue_get_guest_notifier(VirtQueue *vq);
 void virtio_queue_set_guest_notifier_fd_handler(VirtQueue *vq, bool assign,
                                                 bool with_irqfd);
 int virtio_device_start_ioeventfd(VirtIODevice *vdev);
+/* Default start_ioeventfd/stop_ioeventfd, for devices that wrap them */
+int virtio_device_start_ioeventfd_impl(VirtIODevice *vdev);
+void virtio_device_stop_ioeventfd_impl(VirtIODevice *vdev);
 int virtio_device_grab_ioeventfd(VirtIODevice *vdev);
 void virtio_device_release_ioeventfd(VirtIODevice *vdev);
 bool virtio_device_ioeventfd_enabled(VirtIODevice *vdev);
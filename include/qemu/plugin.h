@@ -89,7 +89,27 @@ struct qemu_plugin_dyn_cb {
             enum qemu_plugin_op op;
             uint64_t imm;
         } inline_insn;
+        /* regular callbacks are only called when @cond holds */
+        struct {
+            enum qemu_plugin_cond cond;
+            uint64_t imm;
+        } cond;
     };
+    /*
+     * Per-vCPU operand of inline ops and conditions. When @entry.score
+     * is NULL, inline ops operate on the uint64_t at @userp instead.
+     */
+    qemu_plugin_u64 entry;
+};
+
+/*
+ * A scoreboard holds one element per vCPU. @data is sized for all the
+ * vCPUs that can exist; when it grows, translated code is flushed since
+ * inline ops embed the address of the elements.
+ */
+struct qemu_plugin_scoreboard {
+    GArray *data;
+    QLIST_ENTRY(qemu_plugin_scoreboard) entry;
 };
 
 struct qemu_plugin_insn {
@@ -47,7 +47,16 @@ typedef uint64_t qemu_plugin_id_t;
 
 extern QEMU_PLUGIN_EXPORT int qemu_plugin_version;
 
-#define QEMU_PLUGIN_VERSION 0
+/*
+ * API versions:
+ *
+ * version 1:
+ * - per-vCPU scoreboards and inline operations on them
+ * - QEMU_PLUGIN_INLINE_STORE_U64
+ * - conditional callbacks
+ * - register and memory read access
+ */
+#define QEMU_PLUGIN_VERSION 1
 
 typedef struct {
     /* string describing architecture */
@@ -194,6 +203,79 @@ enum qemu_plugin_mem_rw {
     QEMU_PLUGIN_MEM_RW,
 };
 
+/*
+ * Scoreboards
+ *
+ * A scoreboard is an array of elements of a given size, one per vCPU.
+ * Each vCPU only ever touches its own element, so plugins can count
+ * events with inline operations or callbacks without any locking.
+ * Scoreboards grow automatically when new vCPUs are created.
+ */
+struct qemu_plugin_scoreboard;
+
+/**
+ * typedef qemu_plugin_u64 - uint64_t member of a scoreboard element
+ * @score: the scoreboard
+ * @offset: offset of the uint64_t in the scoreboard element
+ *
+ * Used to operate on a single counter of a scoreboard, both from
+ * inline operations and from the qemu_plugin_u64_* functions.
+ */
+typedef struct {
+    struct qemu_plugin_scoreboard *score;
+    size_t offset;
+} qemu_plugin_u64;
+
+/**
+ * qemu_plugin_scoreboard_new() - allocate a new scoreboard
+ * @element_size: size (in bytes) of each vCPU element
+ *
+ * Elements are zero-initialized. Returns the new scoreboard.
+ */
+struct qemu_plugin_scoreboard *qemu_plugin_scoreboard_new(size_t element_size);
+
+/**
+ * qemu_plugin_scoreboard_free() - free a scoreboard
+ * @score: scoreboard to free
+ *
+ * No inline operation or callback may reference @score anymore, e.g.
+ * call this from the atexit callback or after a TB flush.
+ */
+void qemu_plugin_scoreboard_free(struct qemu_plugin_scoreboard *score);
+
+/**
+ * qemu_plugin_scoreboard_find() - get the element of a given vCPU
+ * @score: scoreboard
+ * @vcpu_index: vCPU index
+ *
+ * The returned pointer is invalidated when the scoreboard grows, so it
+ * must not be kept across callbacks.
+ */
+void *qemu_plugin_scoreboard_find(struct qemu_plugin_scoreboard *score,
+                                  unsigned int vcpu_index);
+
+/* uint64_t counter that is the whole element of @score */
+#define qemu_plugin_scoreboard_u64(score) \
+    ((qemu_plugin_u64) {score, 0})
+
+/* uint64_t @member of @type, the element type of @score */
+#define qemu_plugin_scoreboard_u64_in_struct(score, type, member) \
+    ((qemu_plugin_u64) {score, offsetof(type, member)})
+
+/* add @added to the counter of @vcpu_index */
+void qemu_plugin_u64_add(qemu_plugin_u64 entry, unsigned int vcpu_index,
+                         uint64_t added);
+
+/* return the counter of @vcpu_index */
+uint64_t qemu_plugin_u64_get(qemu_plugin_u64 entry, unsigned int vcpu_index);
+
+/* set the counter of @vcpu_index to @val */
+void qemu_plugin_u64_set(qemu_plugin_u64 entry, unsigned int vcpu_index,
+                         uint64_t val);
+
+/* return the sum of the counters of all vCPUs */
+uint64_t qemu_plugin_u64_sum(qemu_plugin_u64 entry);
+
 /**
  * qemu_plugin_register_vcpu_tb_trans_cb() - register a translate cb
  * @id: plugin ID
@@ -228,6 +310,22 @@ void qemu_plugin_register_vcpu_tb_exec_cb(struct qemu_plugin_tb *tb,
 
 enum qemu_plugin_op {
     QEMU_PLUGIN_INLINE_ADD_U64,
+    QEMU_PLUGIN_INLINE_STORE_U64,
+};
+
+/*
+ * Conditions of conditional callbacks. The comparisons are unsigned
+ * and performed as "counter <cond> immediate".
+ */
+enum qemu_plugin_cond {
+    QEMU_PLUGIN_COND_NEVER,
+    QEMU_PLUGIN_COND_ALWAYS,
+    QEMU_PLUGIN_COND_EQ,
+    QEMU_PLUGIN_COND_NE,
+    QEMU_PLUGIN_COND_LT,
+    QEMU_PLUGIN_COND_LE,
+    QEMU_PLUGIN_COND_GT,
+    QEMU_PLUGIN_COND_GE,
 };
 
 /**
@@ -245,6 +343,45 @@ void qemu_plugin_register_vcpu_tb_exec_inline(struct qemu_plugin_tb *tb,
                                               enum qemu_plugin_op op,
                                               void *ptr, uint64_t imm);
 
+/**
+ * qemu_plugin_register_vcpu_tb_exec_inline_per_vcpu() - per-vCPU inline op
+ * @tb: the opaque qemu_plugin_tb handle for the translation
+ * @op: the type of qemu_plugin_op (e.g. ADD_U64)
+ * @entry: the scoreboard counter for the op
+ * @imm: the op data (e.g. 1)
+ *
+ * Like qemu_plugin_register_vcpu_tb_exec_inline(), but operate on the
+ * counter of the vCPU executing the translated unit.
+ */
+void qemu_plugin_register_vcpu_tb_exec_inline_per_vcpu(
+    struct qemu_plugin_tb *tb,
+    enum qemu_plugin_op op,
+    qemu_plugin_u64 entry,
+    uint64_t imm);
+
+/**
+ * qemu_plugin_register_vcpu_tb_exec_cond_cb() - conditional execution cb
+ * @tb: the opaque qemu_plugin_tb handle for the translation
+ * @cb: callback function
+ * @flags: does the plugin read or write the CPU's registers?
+ * @cond: condition to enable the callback
+ * @entry: the scoreboard counter compared against @imm
+ * @imm: the value to compare with
+ * @userdata: any plugin data to pass to the @cb?
+ *
+ * The @cb function is called every time a translated unit executes and
+ * the counter of the executing vCPU satisfies @cond. The comparison is
+ * done inline, so a callback that rarely fires costs little more than
+ * an inline operation.
+ */
+void qemu_plugin_register_vcpu_tb_exec_cond_cb(struct qemu_plugin_tb *tb,
+                                               qemu_plugin_vcpu_udata_cb_t cb,
+                                               enum qemu_plugin_cb_flags flags,
+                                               enum qemu_plugin_cond cond,
+                                               qemu_plugin_u64 entry,
+                                               uint64_t imm,
+                                               void *userdata);
+
 /**
  * qemu_plugin_register_vcpu_insn_exec_cb() - register insn execution cb
  * @insn: the opaque qemu_plugin_insn handle for an instruction
@@ -274,6 +411,44 @@ void qemu_plugin_register_vcpu_insn_exec_inline(struct qemu_plugin_insn *insn,
                                                 enum qemu_plugin_op op,
                                                 void *ptr, uint64_t imm);
 
+/**
+ * qemu_plugin_register_vcpu_insn_exec_inline_per_vcpu() - per-vCPU inline op
+ * @insn: the opaque qemu_plugin_insn handle for an instruction
+ * @op: the type of qemu_plugin_op (e.g. ADD_U64)
+ * @entry: the scoreboard counter for the op
+ * @imm: the op data (e.g. 1)
+ *
+ * Like qemu_plugin_register_vcpu_insn_exec_inline(), but operate on the
+ * counter of the vCPU executing the instruction.
+ */
+void qemu_plugin_register_vcpu_insn_exec_inline_per_vcpu(
+    struct qemu_plugin_insn *insn,
+    enum qemu_plugin_op op,
+    qemu_plugin_u64 entry,
+    uint64_t imm);
+
+/**
+ * qemu_plugin_register_vcpu_insn_exec_cond_cb() - conditional insn cb
+ * @insn: the opaque qemu_plugin_insn handle for an instruction
+ * @cb: callback function
+ * @flags: does the plugin read or write the CPU's registers?
+ * @cond: condition to enable the callback
+ * @entry: the scoreboard counter compared against @imm
+ * @imm: the value to compare with
+ * @userdata: any plugin data to pass to the @cb?
+ *
+ * The @cb function is called every time the instruction executes and
+ * the counter of the executing vCPU satisfies @cond.
+ */
+void qemu_plugin_register_vcpu_insn_exec_cond_cb(
+    struct qemu_plugin_insn *insn,
+    qemu_plugin_vcpu_udata_cb_t cb,
+    enum qemu_plugin_cb_flags flags,
+    enum qemu_plugin_cond cond,
+    qemu_plugin_u64 entry,
+    uint64_t imm,
+    void *userdata);
+
 /*
  * Helpers to query information about the instructions in a block
  */
@@ -346,6 +521,13 @@ void qemu_plugin_register_vcpu_mem_inline(struct qemu_plugin_insn *insn,
                                           enum qemu_plugin_op op, void *ptr,
                                           uint64_t imm);
 
+void qemu_plugin_register_vcpu_mem_inline_per_vcpu(
+    struct qemu_plugin_insn *insn,
+    enum qemu_plugin_mem_rw rw,
+    enum qemu_plugin_op op,
+    qemu_plugin_u64 entry,
+    uint64_t imm);
+
 
 
 typedef void
@@ -399,6 +581,55 @@ int qemu_plugin_n_vcpus(void);
 /* returns -1 in user-mode */
 int qemu_plugin_n_max_vcpus(void);
 
+/*
+ * Register and memory access
+ *
+ * These functions may only be called from vCPU callbacks. Register
+ * reads also require the callback to be registered with
+ * QEMU_PLUGIN_CB_R_REGS or QEMU_PLUGIN_CB_RW_REGS; otherwise the values
+ * returned may be stale.
+ */
+struct qemu_plugin_register;
+
+/**
+ * qemu_plugin_find_register() - look up a register by name
+ * @vcpu_index: vCPU whose register description to use
+ * @name: register name as found in the target's gdb XML, e.g. "rip"
+ *
+ * Returns an opaque handle that is valid for all vCPUs of the same
+ * type, or NULL if the register does not exist. Since the lookup is
+ * not cheap, do it once (e.g. from the vCPU init callback) and keep
+ * the handle.
+ */
+struct qemu_plugin_register *qemu_plugin_find_register(unsigned int vcpu_index,
+                                                       const char *name);
+
+/**
+ * qemu_plugin_read_register() - read a register of the current vCPU
+ * @reg: handle returned by qemu_plugin_find_register()
+ * @buf: destination buffer
+ * @len: size of @buf
+ *
+ * The register is stored in target byte order. Note that many targets
+ * only update the program counter at the end of translated units, so
+ * use qemu_plugin_insn_vaddr() to know where an instruction lives.
+ *
+ * Returns the size of the register, or -1 if it does not fit in @buf.
+ */
+int qemu_plugin_read_register(struct qemu_plugin_register *reg,
+                              void *buf, size_t len);
+
+/**
+ * qemu_plugin_read_memory_vaddr() - read guest memory of the current vCPU
+ * @addr: guest virtual address
+ * @buf: destination buffer
+ * @len: number of bytes to read
+ *
+ * The access goes through the current vCPU's MMU without causing any
+ * guest-visible fault. Returns true if all of @len bytes were read.
+ */
+bool qemu_plugin_read_memory_vaddr(uint64_t addr, void *buf, size_t len);
+
 /**
  * qemu_plugin_outs() - output string via QEMU's logging system
  * @string: a string
@@ -1264,6 +1264,11 @@ static inline void tcg_gen_discard_ptr(TCGv_ptr a)
     glue(tcg_gen_discard_,PTR)((NAT)a);
 }
 
+static inline void tcg_gen_movi_ptr(TCGv_ptr r, intptr_t a)
+{
+    glue(tcg_gen_movi_,PTR)((NAT)r, a);
+}
+
 static inline void tcg_gen_add_ptr(TCGv_ptr r, TCGv_ptr a, TCGv_ptr b)
 {
     glue(tcg_gen_add_,PTR)((NAT)r, (NAT)a, (NAT)b);
@@ -1274,6 +1279,17 @@ static inline void tcg_gen_addi_ptr(TCGv_ptr r, TCGv_ptr a, intptr_t b)
     glue(tcg_gen_addi_,PTR)((NAT)r, (NAT)a, b);
 }
 
+static inline void tcg_gen_andi_ptr(TCGv_ptr r, TCGv_ptr a, intptr_t b)
+{
+    glue(tcg_gen_andi_,PTR)((NAT)r, (NAT)a, b);
+}
+
+static inline void tcg_gen_brcond_ptr(TCGCond cond, TCGv_ptr a,
+                                      TCGv_ptr b, TCGLabel *label)
+{
+    glue(tcg_gen_brcond_,PTR)(cond, (NAT)a, (NAT)b, label);
+}
+
 static inline void tcg_gen_brcondi_ptr(TCGCond cond, TCGv_ptr a,
                                        intptr_t b, TCGLabel *label)
 {
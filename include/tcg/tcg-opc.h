@@ -281,6 +281,43 @@ DEF(tci_movi_i32, 1, 0, 1, TCG_OPF_NOT_PRESENT)
 #if TCG_TARGET_REG_BITS == 64
 DEF(tci_movi_i64, 1, 0, 1, TCG_OPF_64BIT | TCG_OPF_NOT_PRESENT)
 #endif
+
+/* Forms with the last input operand as an immediate. */
+DEF(tci_addi_i32, 1, 1, 1, TCG_OPF_NOT_PRESENT)
+DEF(tci_andi_i32, 1, 1, 1, TCG_OPF_NOT_PRESENT)
+DEF(tci_ori_i32, 1, 1, 1, TCG_OPF_NOT_PRESENT)
+DEF(tci_xori_i32, 1, 1, 1, TCG_OPF_NOT_PRESENT)
+DEF(tci_shli_i32, 1, 1, 1, TCG_OPF_NOT_PRESENT)
+DEF(tci_shri_i32, 1, 1, 1, TCG_OPF_NOT_PRESENT)
+DEF(tci_sari_i32, 1, 1, 1, TCG_OPF_NOT_PRESENT)
+DEF(tci_setcondi_i32, 1, 1, 2, TCG_OPF_NOT_PRESENT)
+DEF(tci_brcondi_i32, 0, 1, 3, TCG_OPF_NOT_PRESENT)
+#if TCG_TARGET_REG_BITS == 64
+DEF(tci_addi_i64, 1, 1, 1, TCG_OPF_64BIT | TCG_OPF_NOT_PRESENT)
+DEF(tci_andi_i64, 1, 1, 1, TCG_OPF_64BIT | TCG_OPF_NOT_PRESENT)
+DEF(tci_ori_i64, 1, 1, 1, TCG_OPF_64BIT | TCG_OPF_NOT_PRESENT)
+DEF(tci_xori_i64, 1, 1, 1, TCG_OPF_64BIT | TCG_OPF_NOT_PRESENT)
+DEF(tci_shli_i64, 1, 1, 1, TCG_OPF_64BIT | TCG_OPF_NOT_PRESENT)
+DEF(tci_shri_i64, 1, 1, 1, TCG_OPF_64BIT | TCG_OPF_NOT_PRESENT)
+DEF(tci_sari_i64, 1, 1, 1, TCG_OPF_64BIT | TCG_OPF_NOT_PRESENT)
+DEF(tci_setcondi_i64, 1, 1, 2, TCG_OPF_64BIT | TCG_OPF_NOT_PRESENT)
+DEF(tci_brcondi_i64, 0, 1, 3, TCG_OPF_64BIT | TCG_OPF_NOT_PRESENT)
+#endif
+
+/*
+ * Superinstructions, each standing for the sequence of instructions
+ * that its name lists.  They only ever replace the dispatch word of
+ * the first instruction of the sequence.
+ */
+DEF(tci_ld_brcondi_i32, 0, 0, 0, TCG_OPF_NOT_PRESENT)
+DEF(tci_setcond_brcondi_i32, 0, 0, 0, TCG_OPF_NOT_PRESENT)
+DEF(tci_movi_st_i32, 0, 0, 0, TCG_OPF_NOT_PRESENT)
+DEF(tci_ld_addi_st_i32, 0, 0, 0, TCG_OPF_NOT_PRESENT)
+#if TCG_TARGET_REG_BITS == 64
+DEF(tci_movi32_st_i64, 0, 0, 0, TCG_OPF_64BIT | TCG_OPF_NOT_PRESENT)
+DEF(tci_movi_st_i64, 0, 0, 0, TCG_OPF_64BIT | TCG_OPF_NOT_PRESENT)
+DEF(tci_ld_addi_st_i64, 0, 0, 0, TCG_OPF_64BIT | TCG_OPF_NOT_PRESENT)
+#endif
 #endif
 
 #undef TLADDR_ARGS
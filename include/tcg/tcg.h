@@ -667,6 +667,12 @@ struct TCGContext {
     QSIMPLEQ_HEAD(, TCGOp) plugin_ops;
 #endif
 
+    /*
+     * When not NULL, new ops are emitted right before this op instead of
+     * being appended to @ops.  Used to inject code into a finished TB.
+     */
+    TCGOp *emit_before_op;
+
     GHashTable *const_table[TCG_TYPE_COUNT];
     TCGTempSet free_temps[TCG_TYPE_COUNT * 2];
     TCGTemp temps[TCG_MAX_TEMPS]; /* globals first, temps after */
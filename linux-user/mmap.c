@@ -17,24 +17,57 @@
  *  along with this program; if not, see <http://www.gnu.org/licenses/>.
  */
 #include "qemu/osdep.h"
+#include "qemu/queue.h"
 #include "trace.h"
 #include "exec/log.h"
 #include "qemu.h"
 
-static pthread_mutex_t mmap_mutex = PTHREAD_MUTEX_INITIALIZER;
+/*
+ * mmap_lock() takes mmap_rwlock for writing.  The translator,
+ * page_unprotect() and the mapping operations that cannot be split by
+ * address all run under it.  target_mmap(MAP_FIXED), target_munmap()
+ * and target_mprotect() on whole host pages instead lock their range
+ * and take mmap_rwlock for reading, so that threads working on disjoint
+ * ranges issue their host syscalls in parallel.  They only serialize
+ * on mmap_commit_mutex to update the page flags and drop translated
+ * code, which counts as holding mmap_lock.
+ *
+ * Where the host supports it, a waiting writer takes precedence over new
+ * readers so that a stream of mapping operations cannot starve the
+ * translator.
+ */
+#ifdef PTHREAD_RWLOCK_WRITER_NONRECURSIVE_INITIALIZER_NP
+static pthread_rwlock_t mmap_rwlock =
+    PTHREAD_RWLOCK_WRITER_NONRECURSIVE_INITIALIZER_NP;
+#else
+static pthread_rwlock_t mmap_rwlock = PTHREAD_RWLOCK_INITIALIZER;
+#endif
 static __thread int mmap_lock_count;
 
+typedef struct MMapRange {
+    abi_ulong start;
+    abi_ulong last;             /* inclusive */
+    bool ranged;
+    QLIST_ENTRY(MMapRange) next;
+} MMapRange;
+
+static QLIST_HEAD(, MMapRange) mmap_ranges =
+    QLIST_HEAD_INITIALIZER(mmap_ranges);
+static pthread_mutex_t mmap_range_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t mmap_range_cond = PTHREAD_COND_INITIALIZER;
+static pthread_mutex_t mmap_commit_mutex = PTHREAD_MUTEX_INITIALIZER;
+
 void mmap_lock(void)
 {
     if (mmap_lock_count++ == 0) {
-        pthread_mutex_lock(&mmap_mutex);
+        pthread_rwlock_wrlock(&mmap_rwlock);
     }
 }
 
 void mmap_unlock(void)
 {
     if (--mmap_lock_count == 0) {
-        pthread_mutex_unlock(&mmap_mutex);
+        pthread_rwlock_unlock(&mmap_rwlock);
     }
 }
 
@@ -43,20 +76,108 @@ bool have_mmap_lock(void)
     return mmap_lock_count > 0 ? true : false;
 }
 
+/*
+ * Lock [@start, @start + @len) for a mapping operation.  The range lock
+ * is only used if @parallel is set, the range covers whole host pages
+ * (so that no host page is shared with another range) and the thread
+ * does not hold mmap_lock yet; otherwise this is just mmap_lock().
+ */
+static void mmap_lock_range(MMapRange *r, abi_ulong start, abi_ulong len,
+                            bool parallel)
+{
+    MMapRange *o;
+
+    r->start = start;
+    r->last = start + len - 1;
+    r->ranged = parallel && len && r->last >= start && !have_mmap_lock() &&
+                !((start | len) & ~qemu_host_page_mask);
+    if (!r->ranged) {
+        mmap_lock();
+        return;
+    }
+
+    pthread_mutex_lock(&mmap_range_mutex);
+retry:
+    QLIST_FOREACH(o, &mmap_ranges, next) {
+        if (o->start <= r->last && r->start <= o->last) {
+            pthread_cond_wait(&mmap_range_cond, &mmap_range_mutex);
+            goto retry;
+        }
+    }
+    QLIST_INSERT_HEAD(&mmap_ranges, r, next);
+    pthread_mutex_unlock(&mmap_range_mutex);
+
+    pthread_rwlock_rdlock(&mmap_rwlock);
+}
+
+/*
+ * Called after the host syscalls, before updating the page flags and
+ * invalidating translated code.  From here on the thread has mmap_lock.
+ */
+static void mmap_commit_range(MMapRange *r)
+{
+    if (r->ranged) {
+        pthread_mutex_lock(&mmap_commit_mutex);
+        mmap_lock_count = 1;
+    }
+}
+
+static void mmap_unlock_range(MMapRange *r)
+{
+    if (!r->ranged) {
+        mmap_unlock();
+        return;
+    }
+
+    if (mmap_lock_count) {
+        assert(mmap_lock_count == 1);
+        mmap_lock_count = 0;
+        pthread_mutex_unlock(&mmap_commit_mutex);
+    }
+    pthread_rwlock_unlock(&mmap_rwlock);
+
+    pthread_mutex_lock(&mmap_range_mutex);
+    QLIST_REMOVE(r, next);
+    pthread_cond_broadcast(&mmap_range_cond);
+    pthread_mutex_unlock(&mmap_range_mutex);
+}
+
+static void mmap_rwlock_init(void)
+{
+    pthread_rwlockattr_t attr;
+
+    pthread_rwlockattr_init(&attr);
+#ifdef PTHREAD_RWLOCK_WRITER_NONRECURSIVE_INITIALIZER_NP
+    pthread_rwlockattr_setkind_np(&attr,
+                                  PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+#endif
+    pthread_rwlock_init(&mmap_rwlock, &attr);
+    pthread_rwlockattr_destroy(&attr);
+}
+
 /* Grab lock to make sure things are in a consistent state after fork().  */
 void mmap_fork_start(void)
 {
     if (mmap_lock_count)
         abort();
-    pthread_mutex_lock(&mmap_mutex);
+    pthread_rwlock_wrlock(&mmap_rwlock);
+    pthread_mutex_lock(&mmap_range_mutex);
+    page_fork_start();
 }
 
 void mmap_fork_end(int child)
 {
-    if (child)
-        pthread_mutex_init(&mmap_mutex, NULL);
-    else
-        pthread_mutex_unlock(&mmap_mutex);
+    page_fork_end(child);
+    if (child) {
+        /* The ranges belonged to threads that do not exist in the child */
+        QLIST_INIT(&mmap_ranges);
+        pthread_mutex_init(&mmap_range_mutex, NULL);
+        pthread_cond_init(&mmap_range_cond, NULL);
+        mmap_rwlock_init();
+    } else {
+        pthread_mutex_unlock(&mmap_range_mutex);
+        pthread_rwlock_unlock(&mmap_rwlock);
+    }
 }
 
 /*
@@ -107,6 +228,7 @@ int target_mprotect(abi_ulong start, abi_ulong len, int target_prot)
 {
     abi_ulong end, host_start, host_end, addr;
     int prot1, ret, page_flags, host_prot;
+    MMapRange range;
 
     trace_target_mprotect(start, len, target_prot);
 
@@ -126,7 +248,7 @@ int target_mprotect(abi_ulong start, abi_ulong len, int target_prot)
         return 0;
     }
 
-    mmap_lock();
+    mmap_lock_range(&range, start, len, true);
     host_start = start & qemu_host_page_mask;
     host_end = HOST_PAGE_ALIGN(end);
     if (start > host_start) {
@@ -168,11 +290,12 @@ int target_mprotect(abi_ulong start, abi_ulong len, int target_prot)
             goto error;
         }
     }
+    mmap_commit_range(&range);
     page_set_flags(start, start + len, page_flags);
-    mmap_unlock();
+    mmap_unlock_range(&range);
     return 0;
 error:
-    mmap_unlock();
+    mmap_unlock_range(&range);
     return ret;
 }
 
@@ -253,8 +376,8 @@ unsigned long last_brk;
 static abi_ulong mmap_find_vma_reserved(abi_ulong start, abi_ulong size,
                                         abi_ulong align)
 {
-    abi_ulong addr, end_addr, incr = qemu_host_page_size;
-    int prot;
+    abi_ulong addr, end_addr;
+    target_ulong used = 0;
     bool looped = false;
 
     if (size > reserved_va) {
@@ -270,30 +393,27 @@ static abi_ulong mmap_find_vma_reserved(abi_ulong start, abi_ulong size,
         looped = true;
     }
 
-    /* Search downward from END_ADDR, checking to see if a page is in use.  */
-    addr = end_addr;
+    /* Search downward from END_ADDR, restarting below any mapping found.  */
     while (1) {
-        addr -= incr;
-        if (addr > end_addr) {
+        addr = end_addr - size;
+        if (addr && !page_range_used(addr, end_addr - 1, &used)) {
+            /* Success!  All pages between ADDR and END_ADDR are free.  */
+            if (start == mmap_next_start) {
+                mmap_next_start = addr;
+            }
+            return addr;
+        }
+        if (addr == 0 || used < size) {
             if (looped) {
                 /* Failure.  The entire address space has been searched.  */
                 return (abi_ulong)-1;
             }
             /* Re-start at the top of the address space.  */
-            addr = end_addr = ((reserved_va - size) & -align) + size;
+            end_addr = ((reserved_va - size) & -align) + size;
             looped = true;
         } else {
-            prot = page_get_flags(addr);
-            if (prot) {
-                /* Page in use.  Restart below this page.  */
-                addr = end_addr = ((addr - size) & -align) + size;
-            } else if (addr && addr + size == end_addr) {
-                /* Success!  All pages between ADDR and END_ADDR are free.  */
-                if (start == mmap_next_start) {
-                    mmap_next_start = addr;
-                }
-                return addr;
-            }
+            /* Page in use.  Restart below the mapping.  */
+            end_addr = ((used - size) & -align) + size;
         }
     }
 }
@@ -417,33 +537,44 @@ abi_long target_mmap(abi_ulong start, abi_ulong len, int target_prot,
 {
     abi_ulong ret, end, real_start, real_end, retaddr, host_offset, host_len;
     int page_flags, host_prot;
+    MMapRange range;
 
-    mmap_lock();
     trace_target_mmap(start, len, target_prot, flags, fd, offset);
 
     if (!len) {
         errno = EINVAL;
-        goto fail;
+        return -1;
     }
 
     page_flags = validate_prot_to_pageflags(&host_prot, target_prot);
     if (!page_flags) {
         errno = EINVAL;
-        goto fail;
+        return -1;
     }
 
     /* Also check for overflows... */
     len = TARGET_PAGE_ALIGN(len);
     if (!len) {
         errno = ENOMEM;
-        goto fail;
+        return -1;
     }
 
     if (offset & ~TARGET_PAGE_MASK) {
         errno = EINVAL;
-        goto fail;
+        return -1;
     }
 
+    /*
+     * Only a fixed mapping that the host can map directly runs under a
+     * range lock; picking an address or emulating the mapping with
+     * fragments and reads needs the whole address space.
+     */
+    mmap_lock_range(&range, start, len,
+                    (flags & MAP_FIXED) &&
+                    !(offset & ~qemu_host_page_mask) &&
+                    ((flags & MAP_ANONYMOUS) ||
+                     qemu_real_host_page_size >= qemu_host_page_size));
+
     real_start = start & qemu_host_page_mask;
     host_offset = offset & qemu_host_page_mask;
 
@@ -599,6 +730,7 @@ abi_long target_mmap(abi_ulong start, abi_ulong len, int target_prot,
         }
     }
  the_end1:
+    mmap_commit_range(&range);
     page_set_flags(start, start + len, page_flags);
  the_end:
     trace_target_mmap_complete(start);
@@ -606,10 +738,10 @@ abi_long target_mmap(abi_ulong start, abi_ulong len, int target_prot,
         log_page_dump(__func__);
     }
     tb_invalidate_phys_range(start, start + len);
-    mmap_unlock();
+    mmap_unlock_range(&range);
     return start;
 fail:
-    mmap_unlock();
+    mmap_unlock_range(&range);
     return -1;
 }
 
@@ -658,6 +790,7 @@ int target_munmap(abi_ulong start, abi_ulong len)
 {
     abi_ulong end, real_start, real_end, addr;
     int prot, ret;
+    MMapRange range;
 
     trace_target_munmap(start, len);
 
@@ -668,7 +801,7 @@ int target_munmap(abi_ulong start, abi_ulong len)
         return -TARGET_EINVAL;
     }
 
-    mmap_lock();
+    mmap_lock_range(&range, start, len, true);
     end = start + len;
     real_start = start & qemu_host_page_mask;
     real_end = HOST_PAGE_ALIGN(end);
@@ -708,10 +841,11 @@ int target_munmap(abi_ulong start, abi_ulong len)
     }
 
     if (ret == 0) {
+        mmap_commit_range(&range);
         page_set_flags(start, start + len, 0);
         tb_invalidate_phys_range(start, start + len);
     }
-    mmap_unlock();
+    mmap_unlock_range(&range);
     return ret;
 }
 
@@ -3065,6 +3065,54 @@ static void target_to_host_low_high(abi_ulong tlow,
     *hhigh = (off >> HOST_LONG_BITS / 2) >> HOST_LONG_BITS / 2;
 }
 
+/*
+ * When the guest lays out struct iovec like the host and guest addresses
+ * are host addresses, the guest array can be used once it has been copied
+ * and every buffer in it checked, without converting it entry by entry.
+ */
+#if !defined(DEBUG_REMAP) && TARGET_ABI_BITS == HOST_LONG_BITS && \
+    defined(HOST_WORDS_BIGENDIAN) == defined(TARGET_WORDS_BIGENDIAN)
+#define IOVEC_SAME_LAYOUT
+#endif
+
+/* Return false if @target_vec needs the general conversion in lock_iovec */
+static bool lock_iovec_direct(int type, struct iovec *vec,
+                              const struct target_iovec *target_vec,
+                              abi_ulong count, abi_ulong max_len)
+{
+#ifdef IOVEC_SAME_LAYOUT
+    abi_ulong total_len = 0;
+    abi_ulong i;
+
+    QEMU_BUILD_BUG_ON(sizeof(struct target_iovec) != sizeof(struct iovec));
+
+    if (guest_base != 0) {
+        return false;
+    }
+
+    /* Work on a copy, as another guest thread may change the array.  */
+    memcpy(vec, target_vec, count * sizeof(*vec));
+    for (i = 0; i < count; i++) {
+        abi_ulong base = (uintptr_t)vec[i].iov_base;
+        abi_long len = vec[i].iov_len;
+
+        /* Errors, partial transfers and truncation take the slow path.  */
+        if (len < 0 || len > max_len - total_len) {
+            return false;
+        }
+        if (len == 0) {
+            vec[i].iov_base = 0;
+        } else if (!access_ok(type, base, len)) {
+            return false;
+        }
+        total_len += len;
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
 static struct iovec *lock_iovec(int type, abi_ulong target_addr,
                                 abi_ulong count, int copy)
 {
@@ -3102,6 +3150,11 @@ static struct iovec *lock_iovec(int type, abi_ulong target_addr,
     max_len = 0x7fffffff & TARGET_PAGE_MASK;
     total_len = 0;
 
+    if (lock_iovec_direct(type, vec, target_vec, count, max_len)) {
+        unlock_user(target_vec, target_addr, 0);
+        return vec;
+    }
+
     for (i = 0; i < count; i++) {
         abi_ulong base = tswapal(target_vec[i].iov_base);
         abi_long len = tswapal(target_vec[i].iov_len);
@@ -3156,6 +3209,7 @@ static struct iovec *lock_iovec(int type, abi_ulong target_addr,
 static void unlock_iovec(struct iovec *vec, abi_ulong target_addr,
                          abi_ulong count, int copy)
 {
+#ifdef DEBUG_REMAP
     struct target_iovec *target_vec;
     int i;
 
@@ -3172,7 +3226,8 @@ static void unlock_iovec(struct iovec *vec, abi_ulong target_addr,
         }
         unlock_user(target_vec, target_addr, 0);
     }
-
+#endif
+    /* Otherwise the buffers were used in place, there is nothing to undo */
     g_free(vec);
 }
 
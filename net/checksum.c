@@ -19,24 +19,280 @@
 #include "net/checksum.h"
 #include "net/eth.h"
 
-uint32_t net_checksum_add_cont(int len, uint8_t *buf, int seq)
+/*
+ * The one's complement sum does not depend on byte order (RFC 1071, 2.B),
+ * so the buffer is summed as host-endian words, several at a time, into a
+ * wide accumulator.  Only the folded 16-bit result is converted to network
+ * order.  Each implementation returns the unfolded sum of the words found
+ * at even offsets from @buf, with a trailing odd byte padded with zero.
+ */
+
+static uint64_t
+net_checksum_sum_int(const uint8_t *buf, size_t len)
+{
+    uint64_t sum = 0;
+
+    /* Split the 64-bit loads so that carries pile up in the top half.  */
+    for (; len >= 32; buf += 32, len -= 32) {
+        uint64_t a = ldq_he_p(buf);
+        uint64_t b = ldq_he_p(buf + 8);
+        uint64_t c = ldq_he_p(buf + 16);
+        uint64_t d = ldq_he_p(buf + 24);
+
+        sum += (a & 0xffffffff) + (a >> 32) + (b & 0xffffffff) + (b >> 32);
+        sum += (c & 0xffffffff) + (c >> 32) + (d & 0xffffffff) + (d >> 32);
+    }
+    for (; len >= 4; buf += 4, len -= 4) {
+        sum += ldl_he_p(buf);
+    }
+    if (len >= 2) {
+        sum += lduw_he_p(buf);
+        buf += 2;
+        len -= 2;
+    }
+    if (len) {
+        uint8_t tail[2] = { *buf, 0 };
+
+        sum += lduw_he_p(tail);
+    }
+    return sum;
+}
+
+/*
+ * The vectorized functions below widen 16-bit words into 32-bit lanes.
+ * A lane absorbs at most 0x1fffe per block, so the lanes are reduced
+ * into the 64-bit sum every NET_CHECKSUM_VEC_BLOCKS blocks, long before
+ * they could overflow.
+ */
+#define NET_CHECKSUM_VEC_BLOCKS 16384
+
+#if defined(CONFIG_AVX2_OPT) || defined(__SSE2__)
+/* Do not use push_options pragmas unnecessarily, because clang
+ * does not support them.
+ */
+#ifdef CONFIG_AVX2_OPT
+#pragma GCC push_options
+#pragma GCC target("sse2")
+#endif
+#include <emmintrin.h>
+
+static uint64_t
+net_checksum_sum_sse2(const uint8_t *buf, size_t len)
+{
+    __m128i zero = _mm_setzero_si128();
+    uint64_t sum = 0;
+
+    while (len >= 16) {
+        size_t n = MIN(len / 16, NET_CHECKSUM_VEC_BLOCKS);
+        __m128i acc = zero;
+        uint32_t lane[4];
+
+        len -= n * 16;
+        do {
+            __m128i t = _mm_loadu_si128((const __m128i *)buf);
+
+            acc = _mm_add_epi32(acc, _mm_unpacklo_epi16(t, zero));
+            acc = _mm_add_epi32(acc, _mm_unpackhi_epi16(t, zero));
+            buf += 16;
+        } while (--n);
+
+        _mm_storeu_si128((__m128i *)lane, acc);
+        sum += (uint64_t)lane[0] + lane[1] + lane[2] + lane[3];
+    }
+    return sum + net_checksum_sum_int(buf, len);
+}
+#ifdef CONFIG_AVX2_OPT
+#pragma GCC pop_options
+#endif
+
+#ifdef CONFIG_AVX2_OPT
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#include <immintrin.h>
+
+static uint64_t
+net_checksum_sum_avx2(const uint8_t *buf, size_t len)
+{
+    __m256i zero = _mm256_setzero_si256();
+    uint64_t sum = 0;
+
+    while (len >= 32) {
+        size_t n = MIN(len / 32, NET_CHECKSUM_VEC_BLOCKS);
+        __m256i acc = zero;
+        uint32_t lane[8];
+
+        len -= n * 32;
+        do {
+            __m256i t = _mm256_loadu_si256((const __m256i *)buf);
+
+            acc = _mm256_add_epi32(acc, _mm256_unpacklo_epi16(t, zero));
+            acc = _mm256_add_epi32(acc, _mm256_unpackhi_epi16(t, zero));
+            buf += 32;
+        } while (--n);
+
+        _mm256_storeu_si256((__m256i *)lane, acc);
+        sum += (uint64_t)lane[0] + lane[1] + lane[2] + lane[3] +
+               lane[4] + lane[5] + lane[6] + lane[7];
+    }
+    return sum + net_checksum_sum_int(buf, len);
+}
+#pragma GCC pop_options
+#endif /* CONFIG_AVX2_OPT */
+
+#define CACHE_SSE2    1
+#define CACHE_AVX2    2
+
+/* Make sure that these variables are appropriately initialized when
+ * SSE2 is enabled on the compiler command-line, but the compiler is
+ * too old to support CONFIG_AVX2_OPT.
+ */
+#ifdef CONFIG_AVX2_OPT
+# define INIT_CACHE 0
+# define INIT_ACCEL net_checksum_sum_int
+#else
+# define INIT_CACHE CACHE_SSE2
+# define INIT_ACCEL net_checksum_sum_sse2
+#endif
+
+static unsigned cpuid_cache = INIT_CACHE;
+static uint64_t (*net_checksum_accel)(const uint8_t *, size_t) = INIT_ACCEL;
+
+static void init_accel(unsigned cache)
 {
-    uint32_t sum1 = 0, sum2 = 0;
-    int i;
+    uint64_t (*fn)(const uint8_t *, size_t) = net_checksum_sum_int;
 
-    for (i = 0; i < len - 1; i += 2) {
-        sum1 += (uint32_t)buf[i];
-        sum2 += (uint32_t)buf[i + 1];
+    if (cache & CACHE_SSE2) {
+        fn = net_checksum_sum_sse2;
     }
-    if (i < len) {
-        sum1 += (uint32_t)buf[i];
+#ifdef CONFIG_AVX2_OPT
+    if (cache & CACHE_AVX2) {
+        fn = net_checksum_sum_avx2;
     }
+#endif
+    net_checksum_accel = fn;
+}
+
+#ifdef CONFIG_AVX2_OPT
+#include "qemu/cpuid.h"
 
-    if (seq & 1) {
-        return sum1 + (sum2 << 8);
-    } else {
-        return sum2 + (sum1 << 8);
+static void __attribute__((constructor)) init_cpuid_cache(void)
+{
+    int max = __get_cpuid_max(0, NULL);
+    int a, b, c, d;
+    unsigned cache = 0;
+
+    if (max >= 1) {
+        __cpuid(1, a, b, c, d);
+        if (d & bit_SSE2) {
+            cache |= CACHE_SSE2;
+        }
+
+        /* We must check that AVX is not just available, but usable.  */
+        if ((c & bit_OSXSAVE) && (c & bit_AVX) && max >= 7) {
+            int bv;
+            __asm("xgetbv" : "=a"(bv), "=d"(d) : "c"(0));
+            __cpuid_count(7, 0, a, b, c, d);
+            if ((bv & 0x6) == 0x6 && (b & bit_AVX2)) {
+                cache |= CACHE_AVX2;
+            }
+        }
     }
+    cpuid_cache = cache;
+    init_accel(cache);
+}
+#endif /* CONFIG_AVX2_OPT */
+
+bool test_net_checksum_next_accel(void)
+{
+    /* If no bits set, we just tested net_checksum_sum_int, and there
+       are no more acceleration options to test.  */
+    if (cpuid_cache == 0) {
+        return false;
+    }
+    /* Disable the accelerator we used before and select a new one.  */
+    cpuid_cache &= cpuid_cache - 1;
+    init_accel(cpuid_cache);
+    return true;
+}
+
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+
+static uint64_t
+net_checksum_sum_neon(const uint8_t *buf, size_t len)
+{
+    uint64_t sum = 0;
+
+    while (len >= 16) {
+        size_t n = MIN(len / 16, NET_CHECKSUM_VEC_BLOCKS);
+        uint32x4_t acc = vdupq_n_u32(0);
+        uint64x2_t t;
+
+        len -= n * 16;
+        do {
+            acc = vpadalq_u16(acc, vreinterpretq_u16_u8(vld1q_u8(buf)));
+            buf += 16;
+        } while (--n);
+
+        t = vpaddlq_u32(acc);
+        sum += vgetq_lane_u64(t, 0) + vgetq_lane_u64(t, 1);
+    }
+    return sum + net_checksum_sum_int(buf, len);
+}
+
+static bool neon_disabled;
+#define net_checksum_accel \
+    (neon_disabled ? net_checksum_sum_int : net_checksum_sum_neon)
+
+bool test_net_checksum_next_accel(void)
+{
+    if (neon_disabled) {
+        return false;
+    }
+    neon_disabled = true;
+    return true;
+}
+
+#else
+#define net_checksum_accel net_checksum_sum_int
+
+bool test_net_checksum_next_accel(void)
+{
+    return false;
+}
+#endif
+
+static uint64_t net_checksum_sum(const uint8_t *buf, size_t len)
+{
+    /* Headers are short; only bother with vectors for payloads.  */
+    if (likely(len >= 64)) {
+        return net_checksum_accel(buf, len);
+    }
+    return net_checksum_sum_int(buf, len);
+}
+
+/*
+ * Fold a host-endian sum to 16 bits and return it in network byte order.
+ * The end-around carry never turns a non-zero sum into zero.
+ */
+static uint32_t net_checksum_fold(uint64_t sum)
+{
+    while (sum >> 16) {
+        sum = (sum & 0xffff) + (sum >> 16);
+    }
+    return be16_to_cpu(sum);
+}
+
+uint32_t net_checksum_add_cont(int len, uint8_t *buf, int seq)
+{
+    uint32_t sum;
+
+    if (len <= 0) {
+        return 0;
+    }
+
+    sum = net_checksum_fold(net_checksum_sum(buf, len));
+    return (seq & 1) ? bswap16(sum) : sum;
 }
 
 uint16_t net_checksum_finish(uint32_t sum)
@@ -186,25 +442,27 @@ uint32_t
 net_checksum_add_iov(const struct iovec *iov, const unsigned int iov_cnt,
                      uint32_t iov_off, uint32_t size, uint32_t csum_offset)
 {
-    size_t iovec_off, buf_off;
+    /*
+     * Chunks are summed in place; the byte swap that a chunk at an odd
+     * offset needs is applied once to the combined sum for that parity.
+     */
+    uint64_t sum[2] = { 0, 0 };
+    size_t iovec_off;
     unsigned int i;
-    uint32_t res = 0;
 
     iovec_off = 0;
-    buf_off = 0;
     for (i = 0; i < iov_cnt && size; i++) {
         if (iov_off < (iovec_off + iov[i].iov_len)) {
             size_t len = MIN((iovec_off + iov[i].iov_len) - iov_off , size);
             void *chunk_buf = iov[i].iov_base + (iov_off - iovec_off);
 
-            res += net_checksum_add_cont(len, chunk_buf, csum_offset);
+            sum[csum_offset & 1] += net_checksum_sum(chunk_buf, len);
             csum_offset += len;
 
-            buf_off += len;
             iov_off += len;
             size -= len;
         }
         iovec_off += iov[i].iov_len;
     }
-    return res;
+    return net_checksum_fold(sum[0]) + bswap16(net_checksum_fold(sum[1]));
 }
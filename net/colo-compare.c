@@ -55,6 +55,8 @@ static NotifierList colo_compare_notifiers =
 #define REGULAR_PACKET_CHECK_MS 1000
 #define DEFAULT_TIME_OUT_MS 3000
 
+#define MAX_COMPARE_WORKERS 64
+
 /* #define DEBUG_COLO_PACKETS */
 
 static QemuMutex colo_compare_mutex;
@@ -64,6 +66,9 @@ static QemuCond event_complete_cond;
 static int event_unhandled_count;
 static uint32_t max_queue_size;
 
+/* Set in colo-compare worker threads, see colo_compare_worker() */
+static __thread bool colo_compare_in_worker;
+
 /*
  *  + CompareState ++
  *  |               |
@@ -101,8 +106,44 @@ typedef struct SendEntry {
     uint32_t size;
     uint32_t vnet_hdr_len;
     uint8_t *buf;
+    QSLIST_ENTRY(SendEntry) next;
 } SendEntry;
 
+/* A packet handed from the chardev readers to a worker shard */
+typedef struct CompareWork {
+    Packet *pkt;
+    ConnectionKey key;
+    int mode;
+    QSLIST_ENTRY(CompareWork) next;
+} CompareWork;
+
+/*
+ * Connections are sharded by the hash of their key, so that all the
+ * packets of a connection, primary and secondary alike, are compared
+ * by the same thread.  Without workers there is a single shard and it
+ * is run by the compare iothread itself.
+ */
+typedef struct CompareShard {
+    struct CompareState *s;
+
+    /*
+     * Record the connection that through the NIC
+     * Element type: Connection
+     */
+    GQueue conn_list;
+    /* Record the connection without repetition */
+    GHashTable *connection_track_table;
+
+    /* Only used by worker threads */
+    QemuThread thread;
+    QemuSemaphore sem;
+    QSLIST_HEAD(, CompareWork) incoming;
+    bool stopping;
+    bool flush;
+    /* the pending flush completes a COLO event */
+    bool event_pending;
+} CompareShard;
+
 struct CompareState {
     Object parent;
 
@@ -122,14 +163,10 @@ struct CompareState {
     bool vnet_hdr;
     uint64_t compare_timeout;
     uint32_t expired_scan_cycle;
+    uint32_t workers;
 
-    /*
-     * Record the connection that through the NIC
-     * Element type: Connection
-     */
-    GQueue conn_list;
-    /* Record the connection without repetition */
-    GHashTable *connection_track_table;
+    CompareShard *shards;
+    uint32_t nr_shards;
 
     IOThread *iothread;
     GMainContext *worker_context;
@@ -137,6 +174,13 @@ struct CompareState {
 
     QEMUBH *event_bh;
     enum colo_event event;
+    /* shards that still have to flush for the current event */
+    int event_shards;
+
+    /* Output handed back by the workers to the compare iothread */
+    QSLIST_HEAD(, SendEntry) out_pending;
+    QEMUBH *out_bh;
+    bool notify_pending;
 
     QTAILQ_ENTRY(CompareState) next;
 };
@@ -187,7 +231,12 @@ static void notify_remote_frame(CompareState *s)
 static void colo_compare_inconsistency_notify(CompareState *s)
 {
     if (s->notify_dev) {
-        notify_remote_frame(s);
+        if (colo_compare_in_worker) {
+            qatomic_set(&s->notify_pending, true);
+            qemu_bh_schedule(s->out_bh);
+        } else {
+            notify_remote_frame(s);
+        }
     } else {
         notifier_list_notify(&colo_compare_notifiers,
                              migrate_get_current());
@@ -225,11 +274,22 @@ static int colo_insert_packet(GQueue *queue, Packet *pkt, uint32_t *max_ack)
 {
     if (g_queue_get_length(queue) <= max_queue_size) {
         if (pkt->ip->ip_p == IPPROTO_TCP) {
+            Packet *tail;
+
             fill_pkt_tcp_info(pkt, max_ack);
-            g_queue_insert_sorted(queue,
-                                  pkt,
-                                  (GCompareDataFunc)seq_sorter,
-                                  NULL);
+            /*
+             * Segments almost always arrive in order, so only walk
+             * the queue when the new one is behind the tail.
+             */
+            tail = g_queue_peek_tail(queue);
+            if (!tail || seq_sorter(pkt, tail, NULL) >= 0) {
+                g_queue_push_tail(queue, pkt);
+            } else {
+                g_queue_insert_sorted(queue,
+                                      pkt,
+                                      (GCompareDataFunc)seq_sorter,
+                                      NULL);
+            }
         } else {
             g_queue_push_tail(queue, pkt);
         }
@@ -238,16 +298,55 @@ static int colo_insert_packet(GQueue *queue, Packet *pkt, uint32_t *max_ack)
     return 0;
 }
 
+static void colo_compare_connection(void *opaque, void *user_data);
+
+/*
+ * Queue the packet on its connection and compare the connection.
+ * Called from the thread that runs @shard.
+ */
+static void colo_compare_shard_packet(CompareShard *shard, int mode,
+                                      Packet *pkt, ConnectionKey *key)
+{
+    CompareState *s = shard->s;
+    Connection *conn;
+    int ret;
+
+    conn = connection_get(shard->connection_track_table,
+                          key,
+                          &shard->conn_list);
+
+    if (!conn->processing) {
+        g_queue_push_tail(&shard->conn_list, conn);
+        conn->processing = true;
+    }
+
+    if (mode == PRIMARY_IN) {
+        ret = colo_insert_packet(&conn->primary_list, pkt, &conn->pack);
+    } else {
+        ret = colo_insert_packet(&conn->secondary_list, pkt, &conn->sack);
+    }
+
+    if (!ret) {
+        trace_colo_compare_drop_packet(colo_mode[mode],
+            "queue size too big, drop packet");
+        packet_destroy(pkt, NULL);
+        pkt = NULL;
+    }
+
+    /* compare packet in the specified connection */
+    colo_compare_connection(conn, s);
+}
+
 /*
  * Return 0 on success, if return -1 means the pkt
  * is unsupported(arp and ipv6) and will be sent later
  */
-static int packet_enqueue(CompareState *s, int mode, Connection **con)
+static int packet_enqueue(CompareState *s, int mode)
 {
     ConnectionKey key;
     Packet *pkt = NULL;
-    Connection *conn;
-    int ret;
+    CompareShard *shard;
+    CompareWork *work;
 
     if (mode == PRIMARY_IN) {
         pkt = packet_new(s->pri_rs.buf,
@@ -266,29 +365,18 @@ static int packet_enqueue(CompareState *s, int mode, Connection **con)
     }
     fill_connection_key(pkt, &key);
 
-    conn = connection_get(s->connection_track_table,
-                          &key,
-                          &s->conn_list);
-
-    if (!conn->processing) {
-        g_queue_push_tail(&s->conn_list, conn);
-        conn->processing = true;
-    }
-
-    if (mode == PRIMARY_IN) {
-        ret = colo_insert_packet(&conn->primary_list, pkt, &conn->pack);
-    } else {
-        ret = colo_insert_packet(&conn->secondary_list, pkt, &conn->sack);
-    }
-
-    if (!ret) {
-        trace_colo_compare_drop_packet(colo_mode[mode],
-            "queue size too big, drop packet");
-        packet_destroy(pkt, NULL);
-        pkt = NULL;
+    shard = &s->shards[connection_key_hash(&key) % s->nr_shards];
+    if (!s->workers) {
+        colo_compare_shard_packet(shard, mode, pkt, &key);
+        return 0;
     }
 
-    *con = conn;
+    work = g_slice_new(CompareWork);
+    work->pkt = pkt;
+    work->key = key;
+    work->mode = mode;
+    QSLIST_INSERT_HEAD_ATOMIC(&shard->incoming, work, next);
+    qemu_sem_post(&shard->sem);
 
     return 0;
 }
@@ -298,15 +386,42 @@ static inline bool after(uint32_t seq1, uint32_t seq2)
         return (int32_t)(seq1 - seq2) > 0;
 }
 
+/*
+ * Send a primary packet to outdev, taking ownership of its data.
+ * The send coroutine belongs to the compare iothread, so workers
+ * hand the packet back to it through out_pending.
+ */
+static int colo_send_primary_pkt(CompareState *s, Packet *pkt)
+{
+    SendEntry *entry;
+
+    if (!colo_compare_in_worker) {
+        return compare_chr_send(s,
+                                pkt->data,
+                                pkt->size,
+                                pkt->vnet_hdr_len,
+                                false,
+                                true);
+    }
+
+    if (!pkt->size) {
+        return 0;
+    }
+
+    entry = g_slice_new(SendEntry);
+    entry->size = pkt->size;
+    entry->vnet_hdr_len = pkt->vnet_hdr_len;
+    entry->buf = pkt->data;
+    QSLIST_INSERT_HEAD_ATOMIC(&s->out_pending, entry, next);
+    qemu_bh_schedule(s->out_bh);
+
+    return 0;
+}
+
 static void colo_release_primary_pkt(CompareState *s, Packet *pkt)
 {
     int ret;
-    ret = compare_chr_send(s,
-                           pkt->data,
-                           pkt->size,
-                           pkt->vnet_hdr_len,
-                           false,
-                           true);
+    ret = colo_send_primary_pkt(s, pkt);
     if (ret < 0) {
         error_report("colo send primary packet failed");
     }
@@ -663,15 +778,13 @@ out:
  * if we have some then we have to checkpoint to wake
  * the secondary up.
  */
-static void colo_old_packet_check(void *opaque)
+static void colo_old_packet_check(CompareShard *shard)
 {
-    CompareState *s = opaque;
-
     /*
      * If we find one old packet, stop finding job and notify
      * COLO frame do checkpoint.
      */
-    g_queue_find_custom(&s->conn_list, s,
+    g_queue_find_custom(&shard->conn_list, shard->s,
                         (GCompareFunc)colo_old_packet_check_one_conn);
 }
 
@@ -800,6 +913,24 @@ out:
     aio_wait_kick();
 }
 
+static int compare_chr_send_entry(SendCo *sendco, SendEntry *entry)
+{
+    g_queue_push_head(&sendco->send_list, entry);
+
+    if (sendco->done) {
+        sendco->co = qemu_coroutine_create(_compare_chr_send, sendco);
+        sendco->done = false;
+        qemu_coroutine_enter(sendco->co);
+        if (sendco->done) {
+            /* report early errors */
+            return sendco->ret;
+        }
+    }
+
+    /* assume success */
+    return 0;
+}
+
 static int compare_chr_send(CompareState *s,
                             uint8_t *buf,
                             uint32_t size,
@@ -829,20 +960,39 @@ static int compare_chr_send(CompareState *s,
         entry->buf = g_malloc(size);
         memcpy(entry->buf, buf, size);
     }
-    g_queue_push_head(&sendco->send_list, entry);
 
-    if (sendco->done) {
-        sendco->co = qemu_coroutine_create(_compare_chr_send, sendco);
-        sendco->done = false;
-        qemu_coroutine_enter(sendco->co);
-        if (sendco->done) {
-            /* report early errors */
-            return sendco->ret;
-        }
+    return compare_chr_send_entry(sendco, entry);
+}
+
+/*
+ * Called from the compare iothread to send out what the
+ * workers have released since the last run.
+ */
+static void colo_compare_out_bh(void *opaque)
+{
+    CompareState *s = opaque;
+    QSLIST_HEAD(, SendEntry) straight, reversed;
+
+    if (qatomic_xchg(&s->notify_pending, false)) {
+        notify_remote_frame(s);
     }
 
-    /* assume success */
-    return 0;
+    QSLIST_MOVE_ATOMIC(&reversed, &s->out_pending);
+    QSLIST_INIT(&straight);
+
+    while (!QSLIST_EMPTY(&reversed)) {
+        SendEntry *entry = QSLIST_FIRST(&reversed);
+        QSLIST_REMOVE_HEAD(&reversed, next);
+        QSLIST_INSERT_HEAD(&straight, entry, next);
+    }
+
+    while (!QSLIST_EMPTY(&straight)) {
+        SendEntry *entry = QSLIST_FIRST(&straight);
+        QSLIST_REMOVE_HEAD(&straight, next);
+        if (compare_chr_send_entry(&s->out_sendco, entry) < 0) {
+            error_report("colo send primary packet failed");
+        }
+    }
 }
 
 static int compare_chr_can_read(void *opaque)
@@ -906,7 +1056,7 @@ static void check_old_packet_regular(void *opaque)
     CompareState *s = opaque;
 
     /* if have old packet we will notify checkpoint */
-    colo_old_packet_check(s);
+    colo_old_packet_check(&s->shards[0]);
     timer_mod(s->packet_check_timer, qemu_clock_get_ms(QEMU_CLOCK_HOST) +
               s->expired_scan_cycle);
 }
@@ -958,13 +1108,49 @@ static void colo_compare_timer_del(CompareState *s)
 
 static void colo_flush_packets(void *opaque, void *user_data);
 
+static void colo_compare_event_done(void)
+{
+    qemu_mutex_lock(&event_mtx);
+    assert(event_unhandled_count > 0);
+    event_unhandled_count--;
+    qemu_cond_broadcast(&event_complete_cond);
+    qemu_mutex_unlock(&event_mtx);
+}
+
+/*
+ * Ask every worker to flush its connections.  If @event is true,
+ * the last worker to do so completes the pending COLO event.
+ */
+static void colo_compare_flush_shards(CompareState *s, bool event)
+{
+    int i;
+
+    if (event) {
+        qatomic_set(&s->event_shards, s->nr_shards);
+    }
+    for (i = 0; i < s->nr_shards; i++) {
+        CompareShard *shard = &s->shards[i];
+
+        if (event) {
+            qatomic_set(&shard->event_pending, true);
+        }
+        smp_wmb();
+        qatomic_set(&shard->flush, true);
+        qemu_sem_post(&shard->sem);
+    }
+}
+
 static void colo_compare_handle_event(void *opaque)
 {
     CompareState *s = opaque;
 
     switch (s->event) {
     case COLO_EVENT_CHECKPOINT:
-        g_queue_foreach(&s->conn_list, colo_flush_packets, s);
+        if (s->workers) {
+            colo_compare_flush_shards(s, true);
+            return;
+        }
+        g_queue_foreach(&s->shards[0].conn_list, colo_flush_packets, s);
         break;
     case COLO_EVENT_FAILOVER:
         break;
@@ -972,11 +1158,101 @@ static void colo_compare_handle_event(void *opaque)
         break;
     }
 
-    qemu_mutex_lock(&event_mtx);
-    assert(event_unhandled_count > 0);
-    event_unhandled_count--;
-    qemu_cond_broadcast(&event_complete_cond);
-    qemu_mutex_unlock(&event_mtx);
+    colo_compare_event_done();
+}
+
+/* Called from a worker thread to process what the readers handed over */
+static void colo_compare_shard_run(CompareShard *shard)
+{
+    CompareState *s = shard->s;
+    QSLIST_HEAD(, CompareWork) straight, reversed;
+
+    QSLIST_MOVE_ATOMIC(&reversed, &shard->incoming);
+    QSLIST_INIT(&straight);
+
+    while (!QSLIST_EMPTY(&reversed)) {
+        CompareWork *work = QSLIST_FIRST(&reversed);
+        QSLIST_REMOVE_HEAD(&reversed, next);
+        QSLIST_INSERT_HEAD(&straight, work, next);
+    }
+
+    while (!QSLIST_EMPTY(&straight)) {
+        CompareWork *work = QSLIST_FIRST(&straight);
+        QSLIST_REMOVE_HEAD(&straight, next);
+        colo_compare_shard_packet(shard, work->mode, work->pkt, &work->key);
+        g_slice_free(CompareWork, work);
+    }
+
+    if (qatomic_xchg(&shard->flush, false)) {
+        bool event;
+
+        event = qatomic_xchg(&shard->event_pending, false);
+        /* colo-compare do checkpoint, flush pri packet and remove sec packet */
+        g_queue_foreach(&shard->conn_list, colo_flush_packets, s);
+        if (event && qatomic_fetch_dec(&s->event_shards) == 1) {
+            colo_compare_event_done();
+        }
+    }
+}
+
+static void *colo_compare_worker(void *opaque)
+{
+    CompareShard *shard = opaque;
+    CompareState *s = shard->s;
+    int64_t next_check = qemu_clock_get_ms(QEMU_CLOCK_HOST) +
+                         s->expired_scan_cycle;
+
+    colo_compare_in_worker = true;
+
+    for (;;) {
+        int64_t now = qemu_clock_get_ms(QEMU_CLOCK_HOST);
+
+        if (now >= next_check) {
+            /* if have old packet we will notify checkpoint */
+            colo_old_packet_check(shard);
+            next_check = now + s->expired_scan_cycle;
+        }
+
+        qemu_sem_timedwait(&shard->sem, next_check - now);
+        colo_compare_shard_run(shard);
+
+        if (qatomic_read(&shard->stopping)) {
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+static void colo_compare_workers_start(CompareState *s)
+{
+    int i;
+
+    for (i = 0; i < s->workers; i++) {
+        CompareShard *shard = &s->shards[i];
+
+        qemu_sem_init(&shard->sem, 0);
+        qemu_thread_create(&shard->thread, "colo-compare", colo_compare_worker,
+                           shard, QEMU_THREAD_JOINABLE);
+    }
+}
+
+static void colo_compare_workers_stop(CompareState *s)
+{
+    int i;
+
+    if (!s->shards) {
+        return;
+    }
+
+    for (i = 0; i < s->workers; i++) {
+        CompareShard *shard = &s->shards[i];
+
+        qatomic_set(&shard->stopping, true);
+        qemu_sem_post(&shard->sem);
+        qemu_thread_join(&shard->thread);
+        qemu_sem_destroy(&shard->sem);
+    }
 }
 
 static void colo_compare_iothread(CompareState *s)
@@ -985,6 +1261,9 @@ static void colo_compare_iothread(CompareState *s)
     object_ref(OBJECT(s->iothread));
     s->worker_context = iothread_get_g_main_context(s->iothread);
 
+    s->out_bh = aio_bh_new(ctx, colo_compare_out_bh, s);
+    colo_compare_workers_start(s);
+
     qemu_chr_fe_set_handlers(&s->chr_pri_in, compare_chr_can_read,
                              compare_pri_chr_in, NULL, NULL,
                              s, s->worker_context, true);
@@ -997,7 +1276,9 @@ static void colo_compare_iothread(CompareState *s)
                                  s, s->worker_context, true);
     }
 
-    colo_compare_timer_init(s);
+    if (!s->workers) {
+        colo_compare_timer_init(s);
+    }
     s->event_bh = aio_bh_new(ctx, colo_compare_handle_event, s);
 }
 
@@ -1133,6 +1414,34 @@ static void compare_set_expired_scan_cycle(Object *obj, Visitor *v,
     s->expired_scan_cycle = value;
 }
 
+static void compare_get_workers(Object *obj, Visitor *v,
+                                const char *name, void *opaque,
+                                Error **errp)
+{
+    CompareState *s = COLO_COMPARE(obj);
+    uint32_t value = s->workers;
+
+    visit_type_uint32(v, name, &value, errp);
+}
+
+static void compare_set_workers(Object *obj, Visitor *v,
+                                const char *name, void *opaque,
+                                Error **errp)
+{
+    CompareState *s = COLO_COMPARE(obj);
+    uint32_t value;
+
+    if (!visit_type_uint32(v, name, &value, errp)) {
+        return;
+    }
+    if (value > MAX_COMPARE_WORKERS) {
+        error_setg(errp, "Property '%s.%s' must not exceed %d",
+                   object_get_typename(obj), name, MAX_COMPARE_WORKERS);
+        return;
+    }
+    s->workers = value;
+}
+
 static void get_max_queue_size(Object *obj, Visitor *v,
                                const char *name, void *opaque,
                                Error **errp)
@@ -1167,9 +1476,8 @@ out:
 static void compare_pri_rs_finalize(SocketReadState *pri_rs)
 {
     CompareState *s = container_of(pri_rs, CompareState, pri_rs);
-    Connection *conn = NULL;
 
-    if (packet_enqueue(s, PRIMARY_IN, &conn)) {
+    if (packet_enqueue(s, PRIMARY_IN)) {
         trace_colo_compare_main("primary: unsupported packet in");
         compare_chr_send(s,
                          pri_rs->buf,
@@ -1177,22 +1485,15 @@ static void compare_pri_rs_finalize(SocketReadState *pri_rs)
                          pri_rs->vnet_hdr_len,
                          false,
                          false);
-    } else {
-        /* compare packet in the specified connection */
-        colo_compare_connection(conn, s);
     }
 }
 
 static void compare_sec_rs_finalize(SocketReadState *sec_rs)
 {
     CompareState *s = container_of(sec_rs, CompareState, sec_rs);
-    Connection *conn = NULL;
 
-    if (packet_enqueue(s, SECONDARY_IN, &conn)) {
+    if (packet_enqueue(s, SECONDARY_IN)) {
         trace_colo_compare_main("secondary: unsupported packet in");
-    } else {
-        /* compare packet in the specified connection */
-        colo_compare_connection(conn, s);
     }
 }
 
@@ -1214,7 +1515,11 @@ static void compare_notify_rs_finalize(SocketReadState *notify_rs)
                                   notify_rs->buf,
                                   notify_rs->packet_len)) {
         /* colo-compare do checkpoint, flush pri packet and remove sec packet */
-        g_queue_foreach(&s->conn_list, colo_flush_packets, s);
+        if (s->workers) {
+            colo_compare_flush_shards(s, false);
+        } else {
+            g_queue_foreach(&s->shards[0].conn_list, colo_flush_packets, s);
+        }
     } else {
         error_report("COLO compare got unsupported instruction");
     }
@@ -1258,6 +1563,7 @@ static void colo_compare_complete(UserCreatable *uc, Error **errp)
 {
     CompareState *s = COLO_COMPARE(uc);
     Chardev *chr;
+    int i;
 
     if (!s->pri_indev || !s->sec_indev || !s->outdev || !s->iothread) {
         error_setg(errp, "colo compare needs 'primary_in' ,"
@@ -1329,12 +1635,19 @@ static void colo_compare_complete(UserCreatable *uc, Error **errp)
         g_queue_init(&s->notify_sendco.send_list);
     }
 
-    g_queue_init(&s->conn_list);
+    s->nr_shards = MAX(s->workers, 1);
+    s->shards = g_new0(CompareShard, s->nr_shards);
+    for (i = 0; i < s->nr_shards; i++) {
+        CompareShard *shard = &s->shards[i];
 
-    s->connection_track_table = g_hash_table_new_full(connection_key_hash,
-                                                      connection_key_equal,
-                                                      g_free,
-                                                      connection_destroy);
+        shard->s = s;
+        g_queue_init(&shard->conn_list);
+        shard->connection_track_table =
+            g_hash_table_new_full(connection_key_hash,
+                                  connection_key_equal,
+                                  g_free,
+                                  connection_destroy);
+    }
 
     colo_compare_iothread(s);
 
@@ -1358,12 +1671,7 @@ static void colo_flush_packets(void *opaque, void *user_data)
 
     while (!g_queue_is_empty(&conn->primary_list)) {
         pkt = g_queue_pop_head(&conn->primary_list);
-        compare_chr_send(s,
-                         pkt->data,
-                         pkt->size,
-                         pkt->vnet_hdr_len,
-                         false,
-                         true);
+        colo_send_primary_pkt(s, pkt);
         packet_destroy_partial(pkt, NULL);
     }
     while (!g_queue_is_empty(&conn->secondary_list)) {
@@ -1409,6 +1717,10 @@ static void colo_compare_init(Object *obj)
                         get_max_queue_size,
                         set_max_queue_size, NULL, NULL);
 
+    object_property_add(obj, "workers", "uint32",
+                        compare_get_workers,
+                        compare_set_workers, NULL, NULL);
+
     s->vnet_hdr = false;
     object_property_add_bool(obj, "vnet_hdr_support", compare_get_vnet_hdr,
                              compare_set_vnet_hdr);
@@ -1418,6 +1730,7 @@ static void colo_compare_finalize(Object *obj)
 {
     CompareState *s = COLO_COMPARE(obj);
     CompareState *tmp = NULL;
+    int i;
 
     qemu_mutex_lock(&colo_compare_mutex);
     QTAILQ_FOREACH(tmp, &net_compares, next) {
@@ -1440,9 +1753,11 @@ static void colo_compare_finalize(Object *obj)
         qemu_chr_fe_deinit(&s->chr_notify_dev, false);
     }
 
+    colo_compare_workers_stop(s);
     colo_compare_timer_del(s);
 
     qemu_bh_delete(s->event_bh);
+    qemu_bh_delete(s->out_bh);
 
     AioContext *ctx = iothread_get_aio_context(s->iothread);
     aio_context_acquire(ctx);
@@ -1452,20 +1767,25 @@ static void colo_compare_finalize(Object *obj)
     }
     aio_context_release(ctx);
 
+    /* Send what the workers released but the iothread did not get to */
+    colo_compare_out_bh(s);
+
     /* Release all unhandled packets after compare thead exited */
-    g_queue_foreach(&s->conn_list, colo_flush_packets, s);
+    for (i = 0; i < s->nr_shards; i++) {
+        g_queue_foreach(&s->shards[i].conn_list, colo_flush_packets, s);
+    }
     AIO_WAIT_WHILE(NULL, !s->out_sendco.done);
 
-    g_queue_clear(&s->conn_list);
+    for (i = 0; i < s->nr_shards; i++) {
+        g_queue_clear(&s->shards[i].conn_list);
+        g_hash_table_destroy(s->shards[i].connection_track_table);
+    }
+    g_free(s->shards);
     g_queue_clear(&s->out_sendco.send_list);
     if (s->notify_dev) {
         g_queue_clear(&s->notify_sendco.send_list);
     }
 
-    if (s->connection_track_table) {
-        g_hash_table_destroy(s->connection_track_table);
-    }
-
     object_unref(OBJECT(s->iothread));
 
     g_free(s->pri_indev);
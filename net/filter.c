@@ -88,6 +88,7 @@ ssize_t qemu_netfilter_pass_to_next(NetClientState *sender,
         direction = nf->direction;
     }
 
+    qemu_net_client_lock(nf->netdev);
     next = netfilter_next(nf, direction);
     while (next) {
         /*
@@ -99,6 +100,7 @@ ssize_t qemu_netfilter_pass_to_next(NetClientState *sender,
         ret = qemu_netfilter_receive(next, direction, sender, flags, iov,
                                      iovcnt, NULL);
         if (ret) {
+            qemu_net_client_unlock(nf->netdev);
             return ret;
         }
         next = netfilter_next(next, direction);
@@ -113,6 +115,7 @@ ssize_t qemu_netfilter_pass_to_next(NetClientState *sender,
         qemu_net_queue_send_iov(sender->peer->incoming_queue,
                                 sender, flags, iov, iovcnt, NULL);
     }
+    qemu_net_client_unlock(nf->netdev);
 
 out:
     /* no receiver, or sender been deleted */
@@ -290,6 +293,8 @@ static void netfilter_complete(UserCreatable *uc, Error **errp)
         }
     }
 
+    /* The filter list is walked by the netdev's AioContext too */
+    qemu_net_client_lock(nf->netdev);
     if (position) {
         if (nf->insert_before_flag) {
             QTAILQ_INSERT_BEFORE(position, nf, next);
@@ -301,6 +306,7 @@ static void netfilter_complete(UserCreatable *uc, Error **errp)
     } else if (!strcmp(nf->position, "tail")) {
         QTAILQ_INSERT_TAIL(&nf->netdev->filters, nf, next);
     }
+    qemu_net_client_unlock(nf->netdev);
 }
 
 static void netfilter_finalize(Object *obj)
@@ -312,9 +318,12 @@ static void netfilter_finalize(Object *obj)
         nfc->cleanup(nf);
     }
 
-    if (nf->netdev && !QTAILQ_EMPTY(&nf->netdev->filters) &&
-        QTAILQ_IN_USE(nf, next)) {
-        QTAILQ_REMOVE(&nf->netdev->filters, nf, next);
+    if (nf->netdev) {
+        qemu_net_client_lock(nf->netdev);
+        if (!QTAILQ_EMPTY(&nf->netdev->filters) && QTAILQ_IN_USE(nf, next)) {
+            QTAILQ_REMOVE(&nf->netdev->filters, nf, next);
+        }
+        qemu_net_client_unlock(nf->netdev);
     }
     g_free(nf->netdev_id);
     g_free(nf->position);
@@ -46,6 +46,7 @@
 #include "qemu/iov.h"
 #include "qemu/qemu-print.h"
 #include "qemu/main-loop.h"
+#include "block/aio.h"
 #include "qemu/option.h"
 #include "qapi/error.h"
 #include "qapi/opts-visitor.h"
@@ -337,6 +338,9 @@ static void qemu_cleanup_net_client(NetClientState *nc)
 {
     QTAILQ_REMOVE(&net_clients, nc, next);
 
+    /* Stop I/O in the IOThread before tearing the client down */
+    qemu_net_client_set_aio_context(nc, NULL);
+
     if (nc->info->cleanup) {
         nc->info->cleanup(nc);
     }
@@ -455,6 +459,15 @@ bool qemu_has_ufo(NetClientState *nc)
     return nc->info->has_ufo(nc);
 }
 
+bool qemu_has_uso(NetClientState *nc)
+{
+    if (!nc || !nc->info->has_uso) {
+        return false;
+    }
+
+    return nc->info->has_uso(nc);
+}
+
 bool qemu_has_vnet_hdr(NetClientState *nc)
 {
     if (!nc || !nc->info->has_vnet_hdr) {
@@ -483,13 +496,13 @@ void qemu_using_vnet_hdr(NetClientState *nc, bool enable)
 }
 
 void qemu_set_offload(NetClientState *nc, int csum, int tso4, int tso6,
-                          int ecn, int ufo)
+                          int ecn, int ufo, int uso4, int uso6)
 {
     if (!nc || !nc->info->set_offload) {
         return;
     }
 
-    nc->info->set_offload(nc, csum, tso4, tso6, ecn, ufo);
+    nc->info->set_offload(nc, csum, tso4, tso6, ecn, ufo, uso4, uso6);
 }
 
 void qemu_set_vnet_hdr_len(NetClientState *nc, int len)
@@ -606,8 +619,55 @@ void qemu_purge_queued_packets(NetClientState *nc)
     qemu_net_queue_purge(nc->peer->incoming_queue, nc);
 }
 
+/*
+ * Move the client's I/O handlers to @ctx, or back to the main loop if @ctx
+ * is NULL.  The peer must be moved to the same context, as packets are
+ * delivered synchronously between the two.  Returns false if the backend
+ * cannot run outside the main loop.
+ *
+ * Context: QEMU global mutex held, with the data path quiesced.
+ */
+bool qemu_net_client_set_aio_context(NetClientState *nc, AioContext *ctx)
+{
+    if (ctx == qemu_get_aio_context()) {
+        ctx = NULL;
+    }
+    if (nc->ctx == ctx) {
+        return true;
+    }
+
+    if (nc->info->set_aio_context) {
+        nc->info->set_aio_context(nc, ctx);
+    } else if (nc->info->type != NET_CLIENT_DRIVER_NIC) {
+        return false;
+    }
+    nc->ctx = ctx;
+    return true;
+}
+
+/*
+ * Packets are passed between a client and its peer, their queues and
+ * their filters without further locking.  In the main loop the BQL
+ * serializes that; for clients running in an IOThread, the AioContext
+ * lock does.  Recursive, so data path callbacks can nest freely.
+ */
+void qemu_net_client_lock(NetClientState *nc)
+{
+    if (nc->ctx) {
+        aio_context_acquire(nc->ctx);
+    }
+}
+
+void qemu_net_client_unlock(NetClientState *nc)
+{
+    if (nc->ctx) {
+        aio_context_release(nc->ctx);
+    }
+}
+
 void qemu_flush_or_purge_queued_packets(NetClientState *nc, bool purge)
 {
+    qemu_net_client_lock(nc);
     nc->receive_disabled = 0;
 
     if (nc->peer && nc->peer->info->type == NET_CLIENT_DRIVER_HUBPORT) {
@@ -624,6 +684,7 @@ void qemu_flush_or_purge_queued_packets(NetClientState *nc, bool purge)
         /* Unable to empty the queue, purge remaining packets */
         qemu_net_queue_purge(nc->incoming_queue, nc->peer);
     }
+    qemu_net_client_unlock(nc);
 }
 
 void qemu_flush_queued_packets(NetClientState *nc)
@@ -648,22 +709,27 @@ static ssize_t qemu_send_packet_async_with_flags(NetClientState *sender,
         return size;
     }
 
+    qemu_net_client_lock(sender);
+
     /* Let filters handle the packet first */
     ret = filter_receive(sender, NET_FILTER_DIRECTION_TX,
                          sender, flags, buf, size, sent_cb);
     if (ret) {
-        return ret;
+        goto out;
     }
 
     ret = filter_receive(sender->peer, NET_FILTER_DIRECTION_RX,
                          sender, flags, buf, size, sent_cb);
     if (ret) {
-        return ret;
+        goto out;
     }
 
     queue = sender->peer->incoming_queue;
 
-    return qemu_net_queue_send(queue, sender, flags, buf, size, sent_cb);
+    ret = qemu_net_queue_send(queue, sender, flags, buf, size, sent_cb);
+out:
+    qemu_net_client_unlock(sender);
+    return ret;
 }
 
 ssize_t qemu_send_packet_async(NetClientState *sender,
@@ -674,6 +740,55 @@ ssize_t qemu_send_packet_async(NetClientState *sender,
                                              buf, size, sent_cb);
 }
 
+/*
+ * Send a burst of packets, one per element of @pkts.  When nothing has to
+ * look at the packets one at a time (filters, a backlog in the peer's
+ * queue), the whole burst goes to the peer's receive_batch callback;
+ * anything it does not take is sent with qemu_send_packet_async().
+ *
+ * Returns 0 if any packet had to be queued: @sent_cb will be called once
+ * the peer drains its queue, and the sender should hold off until then.
+ * Otherwise returns the error of the last packet the peer failed to
+ * receive, or @count if there was none.
+ */
+int qemu_send_packets_async(NetClientState *sender, const struct iovec *pkts,
+                            int count, NetPacketSent *sent_cb)
+{
+    NetClientState *peer = sender->peer;
+    bool queued = false;
+    ssize_t ret, err = 0;
+    int i = 0;
+
+    if (sender->link_down || !peer) {
+        return count;
+    }
+
+    qemu_net_client_lock(sender);
+
+    if (peer->info->receive_batch && !peer->link_down &&
+        QTAILQ_EMPTY(&sender->filters) && QTAILQ_EMPTY(&peer->filters) &&
+        !qemu_net_queue_busy(peer->incoming_queue) &&
+        qemu_can_send_packet(sender)) {
+        i = peer->info->receive_batch(peer, pkts, count);
+    }
+
+    for (; i < count; i++) {
+        ret = qemu_send_packet_async(sender, pkts[i].iov_base, pkts[i].iov_len,
+                                     sent_cb);
+        if (ret == 0) {
+            queued = true;
+        } else if (ret < 0) {
+            err = ret;
+        }
+    }
+
+    qemu_net_client_unlock(sender);
+    if (queued) {
+        return 0;
+    }
+    return err < 0 ? err : count;
+}
+
 ssize_t qemu_send_packet(NetClientState *nc, const uint8_t *buf, int size)
 {
     return qemu_send_packet_async(nc, buf, size, NULL);
@@ -763,24 +878,29 @@ ssize_t qemu_sendv_packet_async(NetClientState *sender,
         return size;
     }
 
+    qemu_net_client_lock(sender);
+
     /* Let filters handle the packet first */
     ret = filter_receive_iov(sender, NET_FILTER_DIRECTION_TX, sender,
                              QEMU_NET_PACKET_FLAG_NONE, iov, iovcnt, sent_cb);
     if (ret) {
-        return ret;
+        goto out;
     }
 
     ret = filter_receive_iov(sender->peer, NET_FILTER_DIRECTION_RX, sender,
                              QEMU_NET_PACKET_FLAG_NONE, iov, iovcnt, sent_cb);
     if (ret) {
-        return ret;
+        goto out;
     }
 
     queue = sender->peer->incoming_queue;
 
-    return qemu_net_queue_send_iov(queue, sender,
-                                   QEMU_NET_PACKET_FLAG_NONE,
-                                   iov, iovcnt, sent_cb);
+    ret = qemu_net_queue_send_iov(queue, sender,
+                                  QEMU_NET_PACKET_FLAG_NONE,
+                                  iov, iovcnt, sent_cb);
+out:
+    qemu_net_client_unlock(sender);
+    return ret;
 }
 
 ssize_t
@@ -964,6 +1084,9 @@ static int (* const net_client_init_fun[NET_CLIENT_DRIVER__MAX])(
 #ifdef CONFIG_NETMAP
         [NET_CLIENT_DRIVER_NETMAP]    = net_init_netmap,
 #endif
+#ifdef CONFIG_AF_XDP
+        [NET_CLIENT_DRIVER_AF_XDP]    = net_init_af_xdp,
+#endif
 #ifdef CONFIG_NET_BRIDGE
         [NET_CLIENT_DRIVER_BRIDGE]    = net_init_bridge,
 #endif
@@ -1057,6 +1180,9 @@ void show_netdevs(void)
 #ifdef CONFIG_NETMAP
         "netmap",
 #endif
+#ifdef CONFIG_AF_XDP
+        "af-xdp",
+#endif
 #ifdef CONFIG_POSIX
         "vhost-user",
 #endif
@@ -23,6 +23,8 @@
 
 #include "qemu/osdep.h"
 #include "net/queue.h"
+#include "qemu/atomic.h"
+#include "qemu/iov.h"
 #include "qemu/queue.h"
 #include "net/net.h"
 
@@ -40,15 +42,62 @@
  * unbounded queueing.
  */
 
+/*
+ * Queued payloads live in reference-counted buffers.  While a queued
+ * packet is being delivered its buffer is published in
+ * net_queue_inflight, and a queue further down the delivery chain (a
+ * buffer filter, or the receiver's incoming queue) that has to keep the
+ * very same bytes takes a reference instead of copying them.
+ *
+ * A buffer is never written while it is shared: a filter that rewrites a
+ * packet does so while forwarding it, when only the stage delivering it
+ * holds a reference.
+ */
+typedef struct NetPacketBuf {
+    unsigned refcnt;
+    size_t size;
+    uint8_t data[];
+} NetPacketBuf;
+
 struct NetPacket {
     QTAILQ_ENTRY(NetPacket) entry;
     NetClientState *sender;
     unsigned flags;
-    int size;
     NetPacketSent *sent_cb;
-    uint8_t data[];
+    NetPacketBuf *buf;
 };
 
+static __thread NetPacketBuf *net_queue_inflight;
+
+static NetPacketBuf *net_packet_buf_get(const struct iovec *iov, int iovcnt)
+{
+    NetPacketBuf *buf = net_queue_inflight;
+
+    if (buf && iovcnt == 1 &&
+        iov[0].iov_base == buf->data && iov[0].iov_len == buf->size) {
+        qatomic_inc(&buf->refcnt);
+        return buf;
+    }
+
+    buf = g_malloc(sizeof(NetPacketBuf) + iov_size(iov, iovcnt));
+    buf->refcnt = 1;
+    buf->size = iov_to_buf(iov, iovcnt, 0, buf->data, iov_size(iov, iovcnt));
+    return buf;
+}
+
+static void net_packet_buf_put(NetPacketBuf *buf)
+{
+    if (qatomic_fetch_dec(&buf->refcnt) == 1) {
+        g_free(buf);
+    }
+}
+
+static void net_packet_free(NetPacket *packet)
+{
+    net_packet_buf_put(packet->buf);
+    g_free(packet);
+}
+
 struct NetQueue {
     void *opaque;
     uint32_t nq_maxlen;
@@ -84,35 +133,12 @@ void qemu_del_net_queue(NetQueue *queue)
 
     QTAILQ_FOREACH_SAFE(packet, &queue->packets, entry, next) {
         QTAILQ_REMOVE(&queue->packets, packet, entry);
-        g_free(packet);
+        net_packet_free(packet);
     }
 
     g_free(queue);
 }
 
-static void qemu_net_queue_append(NetQueue *queue,
-                                  NetClientState *sender,
-                                  unsigned flags,
-                                  const uint8_t *buf,
-                                  size_t size,
-                                  NetPacketSent *sent_cb)
-{
-    NetPacket *packet;
-
-    if (queue->nq_count >= queue->nq_maxlen && !sent_cb) {
-        return; /* drop if queue full and no callback */
-    }
-    packet = g_malloc(sizeof(NetPacket) + size);
-    packet->sender = sender;
-    packet->flags = flags;
-    packet->size = size;
-    packet->sent_cb = sent_cb;
-    memcpy(packet->data, buf, size);
-
-    queue->nq_count++;
-    QTAILQ_INSERT_TAIL(&queue->packets, packet, entry);
-}
-
 void qemu_net_queue_append_iov(NetQueue *queue,
                                NetClientState *sender,
                                unsigned flags,
@@ -121,33 +147,36 @@ void qemu_net_queue_append_iov(NetQueue *queue,
                                NetPacketSent *sent_cb)
 {
     NetPacket *packet;
-    size_t max_len = 0;
-    int i;
 
     if (queue->nq_count >= queue->nq_maxlen && !sent_cb) {
         return; /* drop if queue full and no callback */
     }
-    for (i = 0; i < iovcnt; i++) {
-        max_len += iov[i].iov_len;
-    }
 
-    packet = g_malloc(sizeof(NetPacket) + max_len);
+    packet = g_new(NetPacket, 1);
     packet->sender = sender;
-    packet->sent_cb = sent_cb;
     packet->flags = flags;
-    packet->size = 0;
-
-    for (i = 0; i < iovcnt; i++) {
-        size_t len = iov[i].iov_len;
-
-        memcpy(packet->data + packet->size, iov[i].iov_base, len);
-        packet->size += len;
-    }
+    packet->sent_cb = sent_cb;
+    packet->buf = net_packet_buf_get(iov, iovcnt);
 
     queue->nq_count++;
     QTAILQ_INSERT_TAIL(&queue->packets, packet, entry);
 }
 
+static void qemu_net_queue_append(NetQueue *queue,
+                                  NetClientState *sender,
+                                  unsigned flags,
+                                  const uint8_t *buf,
+                                  size_t size,
+                                  NetPacketSent *sent_cb)
+{
+    struct iovec iov = {
+        .iov_base = (void *)buf,
+        .iov_len = size
+    };
+
+    qemu_net_queue_append_iov(queue, sender, flags, &iov, 1, sent_cb);
+}
+
 static ssize_t qemu_net_queue_deliver(NetQueue *queue,
                                       NetClientState *sender,
                                       unsigned flags,
@@ -182,6 +211,20 @@ static ssize_t qemu_net_queue_deliver_iov(NetQueue *queue,
     return ret;
 }
 
+static ssize_t qemu_net_queue_deliver_packet(NetQueue *queue,
+                                             NetPacket *packet)
+{
+    NetPacketBuf *inflight = net_queue_inflight;
+    ssize_t ret;
+
+    net_queue_inflight = packet->buf;
+    ret = qemu_net_queue_deliver(queue, packet->sender, packet->flags,
+                                 packet->buf->data, packet->buf->size);
+    net_queue_inflight = inflight;
+
+    return ret;
+}
+
 ssize_t qemu_net_queue_send(NetQueue *queue,
                             NetClientState *sender,
                             unsigned flags,
@@ -243,11 +286,17 @@ void qemu_net_queue_purge(NetQueue *queue, NetClientState *from)
             if (packet->sent_cb) {
                 packet->sent_cb(packet->sender, 0);
             }
-            g_free(packet);
+            net_packet_free(packet);
         }
     }
 }
 
+/* True while packets wait in @queue or are being redelivered from it */
+bool qemu_net_queue_busy(NetQueue *queue)
+{
+    return queue->delivering || !QTAILQ_EMPTY(&queue->packets);
+}
+
 bool qemu_net_queue_flush(NetQueue *queue)
 {
     if (queue->delivering)
@@ -261,11 +310,7 @@ bool qemu_net_queue_flush(NetQueue *queue)
         QTAILQ_REMOVE(&queue->packets, packet, entry);
         queue->nq_count--;
 
-        ret = qemu_net_queue_deliver(queue,
-                                     packet->sender,
-                                     packet->flags,
-                                     packet->data,
-                                     packet->size);
+        ret = qemu_net_queue_deliver_packet(queue, packet);
         if (ret == 0) {
             queue->nq_count++;
             QTAILQ_INSERT_HEAD(&queue->packets, packet, entry);
@@ -276,7 +321,7 @@ bool qemu_net_queue_flush(NetQueue *queue)
             packet->sent_cb(packet->sender, ret);
         }
 
-        g_free(packet);
+        net_packet_free(packet);
     }
     return true;
 }
@@ -34,6 +34,11 @@
 #include "qemu/iov.h"
 #include "qemu/main-loop.h"
 
+/* Packets handed to the peer at once by the receive paths */
+#define NET_SOCKET_BATCH_MAX 32
+/* Size of a recvmmsg() buffer, enough for the largest UDP datagram */
+#define NET_SOCKET_DGRAM_BUFSIZE 65536
+
 typedef struct NetSocketState {
     NetClientState nc;
     int listen_fd;
@@ -44,6 +49,9 @@ typedef struct NetSocketState {
     IOHandler *send_fn;           /* differs between SOCK_STREAM/SOCK_DGRAM */
     bool read_poll;               /* waiting to receive data? */
     bool write_poll;              /* waiting to transmit data? */
+#ifdef CONFIG_LINUX
+    uint8_t *dgram_bufs;          /* recvmmsg() buffers, allocated lazily */
+#endif
 } NetSocketState;
 
 static void net_socket_accept(void *opaque);
@@ -155,6 +163,49 @@ static void net_socket_rs_finalize(SocketReadState *rs)
     }
 }
 
+/*
+ * Pass the complete frames at the start of @buf to the peer in bursts,
+ * straight from the receive buffer.  Returns the number of bytes used;
+ * whatever is left is a partial frame for the reassembly state machine.
+ */
+static int net_socket_send_frames(NetSocketState *s, const uint8_t *buf,
+                                  int size)
+{
+    struct iovec pkts[NET_SOCKET_BATCH_MAX];
+    int offset = 0;
+    int count;
+
+    /* Only at a frame boundary */
+    if (s->rs.state != 0 || s->rs.index != 0) {
+        return 0;
+    }
+
+    do {
+        for (count = 0; count < NET_SOCKET_BATCH_MAX; count++) {
+            uint32_t len;
+
+            if (size - offset < 4) {
+                break;
+            }
+            len = ldl_be_p(buf + offset);
+            if (len == 0 || len > sizeof(s->rs.buf) ||
+                len > size - offset - 4) {
+                break;
+            }
+            pkts[count].iov_base = (void *)(buf + offset + 4);
+            pkts[count].iov_len = len;
+            offset += 4 + len;
+        }
+
+        if (count && qemu_send_packets_async(&s->nc, pkts, count,
+                                             net_socket_send_completed) == 0) {
+            net_socket_read_poll(s, false);
+        }
+    } while (count == NET_SOCKET_BATCH_MAX);
+
+    return offset;
+}
+
 static void net_socket_send(void *opaque)
 {
     NetSocketState *s = opaque;
@@ -162,6 +213,7 @@ static void net_socket_send(void *opaque)
     int ret;
     uint8_t buf1[NET_BUFSIZE];
     const uint8_t *buf;
+    int offset;
 
     size = qemu_recv(s->fd, buf1, sizeof(buf1), 0);
     if (size < 0) {
@@ -186,13 +238,83 @@ static void net_socket_send(void *opaque)
     }
     buf = buf1;
 
-    ret = net_fill_rstate(&s->rs, buf, size);
+    offset = net_socket_send_frames(s, buf, size);
+    if (offset == size) {
+        return;
+    }
+
+    ret = net_fill_rstate(&s->rs, buf + offset, size - offset);
 
     if (ret == -1) {
         goto eoc;
     }
 }
 
+#ifdef CONFIG_LINUX
+/*
+ * Receive up to NET_SOCKET_BATCH_MAX datagrams per recvmmsg() and pass
+ * them to the peer in one burst.  As in tap_send(), at most 50 packets
+ * are handled per callback so that a busy link cannot stall the guest.
+ */
+static void net_socket_send_dgram(void *opaque)
+{
+    NetSocketState *s = opaque;
+    struct mmsghdr msgs[NET_SOCKET_BATCH_MAX];
+    struct iovec iov[NET_SOCKET_BATCH_MAX];
+    struct iovec pkts[NET_SOCKET_BATCH_MAX];
+    int packets = 0;
+
+    if (!s->dgram_bufs) {
+        s->dgram_bufs = g_malloc(NET_SOCKET_BATCH_MAX *
+                                 NET_SOCKET_DGRAM_BUFSIZE);
+    }
+
+    while (packets < 50) {
+        int want = MIN(NET_SOCKET_BATCH_MAX, 50 - packets);
+        bool queued = false;
+        int count, i;
+
+        for (i = 0; i < want; i++) {
+            iov[i].iov_base = s->dgram_bufs + i * NET_SOCKET_DGRAM_BUFSIZE;
+            iov[i].iov_len = NET_SOCKET_DGRAM_BUFSIZE;
+            memset(&msgs[i], 0, sizeof(msgs[i]));
+            msgs[i].msg_hdr.msg_iov = &iov[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        do {
+            count = recvmmsg(s->fd, msgs, want, MSG_DONTWAIT, NULL);
+        } while (count < 0 && errno == EINTR);
+        if (count <= 0) {
+            return;
+        }
+
+        for (i = 0; i < count && msgs[i].msg_len; i++) {
+            pkts[i].iov_base = iov[i].iov_base;
+            pkts[i].iov_len = msgs[i].msg_len;
+        }
+        if (i && qemu_send_packets_async(&s->nc, pkts, i,
+                                         net_socket_send_completed) == 0) {
+            queued = true;
+        }
+
+        if (i < count) {
+            /* end of connection */
+            net_socket_read_poll(s, false);
+            net_socket_write_poll(s, false);
+            return;
+        }
+        if (queued) {
+            net_socket_read_poll(s, false);
+            return;
+        }
+        if (count < want) {
+            return;
+        }
+        packets += count;
+    }
+}
+#else
 static void net_socket_send_dgram(void *opaque)
 {
     NetSocketState *s = opaque;
@@ -212,6 +334,7 @@ static void net_socket_send_dgram(void *opaque)
         net_socket_read_poll(s, false);
     }
 }
+#endif
 
 static int net_socket_mcast_create(struct sockaddr_in *mcastaddr,
                                    struct in_addr *localaddr,
@@ -320,6 +443,10 @@ static void net_socket_cleanup(NetClientState *nc)
         closesocket(s->listen_fd);
         s->listen_fd = -1;
     }
+#ifdef CONFIG_LINUX
+    g_free(s->dgram_bufs);
+    s->dgram_bufs = NULL;
+#endif
 }
 
 static NetClientInfo net_dgram_socket_info = {
@@ -467,11 +594,17 @@ static NetSocketState *net_socket_fd_init(NetClientState *peer,
     case SOCK_DGRAM:
         return net_socket_fd_init_dgram(peer, model, name, fd, is_connected,
                                         mc, errp);
+#ifdef SOCK_SEQPACKET
+    case SOCK_SEQPACKET:
+        /* Message boundaries are kept, so no framing is needed */
+        return net_socket_fd_init_dgram(peer, model, name, fd, is_connected,
+                                        NULL, errp);
+#endif
     case SOCK_STREAM:
         return net_socket_fd_init_stream(peer, model, name, fd, is_connected);
     default:
-        error_setg(errp, "socket type=%d for fd=%d must be either"
-                   " SOCK_DGRAM or SOCK_STREAM", so_type, fd);
+        error_setg(errp, "socket type=%d for fd=%d must be"
+                   " SOCK_DGRAM, SOCK_SEQPACKET or SOCK_STREAM", so_type, fd);
         closesocket(fd);
     }
     return NULL;
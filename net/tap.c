@@ -42,21 +42,35 @@
 #include "qemu/error-report.h"
 #include "qemu/main-loop.h"
 #include "qemu/sockets.h"
+#include "block/aio.h"
+#include "block/aio-wait.h"
 
 #include "net/tap.h"
 
 #include "net/vhost_net.h"
 
+/*
+ * tap_send() reads packets back to back into one buffer and hands them to
+ * the peer as a burst.  Small packets pack densely; a new read is only
+ * started while a maximum-sized packet still fits.  Each packet starts at
+ * a multiple of TAP_BATCH_ALIGN, because the NIC models read the headers
+ * through structure pointers.
+ */
+#define TAP_BATCH_MAX       32
+#define TAP_BATCH_ALIGN     sizeof(uint64_t)
+#define TAP_BATCH_BUFSIZE   (2 * NET_BUFSIZE + TAP_BATCH_MAX * TAP_BATCH_ALIGN)
+
 typedef struct TAPState {
     NetClientState nc;
     int fd;
     char down_script[1024];
     char down_script_arg[128];
-    uint8_t buf[NET_BUFSIZE];
+    uint8_t buf[TAP_BATCH_BUFSIZE] QEMU_ALIGNED(TAP_BATCH_ALIGN);
     bool read_poll;
     bool write_poll;
     bool using_vnet_hdr;
     bool has_ufo;
+    bool has_uso;
     bool enabled;
     VHostNetState *vhost_net;
     unsigned host_vnet_hdr_len;
@@ -69,12 +83,17 @@ static void launch_script(const char *setup_script, const char *ifname,
 static void tap_send(void *opaque);
 static void tap_writable(void *opaque);
 
+static void tap_set_fd_handler(TAPState *s, AioContext *ctx)
+{
+    aio_set_fd_handler(ctx ? ctx : iohandler_get_aio_context(), s->fd, false,
+                       s->read_poll && s->enabled ? tap_send : NULL,
+                       s->write_poll && s->enabled ? tap_writable : NULL,
+                       NULL, s);
+}
+
 static void tap_update_fd_handler(TAPState *s)
 {
-    qemu_set_fd_handler(s->fd,
-                        s->read_poll && s->enabled ? tap_send : NULL,
-                        s->write_poll && s->enabled ? tap_writable : NULL,
-                        s);
+    tap_set_fd_handler(s, s->nc.ctx);
 }
 
 static void tap_read_poll(TAPState *s, bool enable)
@@ -184,41 +203,63 @@ static void tap_send_completed(NetClientState *nc, ssize_t len)
 static void tap_send(void *opaque)
 {
     TAPState *s = opaque;
-    int size;
+    struct iovec pkts[TAP_BATCH_MAX];
     int packets = 0;
+    bool drained = false;
+    int ret;
 
-    while (true) {
-        uint8_t *buf = s->buf;
+    qemu_net_client_lock(&s->nc);
+    while (!drained) {
+        size_t offset = 0;
+        int count = 0;
 
-        size = tap_read_packet(s->fd, s->buf, sizeof(s->buf));
-        if (size <= 0) {
-            break;
+        /*
+         * When the host keeps receiving more packets while tap_send() is
+         * running we can hog the QEMU global mutex.  Limit the number of
+         * packets that are processed per tap_send() callback to prevent
+         * stalling the guest.
+         */
+        while (count < MIN(TAP_BATCH_MAX, 50 - packets) &&
+               offset + NET_BUFSIZE <= sizeof(s->buf)) {
+            uint8_t *buf = s->buf + offset;
+            int size;
+
+            size = tap_read_packet(s->fd, buf, NET_BUFSIZE);
+            if (size <= 0) {
+                drained = true;
+                break;
+            }
+            offset = QEMU_ALIGN_UP(offset + size, TAP_BATCH_ALIGN);
+
+            if (s->host_vnet_hdr_len && !s->using_vnet_hdr) {
+                buf  += s->host_vnet_hdr_len;
+                size -= s->host_vnet_hdr_len;
+            }
+
+            pkts[count].iov_base = buf;
+            pkts[count].iov_len = size;
+            count++;
         }
 
-        if (s->host_vnet_hdr_len && !s->using_vnet_hdr) {
-            buf  += s->host_vnet_hdr_len;
-            size -= s->host_vnet_hdr_len;
+        if (!count) {
+            break;
         }
 
-        size = qemu_send_packet_async(&s->nc, buf, size, tap_send_completed);
-        if (size == 0) {
+        ret = qemu_send_packets_async(&s->nc, pkts, count,
+                                      tap_send_completed);
+        if (ret == 0) {
             tap_read_poll(s, false);
             break;
-        } else if (size < 0) {
+        } else if (ret < 0) {
             break;
         }
 
-        /*
-         * When the host keeps receiving more packets while tap_send() is
-         * running we can hog the QEMU global mutex.  Limit the number of
-         * packets that are processed per tap_send() callback to prevent
-         * stalling the guest.
-         */
-        packets++;
+        packets += count;
         if (packets >= 50) {
             break;
         }
     }
+    qemu_net_client_unlock(&s->nc);
 }
 
 static bool tap_has_ufo(NetClientState *nc)
@@ -230,6 +271,15 @@ static bool tap_has_ufo(NetClientState *nc)
     return s->has_ufo;
 }
 
+static bool tap_has_uso(NetClientState *nc)
+{
+    TAPState *s = DO_UPCAST(TAPState, nc, nc);
+
+    assert(nc->info->type == NET_CLIENT_DRIVER_TAP);
+
+    return s->has_uso;
+}
+
 static bool tap_has_vnet_hdr(NetClientState *nc)
 {
     TAPState *s = DO_UPCAST(TAPState, nc, nc);
@@ -286,14 +336,14 @@ static int tap_set_vnet_be(NetClientState *nc, bool is_be)
 }
 
 static void tap_set_offload(NetClientState *nc, int csum, int tso4,
-                     int tso6, int ecn, int ufo)
+                     int tso6, int ecn, int ufo, int uso4, int uso6)
 {
     TAPState *s = DO_UPCAST(TAPState, nc, nc);
     if (s->fd < 0) {
         return;
     }
 
-    tap_fd_set_offload(s->fd, csum, tso4, tso6, ecn, ufo);
+    tap_fd_set_offload(s->fd, csum, tso4, tso6, ecn, ufo, uso4, uso6);
 }
 
 static void tap_exit_notify(Notifier *notifier, void *data)
@@ -330,6 +380,40 @@ static void tap_cleanup(NetClientState *nc)
     s->fd = -1;
 }
 
+/* Context: BH in the IOThread the fd handlers are moved away from */
+static void tap_detach_aio_context_bh(void *opaque)
+{
+    TAPState *s = opaque;
+
+    aio_set_fd_handler(s->nc.ctx, s->fd, false, NULL, NULL, NULL, NULL);
+}
+
+static void tap_set_aio_context(NetClientState *nc, AioContext *ctx)
+{
+    TAPState *s = DO_UPCAST(TAPState, nc, nc);
+
+    if (s->fd < 0) {
+        return;
+    }
+
+    /*
+     * Unregister from the IOThread itself, so that tap_send() cannot be
+     * running there anymore once we return.
+     */
+    if (nc->ctx) {
+        aio_context_acquire(nc->ctx);
+        aio_wait_bh_oneshot(nc->ctx, tap_detach_aio_context_bh, s);
+        aio_context_release(nc->ctx);
+    } else {
+        aio_set_fd_handler(iohandler_get_aio_context(), s->fd, false,
+                           NULL, NULL, NULL, NULL);
+    }
+
+    /* tap_send() takes the new lock as soon as the handler is registered */
+    nc->ctx = ctx;
+    tap_set_fd_handler(s, ctx);
+}
+
 static void tap_poll(NetClientState *nc, bool enable)
 {
     TAPState *s = DO_UPCAST(TAPState, nc, nc);
@@ -355,6 +439,7 @@ static NetClientInfo net_tap_info = {
     .poll = tap_poll,
     .cleanup = tap_cleanup,
     .has_ufo = tap_has_ufo,
+    .has_uso = tap_has_uso,
     .has_vnet_hdr = tap_has_vnet_hdr,
     .has_vnet_hdr_len = tap_has_vnet_hdr_len,
     .using_vnet_hdr = tap_using_vnet_hdr,
@@ -362,6 +447,7 @@ static NetClientInfo net_tap_info = {
     .set_vnet_hdr_len = tap_set_vnet_hdr_len,
     .set_vnet_le = tap_set_vnet_le,
     .set_vnet_be = tap_set_vnet_be,
+    .set_aio_context = tap_set_aio_context,
 };
 
 static TAPState *net_tap_fd_init(NetClientState *peer,
@@ -381,8 +467,9 @@ static TAPState *net_tap_fd_init(NetClientState *peer,
     s->host_vnet_hdr_len = vnet_hdr ? sizeof(struct virtio_net_hdr) : 0;
     s->using_vnet_hdr = false;
     s->has_ufo = tap_probe_has_ufo(s->fd);
+    s->has_uso = tap_probe_has_uso(s->fd);
     s->enabled = true;
-    tap_set_offload(&s->nc, 0, 0, 0, 0, 0);
+    tap_set_offload(&s->nc, 0, 0, 0, 0, 0, 0, 0);
     /*
      * Make sure host header length is set correctly in tap:
      * it might have been modified by another instance of qemu.
@@ -41,6 +41,7 @@
 #include "tcg/tcg.h"
 #include "exec/exec-all.h"
 #include "disas/disas.h"
+#include "exec/gdbstub.h"
 #include "plugin.h"
 #ifndef CONFIG_USER_ONLY
 #include "qemu/plugin-memory.h"
@@ -95,6 +96,28 @@ void qemu_plugin_register_vcpu_tb_exec_inline(struct qemu_plugin_tb *tb,
     plugin_register_inline_op(&tb->cbs[PLUGIN_CB_INLINE], 0, op, ptr, imm);
 }
 
+void qemu_plugin_register_vcpu_tb_exec_inline_per_vcpu(
+    struct qemu_plugin_tb *tb,
+    enum qemu_plugin_op op,
+    qemu_plugin_u64 entry,
+    uint64_t imm)
+{
+    plugin_register_inline_op_on_entry(&tb->cbs[PLUGIN_CB_INLINE], 0, op,
+                                       entry, imm);
+}
+
+void qemu_plugin_register_vcpu_tb_exec_cond_cb(struct qemu_plugin_tb *tb,
+                                               qemu_plugin_vcpu_udata_cb_t cb,
+                                               enum qemu_plugin_cb_flags flags,
+                                               enum qemu_plugin_cond cond,
+                                               qemu_plugin_u64 entry,
+                                               uint64_t imm,
+                                               void *udata)
+{
+    plugin_register_dyn_cond_cb__udata(&tb->cbs[PLUGIN_CB_REGULAR],
+                                       cb, flags, cond, entry, imm, udata);
+}
+
 void qemu_plugin_register_vcpu_insn_exec_cb(struct qemu_plugin_insn *insn,
                                             qemu_plugin_vcpu_udata_cb_t cb,
                                             enum qemu_plugin_cb_flags flags,
@@ -112,6 +135,30 @@ void qemu_plugin_register_vcpu_insn_exec_inline(struct qemu_plugin_insn *insn,
                               0, op, ptr, imm);
 }
 
+void qemu_plugin_register_vcpu_insn_exec_inline_per_vcpu(
+    struct qemu_plugin_insn *insn,
+    enum qemu_plugin_op op,
+    qemu_plugin_u64 entry,
+    uint64_t imm)
+{
+    plugin_register_inline_op_on_entry(
+        &insn->cbs[PLUGIN_CB_INSN][PLUGIN_CB_INLINE], 0, op, entry, imm);
+}
+
+void qemu_plugin_register_vcpu_insn_exec_cond_cb(
+    struct qemu_plugin_insn *insn,
+    qemu_plugin_vcpu_udata_cb_t cb,
+    enum qemu_plugin_cb_flags flags,
+    enum qemu_plugin_cond cond,
+    qemu_plugin_u64 entry,
+    uint64_t imm,
+    void *udata)
+{
+    plugin_register_dyn_cond_cb__udata(
+        &insn->cbs[PLUGIN_CB_INSN][PLUGIN_CB_REGULAR],
+        cb, flags, cond, entry, imm, udata);
+}
+
 
 
 void qemu_plugin_register_vcpu_mem_cb(struct qemu_plugin_insn *insn,
@@ -133,6 +180,17 @@ void qemu_plugin_register_vcpu_mem_inline(struct qemu_plugin_insn *insn,
         rw, op, ptr, imm);
 }
 
+void qemu_plugin_register_vcpu_mem_inline_per_vcpu(
+    struct qemu_plugin_insn *insn,
+    enum qemu_plugin_mem_rw rw,
+    enum qemu_plugin_op op,
+    qemu_plugin_u64 entry,
+    uint64_t imm)
+{
+    plugin_register_inline_op_on_entry(
+        &insn->cbs[PLUGIN_CB_MEM][PLUGIN_CB_INLINE], rw, op, entry, imm);
+}
+
 void qemu_plugin_register_vcpu_tb_trans_cb(qemu_plugin_id_t id,
                                            qemu_plugin_vcpu_tb_trans_cb_t cb)
 {
@@ -333,6 +391,110 @@ int qemu_plugin_n_max_vcpus(void)
 #endif
 }
 
+/*
+ * Scoreboards
+ *
+ * Plugins only ever touch the elements from vCPU callbacks or while
+ * the vCPUs are stopped, and the elements only move with all vCPUs
+ * stopped, so there is no locking here.
+ */
+
+struct qemu_plugin_scoreboard *qemu_plugin_scoreboard_new(size_t element_size)
+{
+    return plugin_scoreboard_new(element_size);
+}
+
+void qemu_plugin_scoreboard_free(struct qemu_plugin_scoreboard *score)
+{
+    plugin_scoreboard_free(score);
+}
+
+void *qemu_plugin_scoreboard_find(struct qemu_plugin_scoreboard *score,
+                                  unsigned int vcpu_index)
+{
+    g_assert(vcpu_index < score->data->len);
+    return &g_array_index(score->data, char,
+                          vcpu_index * g_array_get_element_size(score->data));
+}
+
+void qemu_plugin_u64_add(qemu_plugin_u64 entry, unsigned int vcpu_index,
+                         uint64_t added)
+{
+    *plugin_u64_address(entry, vcpu_index) += added;
+}
+
+uint64_t qemu_plugin_u64_get(qemu_plugin_u64 entry, unsigned int vcpu_index)
+{
+    return *plugin_u64_address(entry, vcpu_index);
+}
+
+void qemu_plugin_u64_set(qemu_plugin_u64 entry, unsigned int vcpu_index,
+                         uint64_t val)
+{
+    *plugin_u64_address(entry, vcpu_index) = val;
+}
+
+uint64_t qemu_plugin_u64_sum(qemu_plugin_u64 entry)
+{
+    uint64_t total = 0;
+    unsigned int i;
+
+    for (i = 0; i < entry.score->data->len; i++) {
+        total += qemu_plugin_u64_get(entry, i);
+    }
+    return total;
+}
+
+/*
+ * Register and memory access
+ *
+ * Registers are looked up by the names in the gdb XML description of
+ * the CPU, and the handle is just the gdb register number plus one so
+ * that it is never NULL.
+ */
+
+struct qemu_plugin_register *qemu_plugin_find_register(unsigned int vcpu_index,
+                                                       const char *name)
+{
+    CPUState *cpu = qemu_get_cpu(vcpu_index);
+    int reg;
+
+    if (!cpu) {
+        return NULL;
+    }
+    reg = gdb_find_register(cpu, name);
+    return reg < 0 ? NULL : GINT_TO_POINTER(reg + 1);
+}
+
+int qemu_plugin_read_register(struct qemu_plugin_register *reg,
+                              void *buf, size_t len)
+{
+    static __thread GByteArray *reg_buf;
+    int size;
+
+    g_assert(current_cpu);
+    if (!reg_buf) {
+        reg_buf = g_byte_array_sized_new(64);
+    }
+    g_byte_array_set_size(reg_buf, 0);
+
+    size = gdb_read_register(current_cpu, reg_buf, GPOINTER_TO_INT(reg) - 1);
+    if (size <= 0 || size > len) {
+        return -1;
+    }
+    memcpy(buf, reg_buf->data, size);
+    return size;
+}
+
+bool qemu_plugin_read_memory_vaddr(uint64_t addr, void *buf, size_t len)
+{
+    g_assert(current_cpu);
+    if (addr != (target_ulong)addr) {
+        return false;
+    }
+    return cpu_memory_rw_debug(current_cpu, addr, buf, len, false) == 0;
+}
+
 /*
  * Plugin output
  */
@@ -213,10 +213,99 @@ plugin_register_cb_udata(qemu_plugin_id_t id, enum qemu_plugin_event ev,
     do_plugin_register_cb(id, ev, func, udata);
 }
 
+static void plugin_scoreboard_init_size__locked(void)
+{
+    if (!plugin.scoreboard_alloc_size) {
+        /*
+         * Size scoreboards for all the vCPUs that can ever exist, so that
+         * they never grow under the feet of running vCPUs. User-mode
+         * returns -1 here; there scoreboards grow with the threads.
+         */
+        plugin.scoreboard_alloc_size = MAX(qemu_plugin_n_max_vcpus(), 1);
+    }
+}
+
+/*
+ * Make sure that all scoreboards have an element for @cpu. Must be
+ * called without holding plugin.lock, since a running vCPU might be
+ * waiting for it while we wait for all vCPUs to stop.
+ */
+static void plugin_grow_scoreboards(CPUState *cpu)
+{
+    struct qemu_plugin_scoreboard *score;
+    size_t size;
+
+    qemu_rec_mutex_lock(&plugin.lock);
+    plugin_scoreboard_init_size__locked();
+    size = plugin.scoreboard_alloc_size;
+    while (cpu->cpu_index >= size) {
+        size *= 2;
+    }
+    if (size == plugin.scoreboard_alloc_size ||
+        QLIST_EMPTY(&plugin.scoreboards)) {
+        plugin.scoreboard_alloc_size = size;
+        qemu_rec_mutex_unlock(&plugin.lock);
+        return;
+    }
+    qemu_rec_mutex_unlock(&plugin.lock);
+
+    /* translated code might be using the elements we are about to move */
+    start_exclusive();
+    qemu_rec_mutex_lock(&plugin.lock);
+    /* another vCPU might have grown the scoreboards in the meantime */
+    if (size > plugin.scoreboard_alloc_size) {
+        QLIST_FOREACH(score, &plugin.scoreboards, entry) {
+            g_array_set_size(score->data, size);
+        }
+        plugin.scoreboard_alloc_size = size;
+        /* inline ops embed the address of the elements */
+        tb_flush(current_cpu);
+    }
+    qemu_rec_mutex_unlock(&plugin.lock);
+    end_exclusive();
+}
+
+struct qemu_plugin_scoreboard *plugin_scoreboard_new(size_t element_size)
+{
+    struct qemu_plugin_scoreboard *score;
+
+    score = g_new0(struct qemu_plugin_scoreboard, 1);
+    score->data = g_array_new(false, true, element_size);
+
+    qemu_rec_mutex_lock(&plugin.lock);
+    plugin_scoreboard_init_size__locked();
+    g_array_set_size(score->data, plugin.scoreboard_alloc_size);
+    QLIST_INSERT_HEAD(&plugin.scoreboards, score, entry);
+    qemu_rec_mutex_unlock(&plugin.lock);
+
+    return score;
+}
+
+void plugin_scoreboard_free(struct qemu_plugin_scoreboard *score)
+{
+    qemu_rec_mutex_lock(&plugin.lock);
+    QLIST_REMOVE(score, entry);
+    qemu_rec_mutex_unlock(&plugin.lock);
+
+    g_array_free(score->data, true);
+    g_free(score);
+}
+
+uint64_t *plugin_u64_address(qemu_plugin_u64 entry, unsigned int cpu_index)
+{
+    GArray *data = entry.score->data;
+    char *base = data->data + entry.offset;
+
+    g_assert(cpu_index < data->len);
+    return (uint64_t *)(base + cpu_index * g_array_get_element_size(data));
+}
+
 void qemu_plugin_vcpu_init_hook(CPUState *cpu)
 {
     bool success;
 
+    plugin_grow_scoreboards(cpu);
+
     qemu_rec_mutex_lock(&plugin.lock);
     plugin_cpu_update__locked(&cpu->cpu_index, NULL, NULL);
     success = g_hash_table_insert(plugin.cpu_ht, &cpu->cpu_index,
@@ -295,6 +384,24 @@ void plugin_register_inline_op(GArray **arr,
     dyn_cb->rw = rw;
     dyn_cb->inline_insn.op = op;
     dyn_cb->inline_insn.imm = imm;
+    dyn_cb->entry = (qemu_plugin_u64) { NULL, 0 };
+}
+
+void plugin_register_inline_op_on_entry(GArray **arr,
+                                        enum qemu_plugin_mem_rw rw,
+                                        enum qemu_plugin_op op,
+                                        qemu_plugin_u64 entry,
+                                        uint64_t imm)
+{
+    struct qemu_plugin_dyn_cb *dyn_cb;
+
+    dyn_cb = plugin_get_dyn_cb(arr);
+    dyn_cb->userp = NULL;
+    dyn_cb->type = PLUGIN_CB_INLINE;
+    dyn_cb->rw = rw;
+    dyn_cb->inline_insn.op = op;
+    dyn_cb->inline_insn.imm = imm;
+    dyn_cb->entry = entry;
 }
 
 static inline uint32_t cb_to_tcg_flags(enum qemu_plugin_cb_flags flags)
@@ -326,6 +433,32 @@ plugin_register_dyn_cb__udata(GArray **arr,
     dyn_cb->tcg_flags = cb_to_tcg_flags(flags);
     dyn_cb->f.vcpu_udata = cb;
     dyn_cb->type = PLUGIN_CB_REGULAR;
+    dyn_cb->cond.cond = QEMU_PLUGIN_COND_ALWAYS;
+    dyn_cb->entry = (qemu_plugin_u64) { NULL, 0 };
+}
+
+void
+plugin_register_dyn_cond_cb__udata(GArray **arr,
+                                   qemu_plugin_vcpu_udata_cb_t cb,
+                                   enum qemu_plugin_cb_flags flags,
+                                   enum qemu_plugin_cond cond,
+                                   qemu_plugin_u64 entry,
+                                   uint64_t imm, void *udata)
+{
+    struct qemu_plugin_dyn_cb *dyn_cb;
+
+    if (cond == QEMU_PLUGIN_COND_NEVER) {
+        return;
+    }
+    dyn_cb = plugin_get_dyn_cb(arr);
+
+    dyn_cb->userp = udata;
+    dyn_cb->tcg_flags = cb_to_tcg_flags(flags);
+    dyn_cb->f.vcpu_udata = cb;
+    dyn_cb->type = PLUGIN_CB_REGULAR;
+    dyn_cb->cond.cond = cond;
+    dyn_cb->cond.imm = imm;
+    dyn_cb->entry = entry;
 }
 
 void plugin_register_vcpu_mem_cb(GArray **arr,
@@ -342,6 +475,8 @@ void plugin_register_vcpu_mem_cb(GArray **arr,
     dyn_cb->type = PLUGIN_CB_REGULAR;
     dyn_cb->rw = rw;
     dyn_cb->f.generic = cb;
+    dyn_cb->cond.cond = QEMU_PLUGIN_COND_ALWAYS;
+    dyn_cb->entry = (qemu_plugin_u64) { NULL, 0 };
 }
 
 /*
@@ -453,14 +588,18 @@ void qemu_plugin_flush_cb(void)
     plugin_cb__simple(QEMU_PLUGIN_EV_FLUSH);
 }
 
-void exec_inline_op(struct qemu_plugin_dyn_cb *cb)
+void exec_inline_op(struct qemu_plugin_dyn_cb *cb, int cpu_index)
 {
-    uint64_t *val = cb->userp;
+    uint64_t *val = cb->entry.score ?
+        plugin_u64_address(cb->entry, cpu_index) : cb->userp;
 
     switch (cb->inline_insn.op) {
     case QEMU_PLUGIN_INLINE_ADD_U64:
         *val += cb->inline_insn.imm;
         break;
+    case QEMU_PLUGIN_INLINE_STORE_U64:
+        *val = cb->inline_insn.imm;
+        break;
     default:
         g_assert_not_reached();
     }
@@ -480,14 +619,14 @@ void qemu_plugin_vcpu_mem_cb(CPUState *cpu, uint64_t vaddr, uint32_t info)
         int w = !!(info & TRACE_MEM_ST) + 1;
 
         if (!(w & cb->rw)) {
-                break;
+            continue;
         }
         switch (cb->type) {
         case PLUGIN_CB_REGULAR:
             cb->f.vcpu_mem(cpu->cpu_index, info, vaddr, cb->userp);
             break;
         case PLUGIN_CB_INLINE:
-            exec_inline_op(cb);
+            exec_inline_op(cb, cpu->cpu_index);
             break;
         default:
             g_assert_not_reached();
@@ -533,6 +672,7 @@ static void __attribute__((__constructor__)) plugin_init(void)
     plugin.id_ht = g_hash_table_new(g_int64_hash, g_int64_equal);
     plugin.cpu_ht = g_hash_table_new(g_int_hash, g_int_equal);
     QTAILQ_INIT(&plugin.ctxs);
+    QLIST_INIT(&plugin.scoreboards);
     qht_init(&plugin.dyn_cb_arr_ht, plugin_dyn_cb_arr_cmp, 16,
              QHT_MODE_AUTO_RESIZE);
     atexit(qemu_plugin_atexit_cb);
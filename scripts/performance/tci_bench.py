@@ -0,0 +1,101 @@
+#!/usr/bin/env python3
+
+#  Compare the run time of two QEMU builds, typically two builds with
+#  --enable-tcg-interpreter before and after a change to TCI, on the
+#  same guest workload.
+#
+#  Syntax:
+#  tci_bench.py [-h] [-r <runs>] -b <baseline qemu> -- \
+#               <qemu executable> [<qemu executable options>] \
+#               <target executable> [<target executable options>]
+#
+#  [-h] - Print the script arguments help message.
+#  [-r] - Number of runs of each build (default 5).  The minimum of the
+#         wall clock times is reported.
+#  -b   - QEMU executable to use as the baseline.  It is run with the
+#         same options as <qemu executable>.
+#
+#  Example of usage:
+#  tci_bench.py -b old/qemu-x86_64 -- new/qemu-x86_64 coremark-x86_64
+#
+#  This file is a part of the project "TCG Continuous Benchmarking".
+#
+#  This program is free software: you can redistribute it and/or modify
+#  it under the terms of the GNU General Public License as published by
+#  the Free Software Foundation, either version 2 of the License, or
+#  (at your option) any later version.
+#
+#  This program is distributed in the hope that it will be useful,
+#  but WITHOUT ANY WARRANTY; without even the implied warranty of
+#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+#  GNU General Public License for more details.
+#
+#  You should have received a copy of the GNU General Public License
+#  along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+import argparse
+import subprocess
+import sys
+import time
+
+
+def run_time(command, runs):
+    """
+    Run a command several times and measure its wall clock time.
+
+    Parameters:
+    command (list): Command and its arguments
+    runs (int): Number of runs
+
+    Returns:
+    (float): Minimum run time in seconds
+    """
+    best = None
+    for _ in range(runs):
+        start = time.perf_counter()
+        result = subprocess.run(command,
+                                stdout=subprocess.DEVNULL,
+                                stderr=subprocess.PIPE)
+        elapsed = time.perf_counter() - start
+        if result.returncode:
+            sys.exit("{} failed:\n{}".format(
+                command[0], result.stderr.decode("utf-8")))
+        if best is None or elapsed < best:
+            best = elapsed
+    return best
+
+
+def main():
+    # Parse the command line arguments
+    parser = argparse.ArgumentParser(
+        usage='tci_bench.py [-h] [-r <runs>] -b <baseline qemu> -- '
+        '<qemu executable> [<qemu executable options>] '
+        '<target executable> [<target executable options>]')
+
+    parser.add_argument('-r', dest='runs', type=int, default=5,
+                        help='Number of runs of each build')
+    parser.add_argument('-b', dest='baseline', type=str, required=True,
+                        help='Baseline QEMU executable')
+    parser.add_argument('command', type=str, nargs='+', help=argparse.SUPPRESS)
+
+    args = parser.parse_args()
+
+    # Extract the needed variables from the args
+    command = args.command
+    baseline = [args.baseline] + command[1:]
+
+    # Run each build once to warm up the page cache
+    run_time(baseline, 1)
+    run_time(command, 1)
+
+    baseline_time = run_time(baseline, args.runs)
+    new_time = run_time(command, args.runs)
+
+    # Print results
+    print('{:<20}{:>12.3f}s'.format("Baseline:", baseline_time))
+    print('{:<20}{:>12.3f}s'.format("New:", new_time))
+    print('{:<20}{:>12.3f}x'.format("Speedup:", baseline_time / new_time))
+
+
+if __name__ == "__main__":
+    main()
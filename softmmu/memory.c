@@ -720,8 +720,27 @@ static MemoryRegion *memory_region_get_flatview_root(MemoryRegion *mr)
     return NULL;
 }
 
-/* Render a memory topology into a list of disjoint absolute ranges. */
-static FlatView *generate_memory_topology(MemoryRegion *mr)
+/* A FlatView that renders the same ranges as another can replace it */
+static bool flatview_equal(FlatView *a, FlatView *b)
+{
+    unsigned i;
+
+    if (a->nr != b->nr) {
+        return false;
+    }
+    for (i = 0; i < a->nr; i++) {
+        if (!flatrange_equal(&a->ranges[i], &b->ranges[i]) ||
+            a->ranges[i].dirty_log_mask != b->ranges[i].dirty_log_mask) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Render a memory topology into a list of disjoint absolute ranges.
+ * @old_view is returned instead if it renders the same ranges.
+ */
+static FlatView *generate_memory_topology(MemoryRegion *mr, FlatView *old_view)
 {
     int i;
     FlatView *view;
@@ -735,6 +754,14 @@ static FlatView *generate_memory_topology(MemoryRegion *mr)
     }
     flatview_simplify(view);
 
+    if (old_view && flatview_equal(old_view, view)) {
+        /* Keep the old view, whose dispatch tree is already built */
+        flatview_unref(view);
+        flatview_ref(old_view);
+        g_hash_table_replace(flat_views, mr, old_view);
+        return old_view;
+    }
+
     view->dispatch = address_space_dispatch_new(view);
     for (i = 0; i < view->nr; i++) {
         MemoryRegionSection mrs =
@@ -988,7 +1015,7 @@ static void flatviews_init(void)
     flat_views = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL,
                                        (GDestroyNotify) flatview_unref);
     if (!empty_view) {
-        empty_view = generate_memory_topology(NULL);
+        empty_view = generate_memory_topology(NULL, NULL);
         /* We keep it alive forever in the global variable.  */
         flatview_ref(empty_view);
     } else {
@@ -999,15 +1026,13 @@ static void flatviews_init(void)
 
 static void flatviews_reset(void)
 {
+    GHashTable *old_views = flat_views;
     AddressSpace *as;
 
-    if (flat_views) {
-        g_hash_table_unref(flat_views);
-        flat_views = NULL;
-    }
+    flat_views = NULL;
     flatviews_init();
 
-    /* Render unique FVs */
+    /* Render unique FVs, reusing those that did not change */
     QTAILQ_FOREACH(as, &address_spaces, address_spaces_link) {
         MemoryRegion *physmr = memory_region_get_flatview_root(as->root);
 
@@ -1015,7 +1040,12 @@ static void flatviews_reset(void)
             continue;
         }
 
-        generate_memory_topology(physmr);
+        generate_memory_topology(physmr, old_views ?
+                                 g_hash_table_lookup(old_views, physmr) : NULL);
+    }
+
+    if (old_views) {
+        g_hash_table_unref(old_views);
     }
 }
 
@@ -1028,6 +1058,13 @@ static void address_space_set_flatview(AddressSpace *as)
     assert(new_view);
 
     if (old_view == new_view) {
+        /* The FlatView was reused because nothing in it changed.  Listeners
+         * that rebuild their copy of the memory map on every commit still
+         * need to hear about each of its sections.
+         */
+        if (!QTAILQ_EMPTY(&as->listeners)) {
+            address_space_update_topology_pass(as, new_view, new_view, true);
+        }
         return;
     }
 
@@ -1070,7 +1107,7 @@ static void address_space_update_topology(AddressSpace *as)
 
     flatviews_init();
     if (!g_hash_table_lookup(flat_views, physmr)) {
-        generate_memory_topology(physmr);
+        generate_memory_topology(physmr, NULL);
     }
     address_space_set_flatview(as);
 }
@@ -3175,6 +3212,9 @@ void mtree_info(bool flatview, bool dispatch_tree, bool owner, bool disabled)
 
         /* Print */
         g_hash_table_foreach(views, mtree_print_flatview, &fvi);
+#if !defined(CONFIG_USER_ONLY)
+        mtree_print_section_cache_stats();
+#endif
 
         /* Free */
         g_hash_table_foreach_remove(views, mtree_info_flatview_free, 0);
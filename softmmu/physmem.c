@@ -122,8 +122,17 @@ typedef struct PhysPageMap {
     MemoryRegionSection *sections;
 } PhysPageMap;
 
+/* Entries in the section cache of an AddressSpaceDispatch, a power of 2 */
+#define SECTION_CACHE_SIZE 16
+
 struct AddressSpaceDispatch {
     MemoryRegionSection *mru_section;
+    /* Recently used sections, indexed by page number.  Like mru_section
+     * the entries are only hints that are checked against the address,
+     * and they go away together with the dispatch when the FlatView
+     * changes.
+     */
+    MemoryRegionSection *section_cache[SECTION_CACHE_SIZE];
     /* This is a multi-level map on the physical address space.
      * The bottom level has pointers to MemoryRegionSections.
      */
@@ -327,17 +336,74 @@ static MemoryRegionSection *phys_page_find(AddressSpaceDispatch *d, hwaddr addr)
     }
 }
 
+/*
+ * Section cache statistics.  Each thread counts its own lookups so that
+ * the counters never bounce between CPUs; "info mtree -f" adds them up.
+ * The counts of threads that have exited go to section_cache_exited.
+ */
+typedef struct SectionCacheStats {
+    unsigned long hits;
+    unsigned long misses;
+    Notifier exit_notifier;
+    QLIST_ENTRY(SectionCacheStats) next;
+} SectionCacheStats;
+
+static __thread SectionCacheStats section_cache_stats;
+static QLIST_HEAD(, SectionCacheStats) section_cache_threads =
+    QLIST_HEAD_INITIALIZER(section_cache_threads);
+static SectionCacheStats section_cache_exited;
+static QemuMutex section_cache_stats_lock;
+
+static void section_cache_stats_exit(Notifier *n, void *unused)
+{
+    SectionCacheStats *s = container_of(n, SectionCacheStats, exit_notifier);
+
+    qemu_mutex_lock(&section_cache_stats_lock);
+    section_cache_exited.hits += s->hits;
+    section_cache_exited.misses += s->misses;
+    QLIST_REMOVE(s, next);
+    qemu_mutex_unlock(&section_cache_stats_lock);
+}
+
+static SectionCacheStats *section_cache_stats_get(void)
+{
+    SectionCacheStats *s = &section_cache_stats;
+
+    if (unlikely(!s->exit_notifier.notify)) {
+        s->exit_notifier.notify = section_cache_stats_exit;
+        qemu_thread_atexit_add(&s->exit_notifier);
+        qemu_mutex_lock(&section_cache_stats_lock);
+        QLIST_INSERT_HEAD(&section_cache_threads, s, next);
+        qemu_mutex_unlock(&section_cache_stats_lock);
+    }
+    return s;
+}
+
 /* Called from RCU critical section */
 static MemoryRegionSection *address_space_lookup_region(AddressSpaceDispatch *d,
                                                         hwaddr addr,
                                                         bool resolve_subpage)
 {
+    MemoryRegionSection *unassigned = &d->map.sections[PHYS_SECTION_UNASSIGNED];
     MemoryRegionSection *section = qatomic_read(&d->mru_section);
     subpage_t *subpage;
 
-    if (!section || section == &d->map.sections[PHYS_SECTION_UNASSIGNED] ||
+    if (!section || section == unassigned ||
         !section_covers_addr(section, addr)) {
-        section = phys_page_find(d, addr);
+        MemoryRegionSection **slot =
+            &d->section_cache[(addr >> TARGET_PAGE_BITS) &
+                              (SECTION_CACHE_SIZE - 1)];
+        SectionCacheStats *stats = section_cache_stats_get();
+
+        section = qatomic_read(slot);
+        if (section && section != unassigned &&
+            section_covers_addr(section, addr)) {
+            qatomic_set(&stats->hits, stats->hits + 1);
+        } else {
+            section = phys_page_find(d, addr);
+            qatomic_set(slot, section);
+            qatomic_set(&stats->misses, stats->misses + 1);
+        }
         qatomic_set(&d->mru_section, section);
     }
     if (resolve_subpage && section->mr->subpage) {
@@ -2630,6 +2696,12 @@ static void tcg_commit(MemoryListener *listener)
     /* since each CPU stores ram addresses in its TLB cache, we must
        reset the modified entries */
     cpuas = container_of(listener, CPUAddressSpace, tcg_as_listener);
+
+    /* The FlatView and its dispatch were reused, the TLB is still valid */
+    if (address_space_to_dispatch(cpuas->as) == cpuas->memory_dispatch) {
+        return;
+    }
+
     cpu_reloading_memory_map();
     /* The CPU and TLB are protected by the iothread lock.
      * We reload the dispatch pointer now because cpu_reloading_memory_map()
@@ -3048,6 +3120,7 @@ void cpu_exec_init_all(void)
      */
     finalize_target_page_bits();
     io_mem_init();
+    qemu_mutex_init(&section_cache_stats_lock);
     memory_map_init();
     qemu_mutex_init(&map_client_list_lock);
 }
@@ -3606,6 +3679,23 @@ static void mtree_print_phys_entries(int start, int end, int skip, int ptr)
 #define MR_SIZE(size) (int128_nz(size) ? (hwaddr)int128_get64( \
                            int128_sub((size), int128_one())) : 0)
 
+void mtree_print_section_cache_stats(void)
+{
+    SectionCacheStats *s;
+    unsigned long hits, misses;
+
+    qemu_mutex_lock(&section_cache_stats_lock);
+    hits = section_cache_exited.hits;
+    misses = section_cache_exited.misses;
+    QLIST_FOREACH(s, &section_cache_threads, next) {
+        hits += qatomic_read(&s->hits);
+        misses += qatomic_read(&s->misses);
+    }
+    qemu_mutex_unlock(&section_cache_stats_lock);
+
+    qemu_printf("Section cache: %lu hits, %lu misses\n", hits, misses);
+}
+
 void mtree_print_dispatch(AddressSpaceDispatch *d, MemoryRegion *root)
 {
     int i;
@@ -218,6 +218,44 @@ qva_to_va(VuDev *dev, uint64_t qemu_addr)
     return NULL;
 }
 
+/* Translate qemu virtual address to guest physical address.  */
+static bool
+qva_to_gpa(VuDev *dev, uint64_t qemu_addr, uint64_t *guest_addr)
+{
+    int i;
+
+    for (i = 0; i < dev->nregions; i++) {
+        VuDevRegion *r = &dev->regions[i];
+
+        if ((qemu_addr >= r->qva) && (qemu_addr < (r->qva + r->size))) {
+            *guest_addr = qemu_addr - r->qva + r->gpa;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/* Translate our virtual address back to guest physical address.  */
+static bool
+va_to_gpa(VuDev *dev, void *addr, uint64_t *guest_addr)
+{
+    uint64_t va = (uintptr_t)addr;
+    int i;
+
+    for (i = 0; i < dev->nregions; i++) {
+        VuDevRegion *r = &dev->regions[i];
+        uint64_t start = r->mmap_addr + r->mmap_offset;
+
+        if ((va >= start) && (va < (start + r->size))) {
+            *guest_addr = va - start + r->gpa;
+            return true;
+        }
+    }
+
+    return false;
+}
+
 static void
 vmsg_close_fds(VhostUserMsg *vmsg)
 {
@@ -506,6 +544,7 @@ vu_get_features_exec(VuDev *dev, VhostUserMsg *vmsg)
         1ULL << VIRTIO_RING_F_INDIRECT_DESC |
         1ULL << VIRTIO_RING_F_EVENT_IDX |
         1ULL << VIRTIO_F_VERSION_1 |
+        1ULL << VIRTIO_F_RING_PACKED |
 
         /* vhost-user feature bits */
         1ULL << VHOST_F_LOG_ALL |
@@ -596,6 +635,13 @@ map_ring(VuDev *dev, VuVirtq *vq)
     vq->vring.used = qva_to_va(dev, vq->vra.used_user_addr);
     vq->vring.avail = qva_to_va(dev, vq->vra.avail_user_addr);
 
+    /* For packed rings, avail and used are the driver and device areas */
+    vq->vring.desc_packed = (struct vring_packed_desc *)vq->vring.desc;
+    vq->vring.driver_event =
+        (struct vring_packed_desc_event *)vq->vring.avail;
+    vq->vring.device_event =
+        (struct vring_packed_desc_event *)vq->vring.used;
+
     DPRINT("Setting virtq addresses:\n");
     DPRINT("    vring_desc  at %p\n", vq->vring.desc);
     DPRINT("    vring_used  at %p\n", vq->vring.used);
@@ -1054,6 +1100,12 @@ vu_set_vring_num_exec(VuDev *dev, VhostUserMsg *vmsg)
     DPRINT("State.num:   %u\n", num);
     dev->vq[index].vring.num = num;
 
+    free(dev->vq[index].used_elems);
+    dev->vq[index].used_elems = calloc(num, sizeof(VuVirtqUsedElem));
+    if (num && !dev->vq[index].used_elems) {
+        vu_panic(dev, "Failed to allocate used elements for vq: %d", index);
+    }
+
     return false;
 }
 
@@ -1082,6 +1134,14 @@ vu_set_vring_addr_exec(VuDev *dev, VhostUserMsg *vmsg)
         return false;
     }
 
+    if (vu_has_feature(dev, VIRTIO_F_RING_PACKED)) {
+        /* The used index and wrap counter come with SET_VRING_BASE */
+        if (!qva_to_gpa(dev, vra->desc_user_addr, &vq->vring.log_desc_addr)) {
+            vq->vring.log_desc_addr = 0;
+        }
+        return false;
+    }
+
     vq->used_idx = le16toh(vq->vring.used->idx);
 
     if (vq->last_avail_idx != vq->used_idx) {
@@ -1100,6 +1160,59 @@ vu_set_vring_addr_exec(VuDev *dev, VhostUserMsg *vmsg)
     return false;
 }
 
+static inline void
+vring_packed_used_advance(VuVirtq *vq, unsigned int ndescs)
+{
+    vq->used_idx += ndescs;
+    if (vq->used_idx >= vq->vring.num) {
+        vq->used_idx -= vq->vring.num;
+        vq->used_wrap_counter ^= 1;
+        vq->signalled_used_valid = false;
+    }
+}
+
+/* Hand the descriptor at ring slot @idx back to the driver.  */
+static void
+vring_packed_used_write(VuDev *dev, VuVirtq *vq, uint16_t id, uint32_t len,
+                        unsigned int idx, bool wrap_counter)
+{
+    struct vring_packed_desc *desc = &vq->vring.desc_packed[idx];
+    uint16_t flags = 0;
+
+    if (wrap_counter) {
+        flags = 1 << VRING_PACKED_DESC_F_AVAIL |
+                1 << VRING_PACKED_DESC_F_USED;
+    }
+
+    desc->id = htole16(id);
+    desc->len = htole32(len);
+    /* The driver may take the descriptor as soon as it sees the flags. */
+    smp_wmb();
+    desc->flags = htole16(flags);
+
+    if (vq->vring.log_desc_addr) {
+        vu_log_write(dev, vq->vring.log_desc_addr + idx * sizeof(*desc),
+                     sizeof(*desc));
+    }
+}
+
+/* Report buffers that were completed in order since the last call.  */
+static void
+vu_queue_packed_report_inorder(VuDev *dev, VuVirtq *vq)
+{
+    if (!vq->inorder_ndescs || unlikely(!vq->vring.desc_packed)) {
+        return;
+    }
+
+    /* Make sure buffers are written before the used descriptor. */
+    smp_wmb();
+
+    vring_packed_used_write(dev, vq, vq->inorder_id, vq->inorder_len,
+                            vq->used_idx, vq->used_wrap_counter);
+    vring_packed_used_advance(vq, vq->inorder_ndescs);
+    vq->inorder_ndescs = 0;
+}
+
 static bool
 vu_set_vring_base_exec(VuDev *dev, VhostUserMsg *vmsg)
 {
@@ -1108,6 +1221,22 @@ vu_set_vring_base_exec(VuDev *dev, VhostUserMsg *vmsg)
 
     DPRINT("State.index: %u\n", index);
     DPRINT("State.num:   %u\n", num);
+
+    if (vu_has_feature(dev, VIRTIO_F_RING_PACKED)) {
+        VuVirtq *vq = &dev->vq[index];
+
+        /*
+         * Bits 0-14 are the index and bit 15 the wrap counter; the low
+         * half is for the avail side and the high half for the used side.
+         */
+        vq->last_avail_idx = num & 0x7fff;
+        vq->last_avail_wrap_counter = !!(num & 0x8000);
+        vq->used_idx = (num >> 16) & 0x7fff;
+        vq->used_wrap_counter = !!(num & 0x80000000);
+        vq->inorder_ndescs = 0;
+        return false;
+    }
+
     dev->vq[index].shadow_avail_idx = dev->vq[index].last_avail_idx = num;
 
     return false;
@@ -1119,7 +1248,16 @@ vu_get_vring_base_exec(VuDev *dev, VhostUserMsg *vmsg)
     unsigned int index = vmsg->payload.state.index;
 
     DPRINT("State.index: %u\n", index);
-    vmsg->payload.state.num = dev->vq[index].last_avail_idx;
+    if (vu_has_feature(dev, VIRTIO_F_RING_PACKED)) {
+        VuVirtq *vq = &dev->vq[index];
+
+        vu_queue_packed_report_inorder(dev, vq);
+        vmsg->payload.state.num =
+            (vq->last_avail_idx | (uint32_t)vq->last_avail_wrap_counter << 15) |
+            (vq->used_idx | (uint32_t)vq->used_wrap_counter << 15) << 16;
+    } else {
+        vmsg->payload.state.num = dev->vq[index].last_avail_idx;
+    }
     vmsg->size = sizeof(vmsg->payload.state);
 
     dev->vq[index].started = false;
@@ -1189,6 +1327,11 @@ vu_check_queue_inflights(VuDev *dev, VuVirtq *vq)
         return 0;
     }
 
+    /* Inflight tracking is only implemented for split rings */
+    if (vu_has_feature(dev, VIRTIO_F_RING_PACKED)) {
+        return 0;
+    }
+
     if (unlikely(!vq->inflight)) {
         return -1;
     }
@@ -1972,6 +2115,9 @@ vu_deinit(VuDev *dev)
             vq->resubmit_list = NULL;
         }
 
+        free(vq->used_elems);
+        vq->used_elems = NULL;
+
         vq->inflight = NULL;
     }
 
@@ -2189,6 +2335,117 @@ virtqueue_read_next_desc(VuDev *dev, struct vring_desc *desc,
     return VIRTQUEUE_READ_DESC_MORE;
 }
 
+static inline bool
+vring_packed_desc_is_avail(VuVirtq *vq, unsigned int idx, bool wrap_counter)
+{
+    uint16_t flags = le16toh(vq->vring.desc_packed[idx].flags);
+    bool avail = !!(flags & (1 << VRING_PACKED_DESC_F_AVAIL));
+    bool used = !!(flags & (1 << VRING_PACKED_DESC_F_USED));
+
+    return avail != used && avail == wrap_counter;
+}
+
+/*
+ * Look up the indirect table of a packed descriptor.  Returns the table and
+ * stores its number of entries in @num, or returns NULL on error.
+ */
+static struct vring_packed_desc *
+vring_packed_indirect_table(VuDev *dev, struct vring_packed_desc *desc,
+                            struct vring_packed_desc *desc_buf,
+                            unsigned int *num)
+{
+    uint64_t desc_addr = le64toh(desc->addr);
+    uint32_t desc_len = le32toh(desc->len);
+    uint64_t read_len = desc_len;
+    struct vring_packed_desc *table;
+
+    if (!desc_len || desc_len % sizeof(struct vring_packed_desc)) {
+        vu_panic(dev, "Invalid size for indirect buffer table");
+        return NULL;
+    }
+
+    table = vu_gpa_to_va(dev, &read_len, desc_addr);
+    if (unlikely(table && read_len != desc_len)) {
+        /* Failed to use zero copy */
+        table = NULL;
+        if (!virtqueue_read_indirect_desc(dev, (struct vring_desc *)desc_buf,
+                                          desc_addr, desc_len)) {
+            table = desc_buf;
+        }
+    }
+    if (!table) {
+        vu_panic(dev, "Invalid indirect buffer table");
+        return NULL;
+    }
+
+    *num = desc_len / sizeof(struct vring_packed_desc);
+    return table;
+}
+
+static void
+vu_queue_packed_get_avail_bytes(VuDev *dev, VuVirtq *vq,
+                                unsigned int *in_total,
+                                unsigned int *out_total,
+                                unsigned max_in_bytes,
+                                unsigned max_out_bytes)
+{
+    struct vring_packed_desc desc_buf[VIRTQUEUE_MAX_SIZE];
+    unsigned int idx = vq->last_avail_idx;
+    bool wrap_counter = vq->last_avail_wrap_counter;
+    unsigned int seen = 0;
+
+    while (seen < vq->vring.num &&
+           vring_packed_desc_is_avail(vq, idx, wrap_counter)) {
+        struct vring_packed_desc *desc = &vq->vring.desc_packed[idx];
+        unsigned int i, num = 1;
+        bool more;
+
+        /* Read the descriptor only after checking that it is available. */
+        smp_rmb();
+
+        if (le16toh(desc->flags) & VRING_DESC_F_INDIRECT) {
+            desc = vring_packed_indirect_table(dev, desc, desc_buf, &num);
+            if (!desc) {
+                *in_total = *out_total = 0;
+                return;
+            }
+        }
+
+        for (i = 0; i < num; i++) {
+            if (le16toh(desc[i].flags) & VRING_DESC_F_WRITE) {
+                *in_total += le32toh(desc[i].len);
+            } else {
+                *out_total += le32toh(desc[i].len);
+            }
+            if (*in_total >= max_in_bytes && *out_total >= max_out_bytes) {
+                return;
+            }
+        }
+
+        do {
+            more = le16toh(vq->vring.desc_packed[idx].flags) &
+                   VRING_DESC_F_NEXT;
+            if (++seen > vq->vring.num) {
+                vu_panic(dev, "Looped descriptor");
+                *in_total = *out_total = 0;
+                return;
+            }
+            if (++idx >= vq->vring.num) {
+                idx = 0;
+                wrap_counter ^= 1;
+            }
+            if (more) {
+                desc = &vq->vring.desc_packed[idx];
+                if (le16toh(desc->flags) & VRING_DESC_F_WRITE) {
+                    *in_total += le32toh(desc->len);
+                } else {
+                    *out_total += le32toh(desc->len);
+                }
+            }
+        } while (more);
+    }
+}
+
 void
 vu_queue_get_avail_bytes(VuDev *dev, VuVirtq *vq, unsigned int *in_bytes,
                          unsigned int *out_bytes,
@@ -2206,6 +2463,12 @@ vu_queue_get_avail_bytes(VuDev *dev, VuVirtq *vq, unsigned int *in_bytes,
         goto done;
     }
 
+    if (vu_has_feature(dev, VIRTIO_F_RING_PACKED)) {
+        vu_queue_packed_get_avail_bytes(dev, vq, &in_total, &out_total,
+                                        max_in_bytes, max_out_bytes);
+        goto done;
+    }
+
     while ((rc = virtqueue_num_heads(dev, vq, idx)) > 0) {
         unsigned int max, desc_len, num_bufs, indirect = 0;
         uint64_t desc_addr, read_len;
@@ -2322,6 +2585,11 @@ vu_queue_empty(VuDev *dev, VuVirtq *vq)
         return true;
     }
 
+    if (vu_has_feature(dev, VIRTIO_F_RING_PACKED)) {
+        return !vring_packed_desc_is_avail(vq, vq->last_avail_idx,
+                                           vq->last_avail_wrap_counter);
+    }
+
     if (vq->shadow_avail_idx != vq->last_avail_idx) {
         return false;
     }
@@ -2329,6 +2597,38 @@ vu_queue_empty(VuDev *dev, VuVirtq *vq)
     return vring_avail_idx(vq) == vq->last_avail_idx;
 }
 
+static bool
+vring_packed_notify(VuDev *dev, VuVirtq *vq)
+{
+    struct vring_packed_desc_event *e = vq->vring.driver_event;
+    uint16_t old, new, flags, off_wrap;
+    int off;
+    bool v;
+
+    flags = le16toh(e->flags);
+    /* Read the event offset only after the flags that enable it. */
+    smp_rmb();
+    off_wrap = le16toh(e->off_wrap);
+
+    v = vq->signalled_used_valid;
+    vq->signalled_used_valid = true;
+    old = vq->signalled_used;
+    new = vq->signalled_used = vq->used_idx;
+
+    if (flags == VRING_PACKED_EVENT_FLAG_DISABLE) {
+        return false;
+    } else if (flags == VRING_PACKED_EVENT_FLAG_ENABLE) {
+        return true;
+    }
+
+    off = off_wrap & ~(1 << VRING_PACKED_EVENT_F_WRAP_CTR);
+    if (vq->used_wrap_counter != off_wrap >> VRING_PACKED_EVENT_F_WRAP_CTR) {
+        off -= vq->vring.num;
+    }
+
+    return !v || vring_need_event(off, new, old);
+}
+
 static bool
 vring_notify(VuDev *dev, VuVirtq *vq)
 {
@@ -2344,6 +2644,10 @@ vring_notify(VuDev *dev, VuVirtq *vq)
         return true;
     }
 
+    if (vu_has_feature(dev, VIRTIO_F_RING_PACKED)) {
+        return vring_packed_notify(dev, vq);
+    }
+
     if (!vu_has_feature(dev, VIRTIO_RING_F_EVENT_IDX)) {
         return !(vring_avail_flags(vq) & VRING_AVAIL_F_NO_INTERRUPT);
     }
@@ -2362,6 +2666,10 @@ static void _vu_queue_notify(VuDev *dev, VuVirtq *vq, bool sync)
         return;
     }
 
+    if (vu_has_feature(dev, VIRTIO_F_IN_ORDER)) {
+        vu_queue_packed_report_inorder(dev, vq);
+    }
+
     if (!vring_notify(dev, vq)) {
         DPRINT("skipped notify...\n");
         return;
@@ -2442,11 +2750,32 @@ vring_set_avail_event(VuVirtq *vq, uint16_t val)
     *avail = htole16(val);
 }
 
+static void
+vring_packed_set_device_event(VuDev *dev, VuVirtq *vq, int enable)
+{
+    struct vring_packed_desc_event *e = vq->vring.device_event;
+
+    if (!enable) {
+        e->flags = htole16(VRING_PACKED_EVENT_FLAG_DISABLE);
+    } else if (vu_has_feature(dev, VIRTIO_RING_F_EVENT_IDX)) {
+        e->off_wrap = htole16(vq->last_avail_idx |
+                              vq->last_avail_wrap_counter <<
+                              VRING_PACKED_EVENT_F_WRAP_CTR);
+        /* Make sure off_wrap is written before the flags. */
+        smp_wmb();
+        e->flags = htole16(VRING_PACKED_EVENT_FLAG_DESC);
+    } else {
+        e->flags = htole16(VRING_PACKED_EVENT_FLAG_ENABLE);
+    }
+}
+
 void
 vu_queue_set_notification(VuDev *dev, VuVirtq *vq, int enable)
 {
     vq->notification = enable;
-    if (vu_has_feature(dev, VIRTIO_RING_F_EVENT_IDX)) {
+    if (vu_has_feature(dev, VIRTIO_F_RING_PACKED)) {
+        vring_packed_set_device_event(dev, vq, enable);
+    } else if (vu_has_feature(dev, VIRTIO_RING_F_EVENT_IDX)) {
         vring_set_avail_event(vq, vring_avail_idx(vq));
     } else if (enable) {
         vring_used_flags_unset_bit(vq, VRING_USED_F_NO_NOTIFY);
@@ -2595,6 +2924,7 @@ vu_queue_map_desc(VuDev *dev, VuVirtq *vq, unsigned int idx, size_t sz)
     /* Now copy what we have collected and mapped */
     elem = virtqueue_alloc_element(sz, out_num, in_num);
     elem->index = idx;
+    elem->ndescs = 1;
     for (i = 0; i < out_num; i++) {
         elem->out_sg[i] = iov[i];
     }
@@ -2608,7 +2938,8 @@ vu_queue_map_desc(VuDev *dev, VuVirtq *vq, unsigned int idx, size_t sz)
 static int
 vu_queue_inflight_get(VuDev *dev, VuVirtq *vq, int desc_idx)
 {
-    if (!vu_has_protocol_feature(dev, VHOST_USER_PROTOCOL_F_INFLIGHT_SHMFD)) {
+    if (!vu_has_protocol_feature(dev, VHOST_USER_PROTOCOL_F_INFLIGHT_SHMFD) ||
+        vu_has_feature(dev, VIRTIO_F_RING_PACKED)) {
         return 0;
     }
 
@@ -2625,7 +2956,8 @@ vu_queue_inflight_get(VuDev *dev, VuVirtq *vq, int desc_idx)
 static int
 vu_queue_inflight_pre_put(VuDev *dev, VuVirtq *vq, int desc_idx)
 {
-    if (!vu_has_protocol_feature(dev, VHOST_USER_PROTOCOL_F_INFLIGHT_SHMFD)) {
+    if (!vu_has_protocol_feature(dev, VHOST_USER_PROTOCOL_F_INFLIGHT_SHMFD) ||
+        vu_has_feature(dev, VIRTIO_F_RING_PACKED)) {
         return 0;
     }
 
@@ -2641,7 +2973,8 @@ vu_queue_inflight_pre_put(VuDev *dev, VuVirtq *vq, int desc_idx)
 static int
 vu_queue_inflight_post_put(VuDev *dev, VuVirtq *vq, int desc_idx)
 {
-    if (!vu_has_protocol_feature(dev, VHOST_USER_PROTOCOL_F_INFLIGHT_SHMFD)) {
+    if (!vu_has_protocol_feature(dev, VHOST_USER_PROTOCOL_F_INFLIGHT_SHMFD) ||
+        vu_has_feature(dev, VIRTIO_F_RING_PACKED)) {
         return 0;
     }
 
@@ -2660,6 +2993,105 @@ vu_queue_inflight_post_put(VuDev *dev, VuVirtq *vq, int desc_idx)
     return 0;
 }
 
+static bool
+vring_packed_map_desc(VuDev *dev, struct vring_packed_desc *desc,
+                      struct iovec *iov,
+                      unsigned int *out_num, unsigned int *in_num)
+{
+    if (le16toh(desc->flags) & VRING_DESC_F_WRITE) {
+        return virtqueue_map_desc(dev, in_num, iov + *out_num,
+                                  VIRTQUEUE_MAX_SIZE - *out_num, true,
+                                  le64toh(desc->addr), le32toh(desc->len));
+    }
+
+    if (*in_num) {
+        vu_panic(dev, "Incorrect order for descriptors");
+        return false;
+    }
+    return virtqueue_map_desc(dev, out_num, iov, VIRTQUEUE_MAX_SIZE, false,
+                              le64toh(desc->addr), le32toh(desc->len));
+}
+
+static void *
+vu_queue_pop_packed(VuDev *dev, VuVirtq *vq, size_t sz)
+{
+    struct vring_packed_desc *desc;
+    struct vring_packed_desc desc_buf[VIRTQUEUE_MAX_SIZE];
+    struct iovec iov[VIRTQUEUE_MAX_SIZE];
+    unsigned int out_num = 0, in_num = 0, ndescs = 0;
+    unsigned int i, max;
+    VuVirtqElement *elem;
+    uint16_t id, flags;
+
+    if (!vring_packed_desc_is_avail(vq, vq->last_avail_idx,
+                                    vq->last_avail_wrap_counter)) {
+        return NULL;
+    }
+    /* Read the descriptor only after checking that it is available. */
+    smp_rmb();
+
+    if (vq->inuse >= vq->vring.num) {
+        vu_panic(dev, "Virtqueue size exceeded");
+        return NULL;
+    }
+
+    desc = &vq->vring.desc_packed[vq->last_avail_idx];
+    if (le16toh(desc->flags) & VRING_DESC_F_INDIRECT) {
+        id = le16toh(desc->id);
+        desc = vring_packed_indirect_table(dev, desc, desc_buf, &max);
+        if (!desc) {
+            return NULL;
+        }
+        for (i = 0; i < max; i++) {
+            if (!vring_packed_map_desc(dev, &desc[i], iov,
+                                       &out_num, &in_num)) {
+                return NULL;
+            }
+        }
+        ndescs = 1;
+    } else {
+        /*
+         * The driver makes the head available last, so the rest of the
+         * chain is already valid.  The buffer id is in the last one.
+         */
+        i = vq->last_avail_idx;
+        do {
+            desc = &vq->vring.desc_packed[i];
+            flags = le16toh(desc->flags);
+            id = le16toh(desc->id);
+            if (++ndescs > vq->vring.num) {
+                vu_panic(dev, "Looped descriptor");
+                return NULL;
+            }
+            if (!vring_packed_map_desc(dev, desc, iov, &out_num, &in_num)) {
+                return NULL;
+            }
+            if (++i >= vq->vring.num) {
+                i = 0;
+            }
+        } while (flags & VRING_DESC_F_NEXT);
+    }
+
+    elem = virtqueue_alloc_element(sz, out_num, in_num);
+    elem->index = id;
+    elem->ndescs = ndescs;
+    for (i = 0; i < out_num; i++) {
+        elem->out_sg[i] = iov[i];
+    }
+    for (i = 0; i < in_num; i++) {
+        elem->in_sg[i] = iov[out_num + i];
+    }
+
+    vq->last_avail_idx += ndescs;
+    if (vq->last_avail_idx >= vq->vring.num) {
+        vq->last_avail_idx -= vq->vring.num;
+        vq->last_avail_wrap_counter ^= 1;
+    }
+    vq->inuse += ndescs;
+
+    return elem;
+}
+
 void *
 vu_queue_pop(VuDev *dev, VuVirtq *vq, size_t sz)
 {
@@ -2672,6 +3104,10 @@ vu_queue_pop(VuDev *dev, VuVirtq *vq, size_t sz)
         return NULL;
     }
 
+    if (vu_has_feature(dev, VIRTIO_F_RING_PACKED)) {
+        return vu_queue_pop_packed(dev, vq, sz);
+    }
+
     if (unlikely(vq->resubmit_list && vq->resubmit_num > 0)) {
         i = (--vq->resubmit_num);
         elem = vu_queue_map_desc(dev, vq, vq->resubmit_list[i].index, sz);
@@ -2723,15 +3159,29 @@ static void
 vu_queue_detach_element(VuDev *dev, VuVirtq *vq, VuVirtqElement *elem,
                         size_t len)
 {
-    vq->inuse--;
+    vq->inuse -= vu_has_feature(dev, VIRTIO_F_RING_PACKED) ? elem->ndescs : 1;
     /* unmap, when DMA support is added */
 }
 
+static void
+vu_queue_packed_rewind(VuVirtq *vq, unsigned int num)
+{
+    if (vq->last_avail_idx < num) {
+        vq->last_avail_idx += vq->vring.num;
+        vq->last_avail_wrap_counter ^= 1;
+    }
+    vq->last_avail_idx -= num;
+}
+
 void
 vu_queue_unpop(VuDev *dev, VuVirtq *vq, VuVirtqElement *elem,
                size_t len)
 {
-    vq->last_avail_idx--;
+    if (vu_has_feature(dev, VIRTIO_F_RING_PACKED)) {
+        vu_queue_packed_rewind(vq, elem->ndescs);
+    } else {
+        vq->last_avail_idx--;
+    }
     vu_queue_detach_element(dev, vq, elem, len);
 }
 
@@ -2741,7 +3191,11 @@ vu_queue_rewind(VuDev *dev, VuVirtq *vq, unsigned int num)
     if (num > vq->inuse) {
         return false;
     }
-    vq->last_avail_idx -= num;
+    if (vu_has_feature(dev, VIRTIO_F_RING_PACKED)) {
+        vu_queue_packed_rewind(vq, num);
+    } else {
+        vq->last_avail_idx -= num;
+    }
     vq->inuse -= num;
     return true;
 }
@@ -2818,6 +3272,30 @@ vu_log_queue_fill(VuDev *dev, VuVirtq *vq,
               == VIRTQUEUE_READ_DESC_MORE));
 }
 
+/*
+ * The packed ring overwrites descriptors with used entries, so the
+ * written guest buffers are found from the mapped iovecs instead.
+ */
+static void
+vu_log_queue_fill_packed(VuDev *dev, const VuVirtqElement *elem,
+                         unsigned int len)
+{
+    unsigned int i, min;
+    uint64_t gpa;
+
+    if (!dev->log_table) {
+        return;
+    }
+
+    for (i = 0; i < elem->in_num && len > 0; i++) {
+        min = MIN(elem->in_sg[i].iov_len, (size_t)len);
+        if (va_to_gpa(dev, elem->in_sg[i].iov_base, &gpa)) {
+            vu_log_write(dev, gpa, min);
+        }
+        len -= min;
+    }
+}
+
 void
 vu_queue_fill(VuDev *dev, VuVirtq *vq,
               const VuVirtqElement *elem,
@@ -2830,6 +3308,18 @@ vu_queue_fill(VuDev *dev, VuVirtq *vq,
         return;
     }
 
+    if (vu_has_feature(dev, VIRTIO_F_RING_PACKED)) {
+        if (idx >= vq->vring.num) {
+            vu_panic(dev, "Used element index out of range");
+            return;
+        }
+        vu_log_queue_fill_packed(dev, elem, len);
+        vq->used_elems[idx].id = elem->index;
+        vq->used_elems[idx].ndescs = elem->ndescs;
+        vq->used_elems[idx].len = len;
+        return;
+    }
+
     vu_log_queue_fill(dev, vq, elem, len);
 
     idx = (idx + vq->used_idx) % vq->vring.num;
@@ -2850,6 +3340,55 @@ void vring_used_idx_set(VuDev *dev, VuVirtq *vq, uint16_t val)
     vq->used_idx = val;
 }
 
+static void
+vu_queue_packed_flush(VuDev *dev, VuVirtq *vq, unsigned int count)
+{
+    unsigned int i, idx, ndescs;
+    bool wrap_counter;
+
+    if (!count) {
+        return;
+    }
+
+    if (vu_has_feature(dev, VIRTIO_F_IN_ORDER)) {
+        /* Reported with a single used descriptor by vu_queue_notify(). */
+        for (i = 0, ndescs = 0; i < count; i++) {
+            ndescs += vq->used_elems[i].ndescs;
+        }
+        vq->inorder_id = vq->used_elems[count - 1].id;
+        vq->inorder_len = vq->used_elems[count - 1].len;
+        vq->inorder_ndescs += ndescs;
+        vq->inuse -= ndescs;
+        return;
+    }
+
+    /* Make sure buffers are written before the used descriptors. */
+    smp_wmb();
+
+    /*
+     * Write the first used descriptor last, so that the driver does
+     * not start on the batch before all of it is visible.
+     */
+    ndescs = vq->used_elems[0].ndescs;
+    for (i = 1; i < count; i++) {
+        idx = vq->used_idx + ndescs;
+        wrap_counter = vq->used_wrap_counter;
+        if (idx >= vq->vring.num) {
+            idx -= vq->vring.num;
+            wrap_counter ^= 1;
+        }
+        vring_packed_used_write(dev, vq, vq->used_elems[i].id,
+                                vq->used_elems[i].len, idx, wrap_counter);
+        ndescs += vq->used_elems[i].ndescs;
+    }
+    vring_packed_used_write(dev, vq, vq->used_elems[0].id,
+                            vq->used_elems[0].len, vq->used_idx,
+                            vq->used_wrap_counter);
+
+    vring_packed_used_advance(vq, ndescs);
+    vq->inuse -= ndescs;
+}
+
 void
 vu_queue_flush(VuDev *dev, VuVirtq *vq, unsigned int count)
 {
@@ -2860,6 +3399,11 @@ vu_queue_flush(VuDev *dev, VuVirtq *vq, unsigned int count)
         return;
     }
 
+    if (vu_has_feature(dev, VIRTIO_F_RING_PACKED)) {
+        vu_queue_packed_flush(dev, vq, count);
+        return;
+    }
+
     /* Make sure buffer is written before we update index. */
     smp_wmb();
 
@@ -265,10 +265,22 @@ typedef struct VuRing {
     struct vring_desc *desc;
     struct vring_avail *avail;
     struct vring_used *used;
+    /* The same areas, as laid out when VIRTIO_F_RING_PACKED is negotiated */
+    struct vring_packed_desc *desc_packed;
+    struct vring_packed_desc_event *driver_event;
+    struct vring_packed_desc_event *device_event;
     uint64_t log_guest_addr;
+    /* Guest address of the packed descriptor ring, for dirty logging */
+    uint64_t log_desc_addr;
     uint32_t flags;
 } VuRing;
 
+typedef struct VuVirtqUsedElem {
+    uint16_t id;
+    uint16_t ndescs;
+    uint32_t len;
+} VuVirtqUsedElem;
+
 typedef struct VuDescStateSplit {
     /* Indicate whether this descriptor is inflight or not.
      * Only available for head-descriptor. */
@@ -332,6 +344,22 @@ typedef struct VuVirtq {
 
     uint16_t used_idx;
 
+    /* Packed ring wrap counters for last_avail_idx and used_idx */
+    bool last_avail_wrap_counter;
+    bool used_wrap_counter;
+
+    /* Packed ring: elements filled since the last flush */
+    VuVirtqUsedElem *used_elems;
+
+    /*
+     * Packed ring with VIRTIO_F_IN_ORDER: descriptors completed but not
+     * yet reported.  A single used descriptor with the id and length of
+     * the last buffer covers all of them.
+     */
+    uint16_t inorder_ndescs;
+    uint16_t inorder_id;
+    uint32_t inorder_len;
+
     /* Last used index value we have signalled on */
     uint16_t signalled_used;
 
@@ -435,6 +463,7 @@ typedef struct VuVirtqElement {
     unsigned int index;
     unsigned int out_num;
     unsigned int in_num;
+    unsigned int ndescs;
     struct iovec *in_sg;
     struct iovec *out_sg;
 } VuVirtqElement;
@@ -571,6 +600,11 @@ bool vu_queue_empty(VuDev *dev, VuVirtq *vq);
  * @vq: a VuVirtq queue
  *
  * Request to notify the queue via callfd (skipped if unnecessary)
+ *
+ * On a packed ring with VIRTIO_F_IN_ORDER, buffers pushed since the last
+ * notification are reported here with a single used descriptor, so the
+ * device must call this after completing a batch even if it expects the
+ * notification itself to be suppressed.
  */
 void vu_queue_notify(VuDev *dev, VuVirtq *vq);
 
@@ -616,7 +650,9 @@ void vu_queue_unpop(VuDev *dev, VuVirtq *vq, VuVirtqElement *elem,
  * @num: number of elements to push back
  *
  * Pretend that elements weren't popped from the virtqueue.  The next
- * virtqueue_pop() will refetch the oldest element.
+ * virtqueue_pop() will refetch the oldest element.  On a packed ring
+ * @num counts descriptors, so this is only exact for elements made of
+ * a single (possibly indirect) descriptor; use vu_queue_unpop() otherwise.
  *
  * Returns: true on success, false if @num is greater than the number of in use
  * elements.
@@ -656,7 +692,8 @@ void vu_queue_push(VuDev *dev, VuVirtq *vq,
  * @num: number of elements to flush
  *
  * Mark the last number of elements as done (used.idx is updated by
- * num elements).
+ * num elements).  With VIRTIO_F_IN_ORDER the elements must have been
+ * filled in the order they were popped.
 */
 void vu_queue_flush(VuDev *dev, VuVirtq *vq, unsigned int num);
 
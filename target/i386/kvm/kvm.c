@@ -4092,6 +4092,7 @@ int kvm_arch_get_registers(CPUState *cs)
     ret = 0;
  out:
     cpu_sync_bndcs_hflags(&cpu->env);
+    cpu_sync_avx_hflag(&cpu->env);
     return ret;
 }
 
@@ -336,6 +336,11 @@ static int cpu_post_load(void *opaque, int version_id)
     env->hflags &= ~HF_CPL_MASK;
     env->hflags |= (env->segs[R_SS].flags >> DESC_DPL_SHIFT) & HF_CPL_MASK;
 
+    /* The AVX enable bit is derived from CR4 and XCR0 and was not
+     * maintained by older versions of QEMU.
+     */
+    cpu_sync_avx_hflag(env);
+
 #ifdef CONFIG_KVM
     if ((env->hflags & HF_GUEST_MASK) &&
         (!env->nested_state ||
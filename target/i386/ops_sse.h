@@ -28,6 +28,7 @@
 #define L(n) MMX_L(n)
 #define Q(n) MMX_Q(n)
 #define SUFFIX _mmx
+#define MOVE(d, r) ((d) = (r))
 #else
 #define Reg ZMMReg
 #define XMM_ONLY(...) __VA_ARGS__
@@ -36,6 +37,15 @@
 #define L(n) ZMM_L(n)
 #define Q(n) ZMM_Q(n)
 #define SUFFIX _xmm
+/*
+ * Only the low 128 bits of the destination belong to an SSE operation;
+ * the bits above must be preserved for AVX, and the VEX translator also
+ * runs these helpers on the upper 128-bit lane of a YMM register.
+ */
+#define MOVE(d, r) do {                         \
+        (d).Q(0) = (r).Q(0);                    \
+        (d).Q(1) = (r).Q(1);                    \
+    } while (0)
 #endif
 
 void glue(helper_psrlw, SUFFIX)(CPUX86State *env, Reg *d, Reg *s)
@@ -516,7 +526,7 @@ void glue(helper_pshufw, SUFFIX)(Reg *d, Reg *s, int order)
     r.W(1) = s->W((order >> 2) & 3);
     r.W(2) = s->W((order >> 4) & 3);
     r.W(3) = s->W((order >> 6) & 3);
-    *d = r;
+    MOVE(*d, r);
 }
 #else
 void helper_shufps(Reg *d, Reg *s, int order)
@@ -527,7 +537,7 @@ void helper_shufps(Reg *d, Reg *s, int order)
     r.L(1) = d->L((order >> 2) & 3);
     r.L(2) = s->L((order >> 4) & 3);
     r.L(3) = s->L((order >> 6) & 3);
-    *d = r;
+    MOVE(*d, r);
 }
 
 void helper_shufpd(Reg *d, Reg *s, int order)
@@ -536,7 +546,7 @@ void helper_shufpd(Reg *d, Reg *s, int order)
 
     r.Q(0) = d->Q(order & 1);
     r.Q(1) = s->Q((order >> 1) & 1);
-    *d = r;
+    MOVE(*d, r);
 }
 
 void glue(helper_pshufd, SUFFIX)(Reg *d, Reg *s, int order)
@@ -547,7 +557,7 @@ void glue(helper_pshufd, SUFFIX)(Reg *d, Reg *s, int order)
     r.L(1) = s->L((order >> 2) & 3);
     r.L(2) = s->L((order >> 4) & 3);
     r.L(3) = s->L((order >> 6) & 3);
-    *d = r;
+    MOVE(*d, r);
 }
 
 void glue(helper_pshuflw, SUFFIX)(Reg *d, Reg *s, int order)
@@ -559,7 +569,7 @@ void glue(helper_pshuflw, SUFFIX)(Reg *d, Reg *s, int order)
     r.W(2) = s->W((order >> 4) & 3);
     r.W(3) = s->W((order >> 6) & 3);
     r.Q(1) = s->Q(1);
-    *d = r;
+    MOVE(*d, r);
 }
 
 void glue(helper_pshufhw, SUFFIX)(Reg *d, Reg *s, int order)
@@ -571,7 +581,7 @@ void glue(helper_pshufhw, SUFFIX)(Reg *d, Reg *s, int order)
     r.W(5) = s->W(4 + ((order >> 2) & 3));
     r.W(6) = s->W(4 + ((order >> 4) & 3));
     r.W(7) = s->W(4 + ((order >> 6) & 3));
-    *d = r;
+    MOVE(*d, r);
 }
 #endif
 
@@ -937,7 +947,7 @@ void helper_haddps(CPUX86State *env, ZMMReg *d, ZMMReg *s)
     r.ZMM_S(1) = float32_add(d->ZMM_S(2), d->ZMM_S(3), &env->sse_status);
     r.ZMM_S(2) = float32_add(s->ZMM_S(0), s->ZMM_S(1), &env->sse_status);
     r.ZMM_S(3) = float32_add(s->ZMM_S(2), s->ZMM_S(3), &env->sse_status);
-    *d = r;
+    MOVE(*d, r);
 }
 
 void helper_haddpd(CPUX86State *env, ZMMReg *d, ZMMReg *s)
@@ -946,7 +956,7 @@ void helper_haddpd(CPUX86State *env, ZMMReg *d, ZMMReg *s)
 
     r.ZMM_D(0) = float64_add(d->ZMM_D(0), d->ZMM_D(1), &env->sse_status);
     r.ZMM_D(1) = float64_add(s->ZMM_D(0), s->ZMM_D(1), &env->sse_status);
-    *d = r;
+    MOVE(*d, r);
 }
 
 void helper_hsubps(CPUX86State *env, ZMMReg *d, ZMMReg *s)
@@ -957,7 +967,7 @@ void helper_hsubps(CPUX86State *env, ZMMReg *d, ZMMReg *s)
     r.ZMM_S(1) = float32_sub(d->ZMM_S(2), d->ZMM_S(3), &env->sse_status);
     r.ZMM_S(2) = float32_sub(s->ZMM_S(0), s->ZMM_S(1), &env->sse_status);
     r.ZMM_S(3) = float32_sub(s->ZMM_S(2), s->ZMM_S(3), &env->sse_status);
-    *d = r;
+    MOVE(*d, r);
 }
 
 void helper_hsubpd(CPUX86State *env, ZMMReg *d, ZMMReg *s)
@@ -966,7 +976,7 @@ void helper_hsubpd(CPUX86State *env, ZMMReg *d, ZMMReg *s)
 
     r.ZMM_D(0) = float64_sub(d->ZMM_D(0), d->ZMM_D(1), &env->sse_status);
     r.ZMM_D(1) = float64_sub(s->ZMM_D(0), s->ZMM_D(1), &env->sse_status);
-    *d = r;
+    MOVE(*d, r);
 }
 
 void helper_addsubps(CPUX86State *env, ZMMReg *d, ZMMReg *s)
@@ -1035,6 +1045,36 @@ SSE_HELPER_CMP(cmpnlt, FPU_CMPNLT)
 SSE_HELPER_CMP(cmpnle, FPU_CMPNLE)
 SSE_HELPER_CMP(cmpord, FPU_CMPORD)
 
+/*
+ * The extra AVX predicates 8-15.  As for 0-7, predicates 16-31 differ
+ * only in whether QNaNs signal, and are mapped onto these.
+ */
+#define FPU_CMPEQU(size, a, b)                                          \
+    (float ## size ## _unordered_quiet(a, b, &env->sse_status) ||       \
+     float ## size ## _eq_quiet(a, b, &env->sse_status) ? -1 : 0)
+#define FPU_CMPNGE(size, a, b)                                          \
+    (float ## size ## _le(b, a, &env->sse_status) ? 0 : -1)
+#define FPU_CMPNGT(size, a, b)                                          \
+    (float ## size ## _lt(b, a, &env->sse_status) ? 0 : -1)
+#define FPU_CMPFALSE(size, a, b) 0
+#define FPU_CMPNEQO(size, a, b)                                         \
+    (float ## size ## _lt_quiet(a, b, &env->sse_status) ||              \
+     float ## size ## _lt_quiet(b, a, &env->sse_status) ? -1 : 0)
+#define FPU_CMPGE(size, a, b)                                           \
+    (float ## size ## _le(b, a, &env->sse_status) ? -1 : 0)
+#define FPU_CMPGT(size, a, b)                                           \
+    (float ## size ## _lt(b, a, &env->sse_status) ? -1 : 0)
+#define FPU_CMPTRUE(size, a, b) -1
+
+SSE_HELPER_CMP(cmpequ, FPU_CMPEQU)
+SSE_HELPER_CMP(cmpnge, FPU_CMPNGE)
+SSE_HELPER_CMP(cmpngt, FPU_CMPNGT)
+SSE_HELPER_CMP(cmpfalse, FPU_CMPFALSE)
+SSE_HELPER_CMP(cmpneqo, FPU_CMPNEQO)
+SSE_HELPER_CMP(cmpge, FPU_CMPGE)
+SSE_HELPER_CMP(cmpgt, FPU_CMPGT)
+SSE_HELPER_CMP(cmptrue, FPU_CMPTRUE)
+
 static const int comis_eflags[4] = {CC_C, CC_Z, 0, CC_Z | CC_P | CC_C};
 
 void helper_ucomiss(CPUX86State *env, Reg *d, Reg *s)
@@ -1153,7 +1193,7 @@ void glue(helper_packsswb, SUFFIX)(CPUX86State *env, Reg *d, Reg *s)
     r.B(14) = satsb((int16_t)s->W(6));
     r.B(15) = satsb((int16_t)s->W(7));
 #endif
-    *d = r;
+    MOVE(*d, r);
 }
 
 void glue(helper_packuswb, SUFFIX)(CPUX86State *env, Reg *d, Reg *s)
@@ -1180,7 +1220,7 @@ void glue(helper_packuswb, SUFFIX)(CPUX86State *env, Reg *d, Reg *s)
     r.B(14) = satub((int16_t)s->W(6));
     r.B(15) = satub((int16_t)s->W(7));
 #endif
-    *d = r;
+    MOVE(*d, r);
 }
 
 void glue(helper_packssdw, SUFFIX)(CPUX86State *env, Reg *d, Reg *s)
@@ -1199,7 +1239,7 @@ void glue(helper_packssdw, SUFFIX)(CPUX86State *env, Reg *d, Reg *s)
     r.W(6) = satsw(s->L(2));
     r.W(7) = satsw(s->L(3));
 #endif
-    *d = r;
+    MOVE(*d, r);
 }
 
 #define UNPCK_OP(base_name, base)                                       \
@@ -1227,7 +1267,7 @@ void glue(helper_packssdw, SUFFIX)(CPUX86State *env, Reg *d, Reg *s)
                  r.B(14) = d->B((base << (SHIFT + 2)) + 7);             \
                  r.B(15) = s->B((base << (SHIFT + 2)) + 7);             \
                                                                       ) \
-            *d = r;                                                     \
+            MOVE(*d, r);                                                     \
     }                                                                   \
                                                                         \
     void glue(helper_punpck ## base_name ## wd, SUFFIX)(CPUX86State *env,\
@@ -1245,7 +1285,7 @@ void glue(helper_packssdw, SUFFIX)(CPUX86State *env, Reg *d, Reg *s)
                  r.W(6) = d->W((base << (SHIFT + 1)) + 3);              \
                  r.W(7) = s->W((base << (SHIFT + 1)) + 3);              \
                                                                       ) \
-            *d = r;                                                     \
+            MOVE(*d, r);                                                     \
     }                                                                   \
                                                                         \
     void glue(helper_punpck ## base_name ## dq, SUFFIX)(CPUX86State *env,\
@@ -1259,7 +1299,7 @@ void glue(helper_packssdw, SUFFIX)(CPUX86State *env, Reg *d, Reg *s)
                  r.L(2) = d->L((base << SHIFT) + 1);                    \
                  r.L(3) = s->L((base << SHIFT) + 1);                    \
                                                                       ) \
-            *d = r;                                                     \
+            MOVE(*d, r);                                                     \
     }                                                                   \
                                                                         \
     XMM_ONLY(                                                           \
@@ -1272,7 +1312,7 @@ void glue(helper_packssdw, SUFFIX)(CPUX86State *env, Reg *d, Reg *s)
                                                                         \
                  r.Q(0) = d->Q(base);                                   \
                  r.Q(1) = s->Q(base);                                   \
-                 *d = r;                                                \
+                 MOVE(*d, r);                                                \
              }                                                          \
                                                                         )
 
@@ -1313,7 +1353,7 @@ void helper_pfacc(CPUX86State *env, MMXReg *d, MMXReg *s)
 
     r.MMX_S(0) = float32_add(d->MMX_S(0), d->MMX_S(1), &env->mmx_status);
     r.MMX_S(1) = float32_add(s->MMX_S(0), s->MMX_S(1), &env->mmx_status);
-    *d = r;
+    MOVE(*d, r);
 }
 
 void helper_pfadd(CPUX86State *env, MMXReg *d, MMXReg *s)
@@ -1378,7 +1418,7 @@ void helper_pfnacc(CPUX86State *env, MMXReg *d, MMXReg *s)
 
     r.MMX_S(0) = float32_sub(d->MMX_S(0), d->MMX_S(1), &env->mmx_status);
     r.MMX_S(1) = float32_sub(s->MMX_S(0), s->MMX_S(1), &env->mmx_status);
-    *d = r;
+    MOVE(*d, r);
 }
 
 void helper_pfpnacc(CPUX86State *env, MMXReg *d, MMXReg *s)
@@ -1387,7 +1427,7 @@ void helper_pfpnacc(CPUX86State *env, MMXReg *d, MMXReg *s)
 
     r.MMX_S(0) = float32_sub(d->MMX_S(0), d->MMX_S(1), &env->mmx_status);
     r.MMX_S(1) = float32_add(s->MMX_S(0), s->MMX_S(1), &env->mmx_status);
-    *d = r;
+    MOVE(*d, r);
 }
 
 void helper_pfrcp(CPUX86State *env, MMXReg *d, MMXReg *s)
@@ -1424,7 +1464,7 @@ void helper_pswapd(CPUX86State *env, MMXReg *d, MMXReg *s)
 
     r.MMX_L(0) = s->MMX_L(1);
     r.MMX_L(1) = s->MMX_L(0);
-    *d = r;
+    MOVE(*d, r);
 }
 #endif
 
@@ -1438,7 +1478,7 @@ void glue(helper_pshufb, SUFFIX)(CPUX86State *env, Reg *d, Reg *s)
         r.B(i) = (s->B(i) & 0x80) ? 0 : (d->B(s->B(i) & ((8 << SHIFT) - 1)));
     }
 
-    *d = r;
+    MOVE(*d, r);
 }
 
 void glue(helper_phaddw, SUFFIX)(CPUX86State *env, Reg *d, Reg *s)
@@ -1455,7 +1495,7 @@ void glue(helper_phaddw, SUFFIX)(CPUX86State *env, Reg *d, Reg *s)
     XMM_ONLY(r.W(6) = (int16_t)s->W(4) + (int16_t)s->W(5));
     XMM_ONLY(r.W(7) = (int16_t)s->W(6) + (int16_t)s->W(7));
 
-    *d = r;
+    MOVE(*d, r);
 }
 
 void glue(helper_phaddd, SUFFIX)(CPUX86State *env, Reg *d, Reg *s)
@@ -1467,7 +1507,7 @@ void glue(helper_phaddd, SUFFIX)(CPUX86State *env, Reg *d, Reg *s)
     r.L((1 << SHIFT) + 0) = (int32_t)s->L(0) + (int32_t)s->L(1);
     XMM_ONLY(r.L(3) = (int32_t)s->L(2) + (int32_t)s->L(3));
 
-    *d = r;
+    MOVE(*d, r);
 }
 
 void glue(helper_phaddsw, SUFFIX)(CPUX86State *env, Reg *d, Reg *s)
@@ -1483,7 +1523,7 @@ void glue(helper_phaddsw, SUFFIX)(CPUX86State *env, Reg *d, Reg *s)
     XMM_ONLY(r.W(6) = satsw((int16_t)s->W(4) + (int16_t)s->W(5)));
     XMM_ONLY(r.W(7) = satsw((int16_t)s->W(6) + (int16_t)s->W(7)));
 
-    *d = r;
+    MOVE(*d, r);
 }
 
 void glue(helper_pmaddubsw, SUFFIX)(CPUX86State *env, Reg *d, Reg *s)
@@ -1585,7 +1625,7 @@ void glue(helper_palignr, SUFFIX)(CPUX86State *env, Reg *d, Reg *s,
 #undef SHR
     }
 
-    *d = r;
+    MOVE(*d, r);
 }
 
 #define XMM0 (env->xmm_regs[0])
@@ -1718,7 +1758,7 @@ void glue(helper_packusdw, SUFFIX)(CPUX86State *env, Reg *d, Reg *s)
     r.W(5) = satuw((int32_t) s->L(1));
     r.W(6) = satuw((int32_t) s->L(2));
     r.W(7) = satuw((int32_t) s->L(3));
-    *d = r;
+    MOVE(*d, r);
 }
 
 #define FMINSB(d, s) MIN((int8_t)d, (int8_t)s)
@@ -1984,7 +2024,7 @@ void glue(helper_mpsadbw, SUFFIX)(CPUX86State *env, Reg *d, Reg *s,
         r.W(i) += abs1(d->B(d0 + 3) - s->B(s0 + 3));
     }
 
-    *d = r;
+    MOVE(*d, r);
 }
 
 /* SSE4.2 op helpers */
@@ -2316,8 +2356,185 @@ void glue(helper_aeskeygenassist, SUFFIX)(CPUX86State *env, Reg *d, Reg *s,
 }
 #endif
 
+/* AVX/AVX2 op helpers */
+#if SHIFT == 1
+/*
+ * These operate on a single 128-bit lane, like the SSE helpers above;
+ * for 256-bit operations the translator calls them once per lane.
+ */
+void glue(helper_vpermilps, SUFFIX)(CPUX86State *env, Reg *d, Reg *s)
+{
+    Reg r;
+
+    r.L(0) = d->L(s->L(0) & 3);
+    r.L(1) = d->L(s->L(1) & 3);
+    r.L(2) = d->L(s->L(2) & 3);
+    r.L(3) = d->L(s->L(3) & 3);
+    MOVE(*d, r);
+}
+
+void glue(helper_vpermilpd, SUFFIX)(CPUX86State *env, Reg *d, Reg *s)
+{
+    Reg r;
+
+    r.Q(0) = d->Q((s->Q(0) >> 1) & 1);
+    r.Q(1) = d->Q((s->Q(1) >> 1) & 1);
+    MOVE(*d, r);
+}
+
+#define FSLLV(d, s, bits) ((s) >= (bits) ? 0 : (d) << (s))
+#define FSRLV(d, s, bits) ((s) >= (bits) ? 0 : (d) >> (s))
+#define FSRAV(d, s, bits) ((s) >= (bits) ? (d) >> ((bits) - 1) : (d) >> (s))
+
+#define SSE_HELPER_VSHIFT(name, elem, num, type, F)                     \
+    void glue(helper_ ## name, SUFFIX)(CPUX86State *env, Reg *d, Reg *s) \
+    {                                                                   \
+        int i;                                                          \
+                                                                        \
+        for (i = 0; i < num; i++) {                                     \
+            d->elem(i) = F((type)d->elem(i), s->elem(i),                \
+                           (int)sizeof(type) * 8);                      \
+        }                                                               \
+    }
+
+SSE_HELPER_VSHIFT(vpsllvd, L, 4, uint32_t, FSLLV)
+SSE_HELPER_VSHIFT(vpsrlvd, L, 4, uint32_t, FSRLV)
+SSE_HELPER_VSHIFT(vpsravd, L, 4, int32_t, FSRAV)
+SSE_HELPER_VSHIFT(vpsllvq, Q, 2, uint64_t, FSLLV)
+SSE_HELPER_VSHIFT(vpsrlvq, Q, 2, uint64_t, FSRLV)
+
+#undef FSLLV
+#undef FSRLV
+#undef FSRAV
+#undef SSE_HELPER_VSHIFT
+
+/*
+ * The remaining helpers cross 128-bit lanes and are passed whole
+ * registers.
+ */
+void helper_vpermd_ymm(CPUX86State *env, ZMMReg *d, ZMMReg *v, ZMMReg *s)
+{
+    ZMMReg r;
+    int i;
+
+    for (i = 0; i < 8; i++) {
+        r.ZMM_L(i) = s->ZMM_L(v->ZMM_L(i) & 7);
+    }
+    d->ZMM_Y(0) = r.ZMM_Y(0);
+}
+
+static target_ulong vmem_linear_addr(CPUX86State *env, target_ulong addr,
+                                     uint32_t desc)
+{
+    int seg = ((desc & VMEM_SEG_MASK) >> VMEM_SEG_SHIFT) - 1;
+
+    if (desc & VMEM_ADDR32) {
+        addr = (uint32_t)addr;
+    }
+    if (seg >= 0) {
+        addr += env->segs[seg].base;
+    }
+    if (desc & VMEM_WRAP32) {
+        addr = (uint32_t)addr;
+    }
+    return addr;
+}
+
+/*
+ * VPGATHERDD/DQ/QD/QQ and VGATHERDPS/DPD/QPS/QPD.  Each completed element
+ * clears its mask element, so that a fault part way through leaves the
+ * architecturally specified partial state behind.
+ */
+void helper_vpgather(CPUX86State *env, ZMMReg *d, ZMMReg *mask,
+                     ZMMReg *idx, target_ulong base, uint32_t desc)
+{
+    uintptr_t ra = GETPC();
+    int scale = desc & VMEM_SCALE_MASK;
+    int nelem = (desc & VMEM_NELEM_MASK) >> VMEM_NELEM_SHIFT;
+    int i;
+
+    for (i = 0; i < nelem; i++) {
+        target_long ofs;
+        target_ulong addr;
+
+        if (desc & VMEM_DATA_Q) {
+            if ((int64_t)mask->ZMM_Q(i) >= 0) {
+                continue;
+            }
+        } else if ((int32_t)mask->ZMM_L(i) >= 0) {
+            continue;
+        }
+
+        if (desc & VMEM_INDEX_Q) {
+            ofs = (int64_t)idx->ZMM_Q(i);
+        } else {
+            ofs = (int32_t)idx->ZMM_L(i);
+        }
+        addr = vmem_linear_addr(env, base + ofs * (1 << scale), desc);
+
+        if (desc & VMEM_DATA_Q) {
+            d->ZMM_Q(i) = cpu_ldq_data_ra(env, addr, ra);
+            mask->ZMM_Q(i) = 0;
+        } else {
+            d->ZMM_L(i) = cpu_ldl_data_ra(env, addr, ra);
+            mask->ZMM_L(i) = 0;
+        }
+    }
+}
+
+/* VMASKMOVPS/PD and VPMASKMOVD/Q; masked-off elements never fault.  */
+void helper_vpmaskmov_ld(CPUX86State *env, ZMMReg *d, ZMMReg *mask,
+                         target_ulong a0, uint32_t desc)
+{
+    uintptr_t ra = GETPC();
+    int nelem = (desc & VMEM_NELEM_MASK) >> VMEM_NELEM_SHIFT;
+    int i;
+
+    for (i = 0; i < nelem; i++) {
+        if (desc & VMEM_DATA_Q) {
+            if ((int64_t)mask->ZMM_Q(i) < 0) {
+                d->ZMM_Q(i) = cpu_ldq_data_ra(env,
+                    vmem_linear_addr(env, a0 + i * 8, desc), ra);
+            } else {
+                d->ZMM_Q(i) = 0;
+            }
+        } else {
+            if ((int32_t)mask->ZMM_L(i) < 0) {
+                d->ZMM_L(i) = cpu_ldl_data_ra(env,
+                    vmem_linear_addr(env, a0 + i * 4, desc), ra);
+            } else {
+                d->ZMM_L(i) = 0;
+            }
+        }
+    }
+}
+
+void helper_vpmaskmov_st(CPUX86State *env, ZMMReg *s, ZMMReg *mask,
+                         target_ulong a0, uint32_t desc)
+{
+    uintptr_t ra = GETPC();
+    int nelem = (desc & VMEM_NELEM_MASK) >> VMEM_NELEM_SHIFT;
+    int i;
+
+    for (i = 0; i < nelem; i++) {
+        if (desc & VMEM_DATA_Q) {
+            if ((int64_t)mask->ZMM_Q(i) < 0) {
+                cpu_stq_data_ra(env, vmem_linear_addr(env, a0 + i * 8, desc),
+                                s->ZMM_Q(i), ra);
+            }
+        } else {
+            if ((int32_t)mask->ZMM_L(i) < 0) {
+                cpu_stl_data_ra(env, vmem_linear_addr(env, a0 + i * 4, desc),
+                                s->ZMM_L(i), ra);
+            }
+        }
+    }
+}
+#endif
+
 #undef SHIFT
 #undef XMM_ONLY
+#undef MOVE
 #undef Reg
 #undef B
 #undef W
@@ -215,6 +215,14 @@ SSE_HELPER_CMP(cmpneq, FPU_CMPNEQ)
 SSE_HELPER_CMP(cmpnlt, FPU_CMPNLT)
 SSE_HELPER_CMP(cmpnle, FPU_CMPNLE)
 SSE_HELPER_CMP(cmpord, FPU_CMPORD)
+SSE_HELPER_CMP(cmpequ, FPU_CMPEQU)
+SSE_HELPER_CMP(cmpnge, FPU_CMPNGE)
+SSE_HELPER_CMP(cmpngt, FPU_CMPNGT)
+SSE_HELPER_CMP(cmpfalse, FPU_CMPFALSE)
+SSE_HELPER_CMP(cmpneqo, FPU_CMPNEQO)
+SSE_HELPER_CMP(cmpge, FPU_CMPGE)
+SSE_HELPER_CMP(cmpgt, FPU_CMPGT)
+SSE_HELPER_CMP(cmptrue, FPU_CMPTRUE)
 
 DEF_HELPER_3(ucomiss, void, env, Reg, Reg)
 DEF_HELPER_3(comiss, void, env, Reg, Reg)
@@ -346,6 +354,21 @@ DEF_HELPER_4(glue(aeskeygenassist, SUFFIX), void, env, Reg, Reg, i32)
 DEF_HELPER_4(glue(pclmulqdq, SUFFIX), void, env, Reg, Reg, i32)
 #endif
 
+/* AVX/AVX2 op helpers */
+#if SHIFT == 1
+DEF_HELPER_3(glue(vpermilps, SUFFIX), void, env, Reg, Reg)
+DEF_HELPER_3(glue(vpermilpd, SUFFIX), void, env, Reg, Reg)
+DEF_HELPER_3(glue(vpsllvd, SUFFIX), void, env, Reg, Reg)
+DEF_HELPER_3(glue(vpsrlvd, SUFFIX), void, env, Reg, Reg)
+DEF_HELPER_3(glue(vpsravd, SUFFIX), void, env, Reg, Reg)
+DEF_HELPER_3(glue(vpsllvq, SUFFIX), void, env, Reg, Reg)
+DEF_HELPER_3(glue(vpsrlvq, SUFFIX), void, env, Reg, Reg)
+DEF_HELPER_4(vpermd_ymm, void, env, ZMMReg, ZMMReg, ZMMReg)
+DEF_HELPER_6(vpgather, void, env, ZMMReg, ZMMReg, ZMMReg, tl, i32)
+DEF_HELPER_5(vpmaskmov_ld, void, env, ZMMReg, ZMMReg, tl, i32)
+DEF_HELPER_5(vpmaskmov_st, void, env, ZMMReg, ZMMReg, tl, i32)
+#endif
+
 #undef SHIFT
 #undef Reg
 #undef SUFFIX
@@ -92,4 +92,18 @@ void do_interrupt_x86_hardirq(CPUX86State *env, int intno, int is_hw);
 /* smm_helper.c */
 void do_smm_enter(X86CPU *cpu);
 
+/*
+ * Descriptor passed by the translator to the AVX2 gather and masked
+ * move helpers in ops_sse.h.
+ */
+#define VMEM_SCALE_MASK     0x3       /* VSIB scale, log2 */
+#define VMEM_INDEX_Q        (1 << 2)  /* 64-bit indices */
+#define VMEM_DATA_Q         (1 << 3)  /* 64-bit elements */
+#define VMEM_NELEM_SHIFT    4         /* number of elements, 1..8 */
+#define VMEM_NELEM_MASK     (0xf << VMEM_NELEM_SHIFT)
+#define VMEM_ADDR32         (1 << 8)  /* 32-bit address size */
+#define VMEM_WRAP32         (1 << 9)  /* linear address wraps at 4GB */
+#define VMEM_SEG_SHIFT      12        /* segment register + 1, or 0 */
+#define VMEM_SEG_MASK       (7 << VMEM_SEG_SHIFT)
+
 #endif /* I386_HELPER_TCG_H */
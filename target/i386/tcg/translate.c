@@ -23,6 +23,7 @@
 #include "disas/disas.h"
 #include "exec/exec-all.h"
 #include "tcg/tcg-op.h"
+#include "tcg/tcg-op-gvec.h"
 #include "exec/cpu_ldst.h"
 #include "exec/translator.h"
 
@@ -103,6 +104,7 @@ typedef struct DisasContext {
 #endif
     int vex_l;  /* vex vector length */
     int vex_v;  /* vex vvvv register, without 1's complement.  */
+    int vex_w;  /* vex W bit */
     int ss32;   /* 32 bit stack segment */
     CCOp cc_op;  /* current CC operation */
     bool cc_op_dirty;
@@ -2224,6 +2226,16 @@ static inline void gen_goto_tb(DisasContext *s, int tb_num, target_ulong eip)
         tcg_gen_exit_tb(s->base.tb, tb_num);
         s->base.is_jmp = DISAS_NORETURN;
     } else {
+#ifndef CONFIG_USER_ONLY
+        /* jump to another page: direct jump while its mapping is unchanged */
+        TCGLabel *l = gen_new_label();
+
+        translator_xpage_guard(&s->base, tb_num, pc, s->mem_index, l);
+        tcg_gen_goto_tb(tb_num);
+        gen_jmp_im(s, eip);
+        tcg_gen_exit_tb(s->base.tb, tb_num);
+        gen_set_label(l);
+#endif
         /* jump to another page */
         gen_jmp_im(s, eip);
         gen_jr(s, s->tmp0);
@@ -2892,7 +2904,7 @@ static const SSEFunc_l_ep sse_op_table3bq[] = {
 };
 #endif
 
-static const SSEFunc_0_epp sse_op_table4[8][4] = {
+static const SSEFunc_0_epp sse_op_table4[16][4] = {
     SSE_FOP(cmpeq),
     SSE_FOP(cmplt),
     SSE_FOP(cmple),
@@ -2901,6 +2913,15 @@ static const SSEFunc_0_epp sse_op_table4[8][4] = {
     SSE_FOP(cmpnlt),
     SSE_FOP(cmpnle),
     SSE_FOP(cmpord),
+    /* AVX only */
+    SSE_FOP(cmpequ),
+    SSE_FOP(cmpnge),
+    SSE_FOP(cmpngt),
+    SSE_FOP(cmpfalse),
+    SSE_FOP(cmpneqo),
+    SSE_FOP(cmpge),
+    SSE_FOP(cmpgt),
+    SSE_FOP(cmptrue),
 };
 
 static const SSEFunc_0_epp sse_op_table5[256] = {
@@ -3029,6 +3050,105 @@ static const struct SSEOpHelper_eppi sse_op_table7[256] = {
     [0xdf] = AESNI_OP(aeskeygenassist),
 };
 
+/*
+ * MMX/SSE integer and logical operations that map directly onto a gvec
+ * expander, so that they expand inline to host vector instructions.
+ * Shared by the legacy and VEX encodings.
+ */
+typedef void GVecGen3Fn(unsigned, uint32_t, uint32_t, uint32_t,
+                        uint32_t, uint32_t);
+
+typedef struct SSEGVecOp {
+    GVecGen3Fn *fn;
+    MemOp vece;
+} SSEGVecOp;
+
+static void gen_gvec_pandn(unsigned vece, uint32_t dofs, uint32_t aofs,
+                           uint32_t bofs, uint32_t oprsz, uint32_t maxsz)
+{
+    tcg_gen_gvec_andc(vece, dofs, bofs, aofs, oprsz, maxsz);
+}
+
+static void gen_gvec_pcmpeq(unsigned vece, uint32_t dofs, uint32_t aofs,
+                            uint32_t bofs, uint32_t oprsz, uint32_t maxsz)
+{
+    tcg_gen_gvec_cmp(TCG_COND_EQ, vece, dofs, aofs, bofs, oprsz, maxsz);
+}
+
+static void gen_gvec_pcmpgt(unsigned vece, uint32_t dofs, uint32_t aofs,
+                            uint32_t bofs, uint32_t oprsz, uint32_t maxsz)
+{
+    tcg_gen_gvec_cmp(TCG_COND_GT, vece, dofs, aofs, bofs, oprsz, maxsz);
+}
+
+static const SSEGVecOp sse_gvec_table1[256] = {
+    [0x54] = { tcg_gen_gvec_and, MO_64 }, /* andps, andpd */
+    [0x55] = { gen_gvec_pandn, MO_64 }, /* andnps, andnpd */
+    [0x56] = { tcg_gen_gvec_or, MO_64 }, /* orps, orpd */
+    [0x57] = { tcg_gen_gvec_xor, MO_64 }, /* xorps, xorpd */
+    [0x64] = { gen_gvec_pcmpgt, MO_8 },
+    [0x65] = { gen_gvec_pcmpgt, MO_16 },
+    [0x66] = { gen_gvec_pcmpgt, MO_32 },
+    [0x74] = { gen_gvec_pcmpeq, MO_8 },
+    [0x75] = { gen_gvec_pcmpeq, MO_16 },
+    [0x76] = { gen_gvec_pcmpeq, MO_32 },
+    [0xd4] = { tcg_gen_gvec_add, MO_64 }, /* paddq */
+    [0xd5] = { tcg_gen_gvec_mul, MO_16 }, /* pmullw */
+    [0xd8] = { tcg_gen_gvec_ussub, MO_8 },
+    [0xd9] = { tcg_gen_gvec_ussub, MO_16 },
+    [0xda] = { tcg_gen_gvec_umin, MO_8 },
+    [0xdb] = { tcg_gen_gvec_and, MO_64 },
+    [0xdc] = { tcg_gen_gvec_usadd, MO_8 },
+    [0xdd] = { tcg_gen_gvec_usadd, MO_16 },
+    [0xde] = { tcg_gen_gvec_umax, MO_8 },
+    [0xdf] = { gen_gvec_pandn, MO_64 },
+    [0xe8] = { tcg_gen_gvec_sssub, MO_8 },
+    [0xe9] = { tcg_gen_gvec_sssub, MO_16 },
+    [0xea] = { tcg_gen_gvec_smin, MO_16 },
+    [0xeb] = { tcg_gen_gvec_or, MO_64 },
+    [0xec] = { tcg_gen_gvec_ssadd, MO_8 },
+    [0xed] = { tcg_gen_gvec_ssadd, MO_16 },
+    [0xee] = { tcg_gen_gvec_smax, MO_16 },
+    [0xef] = { tcg_gen_gvec_xor, MO_64 },
+    [0xf8] = { tcg_gen_gvec_sub, MO_8 },
+    [0xf9] = { tcg_gen_gvec_sub, MO_16 },
+    [0xfa] = { tcg_gen_gvec_sub, MO_32 },
+    [0xfb] = { tcg_gen_gvec_sub, MO_64 },
+    [0xfc] = { tcg_gen_gvec_add, MO_8 },
+    [0xfd] = { tcg_gen_gvec_add, MO_16 },
+    [0xfe] = { tcg_gen_gvec_add, MO_32 },
+};
+
+/* 0f 38 map; these only have xmm forms.  */
+static const SSEGVecOp sse_gvec_table6[256] = {
+    [0x29] = { gen_gvec_pcmpeq, MO_64 },
+    [0x37] = { gen_gvec_pcmpgt, MO_64 },
+    [0x38] = { tcg_gen_gvec_smin, MO_8 },
+    [0x39] = { tcg_gen_gvec_smin, MO_32 },
+    [0x3a] = { tcg_gen_gvec_umin, MO_16 },
+    [0x3b] = { tcg_gen_gvec_umin, MO_32 },
+    [0x3c] = { tcg_gen_gvec_smax, MO_8 },
+    [0x3d] = { tcg_gen_gvec_smax, MO_32 },
+    [0x3e] = { tcg_gen_gvec_umax, MO_16 },
+    [0x3f] = { tcg_gen_gvec_umax, MO_32 },
+    [0x40] = { tcg_gen_gvec_mul, MO_32 }, /* pmulld */
+};
+
+/* op1 = op(op1, op2) on an mmx or the low 128 bits of an xmm register */
+static void gen_sse_gvec(const SSEGVecOp *op, bool is_xmm,
+                         int op1_offset, int op2_offset)
+{
+    if (is_xmm) {
+        op1_offset += offsetof(ZMMReg, ZMM_X(0));
+        op2_offset += offsetof(ZMMReg, ZMM_X(0));
+        op->fn(op->vece, op1_offset, op1_offset, op2_offset, 16, 16);
+    } else {
+        op->fn(op->vece, op1_offset, op1_offset, op2_offset, 8, 8);
+    }
+}
+
+#include "translate-avx.c.inc"
+
 static void gen_sse(CPUX86State *env, DisasContext *s, int b,
                     target_ulong pc_start, int rex_r)
 {
@@ -3040,6 +3160,10 @@ static void gen_sse(CPUX86State *env, DisasContext *s, int b,
     SSEFunc_0_eppt sse_fn_eppt;
     MemOp ot;
 
+    if ((s->prefix & PREFIX_VEX) && gen_vex_sse(env, s, b, pc_start, rex_r)) {
+        return;
+    }
+
     b &= 0xff;
     if (s->prefix & PREFIX_DATA)
         b1 = 1;
@@ -3752,6 +3876,24 @@ static void gen_sse(CPUX86State *env, DisasContext *s, int b,
                 goto unknown_op;
             }
 
+            if (sse_gvec_table6[b].fn) {
+                gen_sse_gvec(&sse_gvec_table6[b], true,
+                             op1_offset, op2_offset);
+                break;
+            }
+            if (b >= 0x1c && b <= 0x1e) {
+                /* pabsb, pabsw, pabsd */
+                if (b1) {
+                    tcg_gen_gvec_abs(b - 0x1c,
+                                     op1_offset + offsetof(ZMMReg, ZMM_X(0)),
+                                     op2_offset + offsetof(ZMMReg, ZMM_X(0)),
+                                     16, 16);
+                } else {
+                    tcg_gen_gvec_abs(b - 0x1c, op1_offset, op2_offset, 8, 8);
+                }
+                break;
+            }
+
             tcg_gen_addi_ptr(s->ptr0, cpu_env, op1_offset);
             tcg_gen_addi_ptr(s->ptr1, cpu_env, op2_offset);
             sse_fn_epp(cpu_env, s->ptr0, s->ptr1);
@@ -4463,6 +4605,11 @@ static void gen_sse(CPUX86State *env, DisasContext *s, int b,
             sse_fn_eppt(cpu_env, s->ptr0, s->ptr1, s->A0);
             break;
         default:
+            if (sse_gvec_table1[b].fn) {
+                gen_sse_gvec(&sse_gvec_table1[b], is_xmm,
+                             op1_offset, op2_offset);
+                break;
+            }
             tcg_gen_addi_ptr(s->ptr0, cpu_env, op1_offset);
             tcg_gen_addi_ptr(s->ptr1, cpu_env, op2_offset);
             sse_fn_epp(cpu_env, s->ptr0, s->ptr1);
@@ -4497,6 +4644,7 @@ static target_ulong disas_insn(DisasContext *s, CPUState *cpu)
     s->rip_offset = 0; /* for relative ip address */
     s->vex_l = 0;
     s->vex_v = 0;
+    s->vex_w = 0;
     if (sigsetjmp(s->jmpbuf, 0) != 0) {
         gen_exception(s, EXCP0D_GPF, pc_start - s->cs_base);
         return s->pc;
@@ -4611,8 +4759,9 @@ static target_ulong disas_insn(DisasContext *s, CPUState *cpu)
                     goto unknown_op;
                 }
             }
-            s->vex_v = (~vex3 >> 3) & 0xf;
+            s->vex_v = (~vex3 >> 3) & (CODE64(s) ? 0xf : 0x7);
             s->vex_l = (vex3 >> 2) & 1;
+            s->vex_w = rex_w > 0;
             prefixes |= pp_prefix[vex3 & 3] | PREFIX_VEX;
         }
         break;
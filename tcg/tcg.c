@@ -152,6 +152,9 @@ static int tcg_target_const_match(tcg_target_long val, TCGType type,
 #ifdef TCG_TARGET_NEED_LDST_LABELS
 static int tcg_out_ldst_finalize(TCGContext *s);
 #endif
+#ifdef TCG_TARGET_NEED_TB_FINALIZE
+static void tcg_out_tb_finalize(TCGContext *s);
+#endif
 
 #define TCG_HIGHWATER 1024
 
@@ -1303,6 +1306,7 @@ void tcg_func_start(TCGContext *s)
     QTAILQ_INIT(&s->ops);
     QTAILQ_INIT(&s->free_ops);
     QSIMPLEQ_INIT(&s->labels);
+    s->emit_before_op = NULL;
 }
 
 static TCGTemp *tcg_temp_alloc(TCGContext *s)
@@ -2647,7 +2651,12 @@ static TCGOp *tcg_op_alloc(TCGOpcode opc)
 TCGOp *tcg_emit_op(TCGOpcode opc)
 {
     TCGOp *op = tcg_op_alloc(opc);
-    QTAILQ_INSERT_TAIL(&tcg_ctx->ops, op, link);
+
+    if (unlikely(tcg_ctx->emit_before_op)) {
+        QTAILQ_INSERT_BEFORE(tcg_ctx->emit_before_op, op, link);
+    } else {
+        QTAILQ_INSERT_TAIL(&tcg_ctx->ops, op, link);
+    }
     return op;
 }
 
@@ -4761,6 +4770,9 @@ int tcg_gen_code(TCGContext *s, TranslationBlock *tb)
     if (!tcg_resolve_relocs(s)) {
         return -2;
     }
+#ifdef TCG_TARGET_NEED_TB_FINALIZE
+    tcg_out_tb_finalize(s);
+#endif
 
 #ifndef CONFIG_TCG_INTERPRETER
     /* flush instruction cache */
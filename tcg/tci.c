@@ -165,197 +165,6 @@ static uint64_t tci_uint64(uint32_t high, uint32_t low)
 }
 #endif
 
-/* Read constant (native size) from bytecode. */
-static tcg_target_ulong tci_read_i(const uint8_t **tb_ptr)
-{
-    tcg_target_ulong value = *(const tcg_target_ulong *)(*tb_ptr);
-    *tb_ptr += sizeof(value);
-    return value;
-}
-
-/* Read unsigned constant (32 bit) from bytecode. */
-static uint32_t tci_read_i32(const uint8_t **tb_ptr)
-{
-    uint32_t value = *(const uint32_t *)(*tb_ptr);
-    *tb_ptr += sizeof(value);
-    return value;
-}
-
-/* Read signed constant (32 bit) from bytecode. */
-static int32_t tci_read_s32(const uint8_t **tb_ptr)
-{
-    int32_t value = *(const int32_t *)(*tb_ptr);
-    *tb_ptr += sizeof(value);
-    return value;
-}
-
-#if TCG_TARGET_REG_BITS == 64
-/* Read constant (64 bit) from bytecode. */
-static uint64_t tci_read_i64(const uint8_t **tb_ptr)
-{
-    uint64_t value = *(const uint64_t *)(*tb_ptr);
-    *tb_ptr += sizeof(value);
-    return value;
-}
-#endif
-
-/* Read indexed register (native size) from bytecode. */
-static tcg_target_ulong
-tci_read_r(const tcg_target_ulong *regs, const uint8_t **tb_ptr)
-{
-    tcg_target_ulong value = tci_read_reg(regs, **tb_ptr);
-    *tb_ptr += 1;
-    return value;
-}
-
-/* Read indexed register (8 bit) from bytecode. */
-static uint8_t tci_read_r8(const tcg_target_ulong *regs, const uint8_t **tb_ptr)
-{
-    uint8_t value = tci_read_reg8(regs, **tb_ptr);
-    *tb_ptr += 1;
-    return value;
-}
-
-#if TCG_TARGET_HAS_ext8s_i32 || TCG_TARGET_HAS_ext8s_i64
-/* Read indexed register (8 bit signed) from bytecode. */
-static int8_t tci_read_r8s(const tcg_target_ulong *regs, const uint8_t **tb_ptr)
-{
-    int8_t value = tci_read_reg8s(regs, **tb_ptr);
-    *tb_ptr += 1;
-    return value;
-}
-#endif
-
-/* Read indexed register (16 bit) from bytecode. */
-static uint16_t tci_read_r16(const tcg_target_ulong *regs,
-                             const uint8_t **tb_ptr)
-{
-    uint16_t value = tci_read_reg16(regs, **tb_ptr);
-    *tb_ptr += 1;
-    return value;
-}
-
-#if TCG_TARGET_HAS_ext16s_i32 || TCG_TARGET_HAS_ext16s_i64
-/* Read indexed register (16 bit signed) from bytecode. */
-static int16_t tci_read_r16s(const tcg_target_ulong *regs,
-                             const uint8_t **tb_ptr)
-{
-    int16_t value = tci_read_reg16s(regs, **tb_ptr);
-    *tb_ptr += 1;
-    return value;
-}
-#endif
-
-/* Read indexed register (32 bit) from bytecode. */
-static uint32_t tci_read_r32(const tcg_target_ulong *regs,
-                             const uint8_t **tb_ptr)
-{
-    uint32_t value = tci_read_reg32(regs, **tb_ptr);
-    *tb_ptr += 1;
-    return value;
-}
-
-#if TCG_TARGET_REG_BITS == 32
-/* Read two indexed registers (2 * 32 bit) from bytecode. */
-static uint64_t tci_read_r64(const tcg_target_ulong *regs,
-                             const uint8_t **tb_ptr)
-{
-    uint32_t low = tci_read_r32(regs, tb_ptr);
-    return tci_uint64(tci_read_r32(regs, tb_ptr), low);
-}
-#elif TCG_TARGET_REG_BITS == 64
-/* Read indexed register (32 bit signed) from bytecode. */
-static int32_t tci_read_r32s(const tcg_target_ulong *regs,
-                             const uint8_t **tb_ptr)
-{
-    int32_t value = tci_read_reg32s(regs, **tb_ptr);
-    *tb_ptr += 1;
-    return value;
-}
-
-/* Read indexed register (64 bit) from bytecode. */
-static uint64_t tci_read_r64(const tcg_target_ulong *regs,
-                             const uint8_t **tb_ptr)
-{
-    uint64_t value = tci_read_reg64(regs, **tb_ptr);
-    *tb_ptr += 1;
-    return value;
-}
-#endif
-
-/* Read indexed register(s) with target address from bytecode. */
-static target_ulong
-tci_read_ulong(const tcg_target_ulong *regs, const uint8_t **tb_ptr)
-{
-    target_ulong taddr = tci_read_r(regs, tb_ptr);
-#if TARGET_LONG_BITS > TCG_TARGET_REG_BITS
-    taddr += (uint64_t)tci_read_r(regs, tb_ptr) << 32;
-#endif
-    return taddr;
-}
-
-/* Read indexed register or constant (native size) from bytecode. */
-static tcg_target_ulong
-tci_read_ri(const tcg_target_ulong *regs, const uint8_t **tb_ptr)
-{
-    tcg_target_ulong value;
-    TCGReg r = **tb_ptr;
-    *tb_ptr += 1;
-    if (r == TCG_CONST) {
-        value = tci_read_i(tb_ptr);
-    } else {
-        value = tci_read_reg(regs, r);
-    }
-    return value;
-}
-
-/* Read indexed register or constant (32 bit) from bytecode. */
-static uint32_t tci_read_ri32(const tcg_target_ulong *regs,
-                              const uint8_t **tb_ptr)
-{
-    uint32_t value;
-    TCGReg r = **tb_ptr;
-    *tb_ptr += 1;
-    if (r == TCG_CONST) {
-        value = tci_read_i32(tb_ptr);
-    } else {
-        value = tci_read_reg32(regs, r);
-    }
-    return value;
-}
-
-#if TCG_TARGET_REG_BITS == 32
-/* Read two indexed registers or constants (2 * 32 bit) from bytecode. */
-static uint64_t tci_read_ri64(const tcg_target_ulong *regs,
-                              const uint8_t **tb_ptr)
-{
-    uint32_t low = tci_read_ri32(regs, tb_ptr);
-    return tci_uint64(tci_read_ri32(regs, tb_ptr), low);
-}
-#elif TCG_TARGET_REG_BITS == 64
-/* Read indexed register or constant (64 bit) from bytecode. */
-static uint64_t tci_read_ri64(const tcg_target_ulong *regs,
-                              const uint8_t **tb_ptr)
-{
-    uint64_t value;
-    TCGReg r = **tb_ptr;
-    *tb_ptr += 1;
-    if (r == TCG_CONST) {
-        value = tci_read_i64(tb_ptr);
-    } else {
-        value = tci_read_reg64(regs, r);
-    }
-    return value;
-}
-#endif
-
-static tcg_target_ulong tci_read_label(const uint8_t **tb_ptr)
-{
-    tcg_target_ulong label = tci_read_i(tb_ptr);
-    tci_assert(label != 0);
-    return label;
-}
-
 static bool tci_compare32(uint32_t u0, uint32_t u1, TCGCond condition)
 {
     bool result = false;
@@ -440,35 +249,122 @@ static bool tci_compare64(uint64_t u0, uint64_t u1, TCGCond condition)
     return result;
 }
 
+/* Address of the instruction following @insn, which has @n extra words. */
+static inline const TCIInsn *tci_next(const TCIInsn *insn, int n)
+{
+    return (const TCIInsn *)((const tcg_target_ulong *)(insn + 1) + n);
+}
+
+/* Read the @n-th extra word of @insn. */
+static inline tcg_target_ulong tci_word(const TCIInsn *insn, int n)
+{
+    return ((const tcg_target_ulong *)(insn + 1))[n];
+}
+
+/* Read the guest address held in the register(s) starting at slot @n. */
+static target_ulong
+tci_read_addr(const tcg_target_ulong *regs, const TCIInsn *insn, int n)
+{
+    target_ulong taddr = tci_read_reg(regs, insn->r[n]);
+#if TARGET_LONG_BITS > TCG_TARGET_REG_BITS
+    taddr += (uint64_t)tci_read_reg(regs, insn->r[n + 1]) << 32;
+#endif
+    return taddr;
+}
+
+/*
+ * Operations that are also part of superinstructions, so that the
+ * fused handlers share their code with the plain ones.
+ */
+
+static inline void tci_ld_i32(tcg_target_ulong *regs, const TCIInsn *insn)
+{
+    tcg_target_ulong base = tci_read_reg(regs, insn->r[1]);
+    tci_write_reg32(regs, insn->r[0], *(uint32_t *)(base + insn->i));
+}
+
+static inline void tci_st_i32(tcg_target_ulong *regs, const TCIInsn *insn)
+{
+    tcg_target_ulong base = tci_read_reg(regs, insn->r[1]);
+    tci_assert(insn->r[1] != TCG_REG_CALL_STACK || insn->i < 0);
+    *(uint32_t *)(base + insn->i) = tci_read_reg32(regs, insn->r[0]);
+}
+
+static inline void tci_movi_i32(tcg_target_ulong *regs, const TCIInsn *insn)
+{
+    tci_write_reg32(regs, insn->r[0], insn->i);
+}
+
+static inline void tci_addi_i32(tcg_target_ulong *regs, const TCIInsn *insn)
+{
+    tci_write_reg32(regs, insn->r[0],
+                    tci_read_reg32(regs, insn->r[1]) + insn->i);
+}
+
+static inline void tci_setcond_i32(tcg_target_ulong *regs,
+                                   const TCIInsn *insn)
+{
+    tci_write_reg32(regs, insn->r[0],
+                    tci_compare32(tci_read_reg32(regs, insn->r[1]),
+                                  tci_read_reg32(regs, insn->r[2]),
+                                  insn->r[3]));
+}
+
+#if TCG_TARGET_REG_BITS == 64
+static inline void tci_ld_i64(tcg_target_ulong *regs, const TCIInsn *insn)
+{
+    tcg_target_ulong base = tci_read_reg(regs, insn->r[1]);
+    tci_write_reg64(regs, insn->r[0], *(uint64_t *)(base + insn->i));
+}
+
+static inline void tci_st_i64(tcg_target_ulong *regs, const TCIInsn *insn)
+{
+    tcg_target_ulong base = tci_read_reg(regs, insn->r[1]);
+    tci_assert(insn->r[1] != TCG_REG_CALL_STACK || insn->i < 0);
+    *(uint64_t *)(base + insn->i) = tci_read_reg64(regs, insn->r[0]);
+}
+
+static inline void tci_movi_i64(tcg_target_ulong *regs, const TCIInsn *insn)
+{
+    tci_write_reg64(regs, insn->r[0], tci_word(insn, 0));
+}
+
+static inline void tci_addi_i64(tcg_target_ulong *regs, const TCIInsn *insn)
+{
+    tci_write_reg64(regs, insn->r[0],
+                    tci_read_reg64(regs, insn->r[1]) + tci_word(insn, 0));
+}
+#endif
+
 #ifdef CONFIG_SOFTMMU
 # define qemu_ld_ub \
-    helper_ret_ldub_mmu(env, taddr, oi, (uintptr_t)tb_ptr)
+    helper_ret_ldub_mmu(env, taddr, oi, (uintptr_t)(insn + 1))
 # define qemu_ld_leuw \
-    helper_le_lduw_mmu(env, taddr, oi, (uintptr_t)tb_ptr)
+    helper_le_lduw_mmu(env, taddr, oi, (uintptr_t)(insn + 1))
 # define qemu_ld_leul \
-    helper_le_ldul_mmu(env, taddr, oi, (uintptr_t)tb_ptr)
+    helper_le_ldul_mmu(env, taddr, oi, (uintptr_t)(insn + 1))
 # define qemu_ld_leq \
-    helper_le_ldq_mmu(env, taddr, oi, (uintptr_t)tb_ptr)
+    helper_le_ldq_mmu(env, taddr, oi, (uintptr_t)(insn + 1))
 # define qemu_ld_beuw \
-    helper_be_lduw_mmu(env, taddr, oi, (uintptr_t)tb_ptr)
+    helper_be_lduw_mmu(env, taddr, oi, (uintptr_t)(insn + 1))
 # define qemu_ld_beul \
-    helper_be_ldul_mmu(env, taddr, oi, (uintptr_t)tb_ptr)
+    helper_be_ldul_mmu(env, taddr, oi, (uintptr_t)(insn + 1))
 # define qemu_ld_beq \
-    helper_be_ldq_mmu(env, taddr, oi, (uintptr_t)tb_ptr)
+    helper_be_ldq_mmu(env, taddr, oi, (uintptr_t)(insn + 1))
 # define qemu_st_b(X) \
-    helper_ret_stb_mmu(env, taddr, X, oi, (uintptr_t)tb_ptr)
+    helper_ret_stb_mmu(env, taddr, X, oi, (uintptr_t)(insn + 1))
 # define qemu_st_lew(X) \
-    helper_le_stw_mmu(env, taddr, X, oi, (uintptr_t)tb_ptr)
+    helper_le_stw_mmu(env, taddr, X, oi, (uintptr_t)(insn + 1))
 # define qemu_st_lel(X) \
-    helper_le_stl_mmu(env, taddr, X, oi, (uintptr_t)tb_ptr)
+    helper_le_stl_mmu(env, taddr, X, oi, (uintptr_t)(insn + 1))
 # define qemu_st_leq(X) \
-    helper_le_stq_mmu(env, taddr, X, oi, (uintptr_t)tb_ptr)
+    helper_le_stq_mmu(env, taddr, X, oi, (uintptr_t)(insn + 1))
 # define qemu_st_bew(X) \
-    helper_be_stw_mmu(env, taddr, X, oi, (uintptr_t)tb_ptr)
+    helper_be_stw_mmu(env, taddr, X, oi, (uintptr_t)(insn + 1))
 # define qemu_st_bel(X) \
-    helper_be_stl_mmu(env, taddr, X, oi, (uintptr_t)tb_ptr)
+    helper_be_stl_mmu(env, taddr, X, oi, (uintptr_t)(insn + 1))
 # define qemu_st_beq(X) \
-    helper_be_stq_mmu(env, taddr, X, oi, (uintptr_t)tb_ptr)
+    helper_be_stq_mmu(env, taddr, X, oi, (uintptr_t)(insn + 1))
 #else
 # define qemu_ld_ub      ldub_p(g2h(taddr))
 # define qemu_ld_leuw    lduw_le_p(g2h(taddr))
@@ -486,6 +382,33 @@ static bool tci_compare64(uint64_t u0, uint64_t u1, TCGCond condition)
 # define qemu_st_beq(X)  stq_be_p(g2h(taddr), X)
 #endif
 
+/*
+ * With labels as values, the interpreter is directly threaded: the
+ * dispatch word of each instruction is the address of its handler, and
+ * every handler ends by jumping to the handler of the next instruction.
+ * Otherwise, or when TCI_SWITCH_DISPATCH is defined to compare the two,
+ * the dispatch word is the opcode and each instruction goes through a
+ * switch statement.
+ */
+#if defined(__GNUC__) && !defined(TCI_SWITCH_DISPATCH)
+# define TCI_THREADED
+#endif
+
+#ifdef TCI_THREADED
+# define CASE(name)         op_##name
+# define CASE_DEFAULT       op_unimplemented
+# define NEXT(n)            do { insn = (n); goto *(void *)insn->op; } while (0)
+/* Continue a superinstruction with the handler of its next part. */
+# define CHAIN(name, n)     do { insn = (n); goto op_##name; } while (0)
+
+static const void *tci_handlers[NB_OPS];
+#else
+# define CASE(name)         case INDEX_op_##name
+# define CASE_DEFAULT       default
+# define NEXT(n)            do { insn = (n); goto dispatch; } while (0)
+# define CHAIN(name, n)     NEXT(n)
+#endif
+
 /* Interpret pseudo code in tb. */
 /*
  * Disable CFI checks.
@@ -495,800 +418,966 @@ static bool tci_compare64(uint64_t u0, uint64_t u1, TCGCond condition)
 uintptr_t QEMU_DISABLE_CFI tcg_qemu_tb_exec(CPUArchState *env,
                                             const void *v_tb_ptr)
 {
-    const uint8_t *tb_ptr = v_tb_ptr;
+#ifdef TCI_THREADED
+    static const void * const handlers[NB_OPS] = {
+        [INDEX_op_call] = &&op_call,
+        [INDEX_op_br] = &&op_br,
+        [INDEX_op_setcond_i32] = &&op_setcond_i32,
+        [INDEX_op_tci_setcondi_i32] = &&op_tci_setcondi_i32,
+#if TCG_TARGET_REG_BITS == 32
+        [INDEX_op_setcond2_i32] = &&op_setcond2_i32,
+#elif TCG_TARGET_REG_BITS == 64
+        [INDEX_op_setcond_i64] = &&op_setcond_i64,
+        [INDEX_op_tci_setcondi_i64] = &&op_tci_setcondi_i64,
+#endif
+        [INDEX_op_mov_i32] = &&op_mov_i32,
+        [INDEX_op_tci_movi_i32] = &&op_tci_movi_i32,
+        [INDEX_op_ld8u_i32] = &&op_ld8u_i32,
+        [INDEX_op_ld_i32] = &&op_ld_i32,
+        [INDEX_op_st8_i32] = &&op_st8_i32,
+        [INDEX_op_st16_i32] = &&op_st16_i32,
+        [INDEX_op_st_i32] = &&op_st_i32,
+        [INDEX_op_add_i32] = &&op_add_i32,
+        [INDEX_op_sub_i32] = &&op_sub_i32,
+        [INDEX_op_mul_i32] = &&op_mul_i32,
+#if TCG_TARGET_HAS_div_i32
+        [INDEX_op_div_i32] = &&op_div_i32,
+        [INDEX_op_divu_i32] = &&op_divu_i32,
+        [INDEX_op_rem_i32] = &&op_rem_i32,
+        [INDEX_op_remu_i32] = &&op_remu_i32,
+#endif
+        [INDEX_op_and_i32] = &&op_and_i32,
+        [INDEX_op_or_i32] = &&op_or_i32,
+        [INDEX_op_xor_i32] = &&op_xor_i32,
+        [INDEX_op_shl_i32] = &&op_shl_i32,
+        [INDEX_op_shr_i32] = &&op_shr_i32,
+        [INDEX_op_sar_i32] = &&op_sar_i32,
+#if TCG_TARGET_HAS_rot_i32
+        [INDEX_op_rotl_i32] = &&op_rotl_i32,
+        [INDEX_op_rotr_i32] = &&op_rotr_i32,
+#endif
+#if TCG_TARGET_HAS_deposit_i32
+        [INDEX_op_deposit_i32] = &&op_deposit_i32,
+#endif
+        [INDEX_op_tci_addi_i32] = &&op_tci_addi_i32,
+        [INDEX_op_tci_andi_i32] = &&op_tci_andi_i32,
+        [INDEX_op_tci_ori_i32] = &&op_tci_ori_i32,
+        [INDEX_op_tci_xori_i32] = &&op_tci_xori_i32,
+        [INDEX_op_tci_shli_i32] = &&op_tci_shli_i32,
+        [INDEX_op_tci_shri_i32] = &&op_tci_shri_i32,
+        [INDEX_op_tci_sari_i32] = &&op_tci_sari_i32,
+        [INDEX_op_brcond_i32] = &&op_brcond_i32,
+        [INDEX_op_tci_brcondi_i32] = &&op_tci_brcondi_i32,
+#if TCG_TARGET_REG_BITS == 32
+        [INDEX_op_add2_i32] = &&op_add2_i32,
+        [INDEX_op_sub2_i32] = &&op_sub2_i32,
+        [INDEX_op_brcond2_i32] = &&op_brcond2_i32,
+        [INDEX_op_mulu2_i32] = &&op_mulu2_i32,
+#endif /* TCG_TARGET_REG_BITS == 32 */
+#if TCG_TARGET_HAS_ext8s_i32
+        [INDEX_op_ext8s_i32] = &&op_ext8s_i32,
+#endif
+#if TCG_TARGET_HAS_ext16s_i32
+        [INDEX_op_ext16s_i32] = &&op_ext16s_i32,
+#endif
+#if TCG_TARGET_HAS_ext8u_i32
+        [INDEX_op_ext8u_i32] = &&op_ext8u_i32,
+#endif
+#if TCG_TARGET_HAS_ext16u_i32
+        [INDEX_op_ext16u_i32] = &&op_ext16u_i32,
+#endif
+#if TCG_TARGET_HAS_bswap16_i32
+        [INDEX_op_bswap16_i32] = &&op_bswap16_i32,
+#endif
+#if TCG_TARGET_HAS_bswap32_i32
+        [INDEX_op_bswap32_i32] = &&op_bswap32_i32,
+#endif
+#if TCG_TARGET_HAS_not_i32
+        [INDEX_op_not_i32] = &&op_not_i32,
+#endif
+#if TCG_TARGET_HAS_neg_i32
+        [INDEX_op_neg_i32] = &&op_neg_i32,
+#endif
+#if TCG_TARGET_REG_BITS == 64
+        [INDEX_op_mov_i64] = &&op_mov_i64,
+        [INDEX_op_tci_movi_i64] = &&op_tci_movi_i64,
+        [INDEX_op_ld8u_i64] = &&op_ld8u_i64,
+        [INDEX_op_ld16u_i64] = &&op_ld16u_i64,
+        [INDEX_op_ld32u_i64] = &&op_ld32u_i64,
+        [INDEX_op_ld32s_i64] = &&op_ld32s_i64,
+        [INDEX_op_ld_i64] = &&op_ld_i64,
+        [INDEX_op_st8_i64] = &&op_st8_i64,
+        [INDEX_op_st16_i64] = &&op_st16_i64,
+        [INDEX_op_st32_i64] = &&op_st32_i64,
+        [INDEX_op_st_i64] = &&op_st_i64,
+        [INDEX_op_add_i64] = &&op_add_i64,
+        [INDEX_op_sub_i64] = &&op_sub_i64,
+        [INDEX_op_mul_i64] = &&op_mul_i64,
+        [INDEX_op_and_i64] = &&op_and_i64,
+        [INDEX_op_or_i64] = &&op_or_i64,
+        [INDEX_op_xor_i64] = &&op_xor_i64,
+        [INDEX_op_shl_i64] = &&op_shl_i64,
+        [INDEX_op_shr_i64] = &&op_shr_i64,
+        [INDEX_op_sar_i64] = &&op_sar_i64,
+#if TCG_TARGET_HAS_rot_i64
+        [INDEX_op_rotl_i64] = &&op_rotl_i64,
+        [INDEX_op_rotr_i64] = &&op_rotr_i64,
+#endif
+#if TCG_TARGET_HAS_deposit_i64
+        [INDEX_op_deposit_i64] = &&op_deposit_i64,
+#endif
+        [INDEX_op_tci_addi_i64] = &&op_tci_addi_i64,
+        [INDEX_op_tci_andi_i64] = &&op_tci_andi_i64,
+        [INDEX_op_tci_ori_i64] = &&op_tci_ori_i64,
+        [INDEX_op_tci_xori_i64] = &&op_tci_xori_i64,
+        [INDEX_op_tci_shli_i64] = &&op_tci_shli_i64,
+        [INDEX_op_tci_shri_i64] = &&op_tci_shri_i64,
+        [INDEX_op_tci_sari_i64] = &&op_tci_sari_i64,
+        [INDEX_op_brcond_i64] = &&op_brcond_i64,
+        [INDEX_op_tci_brcondi_i64] = &&op_tci_brcondi_i64,
+#if TCG_TARGET_HAS_ext8u_i64
+        [INDEX_op_ext8u_i64] = &&op_ext8u_i64,
+#endif
+#if TCG_TARGET_HAS_ext8s_i64
+        [INDEX_op_ext8s_i64] = &&op_ext8s_i64,
+#endif
+#if TCG_TARGET_HAS_ext16s_i64
+        [INDEX_op_ext16s_i64] = &&op_ext16s_i64,
+#endif
+#if TCG_TARGET_HAS_ext16u_i64
+        [INDEX_op_ext16u_i64] = &&op_ext16u_i64,
+#endif
+#if TCG_TARGET_HAS_ext32s_i64
+        [INDEX_op_ext32s_i64] = &&op_ext32s_i64,
+#endif
+        [INDEX_op_ext_i32_i64] = &&op_ext_i32_i64,
+#if TCG_TARGET_HAS_ext32u_i64
+        [INDEX_op_ext32u_i64] = &&op_ext32u_i64,
+#endif
+        [INDEX_op_extu_i32_i64] = &&op_extu_i32_i64,
+#if TCG_TARGET_HAS_bswap16_i64
+        [INDEX_op_bswap16_i64] = &&op_bswap16_i64,
+#endif
+#if TCG_TARGET_HAS_bswap32_i64
+        [INDEX_op_bswap32_i64] = &&op_bswap32_i64,
+#endif
+#if TCG_TARGET_HAS_bswap64_i64
+        [INDEX_op_bswap64_i64] = &&op_bswap64_i64,
+#endif
+#if TCG_TARGET_HAS_not_i64
+        [INDEX_op_not_i64] = &&op_not_i64,
+#endif
+#if TCG_TARGET_HAS_neg_i64
+        [INDEX_op_neg_i64] = &&op_neg_i64,
+#endif
+#endif /* TCG_TARGET_REG_BITS == 64 */
+        [INDEX_op_exit_tb] = &&op_exit_tb,
+        [INDEX_op_goto_tb] = &&op_goto_tb,
+        [INDEX_op_qemu_ld_i32] = &&op_qemu_ld_i32,
+        [INDEX_op_qemu_ld_i64] = &&op_qemu_ld_i64,
+        [INDEX_op_qemu_st_i32] = &&op_qemu_st_i32,
+        [INDEX_op_qemu_st_i64] = &&op_qemu_st_i64,
+        [INDEX_op_mb] = &&op_mb,
+        [INDEX_op_tci_ld_brcondi_i32] = &&op_tci_ld_brcondi_i32,
+        [INDEX_op_tci_setcond_brcondi_i32] = &&op_tci_setcond_brcondi_i32,
+        [INDEX_op_tci_movi_st_i32] = &&op_tci_movi_st_i32,
+        [INDEX_op_tci_ld_addi_st_i32] = &&op_tci_ld_addi_st_i32,
+#if TCG_TARGET_REG_BITS == 64
+        [INDEX_op_tci_movi32_st_i64] = &&op_tci_movi32_st_i64,
+        [INDEX_op_tci_movi_st_i64] = &&op_tci_movi_st_i64,
+        [INDEX_op_tci_ld_addi_st_i64] = &&op_tci_ld_addi_st_i64,
+#endif
+    };
+#endif
+    const TCIInsn *insn = v_tb_ptr;
     tcg_target_ulong regs[TCG_TARGET_NB_REGS];
     long tcg_temps[CPU_TEMP_BUF_NLONGS];
     uintptr_t sp_value = (uintptr_t)(tcg_temps + CPU_TEMP_BUF_NLONGS);
-    uintptr_t ret = 0;
-
-    regs[TCG_AREG0] = (tcg_target_ulong)env;
-    regs[TCG_REG_CALL_STACK] = sp_value;
-    tci_assert(tb_ptr);
-
-    for (;;) {
-        TCGOpcode opc = tb_ptr[0];
-#if defined(CONFIG_DEBUG_TCG) && !defined(NDEBUG)
-        uint8_t op_size = tb_ptr[1];
-        const uint8_t *old_code_ptr = tb_ptr;
-#endif
-        tcg_target_ulong t0;
-        tcg_target_ulong t1;
-        tcg_target_ulong t2;
-        tcg_target_ulong label;
-        TCGCond condition;
-        target_ulong taddr;
-        uint8_t tmp8;
-        uint16_t tmp16;
-        uint32_t tmp32;
-        uint64_t tmp64;
+    tcg_target_ulong t0;
+    tcg_target_ulong t1;
+    tcg_target_ulong t2;
+    target_ulong taddr;
+    uint32_t tmp32;
+    uint64_t tmp64;
 #if TCG_TARGET_REG_BITS == 32
-        uint64_t v64;
+    uint64_t v64;
 #endif
-        TCGMemOpIdx oi;
+    TCGMemOpIdx oi;
+
+#ifdef TCI_THREADED
+    if (unlikely(env == NULL)) {
+        /* Called by tci_dispatch_word to publish the handler addresses. */
+        int i;
 
-#if defined(GETPC)
-        tci_tb_ptr = (uintptr_t)tb_ptr;
+        for (i = 0; i < NB_OPS; i++) {
+            tci_handlers[i] = handlers[i] ? handlers[i] : &&op_unimplemented;
+        }
+        return 0;
+    }
 #endif
 
-        /* Skip opcode and size entry. */
-        tb_ptr += 2;
+    regs[TCG_AREG0] = (tcg_target_ulong)env;
+    regs[TCG_REG_CALL_STACK] = sp_value;
+    tci_assert(insn);
 
-        switch (opc) {
-        case INDEX_op_call:
-            t0 = tci_read_ri(regs, &tb_ptr);
+#ifdef TCI_THREADED
+    goto *(void *)insn->op;
+#else
+ dispatch:
+    switch (insn->op)
+#endif
+    {
+    CASE(call):
+        t0 = tci_word(insn, 0);
+        /* The return address of the helper is the next instruction. */
+        tci_tb_ptr = (uintptr_t)tci_next(insn, 1);
 #if TCG_TARGET_REG_BITS == 32
-            tmp64 = ((helper_function)t0)(tci_read_reg(regs, TCG_REG_R0),
-                                          tci_read_reg(regs, TCG_REG_R1),
-                                          tci_read_reg(regs, TCG_REG_R2),
-                                          tci_read_reg(regs, TCG_REG_R3),
-                                          tci_read_reg(regs, TCG_REG_R5),
-                                          tci_read_reg(regs, TCG_REG_R6),
-                                          tci_read_reg(regs, TCG_REG_R7),
-                                          tci_read_reg(regs, TCG_REG_R8),
-                                          tci_read_reg(regs, TCG_REG_R9),
-                                          tci_read_reg(regs, TCG_REG_R10),
-                                          tci_read_reg(regs, TCG_REG_R11),
-                                          tci_read_reg(regs, TCG_REG_R12));
-            tci_write_reg(regs, TCG_REG_R0, tmp64);
-            tci_write_reg(regs, TCG_REG_R1, tmp64 >> 32);
+        tmp64 = ((helper_function)t0)(tci_read_reg(regs, TCG_REG_R0),
+                                      tci_read_reg(regs, TCG_REG_R1),
+                                      tci_read_reg(regs, TCG_REG_R2),
+                                      tci_read_reg(regs, TCG_REG_R3),
+                                      tci_read_reg(regs, TCG_REG_R5),
+                                      tci_read_reg(regs, TCG_REG_R6),
+                                      tci_read_reg(regs, TCG_REG_R7),
+                                      tci_read_reg(regs, TCG_REG_R8),
+                                      tci_read_reg(regs, TCG_REG_R9),
+                                      tci_read_reg(regs, TCG_REG_R10),
+                                      tci_read_reg(regs, TCG_REG_R11),
+                                      tci_read_reg(regs, TCG_REG_R12));
+        tci_write_reg(regs, TCG_REG_R0, tmp64);
+        tci_write_reg(regs, TCG_REG_R1, tmp64 >> 32);
 #else
-            tmp64 = ((helper_function)t0)(tci_read_reg(regs, TCG_REG_R0),
-                                          tci_read_reg(regs, TCG_REG_R1),
-                                          tci_read_reg(regs, TCG_REG_R2),
-                                          tci_read_reg(regs, TCG_REG_R3),
-                                          tci_read_reg(regs, TCG_REG_R5),
-                                          tci_read_reg(regs, TCG_REG_R6));
-            tci_write_reg(regs, TCG_REG_R0, tmp64);
+        tmp64 = ((helper_function)t0)(tci_read_reg(regs, TCG_REG_R0),
+                                      tci_read_reg(regs, TCG_REG_R1),
+                                      tci_read_reg(regs, TCG_REG_R2),
+                                      tci_read_reg(regs, TCG_REG_R3),
+                                      tci_read_reg(regs, TCG_REG_R5),
+                                      tci_read_reg(regs, TCG_REG_R6));
+        tci_write_reg(regs, TCG_REG_R0, tmp64);
 #endif
-            break;
-        case INDEX_op_br:
-            label = tci_read_label(&tb_ptr);
-            tci_assert(tb_ptr == old_code_ptr + op_size);
-            tb_ptr = (uint8_t *)label;
-            continue;
-        case INDEX_op_setcond_i32:
-            t0 = *tb_ptr++;
-            t1 = tci_read_r32(regs, &tb_ptr);
-            t2 = tci_read_ri32(regs, &tb_ptr);
-            condition = *tb_ptr++;
-            tci_write_reg32(regs, t0, tci_compare32(t1, t2, condition));
-            break;
+        NEXT(tci_next(insn, 1));
+    CASE(br):
+        NEXT((const TCIInsn *)tci_word(insn, 0));
+    CASE(setcond_i32):
+        tci_setcond_i32(regs, insn);
+        NEXT(insn + 1);
+    CASE(tci_setcondi_i32):
+        tci_write_reg32(regs, insn->r[0],
+                        tci_compare32(tci_read_reg32(regs, insn->r[1]),
+                                      insn->i, insn->r[3]));
+        NEXT(insn + 1);
 #if TCG_TARGET_REG_BITS == 32
-        case INDEX_op_setcond2_i32:
-            t0 = *tb_ptr++;
-            tmp64 = tci_read_r64(regs, &tb_ptr);
-            v64 = tci_read_ri64(regs, &tb_ptr);
-            condition = *tb_ptr++;
-            tci_write_reg32(regs, t0, tci_compare64(tmp64, v64, condition));
-            break;
+    CASE(setcond2_i32):
+        tmp64 = tci_uint64(tci_read_reg32(regs, insn->r[2]),
+                           tci_read_reg32(regs, insn->r[1]));
+        v64 = tci_uint64(tci_read_reg32(regs, insn->i & 0xff),
+                         tci_read_reg32(regs, insn->r[3]));
+        tci_write_reg32(regs, insn->r[0],
+                        tci_compare64(tmp64, v64, insn->i >> 8));
+        NEXT(insn + 1);
 #elif TCG_TARGET_REG_BITS == 64
-        case INDEX_op_setcond_i64:
-            t0 = *tb_ptr++;
-            t1 = tci_read_r64(regs, &tb_ptr);
-            t2 = tci_read_ri64(regs, &tb_ptr);
-            condition = *tb_ptr++;
-            tci_write_reg64(regs, t0, tci_compare64(t1, t2, condition));
-            break;
+    CASE(setcond_i64):
+        tci_write_reg64(regs, insn->r[0],
+                        tci_compare64(tci_read_reg64(regs, insn->r[1]),
+                                      tci_read_reg64(regs, insn->r[2]),
+                                      insn->r[3]));
+        NEXT(insn + 1);
+    CASE(tci_setcondi_i64):
+        tci_write_reg64(regs, insn->r[0],
+                        tci_compare64(tci_read_reg64(regs, insn->r[1]),
+                                      tci_word(insn, 0), insn->r[3]));
+        NEXT(tci_next(insn, 1));
 #endif
-        case INDEX_op_mov_i32:
-            t0 = *tb_ptr++;
-            t1 = tci_read_r32(regs, &tb_ptr);
-            tci_write_reg32(regs, t0, t1);
-            break;
-        case INDEX_op_tci_movi_i32:
-            t0 = *tb_ptr++;
-            t1 = tci_read_i32(&tb_ptr);
-            tci_write_reg32(regs, t0, t1);
-            break;
+    CASE(mov_i32):
+        tci_write_reg32(regs, insn->r[0], tci_read_reg32(regs, insn->r[1]));
+        NEXT(insn + 1);
+    CASE(tci_movi_i32):
+        tci_movi_i32(regs, insn);
+        NEXT(insn + 1);
 
-            /* Load/store operations (32 bit). */
+        /* Load/store operations (32 bit). */
 
-        case INDEX_op_ld8u_i32:
-            t0 = *tb_ptr++;
-            t1 = tci_read_r(regs, &tb_ptr);
-            t2 = tci_read_s32(&tb_ptr);
-            tci_write_reg8(regs, t0, *(uint8_t *)(t1 + t2));
-            break;
-        case INDEX_op_ld8s_i32:
-            TODO();
-            break;
-        case INDEX_op_ld16u_i32:
-            TODO();
-            break;
-        case INDEX_op_ld16s_i32:
-            TODO();
-            break;
-        case INDEX_op_ld_i32:
-            t0 = *tb_ptr++;
-            t1 = tci_read_r(regs, &tb_ptr);
-            t2 = tci_read_s32(&tb_ptr);
-            tci_write_reg32(regs, t0, *(uint32_t *)(t1 + t2));
-            break;
-        case INDEX_op_st8_i32:
-            t0 = tci_read_r8(regs, &tb_ptr);
-            t1 = tci_read_r(regs, &tb_ptr);
-            t2 = tci_read_s32(&tb_ptr);
-            *(uint8_t *)(t1 + t2) = t0;
-            break;
-        case INDEX_op_st16_i32:
-            t0 = tci_read_r16(regs, &tb_ptr);
-            t1 = tci_read_r(regs, &tb_ptr);
-            t2 = tci_read_s32(&tb_ptr);
-            *(uint16_t *)(t1 + t2) = t0;
-            break;
-        case INDEX_op_st_i32:
-            t0 = tci_read_r32(regs, &tb_ptr);
-            t1 = tci_read_r(regs, &tb_ptr);
-            t2 = tci_read_s32(&tb_ptr);
-            tci_assert(t1 != sp_value || (int32_t)t2 < 0);
-            *(uint32_t *)(t1 + t2) = t0;
-            break;
+    CASE(ld8u_i32):
+        t1 = tci_read_reg(regs, insn->r[1]);
+        tci_write_reg8(regs, insn->r[0], *(uint8_t *)(t1 + insn->i));
+        NEXT(insn + 1);
+    CASE(ld_i32):
+        tci_ld_i32(regs, insn);
+        NEXT(insn + 1);
+    CASE(st8_i32):
+        t1 = tci_read_reg(regs, insn->r[1]);
+        *(uint8_t *)(t1 + insn->i) = tci_read_reg8(regs, insn->r[0]);
+        NEXT(insn + 1);
+    CASE(st16_i32):
+        t1 = tci_read_reg(regs, insn->r[1]);
+        *(uint16_t *)(t1 + insn->i) = tci_read_reg16(regs, insn->r[0]);
+        NEXT(insn + 1);
+    CASE(st_i32):
+        tci_st_i32(regs, insn);
+        NEXT(insn + 1);
 
-            /* Arithmetic operations (32 bit). */
+        /* Arithmetic operations (32 bit). */
 
-        case INDEX_op_add_i32:
-            t0 = *tb_ptr++;
-            t1 = tci_read_ri32(regs, &tb_ptr);
-            t2 = tci_read_ri32(regs, &tb_ptr);
-            tci_write_reg32(regs, t0, t1 + t2);
-            break;
-        case INDEX_op_sub_i32:
-            t0 = *tb_ptr++;
-            t1 = tci_read_ri32(regs, &tb_ptr);
-            t2 = tci_read_ri32(regs, &tb_ptr);
-            tci_write_reg32(regs, t0, t1 - t2);
-            break;
-        case INDEX_op_mul_i32:
-            t0 = *tb_ptr++;
-            t1 = tci_read_ri32(regs, &tb_ptr);
-            t2 = tci_read_ri32(regs, &tb_ptr);
-            tci_write_reg32(regs, t0, t1 * t2);
-            break;
+    CASE(add_i32):
+        t1 = tci_read_reg32(regs, insn->r[1]);
+        t2 = tci_read_reg32(regs, insn->r[2]);
+        tci_write_reg32(regs, insn->r[0], t1 + t2);
+        NEXT(insn + 1);
+    CASE(sub_i32):
+        t1 = tci_read_reg32(regs, insn->r[1]);
+        t2 = tci_read_reg32(regs, insn->r[2]);
+        tci_write_reg32(regs, insn->r[0], t1 - t2);
+        NEXT(insn + 1);
+    CASE(mul_i32):
+        t1 = tci_read_reg32(regs, insn->r[1]);
+        t2 = tci_read_reg32(regs, insn->r[2]);
+        tci_write_reg32(regs, insn->r[0], t1 * t2);
+        NEXT(insn + 1);
 #if TCG_TARGET_HAS_div_i32
-        case INDEX_op_div_i32:
-            t0 = *tb_ptr++;
-            t1 = tci_read_ri32(regs, &tb_ptr);
-            t2 = tci_read_ri32(regs, &tb_ptr);
-            tci_write_reg32(regs, t0, (int32_t)t1 / (int32_t)t2);
-            break;
-        case INDEX_op_divu_i32:
-            t0 = *tb_ptr++;
-            t1 = tci_read_ri32(regs, &tb_ptr);
-            t2 = tci_read_ri32(regs, &tb_ptr);
-            tci_write_reg32(regs, t0, t1 / t2);
-            break;
-        case INDEX_op_rem_i32:
-            t0 = *tb_ptr++;
-            t1 = tci_read_ri32(regs, &tb_ptr);
-            t2 = tci_read_ri32(regs, &tb_ptr);
-            tci_write_reg32(regs, t0, (int32_t)t1 % (int32_t)t2);
-            break;
-        case INDEX_op_remu_i32:
-            t0 = *tb_ptr++;
-            t1 = tci_read_ri32(regs, &tb_ptr);
-            t2 = tci_read_ri32(regs, &tb_ptr);
-            tci_write_reg32(regs, t0, t1 % t2);
-            break;
-#elif TCG_TARGET_HAS_div2_i32
-        case INDEX_op_div2_i32:
-        case INDEX_op_divu2_i32:
-            TODO();
-            break;
+    CASE(div_i32):
+        t1 = tci_read_reg32(regs, insn->r[1]);
+        t2 = tci_read_reg32(regs, insn->r[2]);
+        tci_write_reg32(regs, insn->r[0], (int32_t)t1 / (int32_t)t2);
+        NEXT(insn + 1);
+    CASE(divu_i32):
+        t1 = tci_read_reg32(regs, insn->r[1]);
+        t2 = tci_read_reg32(regs, insn->r[2]);
+        tci_write_reg32(regs, insn->r[0], t1 / t2);
+        NEXT(insn + 1);
+    CASE(rem_i32):
+        t1 = tci_read_reg32(regs, insn->r[1]);
+        t2 = tci_read_reg32(regs, insn->r[2]);
+        tci_write_reg32(regs, insn->r[0], (int32_t)t1 % (int32_t)t2);
+        NEXT(insn + 1);
+    CASE(remu_i32):
+        t1 = tci_read_reg32(regs, insn->r[1]);
+        t2 = tci_read_reg32(regs, insn->r[2]);
+        tci_write_reg32(regs, insn->r[0], t1 % t2);
+        NEXT(insn + 1);
 #endif
-        case INDEX_op_and_i32:
-            t0 = *tb_ptr++;
-            t1 = tci_read_ri32(regs, &tb_ptr);
-            t2 = tci_read_ri32(regs, &tb_ptr);
-            tci_write_reg32(regs, t0, t1 & t2);
-            break;
-        case INDEX_op_or_i32:
-            t0 = *tb_ptr++;
-            t1 = tci_read_ri32(regs, &tb_ptr);
-            t2 = tci_read_ri32(regs, &tb_ptr);
-            tci_write_reg32(regs, t0, t1 | t2);
-            break;
-        case INDEX_op_xor_i32:
-            t0 = *tb_ptr++;
-            t1 = tci_read_ri32(regs, &tb_ptr);
-            t2 = tci_read_ri32(regs, &tb_ptr);
-            tci_write_reg32(regs, t0, t1 ^ t2);
-            break;
+    CASE(and_i32):
+        t1 = tci_read_reg32(regs, insn->r[1]);
+        t2 = tci_read_reg32(regs, insn->r[2]);
+        tci_write_reg32(regs, insn->r[0], t1 & t2);
+        NEXT(insn + 1);
+    CASE(or_i32):
+        t1 = tci_read_reg32(regs, insn->r[1]);
+        t2 = tci_read_reg32(regs, insn->r[2]);
+        tci_write_reg32(regs, insn->r[0], t1 | t2);
+        NEXT(insn + 1);
+    CASE(xor_i32):
+        t1 = tci_read_reg32(regs, insn->r[1]);
+        t2 = tci_read_reg32(regs, insn->r[2]);
+        tci_write_reg32(regs, insn->r[0], t1 ^ t2);
+        NEXT(insn + 1);
 
-            /* Shift/rotate operations (32 bit). */
+        /* Shift/rotate operations (32 bit). */
 
-        case INDEX_op_shl_i32:
-            t0 = *tb_ptr++;
-            t1 = tci_read_ri32(regs, &tb_ptr);
-            t2 = tci_read_ri32(regs, &tb_ptr);
-            tci_write_reg32(regs, t0, t1 << (t2 & 31));
-            break;
-        case INDEX_op_shr_i32:
-            t0 = *tb_ptr++;
-            t1 = tci_read_ri32(regs, &tb_ptr);
-            t2 = tci_read_ri32(regs, &tb_ptr);
-            tci_write_reg32(regs, t0, t1 >> (t2 & 31));
-            break;
-        case INDEX_op_sar_i32:
-            t0 = *tb_ptr++;
-            t1 = tci_read_ri32(regs, &tb_ptr);
-            t2 = tci_read_ri32(regs, &tb_ptr);
-            tci_write_reg32(regs, t0, ((int32_t)t1 >> (t2 & 31)));
-            break;
+    CASE(shl_i32):
+        t1 = tci_read_reg32(regs, insn->r[1]);
+        t2 = tci_read_reg32(regs, insn->r[2]);
+        tci_write_reg32(regs, insn->r[0], t1 << (t2 & 31));
+        NEXT(insn + 1);
+    CASE(shr_i32):
+        t1 = tci_read_reg32(regs, insn->r[1]);
+        t2 = tci_read_reg32(regs, insn->r[2]);
+        tci_write_reg32(regs, insn->r[0], t1 >> (t2 & 31));
+        NEXT(insn + 1);
+    CASE(sar_i32):
+        t1 = tci_read_reg32(regs, insn->r[1]);
+        t2 = tci_read_reg32(regs, insn->r[2]);
+        tci_write_reg32(regs, insn->r[0], ((int32_t)t1 >> (t2 & 31)));
+        NEXT(insn + 1);
 #if TCG_TARGET_HAS_rot_i32
-        case INDEX_op_rotl_i32:
-            t0 = *tb_ptr++;
-            t1 = tci_read_ri32(regs, &tb_ptr);
-            t2 = tci_read_ri32(regs, &tb_ptr);
-            tci_write_reg32(regs, t0, rol32(t1, t2 & 31));
-            break;
-        case INDEX_op_rotr_i32:
-            t0 = *tb_ptr++;
-            t1 = tci_read_ri32(regs, &tb_ptr);
-            t2 = tci_read_ri32(regs, &tb_ptr);
-            tci_write_reg32(regs, t0, ror32(t1, t2 & 31));
-            break;
+    CASE(rotl_i32):
+        t1 = tci_read_reg32(regs, insn->r[1]);
+        t2 = tci_read_reg32(regs, insn->r[2]);
+        tci_write_reg32(regs, insn->r[0], rol32(t1, t2 & 31));
+        NEXT(insn + 1);
+    CASE(rotr_i32):
+        t1 = tci_read_reg32(regs, insn->r[1]);
+        t2 = tci_read_reg32(regs, insn->r[2]);
+        tci_write_reg32(regs, insn->r[0], ror32(t1, t2 & 31));
+        NEXT(insn + 1);
 #endif
 #if TCG_TARGET_HAS_deposit_i32
-        case INDEX_op_deposit_i32:
-            t0 = *tb_ptr++;
-            t1 = tci_read_r32(regs, &tb_ptr);
-            t2 = tci_read_r32(regs, &tb_ptr);
-            tmp16 = *tb_ptr++;
-            tmp8 = *tb_ptr++;
-            tmp32 = (((1 << tmp8) - 1) << tmp16);
-            tci_write_reg32(regs, t0, (t1 & ~tmp32) | ((t2 << tmp16) & tmp32));
-            break;
+    CASE(deposit_i32):
+        t1 = tci_read_reg32(regs, insn->r[1]);
+        t2 = tci_read_reg32(regs, insn->r[2]);
+        tmp32 = (((1 << insn->i) - 1) << insn->r[3]);
+        tci_write_reg32(regs, insn->r[0],
+                        (t1 & ~tmp32) | ((t2 << insn->r[3]) & tmp32));
+        NEXT(insn + 1);
 #endif
-        case INDEX_op_brcond_i32:
-            t0 = tci_read_r32(regs, &tb_ptr);
-            t1 = tci_read_ri32(regs, &tb_ptr);
-            condition = *tb_ptr++;
-            label = tci_read_label(&tb_ptr);
-            if (tci_compare32(t0, t1, condition)) {
-                tci_assert(tb_ptr == old_code_ptr + op_size);
-                tb_ptr = (uint8_t *)label;
-                continue;
-            }
-            break;
+
+        /* Operations with an immediate operand (32 bit). */
+
+    CASE(tci_addi_i32):
+        tci_addi_i32(regs, insn);
+        NEXT(insn + 1);
+    CASE(tci_andi_i32):
+        t1 = tci_read_reg32(regs, insn->r[1]);
+        tci_write_reg32(regs, insn->r[0], t1 & insn->i);
+        NEXT(insn + 1);
+    CASE(tci_ori_i32):
+        t1 = tci_read_reg32(regs, insn->r[1]);
+        tci_write_reg32(regs, insn->r[0], t1 | insn->i);
+        NEXT(insn + 1);
+    CASE(tci_xori_i32):
+        t1 = tci_read_reg32(regs, insn->r[1]);
+        tci_write_reg32(regs, insn->r[0], t1 ^ insn->i);
+        NEXT(insn + 1);
+    CASE(tci_shli_i32):
+        t1 = tci_read_reg32(regs, insn->r[1]);
+        tci_write_reg32(regs, insn->r[0], t1 << (insn->i & 31));
+        NEXT(insn + 1);
+    CASE(tci_shri_i32):
+        t1 = tci_read_reg32(regs, insn->r[1]);
+        tci_write_reg32(regs, insn->r[0], t1 >> (insn->i & 31));
+        NEXT(insn + 1);
+    CASE(tci_sari_i32):
+        t1 = tci_read_reg32(regs, insn->r[1]);
+        tci_write_reg32(regs, insn->r[0], (int32_t)t1 >> (insn->i & 31));
+        NEXT(insn + 1);
+
+    CASE(brcond_i32):
+        t0 = tci_read_reg32(regs, insn->r[0]);
+        t1 = tci_read_reg32(regs, insn->r[1]);
+        if (tci_compare32(t0, t1, insn->r[2])) {
+            NEXT((const TCIInsn *)tci_word(insn, 0));
+        }
+        NEXT(tci_next(insn, 1));
+    CASE(tci_brcondi_i32):
+        t0 = tci_read_reg32(regs, insn->r[0]);
+        if (tci_compare32(t0, insn->i, insn->r[2])) {
+            NEXT((const TCIInsn *)tci_word(insn, 0));
+        }
+        NEXT(tci_next(insn, 1));
 #if TCG_TARGET_REG_BITS == 32
-        case INDEX_op_add2_i32:
-            t0 = *tb_ptr++;
-            t1 = *tb_ptr++;
-            tmp64 = tci_read_r64(regs, &tb_ptr);
-            tmp64 += tci_read_r64(regs, &tb_ptr);
-            tci_write_reg64(regs, t1, t0, tmp64);
-            break;
-        case INDEX_op_sub2_i32:
-            t0 = *tb_ptr++;
-            t1 = *tb_ptr++;
-            tmp64 = tci_read_r64(regs, &tb_ptr);
-            tmp64 -= tci_read_r64(regs, &tb_ptr);
-            tci_write_reg64(regs, t1, t0, tmp64);
-            break;
-        case INDEX_op_brcond2_i32:
-            tmp64 = tci_read_r64(regs, &tb_ptr);
-            v64 = tci_read_ri64(regs, &tb_ptr);
-            condition = *tb_ptr++;
-            label = tci_read_label(&tb_ptr);
-            if (tci_compare64(tmp64, v64, condition)) {
-                tci_assert(tb_ptr == old_code_ptr + op_size);
-                tb_ptr = (uint8_t *)label;
-                continue;
-            }
-            break;
-        case INDEX_op_mulu2_i32:
-            t0 = *tb_ptr++;
-            t1 = *tb_ptr++;
-            t2 = tci_read_r32(regs, &tb_ptr);
-            tmp64 = tci_read_r32(regs, &tb_ptr);
-            tci_write_reg64(regs, t1, t0, t2 * tmp64);
-            break;
+    CASE(add2_i32):
+        tmp64 = tci_uint64(tci_read_reg32(regs, insn->r[3]),
+                           tci_read_reg32(regs, insn->r[2]));
+        tmp64 += tci_uint64(tci_read_reg32(regs, insn->i >> 8),
+                            tci_read_reg32(regs, insn->i & 0xff));
+        tci_write_reg64(regs, insn->r[1], insn->r[0], tmp64);
+        NEXT(insn + 1);
+    CASE(sub2_i32):
+        tmp64 = tci_uint64(tci_read_reg32(regs, insn->r[3]),
+                           tci_read_reg32(regs, insn->r[2]));
+        tmp64 -= tci_uint64(tci_read_reg32(regs, insn->i >> 8),
+                            tci_read_reg32(regs, insn->i & 0xff));
+        tci_write_reg64(regs, insn->r[1], insn->r[0], tmp64);
+        NEXT(insn + 1);
+    CASE(brcond2_i32):
+        tmp64 = tci_uint64(tci_read_reg32(regs, insn->r[1]),
+                           tci_read_reg32(regs, insn->r[0]));
+        v64 = tci_uint64(tci_read_reg32(regs, insn->r[3]),
+                         tci_read_reg32(regs, insn->r[2]));
+        if (tci_compare64(tmp64, v64, insn->i)) {
+            NEXT((const TCIInsn *)tci_word(insn, 0));
+        }
+        NEXT(tci_next(insn, 1));
+    CASE(mulu2_i32):
+        t2 = tci_read_reg32(regs, insn->r[2]);
+        tmp64 = tci_read_reg32(regs, insn->r[3]);
+        tci_write_reg64(regs, insn->r[1], insn->r[0], t2 * tmp64);
+        NEXT(insn + 1);
 #endif /* TCG_TARGET_REG_BITS == 32 */
 #if TCG_TARGET_HAS_ext8s_i32
-        case INDEX_op_ext8s_i32:
-            t0 = *tb_ptr++;
-            t1 = tci_read_r8s(regs, &tb_ptr);
-            tci_write_reg32(regs, t0, t1);
-            break;
+    CASE(ext8s_i32):
+        t1 = tci_read_reg8s(regs, insn->r[1]);
+        tci_write_reg32(regs, insn->r[0], t1);
+        NEXT(insn + 1);
 #endif
 #if TCG_TARGET_HAS_ext16s_i32
-        case INDEX_op_ext16s_i32:
-            t0 = *tb_ptr++;
-            t1 = tci_read_r16s(regs, &tb_ptr);
-            tci_write_reg32(regs, t0, t1);
-            break;
+    CASE(ext16s_i32):
+        t1 = tci_read_reg16s(regs, insn->r[1]);
+        tci_write_reg32(regs, insn->r[0], t1);
+        NEXT(insn + 1);
 #endif
 #if TCG_TARGET_HAS_ext8u_i32
-        case INDEX_op_ext8u_i32:
-            t0 = *tb_ptr++;
-            t1 = tci_read_r8(regs, &tb_ptr);
-            tci_write_reg32(regs, t0, t1);
-            break;
+    CASE(ext8u_i32):
+        t1 = tci_read_reg8(regs, insn->r[1]);
+        tci_write_reg32(regs, insn->r[0], t1);
+        NEXT(insn + 1);
 #endif
 #if TCG_TARGET_HAS_ext16u_i32
-        case INDEX_op_ext16u_i32:
-            t0 = *tb_ptr++;
-            t1 = tci_read_r16(regs, &tb_ptr);
-            tci_write_reg32(regs, t0, t1);
-            break;
+    CASE(ext16u_i32):
+        t1 = tci_read_reg16(regs, insn->r[1]);
+        tci_write_reg32(regs, insn->r[0], t1);
+        NEXT(insn + 1);
 #endif
 #if TCG_TARGET_HAS_bswap16_i32
-        case INDEX_op_bswap16_i32:
-            t0 = *tb_ptr++;
-            t1 = tci_read_r16(regs, &tb_ptr);
-            tci_write_reg32(regs, t0, bswap16(t1));
-            break;
+    CASE(bswap16_i32):
+        t1 = tci_read_reg16(regs, insn->r[1]);
+        tci_write_reg32(regs, insn->r[0], bswap16(t1));
+        NEXT(insn + 1);
 #endif
 #if TCG_TARGET_HAS_bswap32_i32
-        case INDEX_op_bswap32_i32:
-            t0 = *tb_ptr++;
-            t1 = tci_read_r32(regs, &tb_ptr);
-            tci_write_reg32(regs, t0, bswap32(t1));
-            break;
+    CASE(bswap32_i32):
+        t1 = tci_read_reg32(regs, insn->r[1]);
+        tci_write_reg32(regs, insn->r[0], bswap32(t1));
+        NEXT(insn + 1);
 #endif
 #if TCG_TARGET_HAS_not_i32
-        case INDEX_op_not_i32:
-            t0 = *tb_ptr++;
-            t1 = tci_read_r32(regs, &tb_ptr);
-            tci_write_reg32(regs, t0, ~t1);
-            break;
+    CASE(not_i32):
+        t1 = tci_read_reg32(regs, insn->r[1]);
+        tci_write_reg32(regs, insn->r[0], ~t1);
+        NEXT(insn + 1);
 #endif
 #if TCG_TARGET_HAS_neg_i32
-        case INDEX_op_neg_i32:
-            t0 = *tb_ptr++;
-            t1 = tci_read_r32(regs, &tb_ptr);
-            tci_write_reg32(regs, t0, -t1);
-            break;
+    CASE(neg_i32):
+        t1 = tci_read_reg32(regs, insn->r[1]);
+        tci_write_reg32(regs, insn->r[0], -t1);
+        NEXT(insn + 1);
 #endif
 #if TCG_TARGET_REG_BITS == 64
-        case INDEX_op_mov_i64:
-            t0 = *tb_ptr++;
-            t1 = tci_read_r64(regs, &tb_ptr);
-            tci_write_reg64(regs, t0, t1);
-            break;
-        case INDEX_op_tci_movi_i64:
-            t0 = *tb_ptr++;
-            t1 = tci_read_i64(&tb_ptr);
-            tci_write_reg64(regs, t0, t1);
-            break;
+    CASE(mov_i64):
+        tci_write_reg64(regs, insn->r[0], tci_read_reg64(regs, insn->r[1]));
+        NEXT(insn + 1);
+    CASE(tci_movi_i64):
+        tci_movi_i64(regs, insn);
+        NEXT(tci_next(insn, 1));
 
-            /* Load/store operations (64 bit). */
+        /* Load/store operations (64 bit). */
 
-        case INDEX_op_ld8u_i64:
-            t0 = *tb_ptr++;
-            t1 = tci_read_r(regs, &tb_ptr);
-            t2 = tci_read_s32(&tb_ptr);
-            tci_write_reg8(regs, t0, *(uint8_t *)(t1 + t2));
-            break;
-        case INDEX_op_ld8s_i64:
-            TODO();
-            break;
-        case INDEX_op_ld16u_i64:
-            t0 = *tb_ptr++;
-            t1 = tci_read_r(regs, &tb_ptr);
-            t2 = tci_read_s32(&tb_ptr);
-            tci_write_reg16(regs, t0, *(uint16_t *)(t1 + t2));
-            break;
-        case INDEX_op_ld16s_i64:
-            TODO();
-            break;
-        case INDEX_op_ld32u_i64:
-            t0 = *tb_ptr++;
-            t1 = tci_read_r(regs, &tb_ptr);
-            t2 = tci_read_s32(&tb_ptr);
-            tci_write_reg32(regs, t0, *(uint32_t *)(t1 + t2));
-            break;
-        case INDEX_op_ld32s_i64:
-            t0 = *tb_ptr++;
-            t1 = tci_read_r(regs, &tb_ptr);
-            t2 = tci_read_s32(&tb_ptr);
-            tci_write_reg32s(regs, t0, *(int32_t *)(t1 + t2));
-            break;
-        case INDEX_op_ld_i64:
-            t0 = *tb_ptr++;
-            t1 = tci_read_r(regs, &tb_ptr);
-            t2 = tci_read_s32(&tb_ptr);
-            tci_write_reg64(regs, t0, *(uint64_t *)(t1 + t2));
-            break;
-        case INDEX_op_st8_i64:
-            t0 = tci_read_r8(regs, &tb_ptr);
-            t1 = tci_read_r(regs, &tb_ptr);
-            t2 = tci_read_s32(&tb_ptr);
-            *(uint8_t *)(t1 + t2) = t0;
-            break;
-        case INDEX_op_st16_i64:
-            t0 = tci_read_r16(regs, &tb_ptr);
-            t1 = tci_read_r(regs, &tb_ptr);
-            t2 = tci_read_s32(&tb_ptr);
-            *(uint16_t *)(t1 + t2) = t0;
-            break;
-        case INDEX_op_st32_i64:
-            t0 = tci_read_r32(regs, &tb_ptr);
-            t1 = tci_read_r(regs, &tb_ptr);
-            t2 = tci_read_s32(&tb_ptr);
-            *(uint32_t *)(t1 + t2) = t0;
-            break;
-        case INDEX_op_st_i64:
-            t0 = tci_read_r64(regs, &tb_ptr);
-            t1 = tci_read_r(regs, &tb_ptr);
-            t2 = tci_read_s32(&tb_ptr);
-            tci_assert(t1 != sp_value || (int32_t)t2 < 0);
-            *(uint64_t *)(t1 + t2) = t0;
-            break;
+    CASE(ld8u_i64):
+        t1 = tci_read_reg(regs, insn->r[1]);
+        tci_write_reg8(regs, insn->r[0], *(uint8_t *)(t1 + insn->i));
+        NEXT(insn + 1);
+    CASE(ld16u_i64):
+        t1 = tci_read_reg(regs, insn->r[1]);
+        tci_write_reg16(regs, insn->r[0], *(uint16_t *)(t1 + insn->i));
+        NEXT(insn + 1);
+    CASE(ld32u_i64):
+        t1 = tci_read_reg(regs, insn->r[1]);
+        tci_write_reg32(regs, insn->r[0], *(uint32_t *)(t1 + insn->i));
+        NEXT(insn + 1);
+    CASE(ld32s_i64):
+        t1 = tci_read_reg(regs, insn->r[1]);
+        tci_write_reg32s(regs, insn->r[0], *(int32_t *)(t1 + insn->i));
+        NEXT(insn + 1);
+    CASE(ld_i64):
+        tci_ld_i64(regs, insn);
+        NEXT(insn + 1);
+    CASE(st8_i64):
+        t1 = tci_read_reg(regs, insn->r[1]);
+        *(uint8_t *)(t1 + insn->i) = tci_read_reg8(regs, insn->r[0]);
+        NEXT(insn + 1);
+    CASE(st16_i64):
+        t1 = tci_read_reg(regs, insn->r[1]);
+        *(uint16_t *)(t1 + insn->i) = tci_read_reg16(regs, insn->r[0]);
+        NEXT(insn + 1);
+    CASE(st32_i64):
+        t1 = tci_read_reg(regs, insn->r[1]);
+        *(uint32_t *)(t1 + insn->i) = tci_read_reg32(regs, insn->r[0]);
+        NEXT(insn + 1);
+    CASE(st_i64):
+        tci_st_i64(regs, insn);
+        NEXT(insn + 1);
 
-            /* Arithmetic operations (64 bit). */
+        /* Arithmetic operations (64 bit). */
 
-        case INDEX_op_add_i64:
-            t0 = *tb_ptr++;
-            t1 = tci_read_ri64(regs, &tb_ptr);
-            t2 = tci_read_ri64(regs, &tb_ptr);
-            tci_write_reg64(regs, t0, t1 + t2);
-            break;
-        case INDEX_op_sub_i64:
-            t0 = *tb_ptr++;
-            t1 = tci_read_ri64(regs, &tb_ptr);
-            t2 = tci_read_ri64(regs, &tb_ptr);
-            tci_write_reg64(regs, t0, t1 - t2);
-            break;
-        case INDEX_op_mul_i64:
-            t0 = *tb_ptr++;
-            t1 = tci_read_ri64(regs, &tb_ptr);
-            t2 = tci_read_ri64(regs, &tb_ptr);
-            tci_write_reg64(regs, t0, t1 * t2);
-            break;
-#if TCG_TARGET_HAS_div_i64
-        case INDEX_op_div_i64:
-        case INDEX_op_divu_i64:
-        case INDEX_op_rem_i64:
-        case INDEX_op_remu_i64:
-            TODO();
-            break;
-#elif TCG_TARGET_HAS_div2_i64
-        case INDEX_op_div2_i64:
-        case INDEX_op_divu2_i64:
-            TODO();
-            break;
-#endif
-        case INDEX_op_and_i64:
-            t0 = *tb_ptr++;
-            t1 = tci_read_ri64(regs, &tb_ptr);
-            t2 = tci_read_ri64(regs, &tb_ptr);
-            tci_write_reg64(regs, t0, t1 & t2);
-            break;
-        case INDEX_op_or_i64:
-            t0 = *tb_ptr++;
-            t1 = tci_read_ri64(regs, &tb_ptr);
-            t2 = tci_read_ri64(regs, &tb_ptr);
-            tci_write_reg64(regs, t0, t1 | t2);
-            break;
-        case INDEX_op_xor_i64:
-            t0 = *tb_ptr++;
-            t1 = tci_read_ri64(regs, &tb_ptr);
-            t2 = tci_read_ri64(regs, &tb_ptr);
-            tci_write_reg64(regs, t0, t1 ^ t2);
-            break;
+    CASE(add_i64):
+        t1 = tci_read_reg64(regs, insn->r[1]);
+        t2 = tci_read_reg64(regs, insn->r[2]);
+        tci_write_reg64(regs, insn->r[0], t1 + t2);
+        NEXT(insn + 1);
+    CASE(sub_i64):
+        t1 = tci_read_reg64(regs, insn->r[1]);
+        t2 = tci_read_reg64(regs, insn->r[2]);
+        tci_write_reg64(regs, insn->r[0], t1 - t2);
+        NEXT(insn + 1);
+    CASE(mul_i64):
+        t1 = tci_read_reg64(regs, insn->r[1]);
+        t2 = tci_read_reg64(regs, insn->r[2]);
+        tci_write_reg64(regs, insn->r[0], t1 * t2);
+        NEXT(insn + 1);
+    CASE(and_i64):
+        t1 = tci_read_reg64(regs, insn->r[1]);
+        t2 = tci_read_reg64(regs, insn->r[2]);
+        tci_write_reg64(regs, insn->r[0], t1 & t2);
+        NEXT(insn + 1);
+    CASE(or_i64):
+        t1 = tci_read_reg64(regs, insn->r[1]);
+        t2 = tci_read_reg64(regs, insn->r[2]);
+        tci_write_reg64(regs, insn->r[0], t1 | t2);
+        NEXT(insn + 1);
+    CASE(xor_i64):
+        t1 = tci_read_reg64(regs, insn->r[1]);
+        t2 = tci_read_reg64(regs, insn->r[2]);
+        tci_write_reg64(regs, insn->r[0], t1 ^ t2);
+        NEXT(insn + 1);
 
-            /* Shift/rotate operations (64 bit). */
+        /* Shift/rotate operations (64 bit). */
 
-        case INDEX_op_shl_i64:
-            t0 = *tb_ptr++;
-            t1 = tci_read_ri64(regs, &tb_ptr);
-            t2 = tci_read_ri64(regs, &tb_ptr);
-            tci_write_reg64(regs, t0, t1 << (t2 & 63));
-            break;
-        case INDEX_op_shr_i64:
-            t0 = *tb_ptr++;
-            t1 = tci_read_ri64(regs, &tb_ptr);
-            t2 = tci_read_ri64(regs, &tb_ptr);
-            tci_write_reg64(regs, t0, t1 >> (t2 & 63));
-            break;
-        case INDEX_op_sar_i64:
-            t0 = *tb_ptr++;
-            t1 = tci_read_ri64(regs, &tb_ptr);
-            t2 = tci_read_ri64(regs, &tb_ptr);
-            tci_write_reg64(regs, t0, ((int64_t)t1 >> (t2 & 63)));
-            break;
+    CASE(shl_i64):
+        t1 = tci_read_reg64(regs, insn->r[1]);
+        t2 = tci_read_reg64(regs, insn->r[2]);
+        tci_write_reg64(regs, insn->r[0], t1 << (t2 & 63));
+        NEXT(insn + 1);
+    CASE(shr_i64):
+        t1 = tci_read_reg64(regs, insn->r[1]);
+        t2 = tci_read_reg64(regs, insn->r[2]);
+        tci_write_reg64(regs, insn->r[0], t1 >> (t2 & 63));
+        NEXT(insn + 1);
+    CASE(sar_i64):
+        t1 = tci_read_reg64(regs, insn->r[1]);
+        t2 = tci_read_reg64(regs, insn->r[2]);
+        tci_write_reg64(regs, insn->r[0], ((int64_t)t1 >> (t2 & 63)));
+        NEXT(insn + 1);
 #if TCG_TARGET_HAS_rot_i64
-        case INDEX_op_rotl_i64:
-            t0 = *tb_ptr++;
-            t1 = tci_read_ri64(regs, &tb_ptr);
-            t2 = tci_read_ri64(regs, &tb_ptr);
-            tci_write_reg64(regs, t0, rol64(t1, t2 & 63));
-            break;
-        case INDEX_op_rotr_i64:
-            t0 = *tb_ptr++;
-            t1 = tci_read_ri64(regs, &tb_ptr);
-            t2 = tci_read_ri64(regs, &tb_ptr);
-            tci_write_reg64(regs, t0, ror64(t1, t2 & 63));
-            break;
+    CASE(rotl_i64):
+        t1 = tci_read_reg64(regs, insn->r[1]);
+        t2 = tci_read_reg64(regs, insn->r[2]);
+        tci_write_reg64(regs, insn->r[0], rol64(t1, t2 & 63));
+        NEXT(insn + 1);
+    CASE(rotr_i64):
+        t1 = tci_read_reg64(regs, insn->r[1]);
+        t2 = tci_read_reg64(regs, insn->r[2]);
+        tci_write_reg64(regs, insn->r[0], ror64(t1, t2 & 63));
+        NEXT(insn + 1);
 #endif
 #if TCG_TARGET_HAS_deposit_i64
-        case INDEX_op_deposit_i64:
-            t0 = *tb_ptr++;
-            t1 = tci_read_r64(regs, &tb_ptr);
-            t2 = tci_read_r64(regs, &tb_ptr);
-            tmp16 = *tb_ptr++;
-            tmp8 = *tb_ptr++;
-            tmp64 = (((1ULL << tmp8) - 1) << tmp16);
-            tci_write_reg64(regs, t0, (t1 & ~tmp64) | ((t2 << tmp16) & tmp64));
-            break;
+    CASE(deposit_i64):
+        t1 = tci_read_reg64(regs, insn->r[1]);
+        t2 = tci_read_reg64(regs, insn->r[2]);
+        tmp64 = (((1ULL << insn->i) - 1) << insn->r[3]);
+        tci_write_reg64(regs, insn->r[0],
+                        (t1 & ~tmp64) | ((t2 << insn->r[3]) & tmp64));
+        NEXT(insn + 1);
 #endif
-        case INDEX_op_brcond_i64:
-            t0 = tci_read_r64(regs, &tb_ptr);
-            t1 = tci_read_ri64(regs, &tb_ptr);
-            condition = *tb_ptr++;
-            label = tci_read_label(&tb_ptr);
-            if (tci_compare64(t0, t1, condition)) {
-                tci_assert(tb_ptr == old_code_ptr + op_size);
-                tb_ptr = (uint8_t *)label;
-                continue;
-            }
-            break;
+
+        /* Operations with an immediate operand (64 bit). */
+
+    CASE(tci_addi_i64):
+        tci_addi_i64(regs, insn);
+        NEXT(tci_next(insn, 1));
+    CASE(tci_andi_i64):
+        t1 = tci_read_reg64(regs, insn->r[1]);
+        tci_write_reg64(regs, insn->r[0], t1 & tci_word(insn, 0));
+        NEXT(tci_next(insn, 1));
+    CASE(tci_ori_i64):
+        t1 = tci_read_reg64(regs, insn->r[1]);
+        tci_write_reg64(regs, insn->r[0], t1 | tci_word(insn, 0));
+        NEXT(tci_next(insn, 1));
+    CASE(tci_xori_i64):
+        t1 = tci_read_reg64(regs, insn->r[1]);
+        tci_write_reg64(regs, insn->r[0], t1 ^ tci_word(insn, 0));
+        NEXT(tci_next(insn, 1));
+    CASE(tci_shli_i64):
+        t1 = tci_read_reg64(regs, insn->r[1]);
+        tci_write_reg64(regs, insn->r[0], t1 << (tci_word(insn, 0) & 63));
+        NEXT(tci_next(insn, 1));
+    CASE(tci_shri_i64):
+        t1 = tci_read_reg64(regs, insn->r[1]);
+        tci_write_reg64(regs, insn->r[0], t1 >> (tci_word(insn, 0) & 63));
+        NEXT(tci_next(insn, 1));
+    CASE(tci_sari_i64):
+        t1 = tci_read_reg64(regs, insn->r[1]);
+        tci_write_reg64(regs, insn->r[0],
+                        (int64_t)t1 >> (tci_word(insn, 0) & 63));
+        NEXT(tci_next(insn, 1));
+
+    CASE(brcond_i64):
+        t0 = tci_read_reg64(regs, insn->r[0]);
+        t1 = tci_read_reg64(regs, insn->r[1]);
+        if (tci_compare64(t0, t1, insn->r[2])) {
+            NEXT((const TCIInsn *)tci_word(insn, 0));
+        }
+        NEXT(tci_next(insn, 1));
+    CASE(tci_brcondi_i64):
+        t0 = tci_read_reg64(regs, insn->r[0]);
+        if (tci_compare64(t0, tci_word(insn, 0), insn->r[2])) {
+            NEXT((const TCIInsn *)tci_word(insn, 1));
+        }
+        NEXT(tci_next(insn, 2));
 #if TCG_TARGET_HAS_ext8u_i64
-        case INDEX_op_ext8u_i64:
-            t0 = *tb_ptr++;
-            t1 = tci_read_r8(regs, &tb_ptr);
-            tci_write_reg64(regs, t0, t1);
-            break;
+    CASE(ext8u_i64):
+        t1 = tci_read_reg8(regs, insn->r[1]);
+        tci_write_reg64(regs, insn->r[0], t1);
+        NEXT(insn + 1);
 #endif
 #if TCG_TARGET_HAS_ext8s_i64
-        case INDEX_op_ext8s_i64:
-            t0 = *tb_ptr++;
-            t1 = tci_read_r8s(regs, &tb_ptr);
-            tci_write_reg64(regs, t0, t1);
-            break;
+    CASE(ext8s_i64):
+        t1 = tci_read_reg8s(regs, insn->r[1]);
+        tci_write_reg64(regs, insn->r[0], t1);
+        NEXT(insn + 1);
 #endif
 #if TCG_TARGET_HAS_ext16s_i64
-        case INDEX_op_ext16s_i64:
-            t0 = *tb_ptr++;
-            t1 = tci_read_r16s(regs, &tb_ptr);
-            tci_write_reg64(regs, t0, t1);
-            break;
+    CASE(ext16s_i64):
+        t1 = tci_read_reg16s(regs, insn->r[1]);
+        tci_write_reg64(regs, insn->r[0], t1);
+        NEXT(insn + 1);
 #endif
 #if TCG_TARGET_HAS_ext16u_i64
-        case INDEX_op_ext16u_i64:
-            t0 = *tb_ptr++;
-            t1 = tci_read_r16(regs, &tb_ptr);
-            tci_write_reg64(regs, t0, t1);
-            break;
+    CASE(ext16u_i64):
+        t1 = tci_read_reg16(regs, insn->r[1]);
+        tci_write_reg64(regs, insn->r[0], t1);
+        NEXT(insn + 1);
 #endif
 #if TCG_TARGET_HAS_ext32s_i64
-        case INDEX_op_ext32s_i64:
+    CASE(ext32s_i64):
 #endif
-        case INDEX_op_ext_i32_i64:
-            t0 = *tb_ptr++;
-            t1 = tci_read_r32s(regs, &tb_ptr);
-            tci_write_reg64(regs, t0, t1);
-            break;
+    CASE(ext_i32_i64):
+        t1 = tci_read_reg32s(regs, insn->r[1]);
+        tci_write_reg64(regs, insn->r[0], t1);
+        NEXT(insn + 1);
 #if TCG_TARGET_HAS_ext32u_i64
-        case INDEX_op_ext32u_i64:
+    CASE(ext32u_i64):
 #endif
-        case INDEX_op_extu_i32_i64:
-            t0 = *tb_ptr++;
-            t1 = tci_read_r32(regs, &tb_ptr);
-            tci_write_reg64(regs, t0, t1);
-            break;
+    CASE(extu_i32_i64):
+        t1 = tci_read_reg32(regs, insn->r[1]);
+        tci_write_reg64(regs, insn->r[0], t1);
+        NEXT(insn + 1);
 #if TCG_TARGET_HAS_bswap16_i64
-        case INDEX_op_bswap16_i64:
-            t0 = *tb_ptr++;
-            t1 = tci_read_r16(regs, &tb_ptr);
-            tci_write_reg64(regs, t0, bswap16(t1));
-            break;
+    CASE(bswap16_i64):
+        t1 = tci_read_reg16(regs, insn->r[1]);
+        tci_write_reg64(regs, insn->r[0], bswap16(t1));
+        NEXT(insn + 1);
 #endif
 #if TCG_TARGET_HAS_bswap32_i64
-        case INDEX_op_bswap32_i64:
-            t0 = *tb_ptr++;
-            t1 = tci_read_r32(regs, &tb_ptr);
-            tci_write_reg64(regs, t0, bswap32(t1));
-            break;
+    CASE(bswap32_i64):
+        t1 = tci_read_reg32(regs, insn->r[1]);
+        tci_write_reg64(regs, insn->r[0], bswap32(t1));
+        NEXT(insn + 1);
 #endif
 #if TCG_TARGET_HAS_bswap64_i64
-        case INDEX_op_bswap64_i64:
-            t0 = *tb_ptr++;
-            t1 = tci_read_r64(regs, &tb_ptr);
-            tci_write_reg64(regs, t0, bswap64(t1));
-            break;
+    CASE(bswap64_i64):
+        t1 = tci_read_reg64(regs, insn->r[1]);
+        tci_write_reg64(regs, insn->r[0], bswap64(t1));
+        NEXT(insn + 1);
 #endif
 #if TCG_TARGET_HAS_not_i64
-        case INDEX_op_not_i64:
-            t0 = *tb_ptr++;
-            t1 = tci_read_r64(regs, &tb_ptr);
-            tci_write_reg64(regs, t0, ~t1);
-            break;
+    CASE(not_i64):
+        t1 = tci_read_reg64(regs, insn->r[1]);
+        tci_write_reg64(regs, insn->r[0], ~t1);
+        NEXT(insn + 1);
 #endif
 #if TCG_TARGET_HAS_neg_i64
-        case INDEX_op_neg_i64:
-            t0 = *tb_ptr++;
-            t1 = tci_read_r64(regs, &tb_ptr);
-            tci_write_reg64(regs, t0, -t1);
-            break;
+    CASE(neg_i64):
+        t1 = tci_read_reg64(regs, insn->r[1]);
+        tci_write_reg64(regs, insn->r[0], -t1);
+        NEXT(insn + 1);
 #endif
 #endif /* TCG_TARGET_REG_BITS == 64 */
 
             /* QEMU specific operations. */
 
-        case INDEX_op_exit_tb:
-            ret = *(uint64_t *)tb_ptr;
-            goto exit;
+    CASE(exit_tb):
+        return tci_word(insn, 0);
+    CASE(goto_tb):
+        /* The displacement is patched atomically by tb_set_jmp_target. */
+        NEXT((const TCIInsn *)((const uint8_t *)(insn + 1)
+                               + qatomic_read(&insn->i)));
+    CASE(qemu_ld_i32):
+        taddr = tci_read_addr(regs, insn, 1);
+        oi = insn->i;
+        switch (get_memop(oi) & (MO_BSWAP | MO_SSIZE)) {
+        case MO_UB:
+            tmp32 = qemu_ld_ub;
+            break;
+        case MO_SB:
+            tmp32 = (int8_t)qemu_ld_ub;
+            break;
+        case MO_LEUW:
+            tmp32 = qemu_ld_leuw;
+            break;
+        case MO_LESW:
+            tmp32 = (int16_t)qemu_ld_leuw;
+            break;
+        case MO_LEUL:
+            tmp32 = qemu_ld_leul;
+            break;
+        case MO_BEUW:
+            tmp32 = qemu_ld_beuw;
+            break;
+        case MO_BESW:
+            tmp32 = (int16_t)qemu_ld_beuw;
+            break;
+        case MO_BEUL:
+            tmp32 = qemu_ld_beul;
+            break;
+        default:
+            tcg_abort();
+        }
+        tci_write_reg(regs, insn->r[0], tmp32);
+        NEXT(insn + 1);
+    CASE(qemu_ld_i64):
+        taddr = tci_read_addr(regs, insn, TCG_TARGET_REG_BITS == 32 ? 2 : 1);
+        oi = insn->i;
+        switch (get_memop(oi) & (MO_BSWAP | MO_SSIZE)) {
+        case MO_UB:
+            tmp64 = qemu_ld_ub;
+            break;
+        case MO_SB:
+            tmp64 = (int8_t)qemu_ld_ub;
+            break;
+        case MO_LEUW:
+            tmp64 = qemu_ld_leuw;
             break;
-        case INDEX_op_goto_tb:
-            /* Jump address is aligned */
-            tb_ptr = QEMU_ALIGN_PTR_UP(tb_ptr, 4);
-            t0 = qatomic_read((int32_t *)tb_ptr);
-            tb_ptr += sizeof(int32_t);
-            tci_assert(tb_ptr == old_code_ptr + op_size);
-            tb_ptr += (int32_t)t0;
-            continue;
-        case INDEX_op_qemu_ld_i32:
-            t0 = *tb_ptr++;
-            taddr = tci_read_ulong(regs, &tb_ptr);
-            oi = tci_read_i(&tb_ptr);
-            switch (get_memop(oi) & (MO_BSWAP | MO_SSIZE)) {
-            case MO_UB:
-                tmp32 = qemu_ld_ub;
-                break;
-            case MO_SB:
-                tmp32 = (int8_t)qemu_ld_ub;
-                break;
-            case MO_LEUW:
-                tmp32 = qemu_ld_leuw;
-                break;
-            case MO_LESW:
-                tmp32 = (int16_t)qemu_ld_leuw;
-                break;
-            case MO_LEUL:
-                tmp32 = qemu_ld_leul;
-                break;
-            case MO_BEUW:
-                tmp32 = qemu_ld_beuw;
-                break;
-            case MO_BESW:
-                tmp32 = (int16_t)qemu_ld_beuw;
-                break;
-            case MO_BEUL:
-                tmp32 = qemu_ld_beul;
-                break;
-            default:
-                tcg_abort();
-            }
-            tci_write_reg(regs, t0, tmp32);
+        case MO_LESW:
+            tmp64 = (int16_t)qemu_ld_leuw;
             break;
-        case INDEX_op_qemu_ld_i64:
-            t0 = *tb_ptr++;
-            if (TCG_TARGET_REG_BITS == 32) {
-                t1 = *tb_ptr++;
-            }
-            taddr = tci_read_ulong(regs, &tb_ptr);
-            oi = tci_read_i(&tb_ptr);
-            switch (get_memop(oi) & (MO_BSWAP | MO_SSIZE)) {
-            case MO_UB:
-                tmp64 = qemu_ld_ub;
-                break;
-            case MO_SB:
-                tmp64 = (int8_t)qemu_ld_ub;
-                break;
-            case MO_LEUW:
-                tmp64 = qemu_ld_leuw;
-                break;
-            case MO_LESW:
-                tmp64 = (int16_t)qemu_ld_leuw;
-                break;
-            case MO_LEUL:
-                tmp64 = qemu_ld_leul;
-                break;
-            case MO_LESL:
-                tmp64 = (int32_t)qemu_ld_leul;
-                break;
-            case MO_LEQ:
-                tmp64 = qemu_ld_leq;
-                break;
-            case MO_BEUW:
-                tmp64 = qemu_ld_beuw;
-                break;
-            case MO_BESW:
-                tmp64 = (int16_t)qemu_ld_beuw;
-                break;
-            case MO_BEUL:
-                tmp64 = qemu_ld_beul;
-                break;
-            case MO_BESL:
-                tmp64 = (int32_t)qemu_ld_beul;
-                break;
-            case MO_BEQ:
-                tmp64 = qemu_ld_beq;
-                break;
-            default:
-                tcg_abort();
-            }
-            tci_write_reg(regs, t0, tmp64);
-            if (TCG_TARGET_REG_BITS == 32) {
-                tci_write_reg(regs, t1, tmp64 >> 32);
-            }
+        case MO_LEUL:
+            tmp64 = qemu_ld_leul;
             break;
-        case INDEX_op_qemu_st_i32:
-            t0 = tci_read_r(regs, &tb_ptr);
-            taddr = tci_read_ulong(regs, &tb_ptr);
-            oi = tci_read_i(&tb_ptr);
-            switch (get_memop(oi) & (MO_BSWAP | MO_SIZE)) {
-            case MO_UB:
-                qemu_st_b(t0);
-                break;
-            case MO_LEUW:
-                qemu_st_lew(t0);
-                break;
-            case MO_LEUL:
-                qemu_st_lel(t0);
-                break;
-            case MO_BEUW:
-                qemu_st_bew(t0);
-                break;
-            case MO_BEUL:
-                qemu_st_bel(t0);
-                break;
-            default:
-                tcg_abort();
-            }
+        case MO_LESL:
+            tmp64 = (int32_t)qemu_ld_leul;
             break;
-        case INDEX_op_qemu_st_i64:
-            tmp64 = tci_read_r64(regs, &tb_ptr);
-            taddr = tci_read_ulong(regs, &tb_ptr);
-            oi = tci_read_i(&tb_ptr);
-            switch (get_memop(oi) & (MO_BSWAP | MO_SIZE)) {
-            case MO_UB:
-                qemu_st_b(tmp64);
-                break;
-            case MO_LEUW:
-                qemu_st_lew(tmp64);
-                break;
-            case MO_LEUL:
-                qemu_st_lel(tmp64);
-                break;
-            case MO_LEQ:
-                qemu_st_leq(tmp64);
-                break;
-            case MO_BEUW:
-                qemu_st_bew(tmp64);
-                break;
-            case MO_BEUL:
-                qemu_st_bel(tmp64);
-                break;
-            case MO_BEQ:
-                qemu_st_beq(tmp64);
-                break;
-            default:
-                tcg_abort();
-            }
+        case MO_LEQ:
+            tmp64 = qemu_ld_leq;
             break;
-        case INDEX_op_mb:
-            /* Ensure ordering for all kinds */
-            smp_mb();
+        case MO_BEUW:
+            tmp64 = qemu_ld_beuw;
+            break;
+        case MO_BESW:
+            tmp64 = (int16_t)qemu_ld_beuw;
+            break;
+        case MO_BEUL:
+            tmp64 = qemu_ld_beul;
+            break;
+        case MO_BESL:
+            tmp64 = (int32_t)qemu_ld_beul;
+            break;
+        case MO_BEQ:
+            tmp64 = qemu_ld_beq;
             break;
         default:
-            TODO();
+            tcg_abort();
+        }
+        tci_write_reg(regs, insn->r[0], tmp64);
+        if (TCG_TARGET_REG_BITS == 32) {
+            tci_write_reg(regs, insn->r[1], tmp64 >> 32);
+        }
+        NEXT(insn + 1);
+    CASE(qemu_st_i32):
+        t0 = tci_read_reg(regs, insn->r[0]);
+        taddr = tci_read_addr(regs, insn, 1);
+        oi = insn->i;
+        switch (get_memop(oi) & (MO_BSWAP | MO_SIZE)) {
+        case MO_UB:
+            qemu_st_b(t0);
             break;
+        case MO_LEUW:
+            qemu_st_lew(t0);
+            break;
+        case MO_LEUL:
+            qemu_st_lel(t0);
+            break;
+        case MO_BEUW:
+            qemu_st_bew(t0);
+            break;
+        case MO_BEUL:
+            qemu_st_bel(t0);
+            break;
+        default:
+            tcg_abort();
         }
-        tci_assert(tb_ptr == old_code_ptr + op_size);
+        NEXT(insn + 1);
+    CASE(qemu_st_i64):
+#if TCG_TARGET_REG_BITS == 32
+        tmp64 = tci_uint64(tci_read_reg32(regs, insn->r[1]),
+                           tci_read_reg32(regs, insn->r[0]));
+        taddr = tci_read_addr(regs, insn, 2);
+#else
+        tmp64 = tci_read_reg64(regs, insn->r[0]);
+        taddr = tci_read_addr(regs, insn, 1);
+#endif
+        oi = insn->i;
+        switch (get_memop(oi) & (MO_BSWAP | MO_SIZE)) {
+        case MO_UB:
+            qemu_st_b(tmp64);
+            break;
+        case MO_LEUW:
+            qemu_st_lew(tmp64);
+            break;
+        case MO_LEUL:
+            qemu_st_lel(tmp64);
+            break;
+        case MO_LEQ:
+            qemu_st_leq(tmp64);
+            break;
+        case MO_BEUW:
+            qemu_st_bew(tmp64);
+            break;
+        case MO_BEUL:
+            qemu_st_bel(tmp64);
+            break;
+        case MO_BEQ:
+            qemu_st_beq(tmp64);
+            break;
+        default:
+            tcg_abort();
+        }
+        NEXT(insn + 1);
+    CASE(mb):
+        /* Ensure ordering for all kinds */
+        smp_mb();
+        NEXT(insn + 1);
+
+        /*
+         * Superinstructions.  Each executes its first part and continues
+         * directly with the handler of the next one, which still has its
+         * own dispatch word in case it is the target of a branch.
+         */
+
+    CASE(tci_ld_brcondi_i32):
+        tci_ld_i32(regs, insn);
+        CHAIN(tci_brcondi_i32, insn + 1);
+    CASE(tci_setcond_brcondi_i32):
+        tci_setcond_i32(regs, insn);
+        CHAIN(tci_brcondi_i32, insn + 1);
+    CASE(tci_movi_st_i32):
+        tci_movi_i32(regs, insn);
+        CHAIN(st_i32, insn + 1);
+    CASE(tci_ld_addi_st_i32):
+        tci_ld_i32(regs, insn);
+        tci_addi_i32(regs, insn + 1);
+        CHAIN(st_i32, insn + 2);
+#if TCG_TARGET_REG_BITS == 64
+    CASE(tci_movi32_st_i64):
+        tci_movi_i32(regs, insn);
+        CHAIN(st_i64, insn + 1);
+    CASE(tci_movi_st_i64):
+        tci_movi_i64(regs, insn);
+        CHAIN(st_i64, tci_next(insn, 1));
+    CASE(tci_ld_addi_st_i64):
+        tci_ld_i64(regs, insn);
+        tci_addi_i64(regs, insn + 1);
+        CHAIN(st_i64, tci_next(insn + 1, 1));
+#endif
+
+    CASE_DEFAULT:
+        TODO();
+    }
+    g_assert_not_reached();
+}
+
+uintptr_t tci_dispatch_word(int opc)
+{
+#ifdef TCI_THREADED
+    if (unlikely(!tci_handlers[0])) {
+        tcg_qemu_tb_exec(NULL, NULL);
     }
-exit:
-    return ret;
+    return (uintptr_t)tci_handlers[opc];
+#else
+    return opc;
+#endif
+}
+
+int tci_dispatch_opc(uintptr_t op)
+{
+#ifdef TCI_THREADED
+    int opc;
+
+    for (opc = 0; opc < NB_OPS; opc++) {
+        if (op == (uintptr_t)tci_handlers[opc]) {
+            return opc;
+        }
+    }
+    return NB_OPS;
+#else
+    return op;
+#endif
 }
@@ -177,8 +177,6 @@ typedef enum {
     TCG_REG_R31,
 #endif
 #endif
-    /* Special value UINT8_MAX is used by TCI to encode constant values. */
-    TCG_CONST = UINT8_MAX
 } TCGReg;
 
 #define TCG_AREG0                       (TCG_TARGET_NB_REGS - 2)
@@ -190,6 +188,30 @@ typedef enum {
 
 void tci_disas(uint8_t opc);
 
+/*
+ * The bytecode is a sequence of fixed-width instructions.  The first
+ * word holds the TCGOpcode while the TB is being generated; once it is
+ * complete, tcg_out_tb_finalize replaces it with the dispatch word the
+ * interpreter wants, i.e. the address of the opcode's handler when the
+ * interpreter is threaded.  Registers and small constants live in the
+ * fixed fields.  Labels, call targets, exit_tb values and 64-bit
+ * immediates follow the instruction as tcg_target_ulong words.
+ *
+ * The displacement of goto_tb is the last field, so that the jump is
+ * relative to the next instruction.
+ */
+typedef struct TCIInsn {
+    uintptr_t op;
+    uint8_t r[4];
+    int32_t i;
+} TCIInsn;
+
+uintptr_t tci_dispatch_word(int opc);
+int tci_dispatch_opc(uintptr_t op);
+int tci_insn_size(int opc);
+
+#define TCG_TARGET_NEED_TB_FINALIZE
+
 #define HAVE_TCG_QEMU_TB_EXEC
 
 /* We could notice __i386__ or __s390x__ and reduce the barriers depending
@@ -0,0 +1,84 @@
+/*
+ * Internet checksum speed benchmark
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or
+ * (at your option) any later version.  See the COPYING file in the
+ * top-level directory.
+ */
+#include "qemu/osdep.h"
+#include "qemu/units.h"
+#include "qemu/iov.h"
+#include "net/checksum.h"
+
+typedef struct ChecksumOpts {
+    size_t chunk_size;
+    unsigned int iov_cnt;
+} ChecksumOpts;
+
+static void test_checksum_speed(const void *opaque)
+{
+    const ChecksumOpts *opts = opaque;
+    const size_t total = 1 * GiB;
+    struct iovec *iov;
+    uint8_t *in;
+    size_t remain, seg, i;
+    uint32_t sum = 0;
+
+    in = g_malloc(opts->chunk_size);
+    for (i = 0; i < opts->chunk_size; i++) {
+        in[i] = g_test_rand_int();
+    }
+
+    /* Odd-sized segments exercise the byte-swapped continuation path.  */
+    iov = g_new(struct iovec, opts->iov_cnt);
+    seg = opts->chunk_size / opts->iov_cnt | 1;
+    for (i = 0; i < opts->iov_cnt; i++) {
+        iov[i].iov_base = in + i * seg;
+        iov[i].iov_len = i + 1 < opts->iov_cnt ?
+                         seg : opts->chunk_size - i * seg;
+    }
+
+    g_test_timer_start();
+    for (remain = total; remain >= opts->chunk_size;
+         remain -= opts->chunk_size) {
+        if (opts->iov_cnt == 1) {
+            sum += net_checksum_add(opts->chunk_size, in);
+        } else {
+            sum += net_checksum_add_iov(iov, opts->iov_cnt, 0,
+                                        opts->chunk_size, 0);
+        }
+    }
+    g_test_timer_elapsed();
+
+    g_test_message("checksum: chunk %zu bytes, %u iovecs, %.2f MB/sec "
+                   "(sum %04x)", opts->chunk_size, opts->iov_cnt,
+                   (double)(total - remain) / MiB / g_test_timer_last(),
+                   net_checksum_finish(sum));
+
+    g_free(iov);
+    g_free(in);
+}
+
+int main(int argc, char **argv)
+{
+    static const size_t sizes[] = { 64, 576, 1500, 9000, 65536 };
+    static const unsigned int iov_cnts[] = { 1, 4 };
+    size_t i, j;
+
+    g_test_init(&argc, &argv, NULL);
+
+    for (i = 0; i < ARRAY_SIZE(sizes); i++) {
+        for (j = 0; j < ARRAY_SIZE(iov_cnts); j++) {
+            ChecksumOpts *opts = g_new(ChecksumOpts, 1);
+            g_autofree char *name = NULL;
+
+            opts->chunk_size = sizes[i];
+            opts->iov_cnt = iov_cnts[j];
+            name = g_strdup_printf("/net/benchmark/checksum/bufsize-%zu/iov-%u",
+                                   sizes[i], iov_cnts[j]);
+            g_test_add_data_func_full(name, opts, test_checksum_speed, g_free);
+        }
+    }
+
+    return g_test_run();
+}
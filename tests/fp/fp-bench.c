@@ -33,6 +33,9 @@ enum op {
     OP_FMA,
     OP_SQRT,
     OP_CMP,
+    OP_ROUND,
+    OP_TO_INT,
+    OP_FROM_INT,
     OP_MAX_NR,
 };
 
@@ -44,14 +47,19 @@ static const char * const op_names[] = {
     [OP_FMA] = "mulAdd",
     [OP_SQRT] = "sqrt",
     [OP_CMP] = "cmp",
+    [OP_ROUND] = "roundToInt",
+    [OP_TO_INT] = "toInt",
+    [OP_FROM_INT] = "fromInt",
     [OP_MAX_NR] = NULL,
 };
 
 enum precision {
     PREC_SINGLE,
     PREC_DOUBLE,
+    PREC_EXTENDED,
     PREC_FLOAT32,
     PREC_FLOAT64,
+    PREC_FLOATX80,
     PREC_MAX_NR,
 };
 
@@ -87,8 +95,10 @@ static const char * const tester_names[] = {
 union fp {
     float f;
     double d;
+    long double ld;
     float32 f32;
     float64 f64;
+    floatx80 fx80;
     uint64_t u64;
 };
 
@@ -151,7 +161,9 @@ static void update_random_ops(int n_ops, enum precision prec)
             } while (!float32_is_normal(r));
             break;
         case PREC_DOUBLE:
+        case PREC_EXTENDED:
         case PREC_FLOAT64:
+        case PREC_FLOATX80:
             do {
                 r = xorshift64star(r);
             } while (!float64_is_normal(r));
@@ -163,12 +175,50 @@ static void update_random_ops(int n_ops, enum precision prec)
     }
 }
 
+/*
+ * Conversions to integer only take the fast path for inputs that fit in
+ * the destination, so keep those operands in the int32 range, with a
+ * fractional part so that rounding has something to do.
+ */
+static double int_range_op(uint64_t r)
+{
+    return (int32_t)r / 16.0;
+}
+
 static void fill_random(union fp *ops, int n_ops, enum precision prec,
-                        bool no_neg)
+                        enum op op, bool no_neg)
 {
     int i;
 
     for (i = 0; i < n_ops; i++) {
+        if (op == OP_FROM_INT) {
+            ops[i].u64 = random_ops[i];
+            continue;
+        }
+        if (op == OP_ROUND || op == OP_TO_INT) {
+            double d = int_range_op(random_ops[i]);
+
+            switch (prec) {
+            case PREC_SINGLE:
+            case PREC_FLOAT32:
+                ops[i].f = d;
+                break;
+            case PREC_DOUBLE:
+            case PREC_FLOAT64:
+                ops[i].d = d;
+                break;
+            case PREC_EXTENDED:
+                ops[i].ld = d;
+                break;
+            case PREC_FLOATX80:
+                ops[i].d = d;
+                ops[i].fx80 = float64_to_floatx80(ops[i].f64, &soft_status);
+                break;
+            default:
+                g_assert_not_reached();
+            }
+            continue;
+        }
         switch (prec) {
         case PREC_SINGLE:
         case PREC_FLOAT32:
@@ -184,6 +234,20 @@ static void fill_random(union fp *ops, int n_ops, enum precision prec,
                 ops[i].f64 = float64_chs(ops[i].f64);
             }
             break;
+        case PREC_EXTENDED:
+            ops[i].u64 = random_ops[i];
+            if (no_neg && ops[i].d < 0) {
+                ops[i].d = -ops[i].d;
+            }
+            ops[i].ld = ops[i].d;
+            break;
+        case PREC_FLOATX80:
+            ops[i].fx80 = float64_to_floatx80(make_float64(random_ops[i]),
+                                              &soft_status);
+            if (no_neg && floatx80_is_neg(ops[i].fx80)) {
+                ops[i].fx80 = floatx80_chs(ops[i].fx80);
+            }
+            break;
         default:
             g_assert_not_reached();
         }
@@ -206,7 +270,7 @@ static void bench(enum precision prec, enum op op, int n_ops, bool no_neg)
         update_random_ops(n_ops, prec);
         switch (prec) {
         case PREC_SINGLE:
-            fill_random(ops, n_ops, prec, no_neg);
+            fill_random(ops, n_ops, prec, op, no_neg);
             t0 = get_clock();
             for (i = 0; i < OPS_PER_ITER; i++) {
                 float a = ops[0].f;
@@ -235,13 +299,22 @@ static void bench(enum precision prec, enum op op, int n_ops, bool no_neg)
                 case OP_CMP:
                     res.u64 = isgreater(a, b);
                     break;
+                case OP_ROUND:
+                    res.f = rintf(a);
+                    break;
+                case OP_TO_INT:
+                    res.u64 = lrintf(a);
+                    break;
+                case OP_FROM_INT:
+                    res.f = (int32_t)ops[0].u64;
+                    break;
                 default:
                     g_assert_not_reached();
                 }
             }
             break;
         case PREC_DOUBLE:
-            fill_random(ops, n_ops, prec, no_neg);
+            fill_random(ops, n_ops, prec, op, no_neg);
             t0 = get_clock();
             for (i = 0; i < OPS_PER_ITER; i++) {
                 double a = ops[0].d;
@@ -270,13 +343,66 @@ static void bench(enum precision prec, enum op op, int n_ops, bool no_neg)
                 case OP_CMP:
                     res.u64 = isgreater(a, b);
                     break;
+                case OP_ROUND:
+                    res.d = rint(a);
+                    break;
+                case OP_TO_INT:
+                    res.u64 = llrint(a);
+                    break;
+                case OP_FROM_INT:
+                    res.d = (int64_t)ops[0].u64;
+                    break;
+                default:
+                    g_assert_not_reached();
+                }
+            }
+            break;
+        case PREC_EXTENDED:
+            fill_random(ops, n_ops, prec, op, no_neg);
+            t0 = get_clock();
+            for (i = 0; i < OPS_PER_ITER; i++) {
+                long double a = ops[0].ld;
+                long double b = ops[1].ld;
+                long double c = ops[2].ld;
+
+                switch (op) {
+                case OP_ADD:
+                    res.ld = a + b;
+                    break;
+                case OP_SUB:
+                    res.ld = a - b;
+                    break;
+                case OP_MUL:
+                    res.ld = a * b;
+                    break;
+                case OP_DIV:
+                    res.ld = a / b;
+                    break;
+                case OP_FMA:
+                    res.ld = fmal(a, b, c);
+                    break;
+                case OP_SQRT:
+                    res.ld = sqrtl(a);
+                    break;
+                case OP_CMP:
+                    res.u64 = isgreater(a, b);
+                    break;
+                case OP_ROUND:
+                    res.ld = rintl(a);
+                    break;
+                case OP_TO_INT:
+                    res.u64 = llrintl(a);
+                    break;
+                case OP_FROM_INT:
+                    res.ld = (int64_t)ops[0].u64;
+                    break;
                 default:
                     g_assert_not_reached();
                 }
             }
             break;
         case PREC_FLOAT32:
-            fill_random(ops, n_ops, prec, no_neg);
+            fill_random(ops, n_ops, prec, op, no_neg);
             t0 = get_clock();
             for (i = 0; i < OPS_PER_ITER; i++) {
                 float32 a = ops[0].f32;
@@ -305,13 +431,22 @@ static void bench(enum precision prec, enum op op, int n_ops, bool no_neg)
                 case OP_CMP:
                     res.u64 = float32_compare_quiet(a, b, &soft_status);
                     break;
+                case OP_ROUND:
+                    res.f32 = float32_round_to_int(a, &soft_status);
+                    break;
+                case OP_TO_INT:
+                    res.u64 = float32_to_int32(a, &soft_status);
+                    break;
+                case OP_FROM_INT:
+                    res.f32 = int32_to_float32(ops[0].u64, &soft_status);
+                    break;
                 default:
                     g_assert_not_reached();
                 }
             }
             break;
         case PREC_FLOAT64:
-            fill_random(ops, n_ops, prec, no_neg);
+            fill_random(ops, n_ops, prec, op, no_neg);
             t0 = get_clock();
             for (i = 0; i < OPS_PER_ITER; i++) {
                 float64 a = ops[0].f64;
@@ -340,6 +475,55 @@ static void bench(enum precision prec, enum op op, int n_ops, bool no_neg)
                 case OP_CMP:
                     res.u64 = float64_compare_quiet(a, b, &soft_status);
                     break;
+                case OP_ROUND:
+                    res.f64 = float64_round_to_int(a, &soft_status);
+                    break;
+                case OP_TO_INT:
+                    res.u64 = float64_to_int64(a, &soft_status);
+                    break;
+                case OP_FROM_INT:
+                    res.f64 = int64_to_float64(ops[0].u64, &soft_status);
+                    break;
+                default:
+                    g_assert_not_reached();
+                }
+            }
+            break;
+        case PREC_FLOATX80:
+            fill_random(ops, n_ops, prec, op, no_neg);
+            t0 = get_clock();
+            for (i = 0; i < OPS_PER_ITER; i++) {
+                floatx80 a = ops[0].fx80;
+                floatx80 b = ops[1].fx80;
+
+                switch (op) {
+                case OP_ADD:
+                    res.fx80 = floatx80_add(a, b, &soft_status);
+                    break;
+                case OP_SUB:
+                    res.fx80 = floatx80_sub(a, b, &soft_status);
+                    break;
+                case OP_MUL:
+                    res.fx80 = floatx80_mul(a, b, &soft_status);
+                    break;
+                case OP_DIV:
+                    res.fx80 = floatx80_div(a, b, &soft_status);
+                    break;
+                case OP_SQRT:
+                    res.fx80 = floatx80_sqrt(a, &soft_status);
+                    break;
+                case OP_CMP:
+                    res.u64 = floatx80_compare_quiet(a, b, &soft_status);
+                    break;
+                case OP_ROUND:
+                    res.fx80 = floatx80_round_to_int(a, &soft_status);
+                    break;
+                case OP_TO_INT:
+                    res.u64 = floatx80_to_int64(a, &soft_status);
+                    break;
+                case OP_FROM_INT:
+                    res.fx80 = int64_to_floatx80(ops[0].u64, &soft_status);
+                    break;
                 default:
                     g_assert_not_reached();
                 }
@@ -365,25 +549,40 @@ static void bench(enum precision prec, enum op op, int n_ops, bool no_neg)
         bench(prec, op, n_ops, true);                   \
     }
 
-#define GEN_BENCH_ALL_TYPES(opname, op, n_ops)                          \
+#define GEN_BENCH_IEEE_TYPES(opname, op, n_ops)                         \
     GEN_BENCH(bench_ ## opname ## _float, float, PREC_SINGLE, op, n_ops) \
     GEN_BENCH(bench_ ## opname ## _double, double, PREC_DOUBLE, op, n_ops) \
     GEN_BENCH(bench_ ## opname ## _float32, float32, PREC_FLOAT32, op, n_ops) \
     GEN_BENCH(bench_ ## opname ## _float64, float64, PREC_FLOAT64, op, n_ops)
 
+#define GEN_BENCH_ALL_TYPES(opname, op, n_ops)                          \
+    GEN_BENCH_IEEE_TYPES(opname, op, n_ops)                             \
+    GEN_BENCH(bench_ ## opname ## _extended, long double, PREC_EXTENDED, \
+              op, n_ops)                                                \
+    GEN_BENCH(bench_ ## opname ## _floatx80, floatx80, PREC_FLOATX80,   \
+              op, n_ops)
+
 GEN_BENCH_ALL_TYPES(add, OP_ADD, 2)
 GEN_BENCH_ALL_TYPES(sub, OP_SUB, 2)
 GEN_BENCH_ALL_TYPES(mul, OP_MUL, 2)
 GEN_BENCH_ALL_TYPES(div, OP_DIV, 2)
-GEN_BENCH_ALL_TYPES(fma, OP_FMA, 3)
+GEN_BENCH_IEEE_TYPES(fma, OP_FMA, 3)
 GEN_BENCH_ALL_TYPES(cmp, OP_CMP, 2)
+GEN_BENCH_ALL_TYPES(round, OP_ROUND, 1)
+GEN_BENCH_ALL_TYPES(to_int, OP_TO_INT, 1)
+GEN_BENCH_ALL_TYPES(from_int, OP_FROM_INT, 1)
 #undef GEN_BENCH_ALL_TYPES
+#undef GEN_BENCH_IEEE_TYPES
 
 #define GEN_BENCH_ALL_TYPES_NO_NEG(name, op, n)                         \
     GEN_BENCH_NO_NEG(bench_ ## name ## _float, float, PREC_SINGLE, op, n) \
     GEN_BENCH_NO_NEG(bench_ ## name ## _double, double, PREC_DOUBLE, op, n) \
     GEN_BENCH_NO_NEG(bench_ ## name ## _float32, float32, PREC_FLOAT32, op, n) \
-    GEN_BENCH_NO_NEG(bench_ ## name ## _float64, float64, PREC_FLOAT64, op, n)
+    GEN_BENCH_NO_NEG(bench_ ## name ## _float64, float64, PREC_FLOAT64, op, n) \
+    GEN_BENCH_NO_NEG(bench_ ## name ## _extended, long double,           \
+                     PREC_EXTENDED, op, n)                              \
+    GEN_BENCH_NO_NEG(bench_ ## name ## _floatx80, floatx80,             \
+                     PREC_FLOATX80, op, n)
 
 GEN_BENCH_ALL_TYPES_NO_NEG(sqrt, OP_SQRT, 1)
 #undef GEN_BENCH_ALL_TYPES_NO_NEG
@@ -392,6 +591,17 @@ GEN_BENCH_ALL_TYPES_NO_NEG(sqrt, OP_SQRT, 1)
 #undef GEN_BENCH
 
 #define GEN_BENCH_FUNCS(opname, op)                             \
+    [op] = {                                                    \
+        [PREC_SINGLE]    = bench_ ## opname ## _float,          \
+        [PREC_DOUBLE]    = bench_ ## opname ## _double,         \
+        [PREC_EXTENDED]  = bench_ ## opname ## _extended,       \
+        [PREC_FLOAT32]   = bench_ ## opname ## _float32,        \
+        [PREC_FLOAT64]   = bench_ ## opname ## _float64,        \
+        [PREC_FLOATX80]  = bench_ ## opname ## _floatx80,       \
+    }
+
+/* softfloat has no floatx80 fused multiply-add */
+#define GEN_BENCH_IEEE_FUNCS(opname, op)                        \
     [op] = {                                                    \
         [PREC_SINGLE]    = bench_ ## opname ## _float,          \
         [PREC_DOUBLE]    = bench_ ## opname ## _double,         \
@@ -404,11 +614,15 @@ static const bench_func_t bench_funcs[OP_MAX_NR][PREC_MAX_NR] = {
     GEN_BENCH_FUNCS(sub, OP_SUB),
     GEN_BENCH_FUNCS(mul, OP_MUL),
     GEN_BENCH_FUNCS(div, OP_DIV),
-    GEN_BENCH_FUNCS(fma, OP_FMA),
+    GEN_BENCH_IEEE_FUNCS(fma, OP_FMA),
     GEN_BENCH_FUNCS(sqrt, OP_SQRT),
     GEN_BENCH_FUNCS(cmp, OP_CMP),
+    GEN_BENCH_FUNCS(round, OP_ROUND),
+    GEN_BENCH_FUNCS(to_int, OP_TO_INT),
+    GEN_BENCH_FUNCS(from_int, OP_FROM_INT),
 };
 
+#undef GEN_BENCH_IEEE_FUNCS
 #undef GEN_BENCH_FUNCS
 
 static void run_bench(void)
@@ -416,7 +630,11 @@ static void run_bench(void)
     bench_func_t f;
 
     f = bench_funcs[operation][precision];
-    g_assert(f);
+    if (!f) {
+        fprintf(stderr, "fatal: '%s' not supported at this precision\n",
+                op_names[operation]);
+        exit(EXIT_FAILURE);
+    }
     f();
 }
 
@@ -445,8 +663,8 @@ static void usage_complete(int argc, char *argv[])
     fprintf(stderr, " -h = show this help message.\n");
     fprintf(stderr, " -o = floating point operation (%s). Default: %s\n",
             op_list, op_names[0]);
-    fprintf(stderr, " -p = floating point precision (single, double). "
-            "Default: single\n");
+    fprintf(stderr, " -p = floating point precision (single, double, "
+            "extended). Default: single\n");
     fprintf(stderr, " -r = rounding mode (even, zero, down, up, tieaway). "
             "Default: even\n");
     fprintf(stderr, " -t = tester (%s). Default: %s\n",
@@ -565,6 +783,8 @@ static void parse_args(int argc, char *argv[])
                 precision = PREC_SINGLE;
             } else if (!strcmp(optarg, "double")) {
                 precision = PREC_DOUBLE;
+            } else if (!strcmp(optarg, "extended")) {
+                precision = PREC_EXTENDED;
             } else {
                 fprintf(stderr, "Unsupported precision '%s'\n", optarg);
                 exit(EXIT_FAILURE);
@@ -608,6 +828,10 @@ static void parse_args(int argc, char *argv[])
         case PREC_DOUBLE:
             precision = PREC_FLOAT64;
             break;
+        case PREC_EXTENDED:
+            precision = PREC_FLOATX80;
+            soft_status.floatx80_rounding_precision = 80;
+            break;
         default:
             g_assert_not_reached();
         }
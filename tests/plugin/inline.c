@@ -0,0 +1,159 @@
+/*
+ * Check per-vCPU inline operations and conditional callbacks
+ *
+ * Every event is counted twice, once with an inline operation on a
+ * scoreboard and once with a regular callback, and both counts must
+ * match for each vCPU. A conditional callback fires every
+ * COND_PERIOD instructions, which is checked against the instruction
+ * count as well.
+ *
+ * License: GNU GPL, version 2 or later.
+ *   See the COPYING file in the top-level directory.
+ */
+#include <inttypes.h>
+#include <stdio.h>
+#include <glib.h>
+
+#include <qemu-plugin.h>
+
+QEMU_PLUGIN_EXPORT int qemu_plugin_version = QEMU_PLUGIN_VERSION;
+
+#define COND_PERIOD 1000
+
+typedef struct {
+    uint64_t tb_inline;
+    uint64_t tb_cb;
+    uint64_t insn_inline;
+    uint64_t insn_cb;
+    uint64_t mem_inline;
+    uint64_t mem_cb;
+    /* instructions since the conditional callback last fired */
+    uint64_t tick;
+    uint64_t cond_cb;
+} CPUCount;
+
+static struct qemu_plugin_scoreboard *counts;
+static qemu_plugin_u64 tb_inline;
+static qemu_plugin_u64 tb_cb;
+static qemu_plugin_u64 insn_inline;
+static qemu_plugin_u64 insn_cb;
+static qemu_plugin_u64 mem_inline;
+static qemu_plugin_u64 mem_cb;
+static qemu_plugin_u64 tick;
+static qemu_plugin_u64 cond_cb;
+
+static GMutex lock;
+static unsigned int n_vcpus;
+
+static void plugin_exit(qemu_plugin_id_t id, void *udata)
+{
+    g_autoptr(GString) report = g_string_new("");
+    unsigned int i;
+
+    for (i = 0; i < n_vcpus; i++) {
+        uint64_t insns = qemu_plugin_u64_get(insn_inline, i);
+        uint64_t conds = insns ? (insns - 1) / COND_PERIOD : 0;
+
+        g_assert_cmpuint(qemu_plugin_u64_get(tb_inline, i), ==,
+                         qemu_plugin_u64_get(tb_cb, i));
+        g_assert_cmpuint(insns, ==, qemu_plugin_u64_get(insn_cb, i));
+        g_assert_cmpuint(qemu_plugin_u64_get(mem_inline, i), ==,
+                         qemu_plugin_u64_get(mem_cb, i));
+        g_assert_cmpuint(qemu_plugin_u64_get(cond_cb, i), ==, conds);
+    }
+
+    g_string_printf(report, "tb: %" PRIu64 ", insn: %" PRIu64
+                    ", mem: %" PRIu64 ", cond: %" PRIu64 "\n",
+                    qemu_plugin_u64_sum(tb_inline),
+                    qemu_plugin_u64_sum(insn_inline),
+                    qemu_plugin_u64_sum(mem_inline),
+                    qemu_plugin_u64_sum(cond_cb));
+    qemu_plugin_outs(report->str);
+    qemu_plugin_scoreboard_free(counts);
+}
+
+static void vcpu_init(qemu_plugin_id_t id, unsigned int cpu_index)
+{
+    g_mutex_lock(&lock);
+    n_vcpus = MAX(n_vcpus, cpu_index + 1);
+    g_mutex_unlock(&lock);
+}
+
+static void vcpu_tb_exec(unsigned int cpu_index, void *udata)
+{
+    qemu_plugin_u64_add(tb_cb, cpu_index, 1);
+}
+
+static void vcpu_insn_exec(unsigned int cpu_index, void *udata)
+{
+    qemu_plugin_u64_add(insn_cb, cpu_index, 1);
+}
+
+static void vcpu_insn_cond(unsigned int cpu_index, void *udata)
+{
+    qemu_plugin_u64_add(cond_cb, cpu_index, 1);
+    qemu_plugin_u64_set(tick, cpu_index, 0);
+}
+
+static void vcpu_mem_access(unsigned int cpu_index, qemu_plugin_meminfo_t info,
+                            uint64_t vaddr, void *udata)
+{
+    qemu_plugin_u64_add(mem_cb, cpu_index, 1);
+}
+
+static void vcpu_tb_trans(qemu_plugin_id_t id, struct qemu_plugin_tb *tb)
+{
+    size_t n_insns = qemu_plugin_tb_n_insns(tb);
+    size_t i;
+
+    qemu_plugin_register_vcpu_tb_exec_inline_per_vcpu(
+        tb, QEMU_PLUGIN_INLINE_ADD_U64, tb_inline, 1);
+    qemu_plugin_register_vcpu_tb_exec_cb(tb, vcpu_tb_exec,
+                                         QEMU_PLUGIN_CB_NO_REGS, NULL);
+
+    for (i = 0; i < n_insns; i++) {
+        struct qemu_plugin_insn *insn = qemu_plugin_tb_get_insn(tb, i);
+
+        /* the condition is checked before the inline ops are executed */
+        qemu_plugin_register_vcpu_insn_exec_cond_cb(
+            insn, vcpu_insn_cond, QEMU_PLUGIN_CB_NO_REGS,
+            QEMU_PLUGIN_COND_GE, tick, COND_PERIOD, NULL);
+        qemu_plugin_register_vcpu_insn_exec_inline_per_vcpu(
+            insn, QEMU_PLUGIN_INLINE_ADD_U64, tick, 1);
+
+        qemu_plugin_register_vcpu_insn_exec_inline_per_vcpu(
+            insn, QEMU_PLUGIN_INLINE_ADD_U64, insn_inline, 1);
+        qemu_plugin_register_vcpu_insn_exec_cb(insn, vcpu_insn_exec,
+                                               QEMU_PLUGIN_CB_NO_REGS, NULL);
+
+        qemu_plugin_register_vcpu_mem_inline_per_vcpu(
+            insn, QEMU_PLUGIN_MEM_RW, QEMU_PLUGIN_INLINE_ADD_U64,
+            mem_inline, 1);
+        qemu_plugin_register_vcpu_mem_cb(insn, vcpu_mem_access,
+                                         QEMU_PLUGIN_CB_NO_REGS,
+                                         QEMU_PLUGIN_MEM_RW, NULL);
+    }
+}
+
+QEMU_PLUGIN_EXPORT int qemu_plugin_install(qemu_plugin_id_t id,
+                                           const qemu_info_t *info,
+                                           int argc, char **argv)
+{
+    counts = qemu_plugin_scoreboard_new(sizeof(CPUCount));
+    tb_inline = qemu_plugin_scoreboard_u64_in_struct(counts, CPUCount,
+                                                     tb_inline);
+    tb_cb = qemu_plugin_scoreboard_u64_in_struct(counts, CPUCount, tb_cb);
+    insn_inline = qemu_plugin_scoreboard_u64_in_struct(counts, CPUCount,
+                                                       insn_inline);
+    insn_cb = qemu_plugin_scoreboard_u64_in_struct(counts, CPUCount, insn_cb);
+    mem_inline = qemu_plugin_scoreboard_u64_in_struct(counts, CPUCount,
+                                                      mem_inline);
+    mem_cb = qemu_plugin_scoreboard_u64_in_struct(counts, CPUCount, mem_cb);
+    tick = qemu_plugin_scoreboard_u64_in_struct(counts, CPUCount, tick);
+    cond_cb = qemu_plugin_scoreboard_u64_in_struct(counts, CPUCount, cond_cb);
+
+    qemu_plugin_register_vcpu_init_cb(id, vcpu_init);
+    qemu_plugin_register_vcpu_tb_trans_cb(id, vcpu_tb_trans);
+    qemu_plugin_register_atexit_cb(id, plugin_exit, NULL);
+    return 0;
+}
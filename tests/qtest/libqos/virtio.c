@@ -23,7 +23,7 @@
  * The following qvirtio_readX/writeX() functions handle Legacy and VIRTIO 1.0
  * accesses seamlessly.
  */
-static uint16_t qvirtio_readw(QVirtioDevice *d, QTestState *qts, uint64_t addr)
+uint16_t qvirtio_readw(QVirtioDevice *d, QTestState *qts, uint64_t addr)
 {
     uint16_t val = qtest_readw(qts, addr);
 
@@ -43,8 +43,8 @@ static uint32_t qvirtio_readl(QVirtioDevice *d, QTestState *qts, uint64_t addr)
     return val;
 }
 
-static void qvirtio_writew(QVirtioDevice *d, QTestState *qts,
-                           uint64_t addr, uint16_t val)
+void qvirtio_writew(QVirtioDevice *d, QTestState *qts,
+                    uint64_t addr, uint16_t val)
 {
     if (d->features & (1ull << VIRTIO_F_VERSION_1) && qtest_big_endian(qts)) {
         val = bswap16(val);
@@ -101,6 +101,11 @@ static inline uint32_t qvring_size(uint32_t num, uint32_t align)
         + sizeof(uint16_t) * 3 + sizeof(struct vring_used_elem) * num;
 }
 
+/* Vring accessors, for tests that drive the rings by hand */
+uint16_t qvirtio_readw(QVirtioDevice *d, QTestState *qts, uint64_t addr);
+void qvirtio_writew(QVirtioDevice *d, QTestState *qts,
+                    uint64_t addr, uint16_t val);
+
 uint8_t qvirtio_config_readb(QVirtioDevice *d, uint64_t addr);
 uint16_t qvirtio_config_readw(QVirtioDevice *d, uint64_t addr);
 uint32_t qvirtio_config_readl(QVirtioDevice *d, uint64_t addr);
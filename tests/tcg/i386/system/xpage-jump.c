@@ -0,0 +1,130 @@
+/*
+ * Direct jumps to another page, with a changing mapping
+ *
+ * Map a page of code that jumps to the next page, both to its start and
+ * to the middle of it, then change the mapping of that next page between
+ * calls, either with invlpg or with a full TLB flush.  The translated
+ * jumps must always reach the code that is currently mapped.  The
+ * Makefile checks the exec log to make sure that the jumps were chained.
+ *
+ * We don't have the benefit of libc, just builtin C primitives and
+ * whatever is in minilib.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <minilib.h>
+
+#define PAGE_SIZE   4096
+#define PG_PRESENT  0x001
+#define PG_RW       0x002
+#define PG_PSE      0x080
+#define CR0_PG      0x80000000
+#define CR4_PSE     0x00000010
+
+/* Virtual address of the code, past the identity mapped first 4MB */
+#define CODE_VADDR  0x400000
+
+/* Entry points in the first page, and their targets in the second */
+#define ENTRY_ALIGNED   0x000
+#define ENTRY_UNALIGNED 0x100
+#define TARGET_UNALIGNED 0x234
+
+#define ROUNDS      8
+#define CALLS       1000
+
+static uint32_t pgdir[1024] __attribute__((aligned(PAGE_SIZE)));
+static uint32_t pgtab[1024] __attribute__((aligned(PAGE_SIZE)));
+static uint8_t code[3][PAGE_SIZE] __attribute__((aligned(PAGE_SIZE)));
+
+static void enable_paging(void)
+{
+    uint32_t cr;
+
+    /* identity map the first 4MB, which holds the test and its stack */
+    pgdir[0] = PG_PRESENT | PG_RW | PG_PSE;
+    pgdir[CODE_VADDR >> 22] = (uint32_t)pgtab | PG_PRESENT | PG_RW;
+
+    asm volatile("mov %%cr4, %0" : "=r"(cr));
+    asm volatile("mov %0, %%cr4" : : "r"(cr | CR4_PSE));
+    asm volatile("mov %0, %%cr3" : : "r"(pgdir) : "memory");
+    asm volatile("mov %%cr0, %0" : "=r"(cr));
+    asm volatile("mov %0, %%cr0" : : "r"(cr | CR0_PG) : "memory");
+}
+
+/* Map page @n of the code to code[@i] */
+static void map_code(int n, int i, bool full_flush)
+{
+    uint32_t cr3;
+
+    pgtab[n] = (uint32_t)code[i] | PG_PRESENT | PG_RW;
+    if (full_flush) {
+        asm volatile("mov %%cr3, %0; mov %0, %%cr3" : "=r"(cr3) : : "memory");
+    } else {
+        asm volatile("invlpg (%0)"
+                     : : "r"(CODE_VADDR + n * PAGE_SIZE) : "memory");
+    }
+}
+
+static void write_code(void)
+{
+    int i;
+
+    /* jmp to the start of the next page */
+    code[0][ENTRY_ALIGNED] = 0xe9;
+    *(uint32_t *)&code[0][ENTRY_ALIGNED + 1] =
+        PAGE_SIZE - (ENTRY_ALIGNED + 5);
+
+    /* jmp to the middle of the next page */
+    code[0][ENTRY_UNALIGNED] = 0xe9;
+    *(uint32_t *)&code[0][ENTRY_UNALIGNED + 1] =
+        PAGE_SIZE + TARGET_UNALIGNED - (ENTRY_UNALIGNED + 5);
+
+    /* mov $i, %eax; ret  and  mov $i + 10, %eax; ret */
+    for (i = 1; i < 3; i++) {
+        code[i][0] = 0xb8;
+        *(uint32_t *)&code[i][1] = i;
+        code[i][5] = 0xc3;
+
+        code[i][TARGET_UNALIGNED] = 0xb8;
+        *(uint32_t *)&code[i][TARGET_UNALIGNED + 1] = i + 10;
+        code[i][TARGET_UNALIGNED + 5] = 0xc3;
+    }
+}
+
+static bool call_code(int entry, int expected, int round, int call)
+{
+    int (*fn)(void) = (int (*)(void))(CODE_VADDR + entry);
+    int r = fn();
+
+    if (r != expected) {
+        ml_printf("FAIL: entry %x round %d call %d: got %d, expected %d\n",
+                  entry, round, call, r, expected);
+        return false;
+    }
+    return true;
+}
+
+int main(void)
+{
+    int round, i;
+
+    write_code();
+    pgtab[0] = (uint32_t)code[0] | PG_PRESENT | PG_RW;
+    enable_paging();
+
+    for (round = 0; round < ROUNDS; round++) {
+        int expected = 1 + round % 2;
+
+        map_code(1, expected, round % 4 >= 2);
+        for (i = 0; i < CALLS; i++) {
+            if (!call_code(ENTRY_ALIGNED, expected, round, i) ||
+                !call_code(ENTRY_UNALIGNED, expected + 10, round, i)) {
+                return 1;
+            }
+        }
+    }
+
+    ml_printf("PASS\n");
+    return 0;
+}
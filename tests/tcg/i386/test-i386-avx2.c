@@ -0,0 +1,87 @@
+/* See if various AVX and AVX2 instructions give expected results */
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+typedef int32_t v8si __attribute__((vector_size(32), aligned(32)));
+typedef int64_t v4di __attribute__((vector_size(32), aligned(32)));
+typedef float v4sf __attribute__((vector_size(16), aligned(16)));
+
+static int eq32(v8si a, v8si b)
+{
+    return memcmp(&a, &b, sizeof(a)) == 0;
+}
+
+int main(int argc, char *argv[])
+{
+    v8si a = { 1, 2, 3, 4, 5, 6, 7, 8 };
+    v8si b = { 10, 20, 30, 40, 50, 60, 70, 80 };
+    v8si idx = { 7, 6, 5, 4, 3, 2, 1, 0 };
+    int32_t table[8] = { 100, 101, 102, 103, 104, 105, 106, 107 };
+    v8si r;
+    v4di q;
+    v4sf f;
+    int mask;
+
+    /* three-operand integer op on both lanes, via gvec */
+    asm volatile ("vpaddd %2, %1, %0" : "=x"(r) : "x"(a), "x"(b));
+    assert(eq32(r, (v8si){ 11, 22, 33, 44, 55, 66, 77, 88 }));
+
+    /* VEX.128 form clears the upper lane of the destination */
+    r = b;
+    asm volatile ("vpsubd %x2, %x1, %x0" : "+x"(r) : "x"(b), "x"(a));
+    assert(eq32(r, (v8si){ 9, 18, 27, 36, 0, 0, 0, 0 }));
+
+    /* lane-wise helper, destination aliasing the vvvv operand */
+    r = a;
+    asm volatile ("vpunpckldq %1, %0, %0" : "+x"(r) : "x"(b));
+    assert(eq32(r, (v8si){ 1, 10, 2, 20, 5, 50, 6, 60 }));
+
+    /* shifts by immediate, including counts larger than the element */
+    asm volatile ("vpslld $4, %1, %0" : "=x"(r) : "x"(a));
+    assert(eq32(r, (v8si){ 16, 32, 48, 64, 80, 96, 112, 128 }));
+    asm volatile ("vpsrld $40, %1, %0" : "=x"(r) : "x"(a));
+    assert(eq32(r, (v8si){ 0 }));
+
+    /* cross-lane permute */
+    asm volatile ("vpermd %2, %1, %0" : "=x"(r) : "x"(idx), "x"(b));
+    assert(eq32(r, (v8si){ 80, 70, 60, 50, 40, 30, 20, 10 }));
+
+    /* vinserti128 / vextracti128 */
+    asm volatile ("vinserti128 $1, %x2, %1, %0" : "=x"(r) : "x"(a), "x"(b));
+    assert(eq32(r, (v8si){ 1, 2, 3, 4, 10, 20, 30, 40 }));
+    asm volatile ("vextracti128 $1, %1, %x0" : "=x"(r) : "x"(b));
+    assert(eq32(r, (v8si){ 50, 60, 70, 80, 0, 0, 0, 0 }));
+
+    /* vpmovzxdq widens across lanes */
+    asm volatile ("vpmovzxdq %x1, %0" : "=x"(q) : "x"(a));
+    assert(q[0] == 1 && q[1] == 2 && q[2] == 3 && q[3] == 4);
+
+    /* broadcast */
+    asm volatile ("vpbroadcastd %x1, %0" : "=x"(r) : "x"(b));
+    assert(eq32(r, (v8si){ 10, 10, 10, 10, 10, 10, 10, 10 }));
+
+    /* gather with a partial mask */
+    r = (v8si){ -1, -1, -1, -1, -1, -1, -1, -1 };
+    {
+        v8si m = { -1, 0, -1, 0, -1, 0, -1, 0 };
+        asm volatile ("vpgatherdd %1, (%3,%2,4), %0"
+                      : "+x"(r), "+x"(m) : "x"(idx), "r"(table) : "memory");
+        assert(eq32(m, (v8si){ 0 }));
+    }
+    assert(eq32(r, (v8si){ 107, -1, 105, -1, 103, -1, 101, -1 }));
+
+    /* vpmovmskb on 256 bits */
+    r = (v8si){ -1, 0, 0, 0, 0, 0, 0, -1 };
+    asm volatile ("vpmovmskb %1, %0" : "=r"(mask) : "x"(r));
+    assert((unsigned)mask == 0xf000000fu);
+
+    /* scalar op merges the upper elements from vvvv */
+    f = (v4sf){ 1.0f, 2.0f, 3.0f, 4.0f };
+    asm volatile ("vaddss %2, %1, %0"
+                  : "=x"(f) : "x"(f), "x"((v4sf){ 0.5f, 9, 9, 9 }));
+    assert(f[0] == 1.5f && f[1] == 2.0f && f[2] == 3.0f && f[3] == 4.0f);
+
+    asm volatile ("vzeroupper");
+    return 0;
+}
@@ -0,0 +1,146 @@
+/*
+ * Concurrent mmap/mprotect/munmap stress test
+ *
+ * Several threads map, protect, remap, check and unmap their own regions at
+ * the same time, so that the address space changes under each of them
+ * while they rely on the protection of their own mappings.  The run
+ * time is reported, making the test a benchmark of the user-mode
+ * memory management paths as well.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#define N_THREADS   8
+#define ITERATIONS  500
+#define MAX_PAGES   64
+
+static long page_size;
+
+static bool churn(unsigned int id, int fd)
+{
+    unsigned int seed = id;
+    int i;
+
+    for (i = 0; i < ITERATIONS; i++) {
+        size_t pages = 1 + rand_r(&seed) % MAX_PAGES;
+        size_t len = pages * page_size;
+        size_t half = pages / 2 * page_size;
+        unsigned char *p;
+        size_t j;
+
+        p = mmap(NULL, len, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED) {
+            perror("mmap");
+            return false;
+        }
+        for (j = 0; j < pages; j++) {
+            p[j * page_size] = id + j;
+        }
+
+        /* make the middle of the region inaccessible for a while */
+        if (pages >= 3) {
+            size_t mid = len - 2 * page_size;
+
+            if (mprotect(p + page_size, mid, PROT_NONE)) {
+                perror("mprotect");
+                return false;
+            }
+            if (pwrite(fd, p + page_size, page_size, 0) != -1 ||
+                errno != EFAULT) {
+                fprintf(stderr, "thread %u: read from PROT_NONE page\n", id);
+                return false;
+            }
+            if (mprotect(p + page_size, mid, PROT_READ)) {
+                perror("mprotect");
+                return false;
+            }
+        }
+
+        if (pwrite(fd, p, len, 0) != (ssize_t)len) {
+            fprintf(stderr, "thread %u: cannot read back region\n", id);
+            return false;
+        }
+        for (j = 0; j < pages; j++) {
+            if (p[j * page_size] != (unsigned char)(id + j)) {
+                fprintf(stderr, "thread %u: page %zu corrupted\n", id, j);
+                return false;
+            }
+        }
+
+        /* replace the last page with a fresh zeroed one in place */
+        if (mmap(p + len - page_size, page_size, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0) !=
+            p + len - page_size) {
+            perror("mmap");
+            return false;
+        }
+        if (p[len - page_size] != 0) {
+            fprintf(stderr, "thread %u: MAP_FIXED page not zeroed\n", id);
+            return false;
+        }
+
+        /* unmap in two steps so that the mapping is split first */
+        if (munmap(p + half, len - half) || (half && munmap(p, half))) {
+            perror("munmap");
+            return false;
+        }
+    }
+    return true;
+}
+
+static void *thread_fn(void *arg)
+{
+    unsigned int id = (uintptr_t)arg;
+    FILE *f = tmpfile();
+    bool ok;
+
+    if (!f) {
+        perror("tmpfile");
+        return (void *)1;
+    }
+    ok = churn(id, fileno(f));
+    fclose(f);
+    return ok ? NULL : (void *)1;
+}
+
+int main(int argc, char **argv)
+{
+    pthread_t threads[N_THREADS];
+    struct timespec start, end;
+    bool failed = false;
+    uintptr_t i;
+
+    page_size = sysconf(_SC_PAGESIZE);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (i = 0; i < N_THREADS; i++) {
+        if (pthread_create(&threads[i], NULL, thread_fn, (void *)i)) {
+            perror("pthread_create");
+            return EXIT_FAILURE;
+        }
+    }
+    for (i = 0; i < N_THREADS; i++) {
+        void *ret;
+
+        pthread_join(threads[i], &ret);
+        failed |= ret != NULL;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    printf("%d threads x %d iterations: %ld ms\n", N_THREADS, ITERATIONS,
+           (long)(end.tv_sec - start.tv_sec) * 1000 +
+           (end.tv_nsec - start.tv_nsec) / 1000000);
+
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
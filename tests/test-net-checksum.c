@@ -0,0 +1,136 @@
+/*
+ * Internet checksum test
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or
+ * (at your option) any later version.  See the COPYING file in the
+ * top-level directory.
+ */
+#include "qemu/osdep.h"
+#include "qemu/units.h"
+#include "qemu/iov.h"
+#include "net/checksum.h"
+
+#define BUF_LEN (64 * KiB + 37)
+
+static uint8_t buffer[BUF_LEN];
+
+/* The byte-at-a-time loop that the accelerated routines must match.  */
+static uint32_t checksum_ref(const uint8_t *buf, size_t len, int seq)
+{
+    uint32_t sum1 = 0, sum2 = 0;
+    size_t i;
+
+    for (i = 0; i + 1 < len; i += 2) {
+        sum1 += buf[i];
+        sum2 += buf[i + 1];
+    }
+    if (i < len) {
+        sum1 += buf[i];
+    }
+    return (seq & 1) ? sum1 + (sum2 << 8) : sum2 + (sum1 << 8);
+}
+
+static void check_flat(const uint8_t *buf, size_t len, int seq)
+{
+    uint32_t sum = net_checksum_add_cont(len, (uint8_t *)buf, seq);
+    uint32_t ref = checksum_ref(buf, len, seq);
+
+    g_assert_cmphex(net_checksum_finish(sum), ==, net_checksum_finish(ref));
+    /* Zero only for all-zero data, callers rely on that */
+    g_assert_cmpint(sum == 0, ==, ref == 0);
+}
+
+static void test_flat(void)
+{
+    size_t a, s;
+    int i;
+
+    /* Every alignment and length around the vector thresholds */
+    for (a = 0; a < 32; a++) {
+        for (s = 0; s < 300; s++) {
+            check_flat(buffer + a, s, 0);
+            check_flat(buffer + a, s, 1);
+        }
+    }
+
+    /* Long buffers, including some that need several lane reductions */
+    for (i = 0; i < 100; i++) {
+        size_t off = g_test_rand_int_range(0, 16);
+        size_t n = g_test_rand_int_range(0, BUF_LEN - off);
+
+        check_flat(buffer + off, n, i & 1);
+    }
+    check_flat(buffer, BUF_LEN, 0);
+}
+
+static void test_flat_all_accel(void)
+{
+    do {
+        test_flat();
+    } while (test_net_checksum_next_accel());
+}
+
+static void test_edge_values(void)
+{
+    static uint8_t ones[4096];
+
+    /* All 0xff sums to 0xffff, never to 0 */
+    memset(ones, 0xff, sizeof(ones));
+    check_flat(ones, sizeof(ones), 0);
+    check_flat(ones, 63, 1);
+    check_flat(ones, 1, 0);
+
+    memset(ones, 0, sizeof(ones));
+    check_flat(ones, sizeof(ones), 0);
+    g_assert_cmphex(net_checksum_add_cont(sizeof(ones), ones, 0), ==, 0);
+}
+
+static void test_iov(void)
+{
+    struct iovec iov[8];
+    int i, j;
+
+    for (i = 0; i < 2000; i++) {
+        size_t start = g_test_rand_int_range(0, 16);
+        size_t pos = start, total = 0, iov_off, size;
+        uint32_t csum_offset = g_test_rand_int_range(0, 4);
+        int cnt = g_test_rand_int_range(1, ARRAY_SIZE(iov) + 1);
+        uint32_t sum, ref;
+
+        /* Segments of random, often odd, length; some empty */
+        for (j = 0; j < cnt; j++) {
+            size_t len = g_test_rand_int_range(0, i < 1000 ? 80 : 3000);
+
+            iov[j].iov_base = buffer + pos;
+            iov[j].iov_len = len;
+            pos += len;
+            total += len;
+        }
+        iov_off = g_test_rand_int_range(0, total + 1);
+        size = g_test_rand_int_range(0, total - iov_off + 1);
+
+        sum = net_checksum_add_iov(iov, cnt, iov_off, size, csum_offset);
+        ref = checksum_ref(buffer + start + iov_off, size, csum_offset);
+        g_assert_cmphex(net_checksum_finish(sum), ==,
+                        net_checksum_finish(ref));
+        g_assert_cmpint(sum == 0, ==, ref == 0);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    size_t i;
+
+    g_test_init(&argc, &argv, NULL);
+
+    for (i = 0; i < sizeof(buffer); i++) {
+        buffer[i] = g_test_rand_int();
+    }
+
+    g_test_add_func("/net/checksum/edge-values", test_edge_values);
+    g_test_add_func("/net/checksum/iov", test_iov);
+    /* Last, because it walks down to the generic implementation.  */
+    g_test_add_func("/net/checksum/flat", test_flat_all_accel);
+
+    return g_test_run();
+}